@@ -0,0 +1,141 @@
+/**
+    @file BenchmarkScene.h
+    @brief Headless GL context and the sphere grid scene shared by RenderBenchmark and BatchRenderer
+    @details The context is an OpenGL core context created through EGL on the surfaceless Mesa platform, so it needs
+    no window, display server or GPU (Mesa llvmpipe renders on the CPU). The scene is a square grid of spheres in the
+    XZ plane, a sun and a ring of point lights above the grid; the executables build their Shapes, Lights or
+    software renderer submissions out of these placements so every renderer draws the same frames.
+*/
+
+#pragma once
+#ifndef BENCHMARKSCENE_H
+#define BENCHMARKSCENE_H
+
+#include <glad/glad.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <cmath>
+#include <iostream>
+#include "../Engine/Light.h"
+#include "../Engine/Transform.h"
+
+struct HeadlessContext
+{
+    EGLDisplay display = EGL_NO_DISPLAY;
+    EGLContext context = EGL_NO_CONTEXT;
+};
+
+/*
+    Creates an OpenGL core context of at least the given version without any window or surface and loads GL
+    through glad
+    Parameters: HeadlessContext& ctx, int major, int minor
+    Returns: Boolean
+*/
+bool initHeadlessContext(HeadlessContext &ctx, int major, int minor)
+{
+    // Prefer the surfaceless Mesa platform (no X11/Wayland/GPU needed), fall back to the default display
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if (getPlatformDisplay != nullptr)
+    {
+        ctx.display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+    }
+    if (ctx.display == EGL_NO_DISPLAY)
+    {
+        ctx.display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    }
+    if (ctx.display == EGL_NO_DISPLAY || !eglInitialize(ctx.display, nullptr, nullptr))
+    {
+        std::cout << "Failed to initialize EGL" << std::endl;
+        return false;
+    }
+    if (!eglBindAPI(EGL_OPENGL_API))
+    {
+        std::cout << "EGL does not support desktop OpenGL" << std::endl;
+        return false;
+    }
+
+    EGLint configAttribs[] = {EGL_SURFACE_TYPE, EGL_PBUFFER_BIT, EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE};
+    EGLConfig config = nullptr;
+    EGLint numConfigs = 0;
+    eglChooseConfig(ctx.display, configAttribs, &config, 1, &numConfigs);
+
+    EGLint contextAttribs[] = {EGL_CONTEXT_MAJOR_VERSION, major,
+                               EGL_CONTEXT_MINOR_VERSION, minor,
+                               EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+                               EGL_NONE};
+    ctx.context = eglCreateContext(ctx.display, numConfigs > 0 ? config : (EGLConfig)0, EGL_NO_CONTEXT, contextAttribs);
+    if (ctx.context == EGL_NO_CONTEXT || !eglMakeCurrent(ctx.display, EGL_NO_SURFACE, EGL_NO_SURFACE, ctx.context))
+    {
+        std::cout << "Failed to create a surfaceless OpenGL " << major << "." << minor << " context" << std::endl;
+        return false;
+    }
+
+    if (!gladLoadGLLoader((GLADloadproc)eglGetProcAddress))
+    {
+        std::cout << "Failed to initialize GLAD" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+/*
+    Releases the EGL context and display
+    Parameters: HeadlessContext& ctx
+    Returns: None
+*/
+void destroyHeadlessContext(HeadlessContext &ctx)
+{
+    eglMakeCurrent(ctx.display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    eglDestroyContext(ctx.display, ctx.context);
+    eglTerminate(ctx.display);
+}
+
+/*
+    Placement of a sphere of the grid: spheres on a square grid in the XZ plane around the camera
+    Parameters: int index, int side (spheres per row)
+    Returns: Transform
+*/
+Transform sphereTransform(int index, int side)
+{
+    float spacing = 3.0f;
+    Transform transform;
+    transform.Translate(vec3((index % side - (side - 1) / 2.0f) * spacing, 0, (index / side - (side - 1) / 2.0f) * spacing));
+    transform.Scale(0.5f);
+    return transform;
+}
+
+/*
+    Directional light of the scene
+    Parameters: None
+    Returns: DirectionalLight
+*/
+DirectionalLight sceneSun()
+{
+    DirectionalLight sun;
+    sun.direction = vec3(-0.3f, -1, -0.2f);
+    sun.ambient = vec3(0.2f, 0.2f, 0.2f);
+    sun.diffuse = vec3(0.5f, 0.5f, 0.5f);
+    sun.specular = vec3(1.0f, 1.0f, 1.0f);
+    return sun;
+}
+
+/*
+    Point light of the ring above the grid
+    Parameters: int index, int count (lights on the ring), int side (spheres per row)
+    Returns: PointLight
+*/
+PointLight scenePointLight(int index, int count, int side)
+{
+    float angle = glm::radians(360.0f * index / count);
+    PointLight pl;
+    pl.position = vec3(std::cos(angle) * side, 3, std::sin(angle) * side);
+    pl.ambient = vec3(0.05f, 0.05f, 0.05f);
+    pl.diffuse = vec3(0.7f, 0.7f, 0.7f);
+    pl.specular = vec3(1.0f, 1.0f, 1.0f);
+    pl.constant = 1;
+    pl.linear = 0.09f;
+    pl.quadratic = 0.032f;
+    return pl;
+}
+
+#endif
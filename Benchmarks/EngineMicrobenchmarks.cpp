@@ -0,0 +1,621 @@
+/**
+    @file EngineMicrobenchmarks.cpp
+    @brief CPU microbenchmarks for engine hot paths (Google Benchmark)
+    @details Exercises the CPU side of the engine without a GL context: OBJ parsing (ObjLoader), transform composition
+    (Transform, MatrixStack), the SimdMath kernels at every level the CPU supports against glm,
+    Camera::updateCamera, point light uniform name building (heap vs FrameArena), the scaling of frame work
+    (compose, cull, sort) over 1..N JobSystem threads and BVH ray casts (the picking path). These paths are GL free
+    (Camera skips its uniform upload when no shader is set), so regressions in parse throughput or per-object CPU
+    cost show up as numbers independent of the driver.
+    Run from the build directory like the main executable so ../Resources resolves.
+*/
+
+//====| Includes |====//
+#include <glad/glad.h>
+#include <benchmark/benchmark.h>
+#include <glm/gtc/constants.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <map>
+#include <thread>
+#include <string>
+#include <vector>
+
+#include "../Engine/ObjLoader.h"
+#include "../Engine/Transform.h"
+#include "../Engine/MatrixStack.h"
+#include "../Engine/Camera.h"
+#include "../Engine/Light.h"
+#include "../Engine/JobSystem.h"
+#include "../Engine/Frustum.h"
+#include "../Engine/FrameArena.h"
+#include "../Engine/Meshlet.h"
+#include "../Engine/OcclusionCuller.h"
+#include "../Engine/SoftwareRasterizer.h"
+#include "../Engine/SimdMath.h"
+#include "../Engine/Bvh.h"
+
+//====| Helpers |====//
+
+/*
+    Generates the OBJ text of a UV sphere with v/vt/vn faces
+    Parameters: int segments (stacks, slices are twice that)
+    Returns: std::string, about 4 * segments^2 triangles
+*/
+std::string makeSphereOBJ(int segments)
+{
+    std::string obj;
+    char line[256];
+    int stacks = segments, slices = segments * 2;
+    for (int i = 0; i <= stacks; i++)
+    {
+        float phi = glm::pi<float>() * i / stacks;
+        for (int j = 0; j <= slices; j++)
+        {
+            float theta = 2 * glm::pi<float>() * j / slices;
+            float x = std::sin(phi) * std::cos(theta), y = std::cos(phi), z = std::sin(phi) * std::sin(theta);
+            snprintf(line, sizeof(line), "v %f %f %f\nvt %f %f\nvn %f %f %f\n", x, y, z, (float)j / slices, (float)i / stacks, x, y, z);
+            obj += line;
+        }
+    }
+    for (int i = 0; i < stacks; i++)
+    {
+        for (int j = 0; j < slices; j++)
+        {
+            int a = i * (slices + 1) + j + 1, b = a + slices + 1;
+            snprintf(line, sizeof(line), "f %d/%d/%d %d/%d/%d %d/%d/%d\nf %d/%d/%d %d/%d/%d %d/%d/%d\n",
+                     a, a, a, b, b, b, a + 1, a + 1, a + 1, a + 1, a + 1, a + 1, b, b, b, b + 1, b + 1, b + 1);
+            obj += line;
+        }
+    }
+    return obj;
+}
+
+/*
+    Generates the triangles of the same UV sphere as makeSphereOBJ without going through OBJ text
+    Parameters: int segments (stacks, slices are twice that), std::vector<glm::vec3>& corners (three per triangle)
+    Returns: None, about 4 * segments^2 triangles
+*/
+void makeSphereTriangles(int segments, std::vector<glm::vec3> &corners)
+{
+    int stacks = segments, slices = segments * 2;
+    std::vector<glm::vec3> grid;
+    for (int i = 0; i <= stacks; i++)
+    {
+        float phi = glm::pi<float>() * i / stacks;
+        for (int j = 0; j <= slices; j++)
+        {
+            float theta = 2 * glm::pi<float>() * j / slices;
+            grid.push_back(glm::vec3(std::sin(phi) * std::cos(theta), std::cos(phi), std::sin(phi) * std::sin(theta)));
+        }
+    }
+    corners.clear();
+    for (int i = 0; i < stacks; i++)
+    {
+        for (int j = 0; j < slices; j++)
+        {
+            int a = i * (slices + 1) + j, b = a + slices + 1;
+            corners.insert(corners.end(), {grid[a], grid[b], grid[a + 1], grid[a + 1], grid[b], grid[b + 1]});
+        }
+    }
+}
+
+/*
+    Registers the SimdMath level (scalar and SSE, the widest triangle test) with sphere sizes of ~16k to ~2M triangles
+    Parameters: benchmark::internal::Benchmark* b
+    Returns: None
+*/
+void bvhSizes(benchmark::internal::Benchmark *b)
+{
+    for (int level = 0; level <= 1; level++)
+    {
+        for (int segments : {64, 256, 724})
+        {
+            b->Args({level, segments});
+        }
+    }
+}
+
+/*
+    Registers thread counts 1, 2, 4, ... up to and including the hardware thread count
+    Parameters: benchmark::internal::Benchmark* b
+    Returns: None
+*/
+void threadCounts(benchmark::internal::Benchmark *b)
+{
+    int cores = std::max(1u, std::thread::hardware_concurrency());
+    for (int threads = 1; threads < cores; threads *= 2)
+    {
+        b->Arg(threads);
+    }
+    b->Arg(cores);
+}
+
+/*
+    Fills matrices with affine transforms and boxes with unit cubes spread around the origin
+    Parameters: int count
+*/
+void makeAffine(std::vector<glm::mat4> &matrices, std::vector<AABB> &boxes, int count)
+{
+    matrices.resize(count);
+    boxes.resize(count);
+    for (int i = 0; i < count; i++)
+    {
+        glm::mat4 m = glm::translate(glm::mat4(1.0f), glm::vec3(i % 17, i % 5, i % 11));
+        m = glm::rotate(m, 0.01f * i, glm::vec3(0, 1, 0));
+        matrices[i] = glm::scale(m, glm::vec3(1.0f + 0.001f * i));
+        boxes[i].min = glm::vec3(i % 13, i % 7, i % 3);
+        boxes[i].max = boxes[i].min + glm::vec3(1.0f);
+    }
+}
+
+/*
+    Selects the SimdMath level of a benchmark (arg 0: 0 = scalar glm, 1 = SSE, 2 = AVX2)
+    Returns: bool, false (and the benchmark is skipped) if the CPU lacks the level
+*/
+bool selectLevel(benchmark::State &state)
+{
+    SimdMath::Level level = (SimdMath::Level)state.range(0);
+    if (SimdMath::setLevel(level) != level)
+    {
+        state.SkipWithError("instruction set not supported");
+        return false;
+    }
+    state.SetLabel(SimdMath::levelName(level));
+    return true;
+}
+
+//====| Benchmarks |====//
+
+// Parse of the sphere.obj that ships with the repo
+static void BM_ParseSphereOBJ(benchmark::State &state)
+{
+    std::string data;
+    if (!ObjLoader::ReadFile("../Resources/Models/sphere.obj", data))
+    {
+        state.SkipWithError("sphere.obj not found, run from the build directory");
+        return;
+    }
+    std::vector<Vertex> vertices;
+    for (auto _ : state)
+    {
+        ObjLoader::Parse(data.data(), data.size(), vertices);
+        benchmark::DoNotOptimize(vertices.data());
+    }
+    state.SetBytesProcessed(state.iterations() * data.size());
+    state.counters["triangles"] = vertices.size() / 3;
+}
+BENCHMARK(BM_ParseSphereOBJ);
+
+// Parse of generated meshes from ~4k to ~1M triangles
+static void BM_ParseGeneratedOBJ(benchmark::State &state)
+{
+    std::string data = makeSphereOBJ(state.range(0));
+    std::vector<Vertex> vertices;
+    for (auto _ : state)
+    {
+        ObjLoader::Parse(data.data(), data.size(), vertices);
+        benchmark::DoNotOptimize(vertices.data());
+    }
+    state.SetBytesProcessed(state.iterations() * data.size());
+    state.SetItemsProcessed(state.iterations() * vertices.size() / 3);
+    state.counters["triangles"] = vertices.size() / 3;
+}
+BENCHMARK(BM_ParseGeneratedOBJ)->Arg(32)->Arg(128)->Arg(512)->Unit(benchmark::kMillisecond);
+
+// Per-object transform updates and composition with the camera matrix, as done for every Shape each frame
+static void BM_TransformCompose(benchmark::State &state)
+{
+    int count = state.range(0);
+    std::vector<Transform> transforms(count);
+    std::vector<glm::mat4> world(count);
+    for (int i = 0; i < count; i++)
+    {
+        transforms[i].Translate(glm::vec3(i % 100, 0, i / 100));
+        transforms[i].Scale(0.5f);
+    }
+    glm::mat4 camera = glm::lookAt(glm::vec3(0, 5, -10), glm::vec3(0, 0, 0), glm::vec3(0, 1, 0));
+    for (auto _ : state)
+    {
+        for (int i = 0; i < count; i++)
+        {
+            transforms[i].Rotate(0.01f, glm::vec3(0, 1, 0));
+            world[i] = camera * transforms[i].view * transforms[i].model;
+        }
+        benchmark::DoNotOptimize(world.data());
+    }
+    state.SetItemsProcessed(state.iterations() * count);
+}
+BENCHMARK(BM_TransformCompose)->Arg(100)->Arg(10000);
+
+// Push / multiply / pop of the global matrix stack, once per drawn object
+static void BM_MatrixStackPushPop(benchmark::State &state)
+{
+    int count = state.range(0);
+    MatrixStack *ms = MatrixStack::getInstance();
+    glm::mat4 view = glm::translate(glm::mat4(1.0f), glm::vec3(1, 2, 3));
+    for (auto _ : state)
+    {
+        for (int i = 0; i < count; i++)
+        {
+            ms->push();
+            ms->top() *= view;
+            benchmark::DoNotOptimize(ms->top());
+            ms->pop();
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * count);
+}
+BENCHMARK(BM_MatrixStackPushPop)->Arg(100)->Arg(10000);
+
+// camera * model for 1024 objects
+static void BM_SimdMultiply(benchmark::State &state)
+{
+    std::vector<glm::mat4> matrices, out(1024);
+    std::vector<AABB> boxes;
+    makeAffine(matrices, boxes, 1024);
+    glm::mat4 camera = glm::lookAt(glm::vec3(0, 5, -10), glm::vec3(0, 0, 0), glm::vec3(0, 1, 0));
+    if (!selectLevel(state))
+        return;
+    for (auto _ : state)
+    {
+        SimdMath::multiply(camera, matrices.data(), out.data(), 1024);
+        benchmark::DoNotOptimize(out.data());
+    }
+    state.SetItemsProcessed(state.iterations() * 1024);
+}
+BENCHMARK(BM_SimdMultiply)->DenseRange(0, 2);
+
+// Affine inverse of 1024 model matrices
+static void BM_SimdAffineInverse(benchmark::State &state)
+{
+    std::vector<glm::mat4> matrices, out(1024);
+    std::vector<AABB> boxes;
+    makeAffine(matrices, boxes, 1024);
+    if (!selectLevel(state))
+        return;
+    for (auto _ : state)
+    {
+        SimdMath::affineInverse(matrices.data(), out.data(), 1024);
+        benchmark::DoNotOptimize(out.data());
+    }
+    state.SetItemsProcessed(state.iterations() * 1024);
+}
+BENCHMARK(BM_SimdAffineInverse)->DenseRange(0, 2);
+
+// Normal matrices of 1024 model matrices
+static void BM_SimdNormalMatrix(benchmark::State &state)
+{
+    std::vector<glm::mat4> matrices;
+    std::vector<glm::mat3> out(1024);
+    std::vector<AABB> boxes;
+    makeAffine(matrices, boxes, 1024);
+    if (!selectLevel(state))
+        return;
+    for (auto _ : state)
+    {
+        SimdMath::normalMatrix(matrices.data(), out.data(), 1024);
+        benchmark::DoNotOptimize(out.data());
+    }
+    state.SetItemsProcessed(state.iterations() * 1024);
+}
+BENCHMARK(BM_SimdNormalMatrix)->DenseRange(0, 2);
+
+// 1024 object space boxes to world space
+static void BM_SimdTransformAABB(benchmark::State &state)
+{
+    std::vector<glm::mat4> matrices;
+    std::vector<AABB> boxes, out(1024);
+    makeAffine(matrices, boxes, 1024);
+    if (!selectLevel(state))
+        return;
+    for (auto _ : state)
+    {
+        SimdMath::transformAABB(matrices[100], boxes.data(), out.data(), 1024);
+        benchmark::DoNotOptimize(out.data());
+    }
+    state.SetItemsProcessed(state.iterations() * 1024);
+}
+BENCHMARK(BM_SimdTransformAABB)->DenseRange(0, 2);
+
+// One frame of camera work: arg mouse events (pitch + yaw) accumulated, then the single Update() of the frame,
+// without a shader bound
+static void BM_CameraUpdate(benchmark::State &state)
+{
+    int events = state.range(0);
+    Camera camera(MatrixStack::getInstance());
+    for (auto _ : state)
+    {
+        for (int i = 0; i < events; i++)
+        {
+            camera.Pitch(0.01f);
+            camera.Yaw(0.1f);
+        }
+        camera.Update();
+        benchmark::DoNotOptimize(camera.GetViewProjection());
+    }
+    state.SetItemsProcessed(state.iterations() * events);
+}
+BENCHMARK(BM_CameraUpdate)->Arg(1)->Arg(100);
+
+// Uniform names for every member of every point light, as built by Light::Upload, on the heap (arg 1 = 0) or in a
+// frame arena reset once per iteration (arg 1 = 1)
+static void BM_LightUniformNames(benchmark::State &state)
+{
+    int lights = state.range(0);
+    const char *members[] = {"position", "ambient", "diffuse", "specular", "constant", "linear", "quadratic"};
+    FrameArena arena;
+    FrameArena::SetCurrent(state.range(1) ? &arena : nullptr);
+    for (auto _ : state)
+    {
+        for (int i = 0; i < lights; i++)
+        {
+            for (const char *member : members)
+            {
+                FrameString name = LightIndex::uniformName(i, member);
+                benchmark::DoNotOptimize(name.data());
+            }
+        }
+        arena.Reset();
+    }
+    FrameArena::SetCurrent(nullptr);
+    state.SetItemsProcessed(state.iterations() * lights * 7);
+}
+BENCHMARK(BM_LightUniformNames)->Args({4, 0})->Args({4, 1})->Args({8, 0})->Args({8, 1});
+
+// RenderQueue::Build style frame work (compose with the camera, cull against the frustum) over 100k objects
+static void BM_JobSystemComposeCull(benchmark::State &state)
+{
+    const int count = 100000;
+    JobSystem jobs(state.range(0));
+    std::vector<Transform> transforms(count);
+    std::vector<glm::mat4> views(count);
+    std::vector<unsigned char> visible(count);
+    for (int i = 0; i < count; i++)
+    {
+        transforms[i].Translate(glm::vec3(i % 300 - 150, (i / 300) % 20, i / 6000 - 8));
+        transforms[i].Rotate(0.001f * i, glm::vec3(0, 1, 0));
+    }
+    glm::mat4 camera = glm::lookAt(glm::vec3(0, 5, -10), glm::vec3(0, 0, 0), glm::vec3(0, 1, 0));
+    Frustum frustum(glm::perspective(glm::radians(45.0f), 8.0f / 6.0f, 0.1f, 100.0f) * camera);
+    for (auto _ : state)
+    {
+        jobs.ParallelFor(count, 256, [&](int begin, int end)
+                         {
+                             for (int i = begin; i < end; i++)
+                             {
+                                 views[i] = camera * transforms[i].view;
+                                 glm::vec3 center = glm::vec3(transforms[i].World()[3]);
+                                 visible[i] = frustum.Intersects(center, 1.0f);
+                             } });
+        benchmark::DoNotOptimize(visible.data());
+    }
+    state.SetItemsProcessed(state.iterations() * count);
+}
+BENCHMARK(BM_JobSystemComposeCull)->Apply(threadCounts)->UseRealTime()->Unit(benchmark::kMicrosecond);
+
+// Sorting 100k draw keys with JobSystem::ParallelSort
+static void BM_JobSystemSort(benchmark::State &state)
+{
+    const int count = 100000;
+    JobSystem jobs(state.range(0));
+    std::vector<unsigned long long> keys(count), sorted;
+    unsigned long long seed = 12345;
+    for (int i = 0; i < count; i++)
+    {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        keys[i] = seed >> 16;
+    }
+    for (auto _ : state)
+    {
+        sorted = keys;
+        jobs.ParallelSort(sorted, [](unsigned long long a, unsigned long long b)
+                          { return a < b; });
+        benchmark::DoNotOptimize(sorted.data());
+        jobs.ResetArenas(); // Merge scratch buffers
+    }
+    state.SetItemsProcessed(state.iterations() * count);
+}
+BENCHMARK(BM_JobSystemSort)->Apply(threadCounts)->UseRealTime()->Unit(benchmark::kMicrosecond);
+
+// Scheduling overhead: 1000 tiny jobs and a continuation on their counter
+static void BM_JobSystemTinyJobs(benchmark::State &state)
+{
+    JobSystem jobs(state.range(0));
+    std::atomic<int> sum{0};
+    for (auto _ : state)
+    {
+        JobCounter counter, after;
+        for (int i = 0; i < 1000; i++)
+        {
+            jobs.Run([&sum]()
+                     { sum.fetch_add(1, std::memory_order_relaxed); },
+                     &counter);
+        }
+        jobs.Then(counter, [&sum]()
+                  { sum.fetch_add(1, std::memory_order_relaxed); },
+                  &after);
+        jobs.Wait(after);
+        jobs.Wait(counter);
+    }
+    state.SetItemsProcessed(state.iterations() * 1001);
+}
+BENCHMARK(BM_JobSystemTinyJobs)->Apply(threadCounts)->UseRealTime();
+
+// Hierarchical-Z occlusion culling of 100k spheres in a grid of rooms: 64 walls are rasterized, the pyramid built
+// and every sphere tested, the counters report how many were hidden and what each step cost
+static void BM_OcclusionCull(benchmark::State &state)
+{
+    const int count = 100000;
+    JobSystem jobs(state.range(0));
+    OcclusionCuller occlusion(&jobs);
+    std::vector<glm::vec3> wall = {{-4, 0, 0}, {4, 0, 0}, {4, 6, 0}, {-4, 0, 0}, {4, 6, 0}, {-4, 6, 0}};
+    std::vector<glm::mat4> walls;
+    for (int i = 0; i < 64; i++)
+    {
+        walls.push_back(glm::translate(glm::mat4(1.0f), glm::vec3((i % 8) * 8 - 32, 0, 10 + (i / 8) * 12)));
+    }
+    std::vector<glm::vec4> spheres(count);
+    std::vector<unsigned char> visible(count);
+    for (int i = 0; i < count; i++)
+    {
+        spheres[i] = glm::vec4(i % 200 * 0.4f - 40, (i / 200) % 10 * 0.5f, 12 + i / 2000 * 2.0f, 0.3f);
+    }
+    glm::mat4 camera = glm::lookAt(glm::vec3(0, 3, -5), glm::vec3(0, 3, 10), glm::vec3(0, 1, 0));
+    glm::mat4 viewProjection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 200.0f) * camera;
+    double rasterMs = 0, testMs = 0;
+    int occluded = 0;
+    for (auto _ : state)
+    {
+        std::fill(visible.begin(), visible.end(), 1);
+        occlusion.Begin(viewProjection);
+        for (const glm::mat4 &world : walls)
+        {
+            occlusion.AddOccluder(wall, world);
+        }
+        occlusion.Rasterize();
+        occluded = occlusion.Cull(count, spheres.data(), visible.data());
+        rasterMs += occlusion.GetStats().rasterMs;
+        testMs += occlusion.GetStats().testMs;
+    }
+    state.counters["occluded"] = occluded;
+    state.counters["raster_ms"] = rasterMs / state.iterations();
+    state.counters["test_ms"] = testMs / state.iterations();
+    state.SetItemsProcessed(state.iterations() * count);
+}
+BENCHMARK(BM_OcclusionCull)->Apply(threadCounts)->UseRealTime()->Unit(benchmark::kMicrosecond);
+
+// Meshlet culling of a 260k triangle sphere seen from outside: frustum and normal cone test per meshlet
+static void BM_MeshletCull(benchmark::State &state)
+{
+    std::string obj = makeSphereOBJ(256);
+    std::vector<Vertex> expanded, vertices;
+    std::vector<uint32_t> indices, meshletIndices;
+    std::vector<Meshlets::Meshlet> meshlets;
+    ObjLoader::Parse(obj.data(), obj.size(), expanded);
+    Meshlets::Weld(expanded, vertices, indices);
+    for (size_t i = 0; i < indices.size(); i += 3)
+    {
+        std::swap(indices[i + 1], indices[i + 2]); // makeSphereOBJ winds clockwise seen from outside
+    }
+    Meshlets::Build(vertices, indices, meshlets, meshletIndices);
+    std::vector<Meshlets::Range> ranges(meshlets.size());
+    glm::vec3 eye(0, 0.5f, -3);
+    glm::mat4 camera = glm::lookAt(eye, glm::vec3(0), glm::vec3(0, 1, 0));
+    Frustum frustum(glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 100.0f) * camera);
+    int drawn = 0, culledMeshlets = 0, culledTriangles = 0;
+    for (auto _ : state)
+    {
+        drawn = Meshlets::Cull(meshlets.data(), (int)meshlets.size(), glm::mat4(1.0f), 1.0f, frustum, eye, ranges.data(),
+                               culledMeshlets, culledTriangles);
+        benchmark::DoNotOptimize(ranges.data());
+    }
+    state.counters["meshlets"] = (double)meshlets.size();
+    state.counters["culled_meshlets"] = culledMeshlets;
+    state.counters["culled_triangles"] = culledTriangles;
+    state.counters["triangles"] = (double)(indices.size() / 3);
+    state.counters["ranges"] = drawn;
+    state.SetItemsProcessed(state.iterations() * meshlets.size());
+}
+BENCHMARK(BM_MeshletCull)->Unit(benchmark::kMicrosecond);
+
+// Software rendering of a 720p frame: 64 lit spheres of 2k triangles, every stage spread over the job system, the
+// counters report the time of each stage
+static void BM_SoftwareRaster(benchmark::State &state)
+{
+    std::string obj = makeSphereOBJ(32);
+    std::vector<Vertex> expanded;
+    ObjLoader::Parse(obj.data(), obj.size(), expanded);
+    for (size_t i = 0; i < expanded.size(); i += 3)
+    {
+        std::swap(expanded[i + 1], expanded[i + 2]); // makeSphereOBJ winds clockwise seen from outside
+    }
+    JobSystem jobs(state.range(0));
+    SoftwareRasterizer rasterizer(&jobs, 1280, 720);
+    int mesh = rasterizer.AddMesh(expanded);
+    SoftwareRasterizer::PointLight light{glm::vec3(0, 3, 0), 1.0f, 0.09f, 0.032f, glm::vec3(0.05f), glm::vec3(0.7f),
+                                         glm::vec3(1.0f)};
+    rasterizer.SetLights({glm::vec3(-0.3f, -1, -0.2f), glm::vec3(0.2f), glm::vec3(0.5f), glm::vec3(1.0f)}, &light, 1);
+    Material material(glm::vec3(0.0215f, 0.1745f, 0.0215f), glm::vec3(0.07568f, 0.61424f, 0.07568f),
+                      glm::vec3(0.633f, 0.727811f, 0.633f), 0.6f);
+    glm::vec3 eye(0, 4, -14);
+    glm::mat4 viewProjection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 200.0f) *
+                               glm::lookAt(eye, glm::vec3(0), glm::vec3(0, 1, 0));
+    SoftwareRasterizer::Stats total;
+    for (auto _ : state)
+    {
+        rasterizer.Begin(viewProjection, eye);
+        for (int i = 0; i < 64; i++)
+        {
+            rasterizer.Submit(mesh, glm::translate(glm::mat4(1.0f), glm::vec3(i % 8 * 3.0f - 10.5f, 0, i / 8 * 3.0f - 10.5f)),
+                              material);
+        }
+        rasterizer.Render();
+        const SoftwareRasterizer::Stats &stats = rasterizer.GetStats();
+        total.vertexMs += stats.vertexMs;
+        total.setupMs += stats.setupMs;
+        total.binMs += stats.binMs;
+        total.rasterMs += stats.rasterMs;
+        total.shadeMs += stats.shadeMs;
+        total.pixelsShaded = stats.pixelsShaded;
+        total.triangles = stats.triangles;
+    }
+    state.counters["triangles"] = total.triangles;
+    state.counters["pixels_shaded"] = total.pixelsShaded;
+    state.counters["vertex_ms"] = total.vertexMs / state.iterations();
+    state.counters["setup_ms"] = total.setupMs / state.iterations();
+    state.counters["bin_ms"] = total.binMs / state.iterations();
+    state.counters["raster_ms"] = total.rasterMs / state.iterations();
+    state.counters["shade_ms"] = total.shadeMs / state.iterations();
+    state.SetItemsProcessed(state.iterations() * total.triangles);
+}
+BENCHMARK(BM_SoftwareRaster)->Apply(threadCounts)->UseRealTime()->Unit(benchmark::kMillisecond);
+
+// Closest hit ray casts into the BVH of a UV sphere of ~16k to ~2M triangles (arg 1 the segments), with the scalar or
+// the SSE triangle test (arg 0). The rays start around the sphere and aim near its center, about 40% hit, the items
+// per second are the rays per second. Each BVH is built once and kept, the benchmark is entered several times per size
+static void BM_BvhRays(benchmark::State &state)
+{
+    static std::map<int, Bvh> built;
+    Bvh &bvh = built[(int)state.range(1)];
+    if (bvh.Empty())
+    {
+        std::vector<glm::vec3> corners;
+        makeSphereTriangles((int)state.range(1), corners);
+        bvh.Build(corners);
+    }
+    const int count = 4096;
+    std::vector<glm::vec3> origins(count), directions(count);
+    for (int i = 0; i < count; i++)
+    {
+        // Starts spread evenly over a sphere of radius 3 (golden angle spiral), targets within 1.2 of the center
+        float y = 1.0f - 2.0f * (i + 0.5f) / count, ring = std::sqrt(1.0f - y * y), angle = 2.399963f * i;
+        origins[i] = 3.0f * glm::vec3(ring * std::cos(angle), y, ring * std::sin(angle));
+        glm::vec3 target(std::sin(i * 0.37f), std::cos(i * 0.61f), std::sin(i * 0.83f + 1.0f));
+        directions[i] = glm::normalize(target * 1.2f - origins[i]);
+    }
+    if (!selectLevel(state))
+        return;
+    int hits = 0;
+    for (auto _ : state)
+    {
+        hits = 0;
+        for (int i = 0; i < count; i++)
+        {
+            BvhHit hit;
+            hits += bvh.Intersect(origins[i], directions[i], FLT_MAX, hit) ? 1 : 0;
+        }
+        benchmark::DoNotOptimize(hits);
+    }
+    const Bvh::Stats &stats = bvh.GetStats();
+    state.counters["triangles"] = stats.triangles;
+    state.counters["nodes"] = stats.nodes;
+    state.counters["depth"] = stats.depth;
+    state.counters["build_ms"] = stats.buildMs;
+    state.counters["hit_rate"] = (double)hits / count;
+    state.SetItemsProcessed(state.iterations() * count);
+}
+BENCHMARK(BM_BvhRays)->Apply(bvhSizes)->Unit(benchmark::kMicrosecond);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,522 @@
+/**
+    @file RenderBenchmark.cpp
+    @brief Headless rendering benchmark
+    @details Creates an offscreen OpenGL context through EGL (surfaceless Mesa platform, so it also runs on GPU-less
+    machines with llvmpipe), builds a parametrized scene out of the engine's Shape, Light and Camera classes, renders a
+    fixed camera path into a framebuffer object and prints frame time statistics as JSON. --software renders the same
+    scene with the SoftwareRasterizer instead, without any GL context, and adds its per-stage timings.
+
+    Usage: RenderBenchmark [--spheres N] [--lights M] [--textured] [--prepass] [--culling gpu|cpu] [--software]
+                           [--threads T] [--frames K] [--warmup W] [--width X] [--height Y] [--out file.json]
+                           [--image file.ppm]
+    --culling draws the spheres through a GpuCuller instead of one Shape each: gpu culls them in a compute shader and
+    draws them with one indirect call (needs GL 4.3), cpu uses the culler's fallback path for comparison.
+    Run from the build directory like the main executable so ../Resources resolves.
+*/
+
+//====| Includes |====//
+#include <glad/glad.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../Engine/Shader.h"
+#include "../Engine/ShaderQueue.h"
+#include "../Engine/ShaderVariants.h"
+#include "../Engine/Shape.h"
+#include "../Engine/Texture.h"
+#include "../Engine/Light.h"
+#include "../Engine/MatrixStack.h"
+#include "../Engine/Camera.h"
+#include "../Engine/Material.h"
+#include "../Engine/RenderStats.h"
+#include "../Engine/RenderQueue.h"
+#include "../Engine/GpuCuller.h"
+#include "../Engine/RenderTarget.h"
+#include "../Engine/SoftwareRasterizer.h"
+#include "BenchmarkScene.h"
+
+//====| Types |====//
+struct BenchmarkOptions
+{
+    int spheres = 64;
+    int lights = 4;
+    bool textured = false;
+    bool prepass = false; // Depth pre-pass before the lit color pass
+    std::string culling;  // "gpu" or "cpu" to draw the spheres through a GpuCuller, empty for Shapes
+    bool software = false; // Render with the SoftwareRasterizer instead of OpenGL
+    int threads = 0;       // Job system threads of the software renderer, 0 for every hardware thread
+    int frames = 300;
+    int warmup = 30;
+    int width = 1280;
+    int height = 720;
+    std::string out;
+    std::string image; // Last frame as a binary PPM
+};
+
+//====| Function Declarations |====//
+bool parseOptions(int argc, char **argv, BenchmarkOptions &options); // Read command line flags
+double percentile(const std::vector<double> &sorted, double p);      // Percentile of an ascending sample set
+int runSoftware(const BenchmarkOptions &options);                    // Benchmark the SoftwareRasterizer
+void printResults(const BenchmarkOptions &options, const std::string &renderer, const std::vector<double> &frameTimes,
+                  long long triangles, long long drawCalls, long long visible, const std::string &extra); // JSON
+bool writeImage(const std::string &path, const unsigned char *pixels, int width, int height); // RGBA rows bottom up
+
+//====| Main |====//
+int main(int argc, char **argv)
+{
+    BenchmarkOptions options;
+    if (!parseOptions(argc, argv, options))
+    {
+        return 1;
+    }
+    if (options.software)
+    {
+        return runSoftware(options);
+    }
+
+    HeadlessContext ctx;
+    bool gpuCulling = options.culling == "gpu";
+    if (!initHeadlessContext(ctx, gpuCulling ? 4 : 3, 3))
+    {
+        return 1;
+    }
+
+    // Offscreen color and depth targets, surfaceless contexts have no default framebuffer
+    RenderTarget *target = new RenderTarget(options.width, options.height);
+    if (!target->Valid())
+    {
+        return 1;
+    }
+    target->Bind();
+    glEnable(GL_DEPTH_TEST);
+
+    // Scene setup is not timed
+    ShaderQueue shaderQueue((GLADloadproc)eglGetProcAddress);
+    Shader lightShader("../Resources/Shaders/Simple.vs", "../Resources/Shaders/Simple.fs", true);
+    shaderQueue.Add(&lightShader);
+    Shader depthShader("../Resources/Shaders/Depth.vs", "../Resources/Shaders/Depth.fs", true);
+    shaderQueue.Add(&depthShader);
+    ShaderVariants variants("../Resources/Shaders/Simple.vs", "../Resources/Shaders/Simple.fs", &shaderQueue);
+
+    MatrixStack *ms = MatrixStack::getInstance();
+    Camera camera(ms);
+    camera.SetShader(&lightShader);
+
+    Texture texture(GL_TEXTURE_2D);
+    if (options.textured && !texture.LoadTexture("../Resources/Photos/lobster.png"))
+    {
+        return 1;
+    }
+
+    // Spheres on a square grid in the XZ plane around the camera
+    std::vector<Shape *> spheres;
+    int side = (int)std::ceil(std::sqrt((double)options.spheres));
+    GpuCuller *culler = nullptr;
+    Shader *cullerShader = nullptr;
+    if (!options.culling.empty())
+    {
+        culler = new GpuCuller((GLADloadproc)eglGetProcAddress, "../Resources/Shaders/Cull.comp", gpuCulling);
+        if (gpuCulling && !culler->UsesGpu())
+        {
+            std::cout << "GPU culling needs compute shaders and indirect draws (GL 4.3)" << std::endl;
+            return 1;
+        }
+        std::vector<std::string> defines = {"NR_POINT_LIGHTS " + std::to_string(options.lights)};
+        cullerShader = new Shader(gpuCulling ? "../Resources/Shaders/Indirect.vs" : "../Resources/Shaders/Simple.vs",
+                                  "../Resources/Shaders/Simple.fs", defines);
+        culler->SetShaders(cullerShader, cullerShader);
+        int mesh = culler->AddMesh("../Resources/Models/sphere.obj");
+        if (mesh < 0)
+        {
+            return 1;
+        }
+        for (int i = 0; i < options.spheres; i++)
+        {
+            culler->AddObject(mesh, sphereTransform(i, side), i % 2 == 0 ? Materials::emerald : Materials::brass);
+        }
+    }
+    else
+    {
+        for (int i = 0; i < options.spheres; i++)
+        {
+            Shape *sphere = new Shape(GL_STATIC_DRAW, "../Resources/Models/sphere.obj");
+            sphere->SetMaterial(i % 2 == 0 ? Materials::emerald : Materials::brass);
+            if (options.textured)
+            {
+                sphere->SetTexture(texture);
+            }
+            sphere->SetTransform(sphereTransform(i, side));
+            spheres.push_back(sphere);
+        }
+    }
+
+    // Point lights on a ring above the grid
+    std::vector<PointLight *> pointLights;
+    std::vector<Light *> lights;
+    DirectionalLight sun = sceneSun();
+    lights.push_back(new Light(&sun, &lightShader));
+    for (int i = 0; i < options.lights; i++)
+    {
+        PointLight *pl = new PointLight(scenePointLight(i, options.lights, side));
+        pointLights.push_back(pl);
+        lights.push_back(new Light(pl, &lightShader));
+    }
+
+    float aspect = (float)options.width / options.height;
+    if (cullerShader != nullptr)
+    {
+        LightIndex::addShader(cullerShader);
+    }
+    variants.OnCompile(LightIndex::addShader);
+    variants.OnCompile([aspect](Shader *s)
+                       { s->usePerspective(glm::radians(45.0f), aspect, 0.1f, 200.0f); });
+    lightShader.usePerspective(glm::radians(45.0f), aspect, 0.1f, 200.0f);
+    camera.SetProjection(lightShader.getProjection());
+    for (Shape *sphere : spheres)
+    {
+        sphere->SetShader(&variants);
+    }
+    shaderQueue.WaitAll(); // Compilation is not part of the measurement
+
+    // Fixed camera path: raised above the grid, looking slightly down, one full turn over the measured frames
+    camera.SlideUp(4.0f);
+    camera.Pitch(-20.0f);
+
+    std::vector<double> frameTimes;
+    long long triangles = 0, drawCalls = 0, visible = 0;
+    int total = options.warmup + options.frames;
+    for (int frame = 0; frame < total; frame++)
+    {
+        auto start = std::chrono::steady_clock::now();
+
+        camera.Yaw(360.0f / options.frames);
+        camera.Update();
+        glClearColor(0.25f, 0.3f, 0.3f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        if (options.prepass)
+        {
+            RenderQueue::BeginDepthPrepass(&depthShader);
+            for (Shape *sphere : spheres)
+            {
+                sphere->DrawDepth();
+            }
+            for (Light *light : lights)
+            {
+                if (light->GetMesh() != nullptr)
+                {
+                    light->GetMesh()->DrawDepth();
+                }
+            }
+            RenderQueue::BeginColorPass();
+        }
+        for (Shape *sphere : spheres)
+        {
+            sphere->Draw();
+        }
+        if (culler != nullptr)
+        {
+            cullerShader->use();
+            cullerShader->setVec3("viewPos", camera.GetPosition());
+            culler->Draw(camera.GetViewProjection());
+        }
+        for (Light *light : lights)
+        {
+            light->Draw();
+        }
+        if (options.prepass)
+        {
+            RenderQueue::EndColorPass();
+        }
+        glFinish(); // Include the GPU work of the frame
+
+        double elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        RenderStats::endFrame();
+        if (frame >= options.warmup)
+        {
+            frameTimes.push_back(elapsed);
+            triangles += RenderStats::last.triangles;
+            drawCalls += RenderStats::last.drawCalls;
+            visible += culler != nullptr ? culler->ReadVisible() : options.spheres;
+        }
+    }
+
+    if (!options.image.empty())
+    {
+        std::vector<unsigned char> pixels(options.width * options.height * 4);
+        glReadPixels(0, 0, options.width, options.height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+        writeImage(options.image, pixels.data(), options.width, options.height);
+    }
+    printResults(options, (const char *)glGetString(GL_RENDERER), frameTimes, triangles, drawCalls, visible, "");
+
+    for (Light *light : lights)
+    {
+        delete light;
+    }
+    for (PointLight *pl : pointLights)
+    {
+        delete pl;
+    }
+    for (Shape *sphere : spheres)
+    {
+        delete sphere;
+    }
+    delete culler;
+    delete cullerShader;
+    ObjectBuffer::destroyInstance();
+    MaterialBuffer::destroyBuffer();
+    delete target;
+    destroyHeadlessContext(ctx);
+    return 0;
+}
+
+//====| Function Definitions |====//
+
+/*
+    Reads the command line flags into the options struct
+    Parameters: int argc, char** argv, BenchmarkOptions& options
+    Returns: Boolean, false on unknown or malformed flags
+*/
+bool parseOptions(int argc, char **argv, BenchmarkOptions &options)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--textured")
+            options.textured = true;
+        else if (arg == "--prepass")
+            options.prepass = true;
+        else if (arg == "--software")
+            options.software = true;
+        else if (arg == "--threads" && hasValue)
+            options.threads = std::atoi(argv[++i]);
+        else if (arg == "--image" && hasValue)
+            options.image = argv[++i];
+        else if (arg == "--culling" && hasValue && (strcmp(argv[i + 1], "gpu") == 0 || strcmp(argv[i + 1], "cpu") == 0))
+            options.culling = argv[++i];
+        else if (arg == "--spheres" && hasValue)
+            options.spheres = std::atoi(argv[++i]);
+        else if (arg == "--lights" && hasValue)
+            options.lights = std::atoi(argv[++i]);
+        else if (arg == "--frames" && hasValue)
+            options.frames = std::atoi(argv[++i]);
+        else if (arg == "--warmup" && hasValue)
+            options.warmup = std::atoi(argv[++i]);
+        else if (arg == "--width" && hasValue)
+            options.width = std::atoi(argv[++i]);
+        else if (arg == "--height" && hasValue)
+            options.height = std::atoi(argv[++i]);
+        else if (arg == "--out" && hasValue)
+            options.out = argv[++i];
+        else
+        {
+            std::cout << "Usage: RenderBenchmark [--spheres N] [--lights M] [--textured] [--prepass] [--culling gpu|cpu]"
+                      << " [--software] [--threads T] [--frames K] [--warmup W] [--width X] [--height Y]"
+                      << " [--out file.json] [--image file.ppm]" << std::endl;
+            return false;
+        }
+    }
+    if (options.lights > MAX_VARIANT_POINT_LIGHTS)
+    {
+        std::cout << "At most " << MAX_VARIANT_POINT_LIGHTS << " point lights are supported" << std::endl;
+        return false;
+    }
+    if (!options.culling.empty() && (options.textured || options.prepass))
+    {
+        std::cout << "--culling draws untextured spheres without a depth pre-pass" << std::endl;
+        return false;
+    }
+    if (options.software && (options.textured || options.prepass || !options.culling.empty()))
+    {
+        std::cout << "--software draws untextured spheres without a depth pre-pass or GPU culling" << std::endl;
+        return false;
+    }
+    if (options.spheres < 1 || options.frames < 1 || options.lights < 0)
+    {
+        std::cout << "--spheres and --frames must be positive" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+/*
+    Nearest-rank percentile of an ascending sample set
+    Parameters: const std::vector<double>& sorted, double p (0-100)
+    Returns: double
+*/
+double percentile(const std::vector<double> &sorted, double p)
+{
+    if (sorted.empty())
+    {
+        return 0;
+    }
+    size_t rank = (size_t)std::ceil(p / 100.0 * sorted.size());
+    return sorted[std::min(sorted.size() - 1, rank > 0 ? rank - 1 : 0)];
+}
+
+/*
+    Renders the scene and camera path of the GL benchmark with the SoftwareRasterizer, no GL context is created.
+    The light markers (cubes) are not drawn.
+    Parameters: const BenchmarkOptions& options
+    Returns: int, exit code
+*/
+int runSoftware(const BenchmarkOptions &options)
+{
+    JobSystem jobs(options.threads);
+    SoftwareRasterizer rasterizer(&jobs, options.width, options.height);
+    int mesh = rasterizer.AddMesh("../Resources/Models/sphere.obj");
+    if (mesh < 0)
+    {
+        return 1;
+    }
+    int side = (int)std::ceil(std::sqrt((double)options.spheres));
+    std::vector<glm::mat4> worlds;
+    for (int i = 0; i < options.spheres; i++)
+    {
+        worlds.push_back(sphereTransform(i, side).World());
+    }
+
+    DirectionalLight sun = sceneSun();
+    std::vector<SoftwareRasterizer::PointLight> pointLights;
+    for (int i = 0; i < options.lights; i++)
+    {
+        PointLight pl = scenePointLight(i, options.lights, side);
+        pointLights.push_back({pl.position, pl.constant, pl.linear, pl.quadratic, pl.ambient, pl.diffuse, pl.specular});
+    }
+    rasterizer.SetLights({sun.direction, sun.ambient, sun.diffuse, sun.specular}, pointLights.data(), (int)pointLights.size());
+    rasterizer.SetClearColor(vec3(0.25f, 0.3f, 0.3f));
+
+    MatrixStack *ms = MatrixStack::getInstance();
+    Camera camera(ms);
+    camera.SetProjection(glm::perspective(glm::radians(45.0f), (float)options.width / options.height, 0.1f, 200.0f));
+    camera.SlideUp(4.0f);
+    camera.Pitch(-20.0f);
+
+    std::vector<double> frameTimes;
+    SoftwareRasterizer::Stats stages;
+    long long triangles = 0, drawCalls = 0;
+    int total = options.warmup + options.frames;
+    for (int frame = 0; frame < total; frame++)
+    {
+        auto start = std::chrono::steady_clock::now();
+
+        camera.Yaw(360.0f / options.frames);
+        camera.Update();
+        rasterizer.Begin(camera.GetViewProjection(), camera.GetPosition());
+        for (int i = 0; i < options.spheres; i++)
+        {
+            rasterizer.Submit(mesh, worlds[i], i % 2 == 0 ? *Materials::emerald : *Materials::brass);
+        }
+        rasterizer.Render();
+        jobs.ResetArenas();
+
+        double elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        if (frame >= options.warmup)
+        {
+            const SoftwareRasterizer::Stats &stats = rasterizer.GetStats();
+            frameTimes.push_back(elapsed);
+            triangles += stats.triangles;
+            drawCalls += stats.draws;
+            stages.vertexMs += stats.vertexMs;
+            stages.setupMs += stats.setupMs;
+            stages.binMs += stats.binMs;
+            stages.rasterMs += stats.rasterMs;
+            stages.shadeMs += stats.shadeMs;
+            stages.pixelsShaded += stats.pixelsShaded;
+        }
+    }
+
+    if (!options.image.empty())
+    {
+        writeImage(options.image, rasterizer.Pixels(), options.width, options.height);
+    }
+    std::ostringstream renderer, extra;
+    renderer << "SoftwareRasterizer (" << SimdMath::levelName(SimdMath::active) << ", " << jobs.Threads() << " threads)";
+    extra << "  \"stage_ms\": {\"vertex\": " << stages.vertexMs / options.frames << ", \"setup\": " << stages.setupMs / options.frames
+          << ", \"bin\": " << stages.binMs / options.frames << ", \"raster\": " << stages.rasterMs / options.frames
+          << ", \"shade\": " << stages.shadeMs / options.frames << "},\n"
+          << "  \"pixels_shaded_per_frame\": " << stages.pixelsShaded / options.frames;
+    printResults(options, renderer.str(), frameTimes, triangles, drawCalls, (long long)options.spheres * options.frames,
+                 extra.str());
+    return 0;
+}
+
+/*
+    Prints the frame time statistics as JSON, and writes them to --out when given
+    Parameters: const BenchmarkOptions& options, const std::string& renderer, const std::vector<double>& frameTimes,
+                long long triangles, long long drawCalls, long long visible (sums over the measured frames),
+                const std::string& extra (more members, empty for none)
+    Returns: None
+*/
+void printResults(const BenchmarkOptions &options, const std::string &renderer, const std::vector<double> &frameTimes,
+                  long long triangles, long long drawCalls, long long visible, const std::string &extra)
+{
+    std::vector<double> sorted = frameTimes;
+    std::sort(sorted.begin(), sorted.end());
+    double sum = 0;
+    for (double t : frameTimes)
+    {
+        sum += t;
+    }
+    double mean = sum / frameTimes.size();
+    double seconds = sum / 1000.0;
+
+    std::ostringstream json;
+    json << "{\n"
+         << "  \"renderer\": \"" << renderer << "\",\n"
+         << "  \"width\": " << options.width << ",\n"
+         << "  \"height\": " << options.height << ",\n"
+         << "  \"spheres\": " << options.spheres << ",\n"
+         << "  \"point_lights\": " << options.lights << ",\n"
+         << "  \"textured\": " << (options.textured ? "true" : "false") << ",\n"
+         << "  \"depth_prepass\": " << (options.prepass ? "true" : "false") << ",\n"
+         << "  \"culling\": \"" << (options.culling.empty() ? "none" : options.culling) << "\",\n"
+         << "  \"frames\": " << options.frames << ",\n"
+         << "  \"frame_ms\": {\"mean\": " << mean << ", \"p50\": " << percentile(sorted, 50)
+         << ", \"p99\": " << percentile(sorted, 99) << ", \"min\": " << sorted.front() << ", \"max\": " << sorted.back() << "},\n"
+         << "  \"fps\": " << options.frames / seconds << ",\n"
+         << "  \"triangles_per_second\": " << triangles / seconds << ",\n"
+         << "  \"draw_calls_per_frame\": " << drawCalls / options.frames << ",\n"
+         << "  \"visible_spheres_per_frame\": " << visible / options.frames << (extra.empty() ? "\n" : ",\n")
+         << extra << (extra.empty() ? "" : "\n") << "}\n";
+    std::cout << json.str();
+    if (!options.out.empty())
+    {
+        std::ofstream file(options.out);
+        file << json.str();
+    }
+
+}
+
+/*
+    Writes an image as a binary PPM
+    Parameters: const std::string& path, const unsigned char* pixels (RGBA, rows from the bottom up), int width,
+                int height
+    Returns: Boolean
+*/
+bool writeImage(const std::string &path, const unsigned char *pixels, int width, int height)
+{
+    std::ofstream file(path, std::ios::binary);
+    if (!file)
+    {
+        std::cout << "Cannot write " << path << std::endl;
+        return false;
+    }
+    file << "P6\n" << width << " " << height << "\n255\n";
+    for (int y = height - 1; y >= 0; y--)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            file.write((const char *)&pixels[(y * width + x) * 4], 3);
+        }
+    }
+    return true;
+}
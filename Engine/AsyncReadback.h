@@ -0,0 +1,317 @@
+/**
+    @class AsyncReadback AsyncReadback.h "Engine/AsyncReadback.h"
+    @brief Reads rendered frames back to the CPU without waiting for the GPU, and hands them to worker threads
+    @details Request() starts a glReadPixels of a RenderTarget into the next pixel pack buffer of a small ring and
+    puts a fence behind it, so the call returns as soon as the copy is queued and the GPU keeps going with the next
+    frame. Poll() (also run by every Request()) looks for fences that have signaled, maps those buffers, copies
+    the pixels into a pooled CPU buffer and runs the request's callback with them as a job on the JobSystem, where
+    it can encode or compare the image while the context thread renders on. Only when the ring wraps around onto
+    a copy that has not finished yet does Request() block, which is counted as a stall; a ring of two or three
+    buffers is usually enough. Callbacks queue up as long as the workers keep up, beyond maxPending the context
+    thread helps them out. Pixels are RGBA8 with the bottom row first, as glReadPixels returns them. A request
+    whose fence fails or whose buffer cannot be mapped is counted as failed and its callback gets null pixels, never
+    a buffer that was not filled. Requests, polls and flushes must come from the context thread, callbacks of
+    delivered and failed requests alike run on any thread of the system (inline when no JobSystem is given).
+*/
+
+#pragma once
+#ifndef ASYNCREADBACK_H
+#define ASYNCREADBACK_H
+
+#include <glad/glad.h>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "JobSystem.h"
+#include "RenderTarget.h"
+
+class AsyncReadback
+{
+public:
+    // Receives the pixels of a finished request, the buffer is recycled once it returns. Pixels are null when the
+    // readback failed
+    typedef std::function<void(const unsigned char *pixels, int width, int height)> Callback;
+
+    struct Stats
+    {
+        long long requested = 0;
+        long long delivered = 0; // Requests whose pixels reached the CPU
+        long long failed = 0;    // Requests whose fence failed or whose buffer could not be mapped
+        long long stalls = 0;    // Request() calls that had to wait for the oldest copy
+        double stallMs = 0;      // Time they waited
+        double copyMs = 0;       // Time spent mapping and copying buffers on the context thread
+        double helpMs = 0;       // Time the context thread ran callbacks because the workers fell behind
+    };
+
+private:
+    struct Slot
+    {
+        unsigned int pbo = 0;
+        size_t capacity = 0;
+        GLsync fence = nullptr; // Null while the slot is free
+        int width = 0, height = 0;
+        Callback callback;
+    };
+
+    JobSystem *jobs;
+    int maxPending;
+    std::vector<Slot> ring;
+    int next = 0; // Slot the next request goes to, also the oldest one in flight
+    JobCounter callbacks;
+    std::mutex poolLock;
+    std::vector<std::unique_ptr<std::vector<unsigned char>>> pool; // Free CPU buffers
+    Stats stats;
+
+    bool collect(Slot &slot, bool wait);
+    std::vector<unsigned char> *acquire(size_t size);
+    void release(std::vector<unsigned char> *buffer);
+
+public:
+    AsyncReadback(JobSystem *jobs, int ringSize = 3, int maxPending = 0);
+    ~AsyncReadback();
+    AsyncReadback(const AsyncReadback &) = delete;
+    void operator=(const AsyncReadback &) = delete;
+
+    void Request(RenderTarget &target, Callback callback);
+    int Poll();
+    void Flush();
+    const Stats &GetStats() const;
+};
+
+/**
+    @brief Creates the ring of pixel pack buffers, they are sized by the first request of each
+    @param jobs Job system the callbacks run on, null to run them inline on the context thread
+    @param ringSize Readbacks in flight at once
+    @param maxPending Callbacks allowed to queue up before the context thread waits for them, 0 picks four per
+    thread of the job system
+*/
+AsyncReadback::AsyncReadback(JobSystem *jobs, int ringSize, int maxPending) : jobs(jobs)
+{
+    this->maxPending = maxPending > 0 ? maxPending : 4 * (jobs != nullptr ? jobs->Threads() : 1);
+    ring.resize(std::max(1, ringSize));
+    for (Slot &slot : ring)
+    {
+        glGenBuffers(1, &slot.pbo);
+    }
+}
+
+/**
+    @brief Delivers the requests in flight, waits for their callbacks and deletes the buffers
+*/
+AsyncReadback::~AsyncReadback()
+{
+    Flush();
+    for (Slot &slot : ring)
+    {
+        glDeleteBuffers(1, &slot.pbo);
+    }
+}
+
+/**
+    @brief Queues the readback of a target's color
+    @details Resolves a multisampled target first. Blocks only when the ring's oldest copy is still in flight.
+    @param target Target to read, the frame must have been drawn into it already
+    @param callback Receives the pixels on a worker thread once they reach the CPU, null pixels if they did not
+*/
+void AsyncReadback::Request(RenderTarget &target, Callback callback)
+{
+    Poll();
+    Slot &slot = ring[next];
+    if (slot.fence != nullptr)
+    {
+        auto start = std::chrono::steady_clock::now();
+        collect(slot, true);
+        stats.stalls++;
+        stats.stallMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    target.Resolve();
+    size_t size = (size_t)target.Width() * target.Height() * 4;
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, target.ReadFramebuffer());
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+    if (slot.capacity < size)
+    {
+        glBufferData(GL_PIXEL_PACK_BUFFER, size, nullptr, GL_STREAM_READ);
+        slot.capacity = size;
+    }
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, target.Width(), target.Height(), GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    glFlush(); // Submits the copy and the fence, Poll() only checks it and would otherwise wait on unrelated work
+    slot.width = target.Width();
+    slot.height = target.Height();
+    slot.callback = std::move(callback);
+    target.Bind();
+    stats.requested++;
+    next = (next + 1) % (int)ring.size();
+}
+
+/**
+    @brief Delivers every request whose copy has finished, oldest first, without blocking on the GPU
+    @returns int, number of requests delivered
+*/
+int AsyncReadback::Poll()
+{
+    int delivered = 0;
+    for (int i = 0; i < (int)ring.size(); i++)
+    {
+        Slot &slot = ring[(next + i) % ring.size()];
+        if (slot.fence == nullptr)
+        {
+            continue;
+        }
+        if (!collect(slot, false))
+        {
+            break; // Copies finish in order, the newer ones are not done either
+        }
+        delivered++;
+    }
+    return delivered;
+}
+
+/**
+    @brief Delivers every request in flight and waits until all callbacks have returned
+*/
+void AsyncReadback::Flush()
+{
+    for (int i = 0; i < (int)ring.size(); i++)
+    {
+        Slot &slot = ring[(next + i) % ring.size()];
+        if (slot.fence != nullptr)
+        {
+            collect(slot, true);
+        }
+    }
+    if (jobs != nullptr)
+    {
+        jobs->Wait(callbacks);
+    }
+}
+
+/**
+    @brief Counters since the readback was created
+*/
+const AsyncReadback::Stats &AsyncReadback::GetStats() const
+{
+    return stats;
+}
+
+/**
+    @brief Copies a slot's pixels out of its buffer and schedules its callback, with null pixels if that failed
+    @param slot Slot with a request in flight
+    @param wait Whether to block until the copy has finished
+    @returns bool, false when the copy has not finished and wait is false
+*/
+bool AsyncReadback::collect(Slot &slot, bool wait)
+{
+    GLenum status = glClientWaitSync(slot.fence, 0, 0);
+    while (wait && (status == GL_TIMEOUT_EXPIRED))
+    {
+        status = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000ull);
+    }
+    if (status == GL_TIMEOUT_EXPIRED)
+    {
+        return false;
+    }
+    glDeleteSync(slot.fence);
+    slot.fence = nullptr;
+
+    // The pixels are only handed on when the copy is known to have finished and the buffer was read whole
+    auto start = std::chrono::steady_clock::now();
+    size_t size = (size_t)slot.width * slot.height * 4;
+    std::vector<unsigned char> *buffer = nullptr;
+    if (status != GL_WAIT_FAILED)
+    {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+        void *mapped = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size, GL_MAP_READ_BIT);
+        if (mapped != nullptr)
+        {
+            buffer = acquire(size);
+            memcpy(buffer->data(), mapped, size);
+            if (glUnmapBuffer(GL_PIXEL_PACK_BUFFER) == GL_FALSE) // Contents lost while mapped
+            {
+                release(buffer);
+                buffer = nullptr;
+            }
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    }
+    stats.copyMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    Callback callback = std::move(slot.callback);
+    slot.callback = nullptr;
+    int width = slot.width, height = slot.height;
+    if (buffer == nullptr)
+    {
+        stats.failed++;
+    }
+    else
+    {
+        stats.delivered++;
+    }
+    if (jobs == nullptr)
+    {
+        callback(buffer != nullptr ? buffer->data() : nullptr, width, height);
+        if (buffer != nullptr)
+        {
+            release(buffer);
+        }
+        return true;
+    }
+    if (callbacks.Pending() >= maxPending)
+    {
+        start = std::chrono::steady_clock::now();
+        jobs->Wait(callbacks);
+        stats.helpMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+    jobs->Run([this, callback, buffer, width, height]()
+              {
+                  callback(buffer != nullptr ? buffer->data() : nullptr, width, height);
+                  if (buffer != nullptr)
+                  {
+                      release(buffer);
+                  }
+              },
+              &callbacks);
+    return true;
+}
+
+/**
+    @brief Takes a CPU buffer of at least size bytes out of the pool, or allocates one
+*/
+std::vector<unsigned char> *AsyncReadback::acquire(size_t size)
+{
+    std::vector<unsigned char> *buffer;
+    {
+        std::lock_guard<std::mutex> guard(poolLock);
+        if (pool.empty())
+        {
+            buffer = new std::vector<unsigned char>();
+        }
+        else
+        {
+            buffer = pool.back().release();
+            pool.pop_back();
+        }
+    }
+    if (buffer->size() < size)
+    {
+        buffer->resize(size);
+    }
+    return buffer;
+}
+
+/**
+    @brief Returns a CPU buffer to the pool, called by the callback jobs
+*/
+void AsyncReadback::release(std::vector<unsigned char> *buffer)
+{
+    std::lock_guard<std::mutex> guard(poolLock);
+    pool.push_back(std::unique_ptr<std::vector<unsigned char>>(buffer));
+}
+
+#endif
@@ -0,0 +1,705 @@
+/**
+    @class Bvh Bvh.h "Engine/Bvh.h"
+    @brief Bounding volume hierarchy over a triangle list for CPU ray casts
+    @details Built top-down with the surface area heuristic evaluated over BVH_SAH_BINS bins of the triangles'
+    centroids per axis, which finds splits about as good as a full sweep in linear time per level. The nodes are
+    stored flattened in depth-first order, 32 bytes each: a node's first child follows it in the array and only the
+    second child's index is kept, so the traversal walks mostly forward through memory. Leaves refer to a range of
+    the triangles, which are reordered to match and stored as a corner and two edges, what the Möller-Trumbore
+    test needs, in packs of BVH_PACK laid out component by component so one SSE test intersects a whole pack
+    (SimdMath's active level picks it, the scalar path tests the triangles one at a time). Every leaf starts a new
+    pack, the lanes left over hold zero sized triangles no ray hits. Intersect() finds the closest hit of a ray,
+    Occluded() stops at the first one (shadow rays). A hierarchy can be built over boxes instead, Visit() then walks
+    the boxes a ray reaches nearest first, which is how Picker finds the objects under a ray. Every query only reads
+    the hierarchy, so any number of threads may cast rays at the same time. No GL calls.
+*/
+
+#pragma once
+#ifndef BVH_H
+#define BVH_H
+
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include "SimdMath.h"
+
+#define BVH_SAH_BINS 16   // Centroid bins per axis when looking for a split
+#define BVH_MAX_LEAF 8    // Triangles a leaf may hold when splitting would not pay off
+#define BVH_STACK_SIZE 64 // Nodes a traversal can keep for later, deeper trees are cut off at build time
+#define BVH_PACK 4        // Triangles intersected at once, the lanes of an SSE register
+
+/**
+    @brief Closest intersection of a ray
+*/
+struct BvhHit
+{
+    float t = 0;        // Distance along the ray, in units of its direction
+    int triangle = -1;  // Index of the triangle in the list the hierarchy was built from
+    float u = 0, v = 0; // Barycentric coordinates of the hit, weights of the triangle's second and third corner
+};
+
+class Bvh
+{
+public:
+    struct Node
+    {
+        glm::vec3 min;
+        uint32_t first; // Leaf: first triangle slot (a multiple of BVH_PACK) or box, interior: index of second child
+        glm::vec3 max;
+        uint32_t count; // Leaf: number of triangles or boxes, 0 for interior nodes
+    };
+
+    struct Stats
+    {
+        int triangles = 0;
+        int nodes = 0;
+        int leaves = 0;
+        int depth = 0;
+        int packs = 0; // Packs of BVH_PACK triangles, the partly empty ones ending the leaves included
+        double buildMs = 0;
+    };
+
+private:
+    struct alignas(16) TrianglePack
+    {
+        float v0[3][BVH_PACK]; // x, y and z of the first corners
+        float e1[3][BVH_PACK]; // Edges to the second corners
+        float e2[3][BVH_PACK]; // Edges to the third corners
+    };
+
+    struct Ray
+    {
+        glm::vec3 origin, direction, inverse;
+#if SIMDMATH_X86
+        __m128 o[3], d[3]; // Origin and direction components in every lane
+#endif
+        Ray(const glm::vec3 &origin, const glm::vec3 &direction);
+    };
+
+    struct BuildItem
+    {
+        glm::vec3 min, max, centroid;
+        uint32_t id;
+    };
+
+    std::vector<Node> nodes;
+    std::vector<TrianglePack> packs; // In leaf order
+    std::vector<uint32_t> ids;       // Input index of every triangle slot (UINT32_MAX for empty lanes) or box
+    uint32_t leafWidth = 1;          // Items tested at once in a leaf, what the split costs are counted in
+    Stats stats;
+
+    void buildTriangles(const glm::vec3 *positions, const uint32_t *indices, uint32_t count);
+    void buildItems(std::vector<BuildItem> &items);
+    void build(std::vector<BuildItem> &items, uint32_t begin, uint32_t end, int depth);
+    static float area(const glm::vec3 &min, const glm::vec3 &max);
+    static bool slab(const Node &node, const Ray &ray, float tMax, float &tEntry);
+    static bool intersect(const TrianglePack &pack, int lanes, const Ray &ray, float tMax, float &t, float &u,
+                          float &v, int &lane);
+    static bool intersectScalar(const TrianglePack &pack, int lanes, const Ray &ray, float tMax, float &t, float &u,
+                                float &v, int &lane);
+#if SIMDMATH_X86
+    static bool intersectSSE(const TrianglePack &pack, const Ray &ray, float tMax, float &t, float &u, float &v,
+                             int &lane);
+#endif
+    template <typename Leaf>
+    bool traverse(const Ray &ray, float &tMax, Leaf leaf) const;
+
+public:
+    void Build(const std::vector<glm::vec3> &corners);
+    void Build(const std::vector<glm::vec3> &positions, const std::vector<uint32_t> &indices);
+    void Build(const std::vector<AABB> &boxes);
+    bool Intersect(const glm::vec3 &origin, const glm::vec3 &direction, float tMax, BvhHit &hit) const;
+    bool Occluded(const glm::vec3 &origin, const glm::vec3 &direction, float tMax) const;
+    template <typename Fn>
+    bool Visit(const glm::vec3 &origin, const glm::vec3 &direction, float &tMax, Fn fn) const;
+    bool Empty() const;
+    void GetBounds(glm::vec3 &min, glm::vec3 &max) const;
+    const Stats &GetStats() const;
+};
+
+/**
+    @brief Prepares a ray for the slab and the triangle tests
+*/
+Bvh::Ray::Ray(const glm::vec3 &origin, const glm::vec3 &direction)
+    : origin(origin), direction(direction), inverse(1.0f / direction)
+{
+#if SIMDMATH_X86
+    for (int axis = 0; axis < 3; axis++)
+    {
+        o[axis] = _mm_set1_ps(origin[axis]);
+        d[axis] = _mm_set1_ps(direction[axis]);
+    }
+#endif
+}
+
+/**
+    @brief Builds the hierarchy, replacing any earlier one
+    @param corners Triangle list, three corners per triangle
+*/
+void Bvh::Build(const std::vector<glm::vec3> &corners)
+{
+    buildTriangles(corners.data(), nullptr, (uint32_t)(corners.size() / 3));
+}
+
+/**
+    @brief Builds the hierarchy over an indexed mesh, replacing any earlier one
+    @param positions Vertex positions
+    @param indices Three per triangle, hits report the triangles in this order
+*/
+void Bvh::Build(const std::vector<glm::vec3> &positions, const std::vector<uint32_t> &indices)
+{
+    buildTriangles(positions.data(), indices.data(), (uint32_t)(indices.size() / 3));
+}
+
+/**
+    @brief Builds the hierarchy over boxes instead of triangles, for Visit()
+    @param boxes Boxes, Visit() reports them by their index in this list
+*/
+void Bvh::Build(const std::vector<AABB> &boxes)
+{
+    auto start = std::chrono::steady_clock::now();
+    std::vector<BuildItem> items(boxes.size());
+    for (size_t i = 0; i < boxes.size(); i++)
+    {
+        items[i].min = boxes[i].min;
+        items[i].max = boxes[i].max;
+        items[i].centroid = (boxes[i].min + boxes[i].max) * 0.5f;
+        items[i].id = (uint32_t)i;
+    }
+    leafWidth = 1;
+    buildItems(items);
+    ids.resize(items.size());
+    for (size_t i = 0; i < items.size(); i++)
+    {
+        ids[i] = items[i].id;
+    }
+    stats.buildMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+/**
+    @brief Builds the hierarchy over triangles and lays them out in packs, leaf by leaf
+    @param indices Three per triangle, null for a plain triangle list
+*/
+void Bvh::buildTriangles(const glm::vec3 *positions, const uint32_t *indices, uint32_t count)
+{
+    auto start = std::chrono::steady_clock::now();
+    auto corner = [positions, indices](uint32_t triangle, int k) -> const glm::vec3 &
+    {
+        return positions[indices != nullptr ? indices[triangle * 3 + k] : triangle * 3 + k];
+    };
+    std::vector<BuildItem> items(count);
+    for (uint32_t i = 0; i < count; i++)
+    {
+        const glm::vec3 &a = corner(i, 0), &b = corner(i, 1), &c = corner(i, 2);
+        items[i].min = glm::min(a, glm::min(b, c));
+        items[i].max = glm::max(a, glm::max(b, c));
+        items[i].centroid = (items[i].min + items[i].max) * 0.5f;
+        items[i].id = i;
+    }
+    leafWidth = BVH_PACK;
+    buildItems(items);
+    stats.triangles = (int)count;
+
+    // Every leaf moves to the start of a pack, the lanes after its last triangle stay zero
+    uint32_t packCount = 0;
+    for (const Node &node : nodes)
+    {
+        packCount += (node.count + BVH_PACK - 1) / BVH_PACK;
+    }
+    packs.assign(packCount, TrianglePack());
+    ids.assign((size_t)packCount * BVH_PACK, UINT32_MAX);
+    uint32_t slot = 0;
+    for (Node &node : nodes)
+    {
+        if (node.count == 0)
+        {
+            continue;
+        }
+        for (uint32_t i = 0; i < node.count; i++)
+        {
+            uint32_t id = items[node.first + i].id;
+            TrianglePack &pack = packs[(slot + i) / BVH_PACK];
+            int lane = (slot + i) % BVH_PACK;
+            glm::vec3 v0 = corner(id, 0), e1 = corner(id, 1) - v0, e2 = corner(id, 2) - v0;
+            for (int axis = 0; axis < 3; axis++)
+            {
+                pack.v0[axis][lane] = v0[axis];
+                pack.e1[axis][lane] = e1[axis];
+                pack.e2[axis][lane] = e2[axis];
+            }
+            ids[slot + i] = id;
+        }
+        node.first = slot;
+        slot += (node.count + BVH_PACK - 1) / BVH_PACK * BVH_PACK;
+    }
+    stats.packs = (int)packCount;
+    stats.buildMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+/**
+    @brief Builds the nodes over the items' boxes, leaving the items in leaf order
+*/
+void Bvh::buildItems(std::vector<BuildItem> &items)
+{
+    nodes.clear();
+    packs.clear();
+    ids.clear();
+    stats = Stats();
+    if (items.empty())
+    {
+        return;
+    }
+    nodes.reserve(items.size() * 2);
+    build(items, 0, (uint32_t)items.size(), 1);
+    stats.nodes = (int)nodes.size();
+}
+
+/**
+    @brief Appends the node of a range of items and, depth first, its children
+*/
+void Bvh::build(std::vector<BuildItem> &items, uint32_t begin, uint32_t end, int depth)
+{
+    uint32_t index = (uint32_t)nodes.size();
+    nodes.push_back(Node());
+    glm::vec3 min(FLT_MAX), max(-FLT_MAX), centroidMin(FLT_MAX), centroidMax(-FLT_MAX);
+    for (uint32_t i = begin; i < end; i++)
+    {
+        min = glm::min(min, items[i].min);
+        max = glm::max(max, items[i].max);
+        centroidMin = glm::min(centroidMin, items[i].centroid);
+        centroidMax = glm::max(centroidMax, items[i].centroid);
+    }
+    nodes[index].min = min;
+    nodes[index].max = max;
+    stats.depth = std::max(stats.depth, depth);
+
+    // Cheapest binned split, in units of the cost of testing one pack (one triangle or box without packs)
+    uint32_t count = end - begin;
+    auto tests = [this](int items)
+    {
+        return (float)((items + leafWidth - 1) / leafWidth);
+    };
+    float leafCost = tests((int)count);
+    float bestCost = FLT_MAX;
+    int bestAxis = -1, bestBin = 0;
+    if (count > 2 && depth < BVH_STACK_SIZE)
+    {
+        float parentArea = area(min, max);
+        for (int axis = 0; axis < 3; axis++)
+        {
+            float extent = centroidMax[axis] - centroidMin[axis];
+            if (extent <= 0)
+            {
+                continue;
+            }
+            int binCounts[BVH_SAH_BINS] = {};
+            glm::vec3 binMin[BVH_SAH_BINS], binMax[BVH_SAH_BINS];
+            std::fill(binMin, binMin + BVH_SAH_BINS, glm::vec3(FLT_MAX));
+            std::fill(binMax, binMax + BVH_SAH_BINS, glm::vec3(-FLT_MAX));
+            float scale = BVH_SAH_BINS / extent;
+            for (uint32_t i = begin; i < end; i++)
+            {
+                int bin = std::min(BVH_SAH_BINS - 1, (int)((items[i].centroid[axis] - centroidMin[axis]) * scale));
+                binCounts[bin]++;
+                binMin[bin] = glm::min(binMin[bin], items[i].min);
+                binMax[bin] = glm::max(binMax[bin], items[i].max);
+            }
+            // Areas and counts left of every plane, then the sweep from the right evaluates each plane
+            float leftArea[BVH_SAH_BINS - 1];
+            int leftCount[BVH_SAH_BINS - 1];
+            glm::vec3 lo(FLT_MAX), hi(-FLT_MAX);
+            int sum = 0;
+            for (int b = 0; b < BVH_SAH_BINS - 1; b++)
+            {
+                sum += binCounts[b];
+                lo = glm::min(lo, binMin[b]);
+                hi = glm::max(hi, binMax[b]);
+                leftCount[b] = sum;
+                leftArea[b] = sum > 0 ? area(lo, hi) : 0;
+            }
+            lo = glm::vec3(FLT_MAX);
+            hi = glm::vec3(-FLT_MAX);
+            sum = 0;
+            for (int b = BVH_SAH_BINS - 1; b > 0; b--)
+            {
+                sum += binCounts[b];
+                lo = glm::min(lo, binMin[b]);
+                hi = glm::max(hi, binMax[b]);
+                if (sum == 0 || leftCount[b - 1] == 0)
+                {
+                    continue;
+                }
+                float cost = 1.0f + (leftArea[b - 1] * tests(leftCount[b - 1]) + area(lo, hi) * tests(sum)) /
+                                        parentArea;
+                if (cost < bestCost)
+                {
+                    bestCost = cost;
+                    bestAxis = axis;
+                    bestBin = b;
+                }
+            }
+        }
+    }
+
+    if (bestAxis < 0 || (bestCost >= leafCost && count <= BVH_MAX_LEAF))
+    {
+        nodes[index].first = begin;
+        nodes[index].count = count;
+        stats.leaves++;
+        return;
+    }
+
+    float offset = centroidMin[bestAxis], scale = BVH_SAH_BINS / (centroidMax[bestAxis] - offset);
+    auto middle = std::partition(items.begin() + begin, items.begin() + end,
+                                 [&](const BuildItem &item)
+                                 {
+                                     int bin = (int)((item.centroid[bestAxis] - offset) * scale);
+                                     return std::min(BVH_SAH_BINS - 1, bin) < bestBin;
+                                 });
+    uint32_t split = (uint32_t)(middle - items.begin());
+    build(items, begin, split, depth + 1);
+    nodes[index].first = (uint32_t)nodes.size();
+    nodes[index].count = 0;
+    build(items, split, end, depth + 1);
+}
+
+/**
+    @brief Surface area of a box, halved (only ratios of areas are used)
+*/
+float Bvh::area(const glm::vec3 &min, const glm::vec3 &max)
+{
+    glm::vec3 d = max - min;
+    return d.x * d.y + d.y * d.z + d.z * d.x;
+}
+
+/**
+    @brief Slab test of a ray against a node's box
+    @param tEntry Receives the distance the ray enters the box at
+*/
+bool Bvh::slab(const Node &node, const Ray &ray, float tMax, float &tEntry)
+{
+    glm::vec3 t0 = (node.min - ray.origin) * ray.inverse;
+    glm::vec3 t1 = (node.max - ray.origin) * ray.inverse;
+    glm::vec3 near = glm::min(t0, t1), far = glm::max(t0, t1);
+    tEntry = std::max(std::max(near.x, near.y), std::max(near.z, 0.0f));
+    float tExit = std::min(std::min(far.x, far.y), std::min(far.z, tMax));
+    return tEntry <= tExit;
+}
+
+/**
+    @brief Closest hit of a ray among the triangles of a pack, with the SSE test unless SimdMath runs scalar
+    @param lanes Triangles of the pack in use
+    @param lane Receives the lane of the triangle hit
+*/
+bool Bvh::intersect(const TrianglePack &pack, int lanes, const Ray &ray, float tMax, float &t, float &u, float &v,
+                    int &lane)
+{
+#if SIMDMATH_X86
+    if (SimdMath::active != SimdMath::Scalar)
+    {
+        return intersectSSE(pack, ray, tMax, t, u, v, lane);
+    }
+#endif
+    return intersectScalar(pack, lanes, ray, tMax, t, u, v, lane);
+}
+
+/**
+    @brief Möller-Trumbore ray/triangle test of the triangles of a pack in turn, both sides of a triangle count
+*/
+bool Bvh::intersectScalar(const TrianglePack &pack, int lanes, const Ray &ray, float tMax, float &t, float &u,
+                          float &v, int &lane)
+{
+    bool found = false;
+    for (int i = 0; i < lanes; i++)
+    {
+        glm::vec3 v0(pack.v0[0][i], pack.v0[1][i], pack.v0[2][i]);
+        glm::vec3 e1(pack.e1[0][i], pack.e1[1][i], pack.e1[2][i]);
+        glm::vec3 e2(pack.e2[0][i], pack.e2[1][i], pack.e2[2][i]);
+        glm::vec3 p = glm::cross(ray.direction, e2);
+        float det = glm::dot(e1, p);
+        if (std::abs(det) < 1e-12f)
+        {
+            continue;
+        }
+        float inverse = 1.0f / det;
+        glm::vec3 s = ray.origin - v0;
+        float hitU = glm::dot(s, p) * inverse;
+        if (hitU < 0.0f || hitU > 1.0f)
+        {
+            continue;
+        }
+        glm::vec3 q = glm::cross(s, e1);
+        float hitV = glm::dot(ray.direction, q) * inverse;
+        if (hitV < 0.0f || hitU + hitV > 1.0f)
+        {
+            continue;
+        }
+        float hitT = glm::dot(e2, q) * inverse;
+        if (hitT > 0.0f && hitT < tMax)
+        {
+            tMax = t = hitT;
+            u = hitU;
+            v = hitV;
+            lane = i;
+            found = true;
+        }
+    }
+    return found;
+}
+
+#if SIMDMATH_X86
+/**
+    @brief The same test on the four triangles of a pack at once
+    @details Empty lanes have zero edges, their determinant of 0 fails them like a ray parallel to its triangle.
+*/
+bool Bvh::intersectSSE(const TrianglePack &pack, const Ray &ray, float tMax, float &t, float &u, float &v, int &lane)
+{
+    __m128 e1x = _mm_load_ps(pack.e1[0]), e1y = _mm_load_ps(pack.e1[1]), e1z = _mm_load_ps(pack.e1[2]);
+    __m128 e2x = _mm_load_ps(pack.e2[0]), e2y = _mm_load_ps(pack.e2[1]), e2z = _mm_load_ps(pack.e2[2]);
+    __m128 dx = ray.d[0], dy = ray.d[1], dz = ray.d[2];
+
+    // p = direction x e2, det = e1 . p
+    __m128 px = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+    __m128 py = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+    __m128 pz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+    __m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)), _mm_mul_ps(e1z, pz));
+    __m128 inverse = _mm_div_ps(_mm_set1_ps(1.0f), det);
+
+    // s = origin - v0, u = s . p / det
+    __m128 sx = _mm_sub_ps(ray.o[0], _mm_load_ps(pack.v0[0]));
+    __m128 sy = _mm_sub_ps(ray.o[1], _mm_load_ps(pack.v0[1]));
+    __m128 sz = _mm_sub_ps(ray.o[2], _mm_load_ps(pack.v0[2]));
+    __m128 hitU = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, px), _mm_mul_ps(sy, py)), _mm_mul_ps(sz, pz)),
+                             inverse);
+
+    // q = s x e1, v = direction . q / det, t = e2 . q / det
+    __m128 qx = _mm_sub_ps(_mm_mul_ps(sy, e1z), _mm_mul_ps(sz, e1y));
+    __m128 qy = _mm_sub_ps(_mm_mul_ps(sz, e1x), _mm_mul_ps(sx, e1z));
+    __m128 qz = _mm_sub_ps(_mm_mul_ps(sx, e1y), _mm_mul_ps(sy, e1x));
+    __m128 hitV = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)), _mm_mul_ps(dz, qz)),
+                             inverse);
+    __m128 hitT = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)),
+                             inverse);
+
+    const __m128 zero = _mm_setzero_ps();
+    __m128 mask = _mm_cmpge_ps(_mm_andnot_ps(_mm_set1_ps(-0.0f), det), _mm_set1_ps(1e-12f));
+    mask = _mm_and_ps(mask, _mm_cmpge_ps(hitU, zero));
+    mask = _mm_and_ps(mask, _mm_cmpge_ps(hitV, zero));
+    mask = _mm_and_ps(mask, _mm_cmple_ps(_mm_add_ps(hitU, hitV), _mm_set1_ps(1.0f)));
+    mask = _mm_and_ps(mask, _mm_cmpgt_ps(hitT, zero));
+    mask = _mm_and_ps(mask, _mm_cmplt_ps(hitT, _mm_set1_ps(tMax)));
+    int bits = _mm_movemask_ps(mask);
+    if (bits == 0)
+    {
+        return false;
+    }
+
+    alignas(16) float ts[BVH_PACK], us[BVH_PACK], vs[BVH_PACK];
+    _mm_store_ps(ts, hitT);
+    _mm_store_ps(us, hitU);
+    _mm_store_ps(vs, hitV);
+    lane = -1;
+    for (int i = 0; i < BVH_PACK; i++)
+    {
+        if ((bits & (1 << i)) && (lane < 0 || ts[i] < ts[lane]))
+        {
+            lane = i;
+        }
+    }
+    t = ts[lane];
+    u = us[lane];
+    v = vs[lane];
+    return true;
+}
+#endif
+
+/**
+    @brief Walks the leaves a ray reaches, nearer child first, skipping the nodes beyond the closest hit so far
+    @param leaf Called as leaf(node, tMax) for every leaf reached, returns whether it found a hit, which shortened tMax
+    @returns bool, whether any leaf found a hit
+*/
+template <typename Leaf>
+bool Bvh::traverse(const Ray &ray, float &tMax, Leaf leaf) const
+{
+    if (nodes.empty())
+    {
+        return false;
+    }
+    uint32_t stack[BVH_STACK_SIZE];
+    int size = 0;
+    uint32_t index = 0;
+    bool found = false;
+    float tEntry;
+    if (!slab(nodes[0], ray, tMax, tEntry))
+    {
+        return false;
+    }
+    while (true)
+    {
+        const Node &node = nodes[index];
+        if (node.count > 0)
+        {
+            found = leaf(node, tMax) || found;
+        }
+        else
+        {
+            // Nearer child first, the farther one waits on the stack
+            uint32_t first = index + 1, second = node.first;
+            float tFirst, tSecond;
+            bool hitFirst = slab(nodes[first], ray, tMax, tFirst);
+            bool hitSecond = slab(nodes[second], ray, tMax, tSecond);
+            if (hitFirst && hitSecond)
+            {
+                if (tSecond < tFirst)
+                {
+                    std::swap(first, second);
+                }
+                stack[size++] = second;
+                index = first;
+                continue;
+            }
+            if (hitFirst || hitSecond)
+            {
+                index = hitFirst ? first : second;
+                continue;
+            }
+        }
+        // Nodes waiting on the stack may lie beyond a hit found since they were pushed
+        do
+        {
+            if (size == 0)
+            {
+                return found;
+            }
+            index = stack[--size];
+        } while (!slab(nodes[index], ray, tMax, tEntry));
+    }
+}
+
+/**
+    @brief Finds the closest triangle a ray hits
+    @param origin Start of the ray
+    @param direction Direction of the ray, t is measured in its length
+    @param tMax Hits at or beyond this distance are ignored
+    @param hit Receives the closest hit
+    @returns bool, whether the ray hits a triangle before tMax
+*/
+bool Bvh::Intersect(const glm::vec3 &origin, const glm::vec3 &direction, float tMax, BvhHit &hit) const
+{
+    Ray ray(origin, direction);
+    return traverse(ray, tMax, [&](const Node &node, float &closest)
+                    {
+                        bool found = false;
+                        uint32_t end = node.first + node.count;
+                        for (uint32_t slot = node.first; slot < end; slot += BVH_PACK)
+                        {
+                            float t, u, v;
+                            int lane;
+                            int lanes = (int)std::min<uint32_t>(BVH_PACK, end - slot);
+                            if (intersect(packs[slot / BVH_PACK], lanes, ray, closest, t, u, v, lane))
+                            {
+                                closest = t;
+                                hit.t = t;
+                                hit.triangle = (int)ids[slot + lane];
+                                hit.u = u;
+                                hit.v = v;
+                                found = true;
+                            }
+                        }
+                        return found; });
+}
+
+/**
+    @brief Whether a ray hits any triangle before a distance, for shadow and visibility rays
+*/
+bool Bvh::Occluded(const glm::vec3 &origin, const glm::vec3 &direction, float tMax) const
+{
+    if (nodes.empty())
+    {
+        return false;
+    }
+    Ray ray(origin, direction);
+    uint32_t stack[BVH_STACK_SIZE];
+    int size = 0;
+    stack[size++] = 0;
+    while (size > 0)
+    {
+        const Node &node = nodes[stack[--size]];
+        float tEntry;
+        if (!slab(node, ray, tMax, tEntry))
+        {
+            continue;
+        }
+        if (node.count == 0)
+        {
+            stack[size++] = node.first;
+            stack[size++] = (uint32_t)(&node - nodes.data()) + 1;
+            continue;
+        }
+        uint32_t end = node.first + node.count;
+        for (uint32_t slot = node.first; slot < end; slot += BVH_PACK)
+        {
+            float t, u, v;
+            int lane;
+            int lanes = (int)std::min<uint32_t>(BVH_PACK, end - slot);
+            if (intersect(packs[slot / BVH_PACK], lanes, ray, tMax, t, u, v, lane))
+            {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+/**
+    @brief Walks the boxes a ray reaches, nearest first, in a hierarchy built over boxes
+    @details Boxes the ray enters beyond the closest hit so far are skipped, so fn should shorten tMax to its hits.
+    @param tMax Boxes entered at or beyond this distance are skipped, receives the closest hit
+    @param fn Called as fn(box, tMax) with the box's index in the list given to Build(), returns whether it found a
+    hit and shortened tMax to it
+    @returns bool, whether fn found any hit
+*/
+template <typename Fn>
+bool Bvh::Visit(const glm::vec3 &origin, const glm::vec3 &direction, float &tMax, Fn fn) const
+{
+    Ray ray(origin, direction);
+    return traverse(ray, tMax, [&](const Node &node, float &closest)
+                    {
+                        bool found = false;
+                        for (uint32_t i = node.first; i < node.first + node.count; i++)
+                        {
+                            found = fn(ids[i], closest) || found;
+                        }
+                        return found; });
+}
+
+/**
+    @brief Whether the hierarchy holds no triangles or boxes
+*/
+bool Bvh::Empty() const
+{
+    return nodes.empty();
+}
+
+/**
+    @brief Box around every triangle, empty (min above max) without triangles
+*/
+void Bvh::GetBounds(glm::vec3 &min, glm::vec3 &max) const
+{
+    min = nodes.empty() ? glm::vec3(FLT_MAX) : nodes[0].min;
+    max = nodes.empty() ? glm::vec3(-FLT_MAX) : nodes[0].max;
+}
+
+/**
+    @brief Size and build time of the hierarchy
+*/
+const Bvh::Stats &Bvh::GetStats() const
+{
+    return stats;
+}
+
+#endif
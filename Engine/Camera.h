@@ -1,7 +1,9 @@
 /**
     @class Camera Camera.h "Engine/Camera.h"
     @brief Class for handling camera transformations
-    @details This class handles camera transformations such as movements and rotations
+    @details This class handles camera transformations such as movements and rotations. Input only changes the
+    camera's position and angles and marks it dirty; Update() rebuilds the view once per frame and caches the view,
+    projection, view-projection and frustum planes for other systems to read.
     @author Kyler Legault
     @date 11/4/24
 */
@@ -13,6 +15,9 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include "MatrixStack.h"
+#include "Frustum.h"
+#include "Shader.h"
+#include "Profiler.h"
 
 class Camera
 {
@@ -21,17 +26,30 @@ class Camera
   glm::vec3 cameraPos, cameraUp, cameraFront, cameraDirection, cameraRight, up;
   float pitch, yaw, roll;
 
+  // Cached results of the last update
+  bool dirty;
+  glm::mat4 view, projection, viewProjection;
+  Frustum frustum;
+
   void updateCamera();
 
 public:
   Camera(MatrixStack *_ms, glm::vec3 _up);
   void SetShader(Shader *_shader);
+  void SetProjection(const glm::mat4 &_projection);
   void SlideFront(float speed);
   void SlideSide(float speed);
   void SlideUp(float speed);
   void Pitch(float angle);
   void Yaw(float angle);
   void Roll(float angle);
+  void LookAt(const glm::vec3 &eye, const glm::vec3 &target);
+  bool Update();
+  glm::vec3 GetPosition() const;
+  const glm::mat4 &GetView();
+  const glm::mat4 &GetProjection();
+  const glm::mat4 &GetViewProjection();
+  const Frustum &GetFrustum();
 };
 
 /**
@@ -45,6 +63,9 @@ Camera::Camera(MatrixStack *_ms, glm::vec3 _up = glm::vec3(0, 1, 0))
   // TODO: Maybe add start position as a parameter?
   ms = _ms;
   up = _up;
+  shader = nullptr;
+  pitch = yaw = roll = 0;
+  projection = glm::perspective(glm::radians(45.0f), 8.0f / 6.0f, 0.1f, 100.0f); // Same default as Shader
 
   // Only used in setup
   glm::vec3 cameraTarget = glm::vec3(0, 0, 3);
@@ -56,7 +77,8 @@ Camera::Camera(MatrixStack *_ms, glm::vec3 _up = glm::vec3(0, 1, 0))
   cameraRight = glm::normalize(glm::cross(up, cameraDirection));
   cameraUp = glm::normalize(glm::cross(cameraDirection, cameraRight));
 
-  updateCamera();
+  dirty = true;
+  Update();
 }
 
 /**
@@ -67,44 +89,55 @@ Camera::Camera(MatrixStack *_ms, glm::vec3 _up = glm::vec3(0, 1, 0))
 void Camera::SetShader(Shader *_shader)
 {
   shader = _shader;
+  shader->onReady([this]()
+                  { shader->setVec3("viewPos", cameraPos); });
+}
+
+/**
+    @brief Sets the projection the view-projection matrix and frustum are built with
+*/
+void Camera::SetProjection(const glm::mat4 &_projection)
+{
+  projection = _projection;
+  dirty = true;
 }
 
 /**
     @brief Moves camera front and back
-    @details Adds cameraFront * speed to cameraPos
+    @details Adds cameraFront * speed to cameraPos, the view is rebuilt by the next Update()
     @param speed Amount to move by
 */
 void Camera::SlideFront(float speed)
 {
   cameraPos += speed * cameraFront;
-  updateCamera();
+  dirty = true;
 }
 
 /**
     @brief Moves camera side to side
-    @details Adds cameraRight * speed to cameraPos
+    @details Adds cameraRight * speed to cameraPos, the view is rebuilt by the next Update()
     @param speed Amount to move by
 */
 void Camera::SlideSide(float speed)
 {
   cameraPos += speed * cameraRight;
-  updateCamera();
+  dirty = true;
 }
 
 /**
     @brief Moves camera up and down
-    @details Adds up * speed to cameraPos
+    @details Adds up * speed to cameraPos, the view is rebuilt by the next Update()
     @param speed Amount to move by
 */
 void Camera::SlideUp(float speed)
 {
   cameraPos += speed * up;
-  updateCamera();
+  dirty = true;
 }
 
 /**
     @brief Adjusts camera pitch (up and down rotation)
-    @details Adds angle to pitch
+    @details Adds angle to pitch, the view is rebuilt by the next Update()
     @param angle Angle to move by
 */
 void Camera::Pitch(float angle)
@@ -114,33 +147,120 @@ void Camera::Pitch(float angle)
     pitch = 89.0f;
   if (pitch < -89.0f)
     pitch = -89.0f;
-
-  updateCamera();
+  dirty = true;
 }
 
 /**
-    @brief Adjusts camera pitch (side to side rotation)
-    @details Adds angle to yaw
+    @brief Adjusts camera yaw (side to side rotation)
+    @details Adds angle to yaw, the view is rebuilt by the next Update()
     @param angle Angle to move by
 */
 void Camera::Yaw(float angle)
 {
   yaw += angle;
-  updateCamera();
+  dirty = true;
 }
 
-// TODO: implement this
+/**
+    @brief Adjusts camera roll (rotation about the view direction)
+    @details Adds angle to roll, the view is rebuilt by the next Update()
+    @param angle Angle to move by
+*/
 void Camera::Roll(float angle)
 {
-  // updateCamera();
+  roll += angle;
+  if (roll > 180.0f)
+    roll -= 360.0f;
+  if (roll < -180.0f)
+    roll += 360.0f;
+  dirty = true;
+}
+
+/**
+    @brief Places the camera at eye looking at target
+    @details Sets the position and derives yaw and pitch from the view direction, roll is reset. The view is rebuilt
+    by the next Update().
+    @param eye New camera position
+    @param target Point to look at, must differ from eye
+*/
+void Camera::LookAt(const glm::vec3 &eye, const glm::vec3 &target)
+{
+  glm::vec3 direction = glm::normalize(target - eye);
+  cameraPos = eye;
+  yaw = glm::degrees(atan2(direction.z, direction.x));
+  pitch = glm::clamp(glm::degrees(asin(direction.y)), -89.0f, 89.0f);
+  roll = 0;
+  dirty = true;
+}
+
+/**
+    @brief Applies the input accumulated since the last update
+    @details Call once per frame after input is processed. Does nothing if the camera did not change, so any
+    number of mouse and key events per frame cost one view rebuild.
+    @returns bool, whether the view changed
+*/
+bool Camera::Update()
+{
+  if (!dirty)
+  {
+    return false;
+  }
+  updateCamera();
+  dirty = false;
+  return true;
+}
+
+/**
+    @brief Returns the camera position in world space
+*/
+glm::vec3 Camera::GetPosition() const
+{
+  return cameraPos;
+}
+
+/**
+    @brief Returns the view matrix, applying pending input first
+*/
+const glm::mat4 &Camera::GetView()
+{
+  Update();
+  return view;
+}
+
+/**
+    @brief Returns the projection matrix
+*/
+const glm::mat4 &Camera::GetProjection()
+{
+  return projection;
+}
+
+/**
+    @brief Returns projection * view, applying pending input first
+*/
+const glm::mat4 &Camera::GetViewProjection()
+{
+  Update();
+  return viewProjection;
+}
+
+/**
+    @brief Returns the world space frustum planes of the view-projection, applying pending input first
+*/
+const Frustum &Camera::GetFrustum()
+{
+  Update();
+  return frustum;
 }
 
 /**
     @brief Updates camera variables
-    @details Recalculates camera directional vector/axes vectors and produces a view matrix on the matrix stack
+    @details Recalculates camera directional vector/axes vectors and produces a view matrix on the matrix stack,
+    along with the cached view-projection and frustum
 */
 void Camera::updateCamera()
 {
+  PROFILE_CPU_SCOPE("Camera::Update");
   // Calculate new camera direction
   cameraDirection.x = cos(glm::radians(yaw)) * cos(glm::radians(pitch));
   cameraDirection.y = sin(glm::radians(pitch));
@@ -151,10 +271,19 @@ void Camera::updateCamera()
   cameraUp = glm::normalize(glm::cross(cameraDirection, cameraRight));
   cameraFront = glm::normalize(cameraDirection);
 
-  // TODO: Implement roll calculation for cameraUp
+  // Roll turns the up and right axes about the view direction
+  if (roll != 0)
+  {
+    glm::mat4 rotation = glm::rotate(glm::mat4(1.0f), glm::radians(roll), cameraFront);
+    cameraUp = glm::vec3(rotation * glm::vec4(cameraUp, 0.0f));
+    cameraRight = glm::vec3(rotation * glm::vec4(cameraRight, 0.0f));
+  }
 
   // Derives view matrix
-  ms->top() = glm::lookAt(cameraPos, cameraPos + cameraFront, cameraUp);
+  view = glm::lookAt(cameraPos, cameraPos + cameraFront, cameraUp);
+  viewProjection = projection * view;
+  frustum = Frustum(viewProjection);
+  ms->top() = view;
 
   // Update shader information
   if (shader != nullptr)
@@ -163,4 +292,4 @@ void Camera::updateCamera()
   }
 }
 
-#endif
\ No newline at end of file
+#endif
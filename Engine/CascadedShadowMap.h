@@ -0,0 +1,596 @@
+/**
+    @class CascadedShadowMap CascadedShadowMap.h "Engine/CascadedShadowMap.h"
+    @brief Cascaded shadow maps of the directional light that cache the static scene between frames
+    @details The camera's view range (up to maxDistance) is split into cascades, nearer ones covering less ground
+    at the same resolution. Each cascade is an orthographic view along the light of a sphere around its slice of
+    the camera frustum, made bigger by a margin: that sphere is the cascade's stable region. The static shapes are
+    drawn into a cascade's layer of a cache texture only when the light direction changes, Invalidate() is
+    called or the camera's slice no longer fits into the region, otherwise the cascade is reused as it is, so a
+    camera moving through a large static scene re-renders a cascade every few frames instead of all of them every
+    frame. Each frame the cached layers are copied into the shadow map the shaders sample and the dynamic shapes
+    are drawn on top, without copies while there are none. Shapes are drawn with the depth program of the
+    pre-pass, which reads only their position stream, and culled against each cascade. Programs registered with
+    AddReceiver() get the cascades' matrices whenever a cascade moves and select the SHADOWED variant of Simple.fs
+    through ShaderVariants. Per cascade, GetStats() counts renders and reuses and keeps the CPU and GPU time of the
+    last render (GPU times arrive a few frames later through timer queries, without stalling). The shapes are
+    registered and moved between the static and dynamic lists on the thread that moves them, which copies their
+    world matrices into Casters with Capture() (e.g. into the FramePacket); Update() draws from such a copy on the
+    context thread and never reads a Transform, so the shapes can keep moving while it draws.
+*/
+
+#pragma once
+#ifndef CASCADEDSHADOWMAP_H
+#define CASCADEDSHADOWMAP_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <vector>
+#include "Frustum.h"
+#include "ObjectBlock.h"
+#include "Profiler.h"
+#include "RenderStats.h"
+#include "Shader.h"
+#include "ShaderVariants.h"
+#include "Shape.h"
+
+#define SHADOW_MAX_CASCADES 4 // MAX_CASCADES in Simple.fs
+#define SHADOW_TEXTURE_UNIT 1 // Texture unit the shadow map is bound to, diffuse textures use unit 0
+
+class CascadedShadowMap
+{
+public:
+    struct CascadeStats
+    {
+        long long rendered = 0; // Frames its static shapes were drawn
+        long long reused = 0;   // Frames it was kept from an earlier frame
+        double cpuMs = 0;       // Time its last render took on the context thread
+        double gpuMs = 0;       // GPU time of its last render, once the query result is back
+        float radius = 0;       // Radius of the region it covers
+        int casters = 0;        // Static shapes drawn in its last render
+    };
+
+    struct Stats
+    {
+        CascadeStats cascades[SHADOW_MAX_CASCADES];
+        int dynamicDraws = 0;   // Dynamic shapes drawn into the cascades this frame
+        double compositeMs = 0; // Time copying the cached layers and drawing the dynamic shapes this frame
+    };
+
+    struct Caster
+    {
+        Shape *shape;
+        glm::mat4 world; // Of the shape when it was captured
+    };
+
+    /**
+        @brief Copy of the casters for one frame, filled by Capture() and drawn by Update()
+        @details The static casters are only copied again when the static shapes changed, so a Casters that is
+        reused every frame (or every few frames, as the packets of RenderThread are) stays allocation free.
+    */
+    struct Casters
+    {
+        std::vector<Caster> statics, dynamics;
+        long long version = -1; // Version of the static shapes the statics were copied at
+    };
+
+private:
+    struct Cascade
+    {
+        glm::mat4 lightSpace = glm::mat4(1.0f); // Projection * view of the light
+        glm::vec3 center = glm::vec3(0.0f);     // Stable region in world space
+        float radius = -1.0f;                   // Negative until the first render
+        unsigned int cacheFbo = 0, fbo = 0;     // Layer of the cache and of the sampled map
+        unsigned int query = 0;
+        bool queryPending = false;
+        bool composited = false; // The sampled layer holds dynamic shapes
+    };
+
+    Shader *depthShader;
+    int count, resolution;
+    float maxDistance;
+    float margin = 0.3f;          // Stable region radius relative to the slice's sphere
+    float casterDistance = 50.0f; // How far towards the light shapes outside the region still cast into it
+    unsigned int cache = 0, map = 0;
+    Cascade cascades[SHADOW_MAX_CASCADES];
+    glm::vec3 lightDirection = glm::vec3(0.0f);
+    std::vector<Shape *> staticShapes, dynamicShapes;
+    long long version = 0;        // Changes with the static shapes, on the thread that registers them
+    long long cachedVersion = -1; // Version of the static shapes in the cache, on the context thread
+    Casters current;              // Captured by the Update() without casters
+    std::vector<const Caster *> visible; // Casters of the cascade being drawn, kept to reuse its memory
+    std::vector<Shader *> receivers;
+    Stats stats;
+
+    unsigned int createMaps(bool compare);
+    void sliceSphere(const glm::mat4 &inverseView, const glm::mat4 &projection, float nearDepth, float farDepth,
+                     glm::vec3 &center, float &radius);
+    void place(Cascade &cascade, const glm::vec3 &center, float radius);
+    int drawCasters(const std::vector<Caster> &casters, const glm::mat4 &lightSpace);
+    void upload(Shader *shader);
+
+public:
+    CascadedShadowMap(Shader *depthShader, int cascadeCount = 3, int resolution = 1024, float maxDistance = 60.0f);
+    ~CascadedShadowMap();
+    CascadedShadowMap(const CascadedShadowMap &) = delete;
+    void operator=(const CascadedShadowMap &) = delete;
+
+    void AddStatic(Shape *shape);
+    void AddDynamic(Shape *shape);
+    void SetDynamic(Shape *shape, bool dynamic);
+    void AddReceiver(Shader *shader);
+    void Invalidate();
+    void Capture(Casters &casters) const;
+    void Update(const glm::mat4 &view, const glm::mat4 &projection, const glm::vec3 &direction, const Casters &casters);
+    void Update(const glm::mat4 &view, const glm::mat4 &projection, const glm::vec3 &direction);
+    void Bind();
+    int Cascades() const;
+    const glm::mat4 &LightSpace(int cascade) const;
+    const Stats &GetStats() const;
+    void PrintStats(std::ostream &out = std::cout) const;
+};
+
+/**
+    @brief Creates the cache and the sampled shadow map, both depth texture arrays with a layer per cascade
+    @param depthShader Program of the depth pre-pass (Depth.vs/Depth.fs), the shapes are drawn with it
+    @param cascadeCount Number of cascades, 1 to SHADOW_MAX_CASCADES
+    @param resolution Width and height of every cascade in texels
+    @param maxDistance How far from the camera shadows reach, clamped to the projection's far plane
+*/
+CascadedShadowMap::CascadedShadowMap(Shader *depthShader, int cascadeCount, int resolution, float maxDistance)
+    : depthShader(depthShader), count(std::max(1, std::min(cascadeCount, SHADOW_MAX_CASCADES))), resolution(resolution),
+      maxDistance(maxDistance)
+{
+    GLint framebuffer = 0;
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &framebuffer);
+    cache = createMaps(false);
+    map = createMaps(true);
+    for (int i = 0; i < count; i++)
+    {
+        unsigned int *fbos[2] = {&cascades[i].cacheFbo, &cascades[i].fbo};
+        unsigned int textures[2] = {cache, map};
+        for (int j = 0; j < 2; j++)
+        {
+            glGenFramebuffers(1, fbos[j]);
+            glBindFramebuffer(GL_FRAMEBUFFER, *fbos[j]);
+            glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, textures[j], 0, i);
+            glDrawBuffer(GL_NONE);
+            glReadBuffer(GL_NONE);
+            if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            {
+                std::cout << "Shadow cascade " << i << " framebuffer is incomplete" << std::endl;
+            }
+        }
+        glGenQueries(1, &cascades[i].query);
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    ShaderVariants::SetActiveShadows(true);
+}
+
+/**
+    @brief Deletes the textures, framebuffers and queries, shapes select unshadowed variants again
+*/
+CascadedShadowMap::~CascadedShadowMap()
+{
+    for (int i = 0; i < count; i++)
+    {
+        glDeleteFramebuffers(1, &cascades[i].cacheFbo);
+        glDeleteFramebuffers(1, &cascades[i].fbo);
+        glDeleteQueries(1, &cascades[i].query);
+    }
+    glDeleteTextures(1, &cache);
+    glDeleteTextures(1, &map);
+    ShaderVariants::SetActiveShadows(false);
+}
+
+/**
+    @brief Creates a depth texture array with a layer per cascade
+    @param compare Whether it is sampled with depth comparison (sampler2DArrayShadow)
+*/
+unsigned int CascadedShadowMap::createMaps(bool compare)
+{
+    unsigned int texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT24, resolution, resolution, count, 0, GL_DEPTH_COMPONENT,
+                 GL_FLOAT, nullptr);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, compare ? GL_LINEAR : GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, compare ? GL_LINEAR : GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    if (compare)
+    {
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+    }
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    RenderStats::frame.textureBytes += (long long)resolution * resolution * count * 4;
+    return texture;
+}
+
+/**
+    @brief Adds a shape that does not move, cached in the cascades
+    @details Call Invalidate() when a static shape is moved or removed after all, or make a shape that is about to
+    move dynamic with SetDynamic().
+*/
+void CascadedShadowMap::AddStatic(Shape *shape)
+{
+    staticShapes.push_back(shape);
+    version++;
+}
+
+/**
+    @brief Adds a shape that moves, drawn into the cascades every frame
+*/
+void CascadedShadowMap::AddDynamic(Shape *shape)
+{
+    dynamicShapes.push_back(shape);
+}
+
+/**
+    @brief Moves a registered shape to the dynamic or the static shapes, e.g. while it is selected to be moved
+    @details Either way the cache is re-rendered in the next Update(), without the shape or with it where it is now.
+    Shapes that were not added are ignored.
+*/
+void CascadedShadowMap::SetDynamic(Shape *shape, bool dynamic)
+{
+    std::vector<Shape *> &from = dynamic ? staticShapes : dynamicShapes;
+    std::vector<Shape *> &to = dynamic ? dynamicShapes : staticShapes;
+    std::vector<Shape *>::iterator found = std::find(from.begin(), from.end(), shape);
+    if (found == from.end())
+    {
+        return;
+    }
+    from.erase(found);
+    to.push_back(shape);
+    version++;
+}
+
+/**
+    @brief Registers a program that receives the shadows, e.g. every variant through ShaderVariants::OnCompile
+    @details Programs still compiling get the cascades once they are linked.
+*/
+void CascadedShadowMap::AddReceiver(Shader *shader)
+{
+    receivers.push_back(shader);
+    shader->onReady([this, shader]()
+                    { upload(shader); });
+}
+
+/**
+    @brief Re-renders every cascade in the next Update(), for changes to the static shapes
+*/
+void CascadedShadowMap::Invalidate()
+{
+    version++;
+}
+
+/**
+    @brief Copies the shapes and their world matrices for an Update() on another thread, call where they move
+    @details The dynamic shapes are copied every call, the static ones only when they changed since casters was
+    last filled.
+    @param casters Copy to fill, typically kept in the frame packet
+*/
+void CascadedShadowMap::Capture(Casters &casters) const
+{
+    if (casters.version != version)
+    {
+        casters.statics.clear();
+        for (Shape *shape : staticShapes)
+        {
+            casters.statics.push_back({shape, shape->GetTransform().World()});
+        }
+        casters.version = version;
+    }
+    casters.dynamics.clear();
+    for (Shape *shape : dynamicShapes)
+    {
+        casters.dynamics.push_back({shape, shape->GetTransform().World()});
+    }
+}
+
+/**
+    @brief Captures the shapes and updates the cascades, for shapes that are only moved on the context thread
+*/
+void CascadedShadowMap::Update(const glm::mat4 &view, const glm::mat4 &projection, const glm::vec3 &direction)
+{
+    Capture(current);
+    Update(view, projection, direction, current);
+}
+
+/**
+    @brief Re-renders the cascades that need it and composites the dynamic shapes, call before drawing the frame
+    @details Restores the bound framebuffer and viewport. Does nothing until the depth program is ready.
+    @param view Camera matrix of the frame
+    @param projection Perspective projection of the frame
+    @param direction Direction the directional light shines in
+    @param casters Shapes of the frame, from Capture()
+*/
+void CascadedShadowMap::Update(const glm::mat4 &view, const glm::mat4 &projection, const glm::vec3 &direction,
+                               const Casters &casters)
+{
+    PROFILE_SCOPE("CascadedShadowMap::Update");
+    auto elapsed = [](std::chrono::steady_clock::time_point since)
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - since).count();
+    };
+
+    // Timer results of earlier renders, only once they are available
+    for (int i = 0; i < count; i++)
+    {
+        Cascade &cascade = cascades[i];
+        GLint available = 0;
+        if (cascade.queryPending)
+        {
+            glGetQueryObjectiv(cascade.query, GL_QUERY_RESULT_AVAILABLE, &available);
+        }
+        if (available)
+        {
+            GLuint64 nanoseconds = 0;
+            glGetQueryObjectui64v(cascade.query, GL_QUERY_RESULT, &nanoseconds);
+            stats.cascades[i].gpuMs = nanoseconds / 1e6;
+            cascade.queryPending = false;
+        }
+    }
+
+    // Nothing is drawn while the depth program is still compiling, the receivers see no cascades until then
+    if (!depthShader->isReady())
+    {
+        return;
+    }
+
+    bool invalid = casters.version != cachedVersion;
+    glm::vec3 lightDir = glm::normalize(direction);
+    if (glm::length(lightDir - lightDirection) > 1e-5f)
+    {
+        lightDirection = lightDir;
+        invalid = true;
+    }
+
+    // Practical split scheme: halfway between logarithmic and uniform splits
+    float nearPlane = projection[3][2] / (projection[2][2] - 1.0f);
+    float farPlane = std::min(projection[3][2] / (projection[2][2] + 1.0f), maxDistance);
+    glm::mat4 inverseView = glm::inverse(view);
+
+    GLint framebuffer = 0, viewport[4];
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &framebuffer);
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    glViewport(0, 0, resolution, resolution);
+    glEnable(GL_POLYGON_OFFSET_FILL);
+    glPolygonOffset(2.0f, 4.0f);
+    depthShader->use();
+
+    bool moved = false;
+    bool composite = !casters.dynamics.empty();
+    auto start = std::chrono::steady_clock::now();
+    double renderMs = 0; // Of the cascades rendered this frame, the rest of the loop is compositing
+    stats.dynamicDraws = 0;
+    for (int i = 0; i < count; i++)
+    {
+        Cascade &cascade = cascades[i];
+        float first = (float)i / count, last = (float)(i + 1) / count;
+        float sliceNear = 0.5f * (nearPlane * std::pow(farPlane / nearPlane, first) + nearPlane + (farPlane - nearPlane) * first);
+        float sliceFar = 0.5f * (nearPlane * std::pow(farPlane / nearPlane, last) + nearPlane + (farPlane - nearPlane) * last);
+        glm::vec3 center;
+        float radius;
+        sliceSphere(inverseView, projection, sliceNear, sliceFar, center, radius);
+
+        bool rendered = false;
+        if (invalid || cascade.radius < 0 || glm::length(center - cascade.center) + radius > cascade.radius)
+        {
+            auto renderStart = std::chrono::steady_clock::now();
+            place(cascade, center, radius * (1.0f + margin));
+            glBindFramebuffer(GL_FRAMEBUFFER, cascade.cacheFbo);
+            glClear(GL_DEPTH_BUFFER_BIT);
+            if (!cascade.queryPending)
+            {
+                glBeginQuery(GL_TIME_ELAPSED, cascade.query);
+            }
+            stats.cascades[i].casters = drawCasters(casters.statics, cascade.lightSpace);
+            if (!cascade.queryPending)
+            {
+                glEndQuery(GL_TIME_ELAPSED);
+                cascade.queryPending = true;
+            }
+            stats.cascades[i].rendered++;
+            stats.cascades[i].cpuMs = elapsed(renderStart);
+            renderMs += stats.cascades[i].cpuMs;
+            stats.cascades[i].radius = cascade.radius;
+            RenderStats::frame.shadowCascadesRendered++;
+            rendered = moved = true;
+        }
+        else
+        {
+            stats.cascades[i].reused++;
+            RenderStats::frame.shadowCascadesReused++;
+        }
+
+        // The sampled layer is the cached one plus this frame's dynamic shapes
+        if (composite || rendered || cascade.composited)
+        {
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, cascade.cacheFbo);
+            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, cascade.fbo);
+            glBlitFramebuffer(0, 0, resolution, resolution, 0, 0, resolution, resolution, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+            glBindFramebuffer(GL_FRAMEBUFFER, cascade.fbo);
+            stats.dynamicDraws += drawCasters(casters.dynamics, cascade.lightSpace);
+            cascade.composited = composite;
+        }
+    }
+    cachedVersion = casters.version;
+    stats.compositeMs = elapsed(start) - renderMs;
+
+    glDisable(GL_POLYGON_OFFSET_FILL);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    if (moved)
+    {
+        for (Shader *shader : receivers)
+        {
+            if (shader->isReady())
+            {
+                upload(shader);
+            }
+        }
+    }
+}
+
+/**
+    @brief Bounding sphere of the part of the camera frustum between two view depths
+*/
+void CascadedShadowMap::sliceSphere(const glm::mat4 &inverseView, const glm::mat4 &projection, float nearDepth,
+                                    float farDepth, glm::vec3 &center, float &radius)
+{
+    glm::vec3 corners[8];
+    float depths[2] = {nearDepth, farDepth};
+    center = glm::vec3(0.0f);
+    for (int i = 0; i < 8; i++)
+    {
+        float depth = depths[i / 4];
+        glm::vec4 corner(depth / projection[0][0] * (i % 2 ? 1.0f : -1.0f), depth / projection[1][1] * (i / 2 % 2 ? 1.0f : -1.0f),
+                         -depth, 1.0f);
+        corners[i] = glm::vec3(inverseView * corner);
+        center += corners[i] / 8.0f;
+    }
+    radius = 0;
+    for (int i = 0; i < 8; i++)
+    {
+        radius = std::max(radius, glm::length(corners[i] - center));
+    }
+}
+
+/**
+    @brief Points a cascade at a region, its center snapped to whole texels so re-renders of the same scene match
+*/
+void CascadedShadowMap::place(Cascade &cascade, const glm::vec3 &center, float radius)
+{
+    glm::vec3 up = std::abs(lightDirection.y) > 0.99f ? glm::vec3(1, 0, 0) : glm::vec3(0, 1, 0);
+    glm::mat4 rotation = glm::lookAt(glm::vec3(0.0f), lightDirection, up);
+    float texel = 2.0f * radius / resolution;
+    glm::vec3 snapped = glm::vec3(rotation * glm::vec4(center, 1.0f));
+    snapped.x = std::floor(snapped.x / texel) * texel;
+    snapped.y = std::floor(snapped.y / texel) * texel;
+    cascade.center = glm::vec3(glm::inverse(rotation) * glm::vec4(snapped, 1.0f));
+    cascade.radius = radius;
+
+    glm::vec3 eye = cascade.center - lightDirection * (radius + casterDistance);
+    glm::mat4 lightView = glm::lookAt(eye, cascade.center, up);
+    glm::mat4 lightProjection = glm::ortho(-radius, radius, -radius, radius, 0.0f, 2.0f * radius + casterDistance);
+    cascade.lightSpace = lightProjection * lightView;
+}
+
+/**
+    @brief Draws the casters a cascade sees into the bound framebuffer with the bound depth program
+    @returns int, number of shapes drawn
+*/
+int CascadedShadowMap::drawCasters(const std::vector<Caster> &casters, const glm::mat4 &lightSpace)
+{
+    Frustum frustum(lightSpace);
+    visible.clear();
+    for (const Caster &caster : casters)
+    {
+        glm::vec3 center;
+        float radius;
+        if (!caster.shape->GetBounds(center, radius))
+        {
+            visible.push_back(&caster);
+            continue;
+        }
+        const glm::mat4 &world = caster.world;
+        float scale = glm::max(glm::length(glm::vec3(world[0])),
+                               glm::max(glm::length(glm::vec3(world[1])), glm::length(glm::vec3(world[2]))));
+        if (frustum.Intersects(glm::vec3(world * glm::vec4(center, 1.0f)), radius * scale))
+        {
+            visible.push_back(&caster);
+        }
+    }
+    if (visible.empty())
+    {
+        return 0;
+    }
+
+    ObjectBuffer *objects = ObjectBuffer::getInstance();
+    objects->Begin((int)visible.size());
+    ObjectBlock block;
+    for (int i = 0; i < (int)visible.size(); i++)
+    {
+        block.Set(lightSpace, visible[i]->world);
+        objects->Set(i, block);
+    }
+    objects->End();
+    for (int i = 0; i < (int)visible.size(); i++)
+    {
+        visible[i]->shape->DrawShadow(i);
+    }
+    return (int)visible.size();
+}
+
+/**
+    @brief Sets a receiving program's shadow map unit and cascade matrices
+*/
+void CascadedShadowMap::upload(Shader *shader)
+{
+    static const char *names[SHADOW_MAX_CASCADES] = {"lightSpace[0]", "lightSpace[1]", "lightSpace[2]", "lightSpace[3]"};
+    shader->use();
+    shader->setInt("shadowMap", SHADOW_TEXTURE_UNIT);
+    shader->setInt("numCascades", cascades[0].radius < 0 ? 0 : count);
+    for (int i = 0; i < count; i++)
+    {
+        shader->setMatrix4(names[i], cascades[i].lightSpace);
+    }
+}
+
+/**
+    @brief Binds the shadow map to SHADOW_TEXTURE_UNIT, leaves unit 0 active
+*/
+void CascadedShadowMap::Bind()
+{
+    glActiveTexture(GL_TEXTURE0 + SHADOW_TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, map);
+    glActiveTexture(GL_TEXTURE0);
+    RenderStats::frame.textureBinds++;
+}
+
+int CascadedShadowMap::Cascades() const
+{
+    return count;
+}
+
+/**
+    @brief Projection * view matrix of a cascade, as the shaders receive it
+*/
+const glm::mat4 &CascadedShadowMap::LightSpace(int cascade) const
+{
+    return cascades[cascade].lightSpace;
+}
+
+/**
+    @brief Render and reuse counts and times of every cascade
+*/
+const CascadedShadowMap::Stats &CascadedShadowMap::GetStats() const
+{
+    return stats;
+}
+
+/**
+    @brief Prints how often each cascade was rendered and reused and how long its last render took
+    @param out Stream to print to
+*/
+void CascadedShadowMap::PrintStats(std::ostream &out) const
+{
+    out << "Shadow cascades (" << resolution << "x" << resolution << ", " << staticShapes.size() << " static, "
+        << dynamicShapes.size() << " dynamic shapes):" << std::endl;
+    for (int i = 0; i < count; i++)
+    {
+        const CascadeStats &cascade = stats.cascades[i];
+        long long frames = cascade.rendered + cascade.reused;
+        out << "  cascade " << i << ": radius " << cascade.radius << ", rendered " << cascade.rendered << ", reused "
+            << cascade.reused << " (" << (frames > 0 ? 100.0 * cascade.reused / frames : 0.0) << "%), last render "
+            << cascade.cpuMs << " ms CPU, " << cascade.gpuMs << " ms GPU, " << cascade.casters << " shapes" << std::endl;
+    }
+}
+
+#endif
@@ -0,0 +1,338 @@
+/**
+    @file ChunkedMesh.h
+    @brief Chunked mesh files for streaming large meshes, independent of OpenGL
+    @details A chunked mesh is a mesh split into spatial chunks on a uniform grid (by triangle centroid), stored as
+    expanded Vertex lists so a chunk can be read with one seek and one read and uploaded as it is. Layout:
+
+        FileHeader | ChunkEntry[chunkCount] | proxy vertices of every chunk | vertices of every chunk
+
+    Every chunk has a coarse proxy, the chunk simplified by vertex clustering on a PROXY_GRID^3 grid, that is stored
+    up front so a reader can keep every proxy resident and page in only the full chunks (see MeshStreamer). Files
+    are written in the machine's byte order. Convert() builds one from an OBJ file; that step still parses the whole
+    OBJ and is meant to run offline (Tools/MeshChunker) or once when the chunked file is missing.
+*/
+
+#pragma once
+#ifndef CHUNKEDMESH_H
+#define CHUNKEDMESH_H
+
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "ObjLoader.h"
+
+namespace ChunkedMesh
+{
+    const uint32_t VERSION = 1;
+    const int DEFAULT_TRIANGLES_PER_CHUNK = 16384;
+    const int PROXY_GRID = 6; // Clustering cells per axis of a chunk's proxy
+
+    struct FileHeader
+    {
+        char magic[4]; // "CMSH"
+        uint32_t version;
+        uint32_t chunkCount;
+        uint32_t reserved;
+        glm::vec3 boundsMin, boundsMax; // Whole mesh
+    };
+
+    struct ChunkEntry
+    {
+        glm::vec3 boundsMin, boundsMax; // Object space box of the chunk's vertices
+        uint64_t offset;                // File offset of the chunk's vertices
+        uint64_t proxyOffset;           // File offset of the proxy's vertices
+        uint32_t vertexCount;           // Three per triangle
+        uint32_t proxyVertexCount;
+    };
+
+    static_assert(sizeof(FileHeader) == 40, "FileHeader must match the file layout");
+    static_assert(sizeof(ChunkEntry) == 48, "ChunkEntry must match the file layout");
+    static_assert(sizeof(Vertex) == 32, "Vertex must be 8 tightly packed floats");
+
+    /**
+        @brief Simplifies a triangle list by vertex clustering
+        @details Vertices are snapped to the average of their cell on a PROXY_GRID^3 grid over the box, triangles
+        whose corners fall into fewer than three cells disappear.
+        @param vertices Triangle list to simplify
+        @param count Number of vertices
+        @param boundsMin, boundsMax Box around the vertices
+        @param proxy Receives the simplified triangle list
+    */
+    void BuildProxy(const Vertex *vertices, int count, glm::vec3 boundsMin, glm::vec3 boundsMax, std::vector<Vertex> &proxy)
+    {
+        const int cells = PROXY_GRID * PROXY_GRID * PROXY_GRID;
+        glm::vec3 extent = glm::max(boundsMax - boundsMin, glm::vec3(1e-6f));
+        std::vector<int> cellOf(count);
+        std::vector<Vertex> sum(cells, Vertex{glm::vec3(0), glm::vec2(0), glm::vec3(0)});
+        std::vector<int> used(cells, 0);
+        for (int i = 0; i < count; i++)
+        {
+            glm::ivec3 cell = glm::clamp(glm::ivec3((vertices[i].position - boundsMin) / extent * (float)PROXY_GRID),
+                                         glm::ivec3(0), glm::ivec3(PROXY_GRID - 1));
+            int index = (cell.z * PROXY_GRID + cell.y) * PROXY_GRID + cell.x;
+            cellOf[i] = index;
+            sum[index].position += vertices[i].position;
+            sum[index].texture += vertices[i].texture;
+            sum[index].normal += vertices[i].normal;
+            used[index]++;
+        }
+        for (int c = 0; c < cells; c++)
+        {
+            if (used[c] > 0)
+            {
+                sum[c].position /= (float)used[c];
+                sum[c].texture /= (float)used[c];
+                float length = glm::length(sum[c].normal);
+                sum[c].normal = length > 0 ? sum[c].normal / length : glm::vec3(0, 1, 0);
+            }
+        }
+
+        proxy.clear();
+        for (int i = 0; i + 2 < count; i += 3)
+        {
+            int a = cellOf[i], b = cellOf[i + 1], c = cellOf[i + 2];
+            if (a != b && b != c && a != c)
+            {
+                proxy.push_back(sum[a]);
+                proxy.push_back(sum[b]);
+                proxy.push_back(sum[c]);
+            }
+        }
+    }
+
+    /**
+        @brief Splits a triangle list into chunks and writes a chunked mesh file
+        @param path File to write
+        @param vertices Expanded triangle list, as ObjLoader produces it
+        @param trianglesPerChunk Average number of triangles a chunk should hold
+        @returns bool, whether the file could be written
+    */
+    bool Write(const std::string &path, const std::vector<Vertex> &vertices, int trianglesPerChunk = DEFAULT_TRIANGLES_PER_CHUNK)
+    {
+        int triangles = (int)vertices.size() / 3;
+        FileHeader header;
+        memcpy(header.magic, "CMSH", 4);
+        header.version = VERSION;
+        header.reserved = 0;
+        header.boundsMin = header.boundsMax = vertices.empty() ? glm::vec3(0) : vertices[0].position;
+        for (const Vertex &v : vertices)
+        {
+            header.boundsMin = glm::min(header.boundsMin, v.position);
+            header.boundsMax = glm::max(header.boundsMax, v.position);
+        }
+
+        // Cubic cells sized so the mesh's box holds about triangles / trianglesPerChunk of them
+        glm::vec3 extent = glm::max(header.boundsMax - header.boundsMin, glm::vec3(1e-6f));
+        float volume = extent.x * extent.y * extent.z;
+        float target = std::max(1.0f, (float)triangles / std::max(1, trianglesPerChunk));
+        float cellSize = std::cbrt(volume / target);
+        glm::ivec3 grid = glm::clamp(glm::ivec3(glm::ceil(extent / cellSize)), glm::ivec3(1), glm::ivec3(256));
+        int cellCount = grid.x * grid.y * grid.z;
+
+        // Counting sort of the triangles by the cell of their centroid
+        std::vector<int> cellOf(triangles), start(cellCount + 1, 0), order(triangles);
+        for (int t = 0; t < triangles; t++)
+        {
+            glm::vec3 centroid = (vertices[t * 3].position + vertices[t * 3 + 1].position + vertices[t * 3 + 2].position) / 3.0f;
+            glm::ivec3 cell = glm::clamp(glm::ivec3((centroid - header.boundsMin) / extent * glm::vec3(grid)),
+                                         glm::ivec3(0), grid - 1);
+            cellOf[t] = (cell.z * grid.y + cell.y) * grid.x + cell.x;
+            start[cellOf[t] + 1]++;
+        }
+        for (int c = 0; c < cellCount; c++)
+        {
+            start[c + 1] += start[c];
+        }
+        std::vector<int> fill(start.begin(), start.end() - 1);
+        for (int t = 0; t < triangles; t++)
+        {
+            order[fill[cellOf[t]]++] = t;
+        }
+
+        // Gather every non-empty cell into a chunk with its proxy
+        std::vector<ChunkEntry> entries;
+        std::vector<std::vector<Vertex>> proxies;
+        std::vector<Vertex> chunk, proxy;
+        for (int c = 0; c < cellCount; c++)
+        {
+            if (start[c] == start[c + 1])
+            {
+                continue;
+            }
+            chunk.clear();
+            for (int i = start[c]; i < start[c + 1]; i++)
+            {
+                chunk.insert(chunk.end(), vertices.begin() + order[i] * 3, vertices.begin() + order[i] * 3 + 3);
+            }
+            ChunkEntry entry;
+            entry.boundsMin = entry.boundsMax = chunk[0].position;
+            for (const Vertex &v : chunk)
+            {
+                entry.boundsMin = glm::min(entry.boundsMin, v.position);
+                entry.boundsMax = glm::max(entry.boundsMax, v.position);
+            }
+            entry.vertexCount = (uint32_t)chunk.size();
+            BuildProxy(chunk.data(), (int)chunk.size(), entry.boundsMin, entry.boundsMax, proxy);
+            entry.proxyVertexCount = (uint32_t)proxy.size();
+            entries.push_back(entry);
+            proxies.push_back(proxy);
+        }
+        header.chunkCount = (uint32_t)entries.size();
+
+        uint64_t offset = sizeof(FileHeader) + entries.size() * sizeof(ChunkEntry);
+        for (ChunkEntry &entry : entries)
+        {
+            entry.proxyOffset = offset;
+            offset += entry.proxyVertexCount * sizeof(Vertex);
+        }
+        for (ChunkEntry &entry : entries)
+        {
+            entry.offset = offset;
+            offset += entry.vertexCount * sizeof(Vertex);
+        }
+
+        FILE *file = fopen(path.c_str(), "wb");
+        if (file == NULL)
+        {
+            std::cout << "Cannot write file " << path << std::endl;
+            return false;
+        }
+        bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+        ok = ok && (entries.empty() || fwrite(entries.data(), sizeof(ChunkEntry), entries.size(), file) == entries.size());
+        for (const std::vector<Vertex> &p : proxies)
+        {
+            ok = ok && (p.empty() || fwrite(p.data(), sizeof(Vertex), p.size(), file) == p.size());
+        }
+        for (int c = 0; c < cellCount; c++)
+        {
+            for (int i = start[c]; i < start[c + 1] && ok; i++)
+            {
+                ok = fwrite(&vertices[order[i] * 3], sizeof(Vertex), 3, file) == 3;
+            }
+        }
+        fclose(file);
+        if (!ok)
+        {
+            std::cout << "Failed writing " << path << std::endl;
+        }
+        return ok;
+    }
+
+    /**
+        @brief Converts an OBJ file into a chunked mesh file
+        @param objPath OBJ file to read
+        @param path Chunked mesh file to write
+        @param trianglesPerChunk Average number of triangles a chunk should hold
+        @returns bool, whether the OBJ could be read and the file written
+    */
+    bool Convert(const std::string &objPath, const std::string &path, int trianglesPerChunk = DEFAULT_TRIANGLES_PER_CHUNK)
+    {
+        std::vector<Vertex> vertices;
+        if (!ObjLoader::Load(objPath, vertices) || vertices.empty())
+        {
+            return false;
+        }
+        return Write(path, vertices, trianglesPerChunk);
+    }
+
+    /**
+        @brief Returns the size of an open file in bytes, -1 when it cannot be told, and leaves its position as it was
+    */
+    long long FileSize(FILE *file)
+    {
+#ifdef _WIN32
+        long long position = _ftelli64(file);
+        if (position < 0 || _fseeki64(file, 0, SEEK_END) != 0)
+        {
+            return -1;
+        }
+        long long size = _ftelli64(file);
+        return _fseeki64(file, position, SEEK_SET) == 0 ? size : -1;
+#else
+        off_t position = ftello(file);
+        if (position < 0 || fseeko(file, 0, SEEK_END) != 0)
+        {
+            return -1;
+        }
+        long long size = (long long)ftello(file);
+        return fseeko(file, position, SEEK_SET) == 0 ? size : -1;
+#endif
+    }
+
+    /**
+        @brief Checks that vertices stored at an offset lie within a file of the given size
+    */
+    bool FitsVertices(uint64_t offset, uint32_t count, long long size)
+    {
+        return offset <= (uint64_t)size && count <= ((uint64_t)size - offset) / sizeof(Vertex);
+    }
+
+    /**
+        @brief Reads the header and the chunk table of a chunked mesh file
+        @details The chunk count and every chunk's vertices are checked against the file's size before anything is
+        sized by them, so a truncated or corrupt file fails the read rather than the allocation.
+        @param file Open file, left positioned after the table
+        @param header Receives the header
+        @param entries Receives one entry per chunk
+        @returns bool, whether the file is a chunked mesh of this version and holds everything its table lists
+    */
+    bool ReadTable(FILE *file, FileHeader &header, std::vector<ChunkEntry> &entries)
+    {
+        entries.clear();
+        if (fseek(file, 0, SEEK_SET) != 0 || fread(&header, sizeof(header), 1, file) != 1 ||
+            memcmp(header.magic, "CMSH", 4) != 0 || header.version != VERSION)
+        {
+            return false;
+        }
+        long long size = FileSize(file);
+        if (size < (long long)sizeof(header) || header.chunkCount > ((uint64_t)size - sizeof(header)) / sizeof(ChunkEntry))
+        {
+            return false;
+        }
+        entries.resize(header.chunkCount);
+        if (!entries.empty() && fread(entries.data(), sizeof(ChunkEntry), entries.size(), file) != entries.size())
+        {
+            return false;
+        }
+        for (const ChunkEntry &entry : entries)
+        {
+            if (!FitsVertices(entry.offset, entry.vertexCount, size) ||
+                !FitsVertices(entry.proxyOffset, entry.proxyVertexCount, size))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+        @brief Reads vertices stored at an offset of the file
+        @param file Open file
+        @param offset File offset (ChunkEntry::offset or proxyOffset)
+        @param count Number of vertices
+        @param vertices Receives the vertices
+        @returns bool, whether they could be read
+    */
+    bool ReadVertices(FILE *file, uint64_t offset, uint32_t count, std::vector<Vertex> &vertices)
+    {
+        vertices.resize(count);
+        if (count == 0)
+        {
+            return true;
+        }
+#ifdef _WIN32
+        int sought = _fseeki64(file, (long long)offset, SEEK_SET);
+#else
+        int sought = fseeko(file, (off_t)offset, SEEK_SET);
+#endif
+        return sought == 0 && fread(vertices.data(), sizeof(Vertex), count, file) == count;
+    }
+}
+
+#endif
@@ -0,0 +1,227 @@
+/**
+    @class FrameArena FrameArena.h "Engine/FrameArena.h"
+    @brief Linear allocator for data that only lives for one frame
+    @details Allocation bumps an offset into a block; nothing is freed individually, Reset() rewinds the arena at
+    the end of the frame. A frame that outgrows the block chains overflow blocks, and the next Reset() replaces
+    them with one block big enough for the peak, so a steady-state frame never touches the heap. Each thread
+    works in its own arena: JobSystem gives every worker one, RenderThread gives its thread and every frame
+    packet one. FrameArena::Current() is the calling thread's arena (nullptr if it has none).
+    FrameAllocator adapts an arena to STL containers (FrameVector, FrameString); an allocator without an arena
+    falls back to the heap, so the same code also runs on threads that have no arena.
+*/
+
+#pragma once
+#ifndef FRAMEARENA_H
+#define FRAMEARENA_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#define FRAMEARENA_DEFAULT_CAPACITY (256 * 1024)
+
+class FrameArena
+{
+  struct Block
+  {
+    char *data;
+    size_t size;
+  };
+
+  std::vector<Block> blocks; // blocks[0] is kept across frames, later blocks are this frame's overflow
+  size_t offset = 0;         // into the last block
+  size_t used = 0, peak = 0; // bytes handed out this frame / in the largest frame so far
+
+  static thread_local FrameArena *current;
+
+  void addBlock(size_t size);
+
+public:
+  FrameArena(size_t capacity = FRAMEARENA_DEFAULT_CAPACITY);
+  ~FrameArena();
+  FrameArena(const FrameArena &) = delete;
+  void operator=(const FrameArena &) = delete;
+
+  void *Allocate(size_t size, size_t align = alignof(std::max_align_t));
+  void Reset();
+  size_t Used() const;
+  size_t Peak() const;
+  size_t Capacity() const;
+
+  static FrameArena *Current();
+  static void SetCurrent(FrameArena *arena);
+};
+
+thread_local FrameArena *FrameArena::current = nullptr;
+
+/**
+    @brief Creates an arena with one block
+    @param capacity Size of the first block in bytes
+*/
+FrameArena::FrameArena(size_t capacity)
+{
+  blocks.reserve(8);
+  addBlock(capacity);
+}
+
+FrameArena::~FrameArena()
+{
+  for (Block &block : blocks)
+  {
+    delete[] block.data;
+  }
+  if (current == this)
+  {
+    current = nullptr;
+  }
+}
+
+void FrameArena::addBlock(size_t size)
+{
+  blocks.push_back(Block{new char[size], size});
+  offset = 0;
+}
+
+/**
+    @brief Allocates memory that stays valid until the next Reset()
+    @param size Number of bytes
+    @param align Alignment, a power of two
+*/
+void *FrameArena::Allocate(size_t size, size_t align)
+{
+  Block *block = &blocks.back();
+  uintptr_t base = (uintptr_t)block->data;
+  uintptr_t start = (base + offset + align - 1) & ~(uintptr_t)(align - 1);
+  if (start + size > base + block->size)
+  {
+    addBlock(std::max(block->size * 2, size + align));
+    block = &blocks.back();
+    base = (uintptr_t)block->data;
+    start = (base + align - 1) & ~(uintptr_t)(align - 1);
+  }
+  offset = start + size - base;
+  used += size;
+  return (void *)start;
+}
+
+/**
+    @brief Rewinds the arena, every allocation made since the last reset becomes invalid
+    @details If the frame needed overflow blocks they are freed and the first block grows to hold the peak.
+*/
+void FrameArena::Reset()
+{
+  peak = std::max(peak, used);
+  if (blocks.size() > 1)
+  {
+    size_t capacity = 0;
+    for (Block &block : blocks)
+    {
+      capacity += block.size;
+      delete[] block.data;
+    }
+    blocks.clear();
+    addBlock(capacity);
+  }
+  offset = 0;
+  used = 0;
+}
+
+/**
+    @brief Bytes allocated since the last reset
+*/
+size_t FrameArena::Used() const
+{
+  return used;
+}
+
+/**
+    @brief Most bytes allocated in one frame
+*/
+size_t FrameArena::Peak() const
+{
+  return std::max(peak, used);
+}
+
+/**
+    @brief Total size of the arena's blocks
+*/
+size_t FrameArena::Capacity() const
+{
+  size_t capacity = 0;
+  for (const Block &block : blocks)
+  {
+    capacity += block.size;
+  }
+  return capacity;
+}
+
+/**
+    @brief Returns the calling thread's arena, nullptr if it has none
+*/
+FrameArena *FrameArena::Current()
+{
+  return current;
+}
+
+/**
+    @brief Sets the calling thread's arena
+*/
+void FrameArena::SetCurrent(FrameArena *arena)
+{
+  current = arena;
+}
+
+/**
+    @class FrameAllocator FrameArena.h "Engine/FrameArena.h"
+    @brief STL allocator that allocates from a FrameArena
+    @details Deallocation is a no-op, memory comes back when the arena is reset, so containers using it must not
+    outlive the frame. A default constructed allocator has no arena and uses the heap.
+*/
+template <typename T>
+class FrameAllocator
+{
+public:
+  typedef T value_type;
+  typedef std::true_type propagate_on_container_copy_assignment;
+  typedef std::true_type propagate_on_container_move_assignment;
+  typedef std::true_type propagate_on_container_swap;
+
+  FrameArena *arena;
+
+  FrameAllocator() : arena(nullptr) {}
+  FrameAllocator(FrameArena *_arena) : arena(_arena) {}
+  template <typename U>
+  FrameAllocator(const FrameAllocator<U> &other) : arena(other.arena) {}
+
+  T *allocate(size_t n)
+  {
+    if (arena != nullptr)
+    {
+      return (T *)arena->Allocate(n * sizeof(T), alignof(T));
+    }
+    return (T *)::operator new(n * sizeof(T));
+  }
+
+  void deallocate(T *p, size_t)
+  {
+    if (arena == nullptr)
+    {
+      ::operator delete(p);
+    }
+  }
+
+  template <typename U>
+  bool operator==(const FrameAllocator<U> &other) const { return arena == other.arena; }
+  template <typename U>
+  bool operator!=(const FrameAllocator<U> &other) const { return arena != other.arena; }
+};
+
+template <typename T>
+using FrameVector = std::vector<T, FrameAllocator<T>>;
+typedef std::basic_string<char, std::char_traits<char>, FrameAllocator<char>> FrameString;
+
+#endif
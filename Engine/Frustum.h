@@ -0,0 +1,81 @@
+/**
+    @class Frustum Frustum.h "Engine/Frustum.h"
+    @brief View frustum planes for visibility tests, independent of OpenGL
+    @details The six planes are extracted from a projection * view matrix (Gribb/Hartmann) and normalized so
+    bounding spheres can be tested with one dot product per plane. Plane normals point into the frustum.
+*/
+
+#pragma once
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <glm/glm.hpp>
+
+class Frustum
+{
+public:
+    glm::vec4 planes[6]; // left, right, bottom, top, near, far as (normal, distance)
+
+    Frustum();
+    Frustum(const glm::mat4 &viewProjection);
+    bool Intersects(const glm::vec3 &center, float radius) const;
+};
+
+/**
+    @brief Creates a frustum that contains everything
+*/
+Frustum::Frustum()
+{
+    for (int i = 0; i < 6; i++)
+    {
+        planes[i] = glm::vec4(0, 0, 0, 1);
+    }
+}
+
+/**
+    @brief Extracts the frustum planes of a projection * view matrix
+    @param viewProjection Matrix taking world space to clip space
+*/
+Frustum::Frustum(const glm::mat4 &viewProjection)
+{
+    const glm::mat4 &m = viewProjection;
+    glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+    glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+    glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+    glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+    planes[0] = row3 + row0;
+    planes[1] = row3 - row0;
+    planes[2] = row3 + row1;
+    planes[3] = row3 - row1;
+    planes[4] = row3 + row2;
+    planes[5] = row3 - row2;
+    for (int i = 0; i < 6; i++)
+    {
+        float length = glm::length(glm::vec3(planes[i]));
+        if (length > 0)
+        {
+            planes[i] /= length;
+        }
+    }
+}
+
+/**
+    @brief Tests a bounding sphere against the frustum
+    @param center Sphere center in the space the planes were extracted in
+    @param radius Sphere radius
+    @returns bool, false only if the sphere is completely outside one of the planes
+*/
+bool Frustum::Intersects(const glm::vec3 &center, float radius) const
+{
+    for (int i = 0; i < 6; i++)
+    {
+        if (glm::dot(glm::vec3(planes[i]), center) + planes[i].w < -radius)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+#endif
@@ -0,0 +1,575 @@
+/**
+    @class GpuCuller GpuCuller.h "Engine/GpuCuller.h"
+    @brief Culls and draws a scene of static meshes with one indirect draw call per frame
+    @details Meshes added to the culler share one vertex and one index buffer, objects (a mesh, a transform and a
+    material) live in a shader storage buffer. Where the context has compute shaders and indirect multi-draws
+    (GL 4.3, Mesa's llvmpipe included) Draw() dispatches Cull.comp, which frustum tests every object's bounding
+    sphere on the GPU and writes a DrawElementsIndirectCommand for each visible one, and then draws the whole scene
+    with a single glMultiDrawElementsIndirect. With GL 4.6 or GL_ARB_indirect_parameters the commands are compacted
+    and their number is read by glMultiDrawElementsIndirectCount, otherwise hidden objects keep a command with no
+    instances. The CPU never touches the objects after they are uploaded. Elsewhere (GL 3.3) Draw() falls back to
+    frustum culling on the CPU and one glDrawElementsBaseVertex per visible object with its ObjectBlock, like
+    RenderQueue. Both paths draw with Simple.fs and read the objects' materials from their MaterialBuffer slots, the
+    GPU path with Indirect.vs, the fallback with Simple.vs. Entry points newer than GL 3.3 are looked up at runtime
+    through the loader, so the engine still runs where they are missing. Everything here runs on the context thread.
+*/
+
+#pragma once
+#ifndef GPUCULLER_H
+#define GPUCULLER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "Frustum.h"
+#include "Material.h"
+#include "MaterialBuffer.h"
+#include "Meshlet.h"
+#include "ObjectBlock.h"
+#include "ObjLoader.h"
+#include "RenderStats.h"
+#include "Shader.h"
+#include "SimdMath.h"
+#include "Transform.h"
+#include "VertexLayout.h"
+
+#ifndef GL_COMPUTE_SHADER
+#define GL_COMPUTE_SHADER 0x91B9
+#endif
+#ifndef GL_SHADER_STORAGE_BUFFER
+#define GL_SHADER_STORAGE_BUFFER 0x90D2
+#endif
+#ifndef GL_DRAW_INDIRECT_BUFFER
+#define GL_DRAW_INDIRECT_BUFFER 0x8F3F
+#endif
+#ifndef GL_PARAMETER_BUFFER
+#define GL_PARAMETER_BUFFER 0x80EE
+#endif
+#ifndef GL_COMMAND_BARRIER_BIT
+#define GL_COMMAND_BARRIER_BIT 0x00000040
+#endif
+#ifndef GL_SHADER_STORAGE_BARRIER_BIT
+#define GL_SHADER_STORAGE_BARRIER_BIT 0x00002000
+#endif
+#ifndef GL_BUFFER_UPDATE_BARRIER_BIT
+#define GL_BUFFER_UPDATE_BARRIER_BIT 0x00000200
+#endif
+
+#define GPUCULLER_GROUP_SIZE 64 // local_size_x of Cull.comp
+
+class GpuCuller
+{
+public:
+    struct Stats
+    {
+        int objects = 0;
+        int visible = -1; // Objects drawn by the last Draw(), -1 on the GPU path until ReadVisible()
+        bool gpu = false; // Whether the last Draw() culled on the GPU
+    };
+
+private:
+    // std430 layout shared with Cull.comp and Indirect.vs
+    struct ObjectData
+    {
+        glm::mat4 model;
+        glm::vec4 normalMatrix[3]; // Columns
+        glm::vec4 bounds;          // World space center, radius
+        glm::ivec4 material;       // x is the slot of the material in the MaterialBlock, the rest pads
+        uint32_t mesh[4];          // Index count, first index, base vertex, mesh
+    };
+
+    struct DrawCommand
+    {
+        uint32_t count;
+        uint32_t instanceCount;
+        uint32_t firstIndex;
+        int32_t baseVertex;
+        uint32_t baseInstance;
+    };
+
+    struct Mesh
+    {
+        uint32_t firstIndex, indexCount;
+        int32_t baseVertex;
+        glm::vec3 center; // Object space bounding sphere
+        float radius;
+    };
+
+    typedef void(APIENTRYP DispatchComputeProc)(GLuint x, GLuint y, GLuint z);
+    typedef void(APIENTRYP MemoryBarrierProc)(GLbitfield barriers);
+    typedef void(APIENTRYP MultiDrawElementsIndirectProc)(GLenum mode, GLenum type, const void *indirect,
+                                                          GLsizei drawCount, GLsizei stride);
+    typedef void(APIENTRYP MultiDrawElementsIndirectCountProc)(GLenum mode, GLenum type, const void *indirect,
+                                                               GLintptr drawCount, GLsizei maxDrawCount, GLsizei stride);
+
+    DispatchComputeProc dispatchCompute = nullptr;
+    MemoryBarrierProc memoryBarrier = nullptr;
+    MultiDrawElementsIndirectProc multiDrawElementsIndirect = nullptr;
+    MultiDrawElementsIndirectCountProc multiDrawElementsIndirectCount = nullptr;
+
+    std::vector<Vertex> vertices;
+    std::vector<uint32_t> indices;
+    std::vector<Mesh> meshes;
+    std::vector<ObjectData> objects;
+    bool geometryDirty = false, objectsDirty = false;
+
+    unsigned int vao = 0, vbo = 0, ebo = 0, objectIDs = 0;
+    unsigned int objectBuffer = 0, commandBuffer = 0, countBuffer = 0;
+    unsigned int cullProgram = 0;
+    int cullPlanes = -1, cullCount = -1, cullCompact = -1;
+    int uploadedObjects = 0;
+
+    Shader *indirectShader = nullptr, *fallbackShader = nullptr;
+    Stats stats;
+
+    void upload();
+    void drawGpu(const glm::mat4 &viewProjection);
+    void drawCpu(const glm::mat4 &viewProjection);
+    bool compileCullProgram(const char *path);
+
+public:
+    GpuCuller(GLADloadproc load, const char *cullPath = "../Resources/Shaders/Cull.comp", bool allowGpu = true);
+    ~GpuCuller();
+    GpuCuller(const GpuCuller &) = delete;
+    void operator=(const GpuCuller &) = delete;
+
+    int AddMesh(const std::vector<Vertex> &expanded);
+    int AddMesh(std::string objPath);
+    int AddObject(int mesh, const Transform &transform, Material *material);
+    void SetTransform(int object, const Transform &transform);
+    void SetShaders(Shader *indirect, Shader *fallback);
+    bool UsesGpu() const;
+    void Draw(const glm::mat4 &viewProjection);
+    int ReadVisible();
+    const Stats &GetStats() const;
+};
+
+/**
+    @brief Looks up the GL 4.3+ entry points and builds the culling program, needs a current context
+    @param load GL function loader (glfwGetProcAddress, eglGetProcAddress)
+    @param cullPath Path of Cull.comp
+    @param allowGpu false always uses the CPU fallback
+*/
+GpuCuller::GpuCuller(GLADloadproc load, const char *cullPath, bool allowGpu)
+{
+    GLint major = 0, minor = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &major);
+    glGetIntegerv(GL_MINOR_VERSION, &minor);
+    int version = major * 10 + minor;
+    if (allowGpu && version >= 43)
+    {
+        dispatchCompute = (DispatchComputeProc)load("glDispatchCompute");
+        memoryBarrier = (MemoryBarrierProc)load("glMemoryBarrier");
+        multiDrawElementsIndirect = (MultiDrawElementsIndirectProc)load("glMultiDrawElementsIndirect");
+        if (version >= 46)
+        {
+            multiDrawElementsIndirectCount = (MultiDrawElementsIndirectCountProc)load("glMultiDrawElementsIndirectCount");
+        }
+        else
+        {
+            GLint extensions = 0;
+            glGetIntegerv(GL_NUM_EXTENSIONS, &extensions);
+            for (int i = 0; i < extensions; i++)
+            {
+                if (strcmp((const char *)glGetStringi(GL_EXTENSIONS, i), "GL_ARB_indirect_parameters") == 0)
+                {
+                    multiDrawElementsIndirectCount = (MultiDrawElementsIndirectCountProc)load("glMultiDrawElementsIndirectCountARB");
+                }
+            }
+        }
+        if (dispatchCompute == nullptr || memoryBarrier == nullptr || multiDrawElementsIndirect == nullptr ||
+            !compileCullProgram(cullPath))
+        {
+            dispatchCompute = nullptr;
+        }
+    }
+
+    glGenVertexArrays(1, &vao);
+    glGenBuffers(1, &vbo);
+    glGenBuffers(1, &ebo);
+    glGenBuffers(1, &objectIDs);
+    if (UsesGpu())
+    {
+        glGenBuffers(1, &objectBuffer);
+        glGenBuffers(1, &commandBuffer);
+        glGenBuffers(1, &countBuffer);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, countBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(uint32_t), nullptr, GL_DYNAMIC_DRAW);
+    }
+}
+
+GpuCuller::~GpuCuller()
+{
+    glDeleteVertexArrays(1, &vao);
+    glDeleteBuffers(1, &vbo);
+    glDeleteBuffers(1, &ebo);
+    glDeleteBuffers(1, &objectIDs);
+    if (UsesGpu())
+    {
+        glDeleteBuffers(1, &objectBuffer);
+        glDeleteBuffers(1, &commandBuffer);
+        glDeleteBuffers(1, &countBuffer);
+    }
+    if (cullProgram != 0)
+    {
+        glDeleteProgram(cullProgram);
+    }
+}
+
+/**
+    @brief Reads and links the culling compute shader
+    @returns bool, false (and the CPU fallback is used) if it does not compile
+*/
+bool GpuCuller::compileCullProgram(const char *path)
+{
+    std::ifstream file(path);
+    if (!file)
+    {
+        std::cout << "Cannot open file " << path << std::endl;
+        return false;
+    }
+    std::stringstream stream;
+    stream << file.rdbuf();
+    std::string code = stream.str();
+    const char *source = code.c_str();
+
+    unsigned int shader = glCreateShader(GL_COMPUTE_SHADER);
+    glShaderSource(shader, 1, &source, NULL);
+    glCompileShader(shader);
+    cullProgram = glCreateProgram();
+    glAttachShader(cullProgram, shader);
+    glLinkProgram(cullProgram);
+    glDeleteShader(shader);
+    GLint success = 0;
+    glGetProgramiv(cullProgram, GL_LINK_STATUS, &success);
+    if (!success)
+    {
+        char infoLog[1024];
+        glGetProgramInfoLog(cullProgram, 1024, NULL, infoLog);
+        std::cout << "ERROR::SHADER::COMPUTE::LINKING_FAILED\n"
+                  << infoLog << std::endl;
+        glDeleteProgram(cullProgram);
+        cullProgram = 0;
+        return false;
+    }
+    cullPlanes = glGetUniformLocation(cullProgram, "planes");
+    cullCount = glGetUniformLocation(cullProgram, "objectCount");
+    cullCompact = glGetUniformLocation(cullProgram, "compact");
+    return true;
+}
+
+/**
+    @brief Adds a mesh to the shared buffers
+    @param expanded Triangle list, as ObjLoader produces it, identical vertices are merged
+    @returns int, mesh index for AddObject()
+*/
+int GpuCuller::AddMesh(const std::vector<Vertex> &expanded)
+{
+    std::vector<Vertex> welded;
+    std::vector<uint32_t> meshIndices;
+    Meshlets::Weld(expanded, welded, meshIndices);
+
+    Mesh mesh;
+    mesh.firstIndex = (uint32_t)indices.size();
+    mesh.indexCount = (uint32_t)meshIndices.size();
+    mesh.baseVertex = (int32_t)vertices.size();
+    glm::vec3 lo = welded.empty() ? glm::vec3(0) : welded[0].position, hi = lo;
+    for (const Vertex &v : welded)
+    {
+        lo = glm::min(lo, v.position);
+        hi = glm::max(hi, v.position);
+    }
+    mesh.center = (lo + hi) * 0.5f;
+    mesh.radius = 0;
+    for (const Vertex &v : welded)
+    {
+        mesh.radius = glm::max(mesh.radius, glm::length(v.position - mesh.center));
+    }
+    meshes.push_back(mesh);
+    vertices.insert(vertices.end(), welded.begin(), welded.end());
+    indices.insert(indices.end(), meshIndices.begin(), meshIndices.end());
+    geometryDirty = true;
+    return (int)meshes.size() - 1;
+}
+
+/**
+    @brief Adds the mesh of an OBJ file to the shared buffers
+    @returns int, mesh index for AddObject(), -1 if the file could not be read
+*/
+int GpuCuller::AddMesh(std::string objPath)
+{
+    std::vector<Vertex> expanded;
+    if (!ObjLoader::Load(objPath, expanded) || expanded.empty())
+    {
+        return -1;
+    }
+    return AddMesh(expanded);
+}
+
+/**
+    @brief Adds an object drawing a mesh
+    @param mesh Index returned by AddMesh()
+    @param transform Object to world transform
+    @param material Material, registered with the MaterialBuffer, whose slot the object draws with; nullptr for
+    slot 0. Later MaterialBuffer::Update() calls reach both paths.
+    @returns int, object index for SetTransform()
+*/
+int GpuCuller::AddObject(int mesh, const Transform &transform, Material *material)
+{
+    ObjectData object;
+    object.mesh[0] = meshes[mesh].indexCount;
+    object.mesh[1] = meshes[mesh].firstIndex;
+    object.mesh[2] = (uint32_t)meshes[mesh].baseVertex;
+    object.mesh[3] = (uint32_t)mesh;
+    object.material = glm::ivec4(MaterialBuffer::getInstance()->Register(material), 0, 0, 0);
+    objects.push_back(object);
+    SetTransform((int)objects.size() - 1, transform);
+    return (int)objects.size() - 1;
+}
+
+/**
+    @brief Moves an object, the object buffer is uploaded again by the next Draw()
+*/
+void GpuCuller::SetTransform(int object, const Transform &transform)
+{
+    ObjectData &data = objects[object];
+    const Mesh &mesh = meshes[data.mesh[3]];
+    glm::mat3 normalMatrix;
+    data.model = transform.World();
+    SimdMath::normalMatrix(&data.model, &normalMatrix, 1);
+    for (int i = 0; i < 3; i++)
+    {
+        data.normalMatrix[i] = glm::vec4(normalMatrix[i], 0.0f);
+    }
+    float scale = glm::max(glm::length(glm::vec3(data.model[0])),
+                           glm::max(glm::length(glm::vec3(data.model[1])), glm::length(glm::vec3(data.model[2]))));
+    data.bounds = glm::vec4(glm::vec3(data.model * glm::vec4(mesh.center, 1.0f)), mesh.radius * scale);
+    objectsDirty = true;
+}
+
+/**
+    @brief Sets the programs the objects are drawn with
+    @param indirect Indirect.vs with Simple.fs, only needed when UsesGpu()
+    @param fallback Simple.vs with Simple.fs, only needed when !UsesGpu()
+*/
+void GpuCuller::SetShaders(Shader *indirect, Shader *fallback)
+{
+    indirectShader = indirect;
+    fallbackShader = fallback;
+}
+
+/**
+    @brief Whether Draw() culls on the GPU and draws with one indirect call
+*/
+bool GpuCuller::UsesGpu() const
+{
+    return dispatchCompute != nullptr;
+}
+
+/**
+    @brief Uploads meshes and objects added or changed since the last frame
+*/
+void GpuCuller::upload()
+{
+    if (geometryDirty)
+    {
+        glBindVertexArray(vao);
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.data(), GL_STATIC_DRAW);
+        VertexLayouts::Interleaved::Link();
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(uint32_t), indices.data(), GL_STATIC_DRAW);
+        glBindVertexArray(0);
+        RenderStats::frame.bufferBytes += vertices.size() * sizeof(Vertex) + indices.size() * sizeof(uint32_t);
+        geometryDirty = false;
+    }
+    if (!objectsDirty)
+    {
+        return;
+    }
+    if ((int)objects.size() != uploadedObjects)
+    {
+        // Object i is drawn as instance 0 with base instance i, which fetches objectIDs[i]
+        std::vector<uint32_t> ids(objects.size());
+        for (size_t i = 0; i < ids.size(); i++)
+        {
+            ids[i] = (uint32_t)i;
+        }
+        glBindVertexArray(vao);
+        glBindBuffer(GL_ARRAY_BUFFER, objectIDs);
+        glBufferData(GL_ARRAY_BUFFER, ids.size() * sizeof(uint32_t), ids.data(), GL_STATIC_DRAW);
+        VertexStream<Attribute<3, uint32_t>>::Link(1);
+        glBindVertexArray(0);
+        if (UsesGpu())
+        {
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+            glBufferData(GL_DRAW_INDIRECT_BUFFER, objects.size() * sizeof(DrawCommand), nullptr, GL_DYNAMIC_DRAW);
+        }
+        uploadedObjects = (int)objects.size();
+    }
+    if (UsesGpu())
+    {
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, objectBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, objects.size() * sizeof(ObjectData), objects.data(), GL_DYNAMIC_DRAW);
+        RenderStats::frame.bufferBytes += objects.size() * sizeof(ObjectData);
+    }
+    objectsDirty = false;
+}
+
+/**
+    @brief Culls the objects against the view and draws the visible ones
+    @param viewProjection Projection times camera matrix
+*/
+void GpuCuller::Draw(const glm::mat4 &viewProjection)
+{
+    PROFILE_SCOPE("GpuCuller::Draw");
+    upload();
+    stats.objects = (int)objects.size();
+    stats.gpu = UsesGpu();
+    if (objects.empty())
+    {
+        stats.visible = 0;
+        return;
+    }
+    if (UsesGpu())
+    {
+        drawGpu(viewProjection);
+    }
+    else
+    {
+        drawCpu(viewProjection);
+    }
+}
+
+/**
+    @brief Dispatches Cull.comp and draws its commands with one call
+*/
+void GpuCuller::drawGpu(const glm::mat4 &viewProjection)
+{
+    Frustum frustum(viewProjection);
+    bool compact = multiDrawElementsIndirectCount != nullptr;
+    uint32_t zero = 0;
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, countBuffer);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(uint32_t), &zero);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, objectBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, commandBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, countBuffer);
+
+    glUseProgram(cullProgram);
+    RenderStats::countProgram(cullProgram);
+    glUniform4fv(cullPlanes, 6, &frustum.planes[0][0]);
+    glUniform1ui(cullCount, (GLuint)objects.size());
+    glUniform1i(cullCompact, compact);
+    dispatchCompute((GLuint)(objects.size() + GPUCULLER_GROUP_SIZE - 1) / GPUCULLER_GROUP_SIZE, 1, 1);
+    // Buffer update for ReadVisible()'s glGetBufferSubData
+    memoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+
+    MaterialBuffer::getInstance()->Upload();
+    indirectShader->use();
+    indirectShader->setMatrix4("viewProjection", viewProjection);
+    glBindVertexArray(vao);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+    if (compact)
+    {
+        glBindBuffer(GL_PARAMETER_BUFFER, countBuffer);
+        multiDrawElementsIndirectCount(GL_TRIANGLES, GL_UNSIGNED_INT, nullptr, 0, (GLsizei)objects.size(), 0);
+    }
+    else
+    {
+        multiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, nullptr, (GLsizei)objects.size(), 0);
+    }
+    RenderStats::frame.drawCalls++;
+    glBindVertexArray(0);
+    stats.visible = -1;
+}
+
+/**
+    @brief Frustum culls on the CPU and draws every visible object with its own call
+*/
+void GpuCuller::drawCpu(const glm::mat4 &viewProjection)
+{
+    Frustum frustum(viewProjection);
+    ObjectBuffer *blocks = ObjectBuffer::getInstance();
+    int visible = 0;
+    for (const ObjectData &object : objects)
+    {
+        visible += frustum.Intersects(glm::vec3(object.bounds), object.bounds.w);
+    }
+    blocks->Begin(visible);
+    ObjectBlock block;
+    for (int i = 0, slot = 0; i < (int)objects.size(); i++)
+    {
+        if (frustum.Intersects(glm::vec3(objects[i].bounds), objects[i].bounds.w))
+        {
+            block.Set(viewProjection, objects[i].model, objects[i].material.x);
+            blocks->Set(slot++, block);
+        }
+    }
+    blocks->End();
+    MaterialBuffer::getInstance()->Upload();
+
+    fallbackShader->use();
+    glBindVertexArray(vao);
+    for (int i = 0, slot = 0; i < (int)objects.size(); i++)
+    {
+        const ObjectData &object = objects[i];
+        if (!frustum.Intersects(glm::vec3(object.bounds), object.bounds.w))
+        {
+            continue;
+        }
+        blocks->Bind(slot++);
+        glDrawElementsBaseVertex(GL_TRIANGLES, object.mesh[0], GL_UNSIGNED_INT,
+                                 (void *)(object.mesh[1] * sizeof(uint32_t)), (GLint)object.mesh[2]);
+        RenderStats::countDraw(object.mesh[0]);
+    }
+    glBindVertexArray(0);
+    stats.visible = visible;
+}
+
+/**
+    @brief Returns the number of objects the last Draw() drew
+    @details On the GPU path this reads the count back and waits for the culling to finish, for tests and
+    benchmarks rather than every frame. Without compaction it reads all commands.
+*/
+int GpuCuller::ReadVisible()
+{
+    if (!UsesGpu() || objects.empty())
+    {
+        return stats.visible;
+    }
+    if (multiDrawElementsIndirectCount != nullptr)
+    {
+        uint32_t count = 0;
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, countBuffer);
+        glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(uint32_t), &count);
+        stats.visible = (int)count;
+    }
+    else
+    {
+        std::vector<DrawCommand> commands(objects.size());
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+        glGetBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, commands.size() * sizeof(DrawCommand), commands.data());
+        stats.visible = 0;
+        for (const DrawCommand &command : commands)
+        {
+            stats.visible += command.instanceCount;
+        }
+    }
+    return stats.visible;
+}
+
+/**
+    @brief Returns the counters of the last Draw()
+*/
+const GpuCuller::Stats &GpuCuller::GetStats() const
+{
+    return stats;
+}
+
+#endif
@@ -0,0 +1,514 @@
+/**
+    @class JobSystem JobSystem.h "Engine/JobSystem.h"
+    @brief Work-stealing job scheduler for splitting frame work across cores
+    @details Every thread of the system owns a ring buffer of jobs: it pushes and pops its own jobs at the back and, when
+    it runs dry, steals from the front of the other threads' queues. The thread that creates the JobSystem is
+    thread 0 and takes part in the work whenever it waits, so a JobSystem of N threads spawns N - 1 workers and a
+    JobSystem of one thread runs everything inline. Completion is tracked with JobCounter: every job run against a
+    counter increments it, finishing decrements it, and jobs registered with Then() are scheduled once it drops to
+    zero. Jobs must not issue GL calls, only the context thread may. Every thread also gets a FrameArena for
+    its transient allocations, reset by ResetArenas() between frames.
+*/
+
+#pragma once
+#ifndef JOBSYSTEM_H
+#define JOBSYSTEM_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "FrameArena.h"
+
+#define JOBSYSTEM_SPIN_COUNT 64 // Failed steal attempts before an idle worker goes to sleep
+
+/**
+    @class JobCounter JobSystem.h "Engine/JobSystem.h"
+    @brief Dependency counter of a group of jobs
+*/
+class JobCounter
+{
+  friend class JobSystem;
+
+  struct Continuation
+  {
+    std::function<void()> fn;
+    JobCounter *counter;
+  };
+
+  std::atomic<int> pending{0};
+  std::mutex lock;
+  std::vector<Continuation> continuations;
+
+public:
+  JobCounter() {}
+  JobCounter(const JobCounter &) = delete;
+  void operator=(const JobCounter &) = delete;
+
+  // True once every job run against the counter has finished, only destroy a counter after JobSystem::Wait on it
+  bool Done() const { return pending.load(std::memory_order_acquire) == 0; }
+  int Pending() const { return pending.load(std::memory_order_acquire); }
+};
+
+class JobSystem
+{
+  struct Job
+  {
+    std::function<void()> fn;
+    JobCounter *counter;
+  };
+
+  // Ring buffer of jobs, grows but never shrinks so a steady-state frame does not allocate
+  struct Queue
+  {
+    std::mutex lock;
+    std::vector<Job> jobs;
+    size_t head = 0, count = 0;
+
+    void pushBack(Job &&job);
+    bool popBack(Job &job);
+    bool popFront(Job &job);
+  };
+
+  std::vector<std::unique_ptr<Queue>> queues;      // one per thread, queue 0 belongs to the creating thread
+  std::vector<std::unique_ptr<FrameArena>> arenas; // one per thread, same indices
+  std::vector<std::thread> workers;
+  std::atomic<int> queued{0};
+  std::atomic<int> sleeping{0};
+  std::atomic<unsigned int> nextExternal{0};
+  std::atomic<bool> running{true};
+  std::mutex sleepLock;
+  std::condition_variable wake;
+
+  static thread_local JobSystem *currentSystem; // system the calling thread belongs to
+  static thread_local int currentIndex;         // the calling thread's queue in that system
+
+  int threadIndex() const;
+  void push(Job job);
+  bool pop(int index, Job &job);
+  bool tryRunOne(int index);
+  void execute(Job &job);
+  void finish(JobCounter *counter);
+  void workerLoop(int index);
+
+public:
+  JobSystem(int threads = 0);
+  ~JobSystem();
+  JobSystem(const JobSystem &) = delete;
+  void operator=(const JobSystem &) = delete;
+
+  int Threads() const;
+  FrameArena *Arena(int thread);
+  void ResetArenas();
+  void Run(std::function<void()> fn, JobCounter *counter = nullptr);
+  void Then(JobCounter &dependency, std::function<void()> fn, JobCounter *counter = nullptr);
+  void Wait(JobCounter &counter);
+  template <typename Function>
+  void ParallelFor(int count, int grain, const Function &fn);
+  template <typename T, typename Allocator, typename Compare>
+  void ParallelSort(std::vector<T, Allocator> &items, Compare comp, int grain = 1024);
+};
+
+thread_local JobSystem *JobSystem::currentSystem = nullptr;
+thread_local int JobSystem::currentIndex = -1;
+
+/**
+    @brief Creates the queues and starts the worker threads
+    @param threads Total number of threads including the calling one, 0 uses every hardware thread
+*/
+JobSystem::JobSystem(int threads)
+{
+  if (threads <= 0)
+  {
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  for (int i = 0; i < threads; i++)
+  {
+    queues.push_back(std::unique_ptr<Queue>(new Queue()));
+    arenas.push_back(std::unique_ptr<FrameArena>(new FrameArena()));
+  }
+  currentSystem = this;
+  currentIndex = 0;
+  FrameArena::SetCurrent(arenas[0].get());
+  for (int i = 1; i < threads; i++)
+  {
+    workers.push_back(std::thread(&JobSystem::workerLoop, this, i));
+  }
+}
+
+/**
+    @brief Stops and joins the workers, jobs that were never waited on are dropped
+*/
+JobSystem::~JobSystem()
+{
+  {
+    std::lock_guard<std::mutex> guard(sleepLock);
+    running = false;
+  }
+  wake.notify_all();
+  for (std::thread &worker : workers)
+  {
+    worker.join();
+  }
+  if (currentSystem == this)
+  {
+    currentSystem = nullptr;
+    currentIndex = -1;
+  }
+  if (FrameArena::Current() == arenas[0].get())
+  {
+    FrameArena::SetCurrent(nullptr);
+  }
+}
+
+/**
+    @brief Number of threads work is spread over, including the creating thread
+*/
+int JobSystem::Threads() const
+{
+  return (int)queues.size();
+}
+
+/**
+    @brief Returns a thread's frame arena (thread 0 is the creating thread)
+*/
+FrameArena *JobSystem::Arena(int thread)
+{
+  return arenas[thread].get();
+}
+
+/**
+    @brief Resets the frame arena of every thread, call once per frame while no jobs are running
+*/
+void JobSystem::ResetArenas()
+{
+  for (std::unique_ptr<FrameArena> &arena : arenas)
+  {
+    arena->Reset();
+  }
+}
+
+/**
+    @brief Queue of the calling thread, -1 for threads outside the system
+*/
+int JobSystem::threadIndex() const
+{
+  return currentSystem == this ? currentIndex : -1;
+}
+
+/**
+    @brief Schedules a job
+    @param fn Work to run on any thread of the system
+    @param counter Incremented now and decremented once the job has run, may be null
+*/
+void JobSystem::Run(std::function<void()> fn, JobCounter *counter)
+{
+  if (counter != nullptr)
+  {
+    counter->pending.fetch_add(1, std::memory_order_relaxed);
+  }
+  push(Job{std::move(fn), counter});
+}
+
+/**
+    @brief Schedules a job once every job of a counter has finished
+    @param dependency Counter to wait on, the job is scheduled right away if it is already done
+    @param fn Work to run
+    @param counter Incremented now and decremented once the job has run, may be null
+*/
+void JobSystem::Then(JobCounter &dependency, std::function<void()> fn, JobCounter *counter)
+{
+  if (counter != nullptr)
+  {
+    counter->pending.fetch_add(1, std::memory_order_relaxed);
+  }
+  std::unique_lock<std::mutex> guard(dependency.lock);
+  if (dependency.Done())
+  {
+    guard.unlock();
+    push(Job{std::move(fn), counter});
+    return;
+  }
+  dependency.continuations.push_back(JobCounter::Continuation{std::move(fn), counter});
+}
+
+/**
+    @brief Blocks until every job of a counter has finished, running queued jobs meanwhile
+*/
+void JobSystem::Wait(JobCounter &counter)
+{
+  int index = threadIndex();
+  while (!counter.Done())
+  {
+    if (!tryRunOne(index))
+    {
+      std::this_thread::yield();
+    }
+  }
+  // The last job drops the count while holding the lock, taking it once more means finish() is done with the counter
+  std::lock_guard<std::mutex> guard(counter.lock);
+}
+
+/**
+    @brief Runs fn over [0, count) split into ranges of at most grain items, and waits for them
+    @param count Number of items
+    @param grain Items per job, 0 picks four ranges per thread
+    @param fn Called with each [begin, end) range. Jobs only hold a reference to it, so a lambda with any
+    number of captures does not allocate.
+*/
+template <typename Function>
+void JobSystem::ParallelFor(int count, int grain, const Function &fn)
+{
+  if (count <= 0)
+  {
+    return;
+  }
+  if (grain <= 0)
+  {
+    grain = std::max(1, count / (Threads() * 4));
+  }
+  if (Threads() == 1 || count <= grain)
+  {
+    fn(0, count);
+    return;
+  }
+  JobCounter counter;
+  for (int begin = grain; begin < count; begin += grain)
+  {
+    int end = std::min(count, begin + grain);
+    Run([&fn, begin, end]()
+        { fn(begin, end); },
+        &counter);
+  }
+  fn(0, std::min(count, grain)); // The first range runs on the calling thread
+  Wait(counter);
+}
+
+/**
+    @brief Sorts a vector by sorting ranges as jobs and merging them pairwise in parallel rounds
+    @details The merges go through a scratch copy allocated from the calling thread's frame arena.
+    @param items Vector to sort
+    @param comp Strict weak ordering, as for std::sort
+    @param grain Smallest range sorted by one job
+*/
+template <typename T, typename Allocator, typename Compare>
+void JobSystem::ParallelSort(std::vector<T, Allocator> &items, Compare comp, int grain)
+{
+  int count = (int)items.size();
+  int chunks = std::min(Threads() * 2, (count + grain - 1) / std::max(1, grain));
+  if (Threads() == 1 || chunks <= 1)
+  {
+    std::sort(items.begin(), items.end(), comp);
+    return;
+  }
+  FrameAllocator<int> allocator(FrameArena::Current());
+  FrameVector<int> bounds(chunks + 1, 0, allocator);
+  for (int i = 0; i <= chunks; i++)
+  {
+    bounds[i] = (int)((long long)count * i / chunks);
+  }
+
+  typename std::vector<T, Allocator>::iterator first = items.begin();
+  FrameVector<T> scratch(count, T(), FrameAllocator<T>(allocator));
+  typename FrameVector<T>::iterator buffer = scratch.begin();
+  ParallelFor(chunks, 1, [&](int begin, int end)
+              {
+                for (int i = begin; i < end; i++)
+                {
+                  std::sort(first + bounds[i], first + bounds[i + 1], comp);
+                } });
+  for (int width = 1; width < chunks; width *= 2)
+  {
+    int merges = (chunks + 2 * width - 1) / (2 * width);
+    ParallelFor(merges, 1, [&](int begin, int end)
+                {
+                  for (int m = begin; m < end; m++)
+                  {
+                    int i = m * 2 * width;
+                    if (i + width < chunks)
+                    {
+                      int lo = bounds[i], mid = bounds[i + width], hi = bounds[std::min(i + 2 * width, chunks)];
+                      std::merge(std::make_move_iterator(first + lo), std::make_move_iterator(first + mid),
+                                 std::make_move_iterator(first + mid), std::make_move_iterator(first + hi),
+                                 buffer + lo, comp);
+                      std::move(buffer + lo, buffer + hi, first + lo);
+                    }
+                  } });
+  }
+}
+
+/**
+    @brief Pushes a job onto the calling thread's queue (round robin for threads outside the system)
+*/
+void JobSystem::push(Job job)
+{
+  int index = threadIndex();
+  if (index < 0)
+  {
+    index = nextExternal.fetch_add(1, std::memory_order_relaxed) % queues.size();
+  }
+  {
+    std::lock_guard<std::mutex> guard(queues[index]->lock);
+    queues[index]->pushBack(std::move(job));
+  }
+  queued.fetch_add(1);
+  if (sleeping.load() > 0)
+  {
+    std::lock_guard<std::mutex> guard(sleepLock);
+    wake.notify_one();
+  }
+}
+
+/**
+    @brief Takes the newest job of the own queue, or steals the oldest job of another queue
+    @param index Queue of the calling thread, -1 to only steal
+*/
+bool JobSystem::pop(int index, Job &job)
+{
+  int count = (int)queues.size();
+  if (index >= 0)
+  {
+    Queue &own = *queues[index];
+    std::lock_guard<std::mutex> guard(own.lock);
+    if (own.popBack(job))
+    {
+      return true;
+    }
+  }
+  for (int i = 1; i <= count; i++)
+  {
+    Queue &victim = *queues[(std::max(index, 0) + i) % count];
+    std::lock_guard<std::mutex> guard(victim.lock);
+    if (victim.popFront(job))
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+    @brief Runs one queued job if there is any
+    @returns bool, whether a job was run
+*/
+bool JobSystem::tryRunOne(int index)
+{
+  if (queued.load(std::memory_order_relaxed) == 0)
+  {
+    return false;
+  }
+  Job job;
+  if (!pop(index, job))
+  {
+    return false;
+  }
+  queued.fetch_sub(1);
+  execute(job);
+  return true;
+}
+
+void JobSystem::execute(Job &job)
+{
+  job.fn();
+  if (job.counter != nullptr)
+  {
+    finish(job.counter);
+  }
+}
+
+/**
+    @brief Decrements a counter and schedules its continuations when it reaches zero
+*/
+void JobSystem::finish(JobCounter *counter)
+{
+  std::vector<JobCounter::Continuation> continuations;
+  {
+    // The lock is taken before the decrement so Then() can never add to a counter that is being drained
+    std::lock_guard<std::mutex> guard(counter->lock);
+    if (counter->pending.fetch_sub(1, std::memory_order_acq_rel) != 1)
+    {
+      return;
+    }
+    continuations.swap(counter->continuations);
+  }
+  for (JobCounter::Continuation &continuation : continuations)
+  {
+    push(Job{std::move(continuation.fn), continuation.counter});
+  }
+}
+
+void JobSystem::Queue::pushBack(Job &&job)
+{
+  if (count == jobs.size())
+  {
+    std::vector<Job> grown(std::max<size_t>(64, jobs.size() * 2));
+    for (size_t i = 0; i < count; i++)
+    {
+      grown[i] = std::move(jobs[(head + i) % jobs.size()]);
+    }
+    jobs.swap(grown);
+    head = 0;
+  }
+  jobs[(head + count) % jobs.size()] = std::move(job);
+  count++;
+}
+
+bool JobSystem::Queue::popBack(Job &job)
+{
+  if (count == 0)
+  {
+    return false;
+  }
+  count--;
+  job = std::move(jobs[(head + count) % jobs.size()]);
+  return true;
+}
+
+bool JobSystem::Queue::popFront(Job &job)
+{
+  if (count == 0)
+  {
+    return false;
+  }
+  job = std::move(jobs[head]);
+  head = (head + 1) % jobs.size();
+  count--;
+  return true;
+}
+
+/**
+    @brief Worker thread body: runs and steals jobs, sleeps when there is nothing to do
+*/
+void JobSystem::workerLoop(int index)
+{
+  currentSystem = this;
+  currentIndex = index;
+  FrameArena::SetCurrent(arenas[index].get());
+  int idle = 0;
+  while (running.load(std::memory_order_relaxed))
+  {
+    if (tryRunOne(index))
+    {
+      idle = 0;
+      continue;
+    }
+    if (++idle < JOBSYSTEM_SPIN_COUNT)
+    {
+      std::this_thread::yield();
+      continue;
+    }
+    std::unique_lock<std::mutex> guard(sleepLock);
+    sleeping.fetch_add(1);
+    wake.wait(guard, [this]()
+              { return queued.load() > 0 || !running.load(); });
+    sleeping.fetch_sub(1);
+    idle = 0;
+  }
+}
+
+#endif
@@ -4,8 +4,10 @@
 #define LIGHT_H
 
 #include <glm/glm.hpp>
+#include <cstdio>
 #include <string>
 #include "VAO.h"
+#include "FrameArena.h"
 #include "Shape.h"
 
 enum LightType
@@ -18,6 +20,7 @@ struct BaseLight
 {
   LightType type;
   glm::vec3 ambient, diffuse, specular;
+  bool baked = false; // In the lightmaps (LightmapBaker.h), lightmapped objects only add its specular term
 };
 struct DirectionalLight : BaseLight
 {
@@ -38,6 +41,15 @@ struct PointLight : BaseLight
   float constant, linear, quadratic;
 };
 
+// Copy of a light's properties, what a frame packet carries to the render thread
+struct LightState
+{
+  LightType type;
+  int index; // pointLights[] index for point lights
+  DirectionalLight directional;
+  PointLight point;
+};
+
 /**
     @class Light Light.h "Engine/Light.h"
     @brief Class for creating and managing lights
@@ -48,16 +60,22 @@ struct PointLight : BaseLight
 
 class Light
 {
-  Shape *mesh;
+  Shape *mesh; // Marker drawn for point lights, nullptr for directional lights
   int lightIndex;
   BaseLight *lp;
   void updateShaderInformation();
+  static std::vector<Vertex> loadMarker(const BaseLight *l);
 
 public:
   Light(BaseLight *l, Shader *s);
+  Light(BaseLight *l, Shader *s, const std::vector<Vertex> &marker);
   ~Light();
   void SetLightIndex(int index);
   int GetLightIndex();
+  void UpdateShader(Shader *s);
+  void GetState(LightState &state);
+  static void Upload(Shader *s, const LightState &state);
+  Shape *GetMesh();
   void Draw();
   void Rotate(float angle, glm::vec3 axis);
   void Scale(float scalar);
@@ -67,15 +85,62 @@ public:
 
 namespace LightIndex
 {
-  std::vector<Light *> lights;
-  void addLight(Light *l, Shader *s)
+  std::vector<Light *> lights;   // Point lights, position in the vector is the pointLights[] index
+  std::vector<Light *> sources;  // Every light, used to fill in shaders registered later
+  std::vector<Shader *> shaders; // Every program that reads light uniforms
+  long long version = 0;         // Bumped whenever a light changes
+  bool deferUploads = false;     // Set while a render thread owns the context, uploads then go through frame packets
+
+  /**
+      @brief Builds the name of a point light uniform, e.g. "pointLights[2].position"
+      @details The string is allocated from the calling thread's FrameArena, the heap if it has none.
+  */
+  FrameString uniformName(int index, const char *member)
+  {
+    char digits[16];
+    snprintf(digits, sizeof(digits), "%d", index);
+    FrameString name(FrameAllocator<char>(FrameArena::Current()));
+    name.reserve(32);
+    name += "pointLights[";
+    name += digits;
+    name += "].";
+    name += member;
+    return name;
+  }
+
+  void updateCount()
+  {
+    ShaderVariants::SetActivePointLights((int)lights.size());
+    for (Shader *s : shaders)
+    {
+      s->onReady([s]()
+                 { s->setInt("numPointLights", lights.size()); });
+    }
+  }
+  void addShader(Shader *s)
+  {
+    for (Shader *existing : shaders)
+    {
+      if (existing == s)
+      {
+        return;
+      }
+    }
+    shaders.push_back(s);
+    for (Light *l : sources)
+    {
+      l->UpdateShader(s);
+    }
+    s->onReady([s]()
+               { s->setInt("numPointLights", lights.size()); });
+  }
+  void addLight(Light *l)
   {
     lights.push_back(l);
     l->SetLightIndex(lights.size() - 1);
-
-    s->setInt("numPointLights", lights.size());
+    updateCount();
   }
-  void removeLight(int index, Shader *s)
+  void removeLight(int index)
   {
     lights.erase(lights.begin() + index);
 
@@ -83,33 +148,90 @@ namespace LightIndex
     {
       lights[i]->SetLightIndex(i);
     }
-    s->setInt("numPointLights", lights.size());
+    updateCount();
+  }
+
+  /**
+      @brief Copies the properties of every light
+      @param states Receives one state per light
+  */
+  void snapshot(std::vector<LightState> &states)
+  {
+    states.resize(sources.size());
+    for (int i = 0; i < (int)sources.size(); i++)
+    {
+      sources[i]->GetState(states[i]);
+    }
+  }
+
+  /**
+      @brief Uploads copied light properties to every linked program
+      @details Programs still compiling are skipped, they receive the lights through their onReady callbacks. The
+      point light count comes from the copies too, the live lights may change on another thread meanwhile.
+  */
+  void upload(const std::vector<LightState> &states)
+  {
+    int pointLights = 0;
+    for (const LightState &state : states)
+    {
+      pointLights += state.type == Point;
+    }
+    for (Shader *s : shaders)
+    {
+      if (!s->isReady())
+      {
+        continue;
+      }
+      s->use();
+      for (const LightState &state : states)
+      {
+        Light::Upload(s, state);
+      }
+      s->setInt("numPointLights", pointLights);
+    }
   }
 }
 
 /**
     @brief Initializes Light
-    @details Creates the underlying mesh object and sets light parameters.
+    @details Reads the marker mesh (cube.obj) of point lights from disk, then initializes the light as the
+    constructor taking the marker does.
     @param l Pointer to a light struct (Directional or Point at this moment)
     @param s Pointer to the shader.
 */
-Light::Light(BaseLight *l, Shader *s)
+Light::Light(BaseLight *l, Shader *s) : Light(l, s, loadMarker(l))
 {
-  mesh = new Shape(GL_STATIC_DRAW, "../Resources/Models/cube.obj");
-  mesh->SetShader(s);
-  if (l->type == Point)
+}
+
+/**
+    @brief Initializes Light with a marker mesh that is already loaded
+    @details Creates the underlying mesh object of point lights and sets light parameters. Directional lights have
+    no position and get no marker. Makes no file access, so a scene can decode the marker with its other assets.
+    @param l Pointer to a light struct (Directional or Point at this moment)
+    @param s Pointer to the shader.
+    @param marker Expanded triangle list drawn at point lights, empty for none
+*/
+Light::Light(BaseLight *l, Shader *s, const std::vector<Vertex> &marker)
+{
+  mesh = nullptr;
+  if (l->type == Point && !marker.empty())
   {
     PointLight *pl = (PointLight *)l;
+    mesh = new Shape(GL_STATIC_DRAW, marker);
+    mesh->SetShader(s);
     mesh->SetMaterial(Materials::blank);
     mesh->Translate(pl->position);
     mesh->Scale(.1);
   }
 
   lp = l;
+  lightIndex = 0;
 
+  LightIndex::sources.push_back(this);
+  LightIndex::addShader(s);
   if (l->type == Point)
   {
-    LightIndex::addLight(this, mesh->GetShader());
+    LightIndex::addLight(this);
   }
 
   updateShaderInformation();
@@ -117,14 +239,37 @@ Light::Light(BaseLight *l, Shader *s)
 
 /**
     @brief Light destructor
-    @details Removes the light from the global light index
+    @details Removes the light from the global light index and deletes its marker
 */
 Light::~Light()
 {
+  delete mesh;
   if (lp->type == Point)
   {
-    LightIndex::removeLight(lightIndex, mesh->GetShader());
+    LightIndex::removeLight(lightIndex);
+  }
+  for (int i = 0; i < (int)LightIndex::sources.size(); i++)
+  {
+    if (LightIndex::sources[i] == this)
+    {
+      LightIndex::sources.erase(LightIndex::sources.begin() + i);
+      break;
+    }
+  }
+}
+
+/**
+    @brief Reads the marker mesh of a light from disk
+    @returns std::vector<Vertex>, cube.obj for point lights, empty for directional lights or when it cannot be read
+*/
+std::vector<Vertex> Light::loadMarker(const BaseLight *l)
+{
+  std::vector<Vertex> marker;
+  if (l->type == Point)
+  {
+    ObjLoader::Load("../Resources/Models/cube.obj", marker);
   }
+  return marker;
 }
 
 /**
@@ -148,48 +293,112 @@ int Light::GetLightIndex()
 
 /**
     @brief Updates internal light information
-    @details Updates light properties on the shader
+    @details Updates light properties on every shader registered with the LightIndex
 */
 void Light::updateShaderInformation()
 {
-  Shader *s = mesh->GetShader();
+  PROFILE_SCOPE("Light::Update");
+  LightIndex::version++;
+  if (LightIndex::deferUploads)
+  {
+    return;
+  }
+  for (Shader *s : LightIndex::shaders)
+  {
+    UpdateShader(s);
+  }
+}
+
+/**
+    @brief Uploads the light properties to one shader
+    @details If the shader is still compiling the upload happens once it links. The callback carries a copy of the
+    properties rather than the light, which may be gone by then; later changes queue callbacks of their own that run
+    after it.
+    @param s Pointer to the shader
+*/
+void Light::UpdateShader(Shader *s)
+{
+  LightState state;
+  GetState(state);
+  if (!s->isReady()) // Deferred shader still compiling, upload once it links
+  {
+    s->onReady([s, state]()
+               {
+                 s->use();
+                 Upload(s, state); });
+    return;
+  }
   s->use();
-  DirectionalLight *dl;
-  PointLight *pl;
-  std::string id;
+  Upload(s, state);
+}
+
+/**
+    @brief Copies the light's properties
+    @param state Receives the type, index and properties
+*/
+void Light::GetState(LightState &state)
+{
+  state.type = lp->type;
+  state.index = lightIndex;
+  if (lp->type == Directional)
+  {
+    state.directional = *(DirectionalLight *)lp;
+  }
+  else if (lp->type == Point)
+  {
+    state.point = *(PointLight *)lp;
+  }
+}
 
-  switch (lp->type)
+/**
+    @brief Sets the uniforms of one light on a program that is in use
+    @param s Pointer to the shader
+    @param state Light properties to upload
+*/
+void Light::Upload(Shader *s, const LightState &state)
+{
+  const DirectionalLight &dl = state.directional;
+  const PointLight &pl = state.point;
+
+  switch (state.type)
   {
   case Directional:
-    dl = (DirectionalLight *)lp;
-    s->setVec3("dirLight.direction", dl->direction);
-    s->setVec3("dirLight.ambient", dl->ambient);
-    s->setVec3("dirLight.diffuse", dl->diffuse);
-    s->setVec3("dirLight.specular", dl->specular);
+    s->setVec3("dirLight.direction", dl.direction);
+    s->setVec3("dirLight.ambient", dl.ambient);
+    s->setVec3("dirLight.diffuse", dl.diffuse);
+    s->setVec3("dirLight.specular", dl.specular);
+    s->setBool("dirLight.baked", dl.baked);
     break;
   case Point:
-    pl = (PointLight *)lp;
-    id = "pointLights[" + std::to_string(lightIndex) + "].";
-    s->setVec3(id + "position", pl->position);
-    s->setVec3(id + "ambient", pl->ambient);
-    s->setVec3(id + "diffuse", pl->diffuse);
-    s->setVec3(id + "specular", pl->specular);
-    s->setFloat(id + "constant", pl->constant);
-    s->setFloat(id + "linear", pl->linear);
-    s->setFloat(id + "quadratic", pl->quadratic);
+    s->setVec3(LightIndex::uniformName(state.index, "position").c_str(), pl.position);
+    s->setVec3(LightIndex::uniformName(state.index, "ambient").c_str(), pl.ambient);
+    s->setVec3(LightIndex::uniformName(state.index, "diffuse").c_str(), pl.diffuse);
+    s->setVec3(LightIndex::uniformName(state.index, "specular").c_str(), pl.specular);
+    s->setFloat(LightIndex::uniformName(state.index, "constant").c_str(), pl.constant);
+    s->setFloat(LightIndex::uniformName(state.index, "linear").c_str(), pl.linear);
+    s->setFloat(LightIndex::uniformName(state.index, "quadratic").c_str(), pl.quadratic);
+    s->setBool(LightIndex::uniformName(state.index, "baked").c_str(), pl.baked);
     break;
   default:
     break;
   }
 }
 
+/**
+    @brief Returns the mesh drawn for the light, nullptr for directional lights
+*/
+Shape *Light::GetMesh()
+{
+  return mesh;
+}
+
 /**
     @brief Draws the light
     @details Draws the underlying mesh of the light for visualization
 */
 void Light::Draw()
 {
-  if (lp->type != Directional)
+  if (mesh != nullptr)
   {
     mesh->Draw();
   }
@@ -203,7 +412,10 @@ void Light::Draw()
 */
 void Light::Rotate(float angle, glm::vec3 axis)
 {
-  mesh->Rotate(angle, axis);
+  if (mesh != nullptr)
+  {
+    mesh->Rotate(angle, axis);
+  }
 }
 
 /**
@@ -213,7 +425,10 @@ void Light::Rotate(float angle, glm::vec3 axis)
 */
 void Light::Scale(float scalar)
 {
-  mesh->Scale(scalar);
+  if (mesh != nullptr)
+  {
+    mesh->Scale(scalar);
+  }
 }
 
 /**
@@ -223,7 +438,10 @@ void Light::Scale(float scalar)
 */
 void Light::Translate(glm::vec3 trans)
 {
-  mesh->Translate(trans);
+  if (mesh != nullptr)
+  {
+    mesh->Translate(trans);
+  }
   if (lp->type != Directional)
   {
     PointLight *tmp = (PointLight *)lp;
@@ -0,0 +1,94 @@
+/**
+    @file Lightmap.h
+    @brief Lightmap coordinates of triangle lists, shared by the baker and the shapes drawing its lightmaps
+    @details Every triangle gets its own chart: the lightmap is a grid of square cells and each cell holds two
+    triangles, one in its lower left and one in its upper right half, mapped onto right triangles whatever their
+    shape. The charts keep LIGHTMAP_GUTTER texels away from the cell's edges and from each other, so bilinear
+    filtering never mixes texels of two triangles and no dilation pass is needed. The layout follows from the
+    number of triangles and the lightmap's width alone, which is why lightmaps are stored as plain images and
+    the coordinates are generated again when a scene is loaded instead of being stored with the meshes.
+*/
+
+#pragma once
+#ifndef LIGHTMAP_H
+#define LIGHTMAP_H
+
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#define LIGHTMAP_GUTTER 2       // Texels between a chart and the edges of its cell and the other chart
+#define LIGHTMAP_MIN_CELL 10    // Smallest cell, its charts keep a few texels inside the gutters
+#define LIGHTMAP_TEXTURE_UNIT 2 // Texture unit lightmaps are bound to, after the diffuse texture and the shadow map
+
+namespace Lightmaps
+{
+    /**
+        @brief Cells per row (and rows) of the square grid holding a number of triangles
+    */
+    int CellsPerRow(int triangles)
+    {
+        int cells = (triangles + 1) / 2;
+        return std::max(1, (int)std::ceil(std::sqrt((float)cells)));
+    }
+
+    /**
+        @brief Corners of a triangle's chart in texels from the corner of its cell
+        @param cellSize Width of a cell in texels
+        @param upper Whether the triangle is the second of its cell
+        @param corners Receives the chart's corners, in the order of the triangle's
+    */
+    void ChartCorners(int cellSize, bool upper, glm::vec2 corners[3])
+    {
+        float g = LIGHTMAP_GUTTER, c = (float)cellSize;
+        if (upper)
+        {
+            corners[0] = glm::vec2(c - g, c - g);
+            corners[1] = glm::vec2(2 * g, c - g);
+            corners[2] = glm::vec2(c - g, 2 * g);
+        }
+        else
+        {
+            corners[0] = glm::vec2(g, g);
+            corners[1] = glm::vec2(c - 2 * g, g);
+            corners[2] = glm::vec2(g, c - 2 * g);
+        }
+    }
+
+    /**
+        @brief Whether a texel of a cell belongs to the upper triangle's chart, the lower one's otherwise
+        @param x Column of the texel in its cell
+        @param y Row of the texel in its cell
+    */
+    bool UpperTexel(int cellSize, int x, int y)
+    {
+        return x + y + 1 > cellSize;
+    }
+
+    /**
+        @brief Lightmap coordinates of every corner of a triangle list
+        @param triangles Number of triangles
+        @param resolution Width and height of the lightmap in texels
+        @param coords Receives three coordinates per triangle, in [0, 1]
+    */
+    void PackTriangles(int triangles, int resolution, std::vector<glm::vec2> &coords)
+    {
+        int row = CellsPerRow(triangles);
+        int cellSize = resolution / row;
+        coords.resize((size_t)triangles * 3);
+        for (int i = 0; i < triangles; i++)
+        {
+            int cell = i / 2;
+            glm::vec2 origin((float)(cell % row * cellSize), (float)(cell / row * cellSize));
+            glm::vec2 corners[3];
+            ChartCorners(cellSize, i % 2 == 1, corners);
+            for (int k = 0; k < 3; k++)
+            {
+                coords[(size_t)i * 3 + k] = (origin + corners[k]) / (float)resolution;
+            }
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,479 @@
+/**
+    @class LightmapBaker LightmapBaker.h "Engine/LightmapBaker.h"
+    @brief Bakes the light of static lights into lightmaps on the CPU, on every core
+    @details Objects are added as world space triangle lists with their material, lights as the records of a scene
+    file (SceneFile.h), so baking needs neither a window nor a GL context. Bake() builds one Bvh over the triangles
+    of every object, also of those that are not baked, which still cast shadows, and then computes each texel of
+    each lightmap: the texel is mapped back onto its triangle (Lightmap.h), the ambient terms of the lights are
+    summed and for each light a shadow ray decides whether its diffuse term reaches the point. With bounce samples,
+    that many cosine distributed rays per texel gather the direct light leaving the surfaces they hit, one bounce
+    of indirect light. Lightmaps hold what Simple.fs computes before the diffuse texture and the specular terms,
+    with the material's ambient and diffuse colors applied: material.ambient * ambient light + material.diffuse *
+    (direct + indirect light). The texel rows are spread over the JobSystem and every texel draws its random
+    numbers from its own position, so the result does not depend on the number of threads. GetStats() reports
+    the rays cast and rays per second.
+*/
+
+#pragma once
+#ifndef LIGHTMAPBAKER_H
+#define LIGHTMAPBAKER_H
+
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+#include "Bvh.h"
+#include "JobSystem.h"
+#include "Lightmap.h"
+#include "SceneFile.h"
+
+class LightmapBaker
+{
+public:
+    struct Settings
+    {
+        float texelsPerUnit = 4.0f; // Texels along the longest edge of an object's triangles per world unit
+        int maxResolution = 2048;   // Widest lightmap, denser meshes get fewer texels per triangle or none at all
+        int bounceSamples = 0;      // Rays per texel gathering one bounce of indirect light, 0 for direct light only
+    };
+
+    struct Stats
+    {
+        int objects = 0;     // Objects added, baked or not
+        int baked = 0;       // Objects that got a lightmap
+        int tooDense = 0;    // Objects to bake with more triangles than a lightmap of maxResolution holds
+        int triangles = 0;   // Triangles in the hierarchy
+        long long texels = 0;
+        long long rays = 0;  // Shadow and bounce rays
+        double buildMs = 0;  // Building the hierarchy
+        double bakeMs = 0;   // Computing the texels
+        int threads = 1;
+
+        double RaysPerSecond() const { return bakeMs > 0 ? rays / (bakeMs / 1000.0) : 0; }
+    };
+
+    struct Image
+    {
+        int width = 0, height = 0;
+        std::vector<float> pixels; // RGB, rows from the bottom up like GL textures
+    };
+
+private:
+    struct Object
+    {
+        uint32_t firstTriangle;
+        int triangles;
+        glm::vec3 ambient, diffuse; // Material colors
+        bool bake;
+        Image lightmap;
+    };
+
+    Settings settings;
+    std::vector<glm::vec3> positions, normals; // World space, three per triangle of every object
+    std::vector<int> triangleObjects;          // Object of each triangle
+    std::vector<Object> objects;
+    SceneFile::SunRecord sun = SceneFile::SunRecord{0, glm::vec3(0, -1, 0), glm::vec3(0), glm::vec3(0), glm::vec3(0)};
+    std::vector<SceneFile::PointLightRecord> pointLights;
+    Bvh bvh;
+    float bias = 1e-4f; // Offset of ray origins from the surface, relative to the scene's size once built
+    Stats stats;
+
+    int resolution(const Object &object) const;
+    void bakeRow(Object &object, int row, long long &rays) const;
+    glm::vec3 ambientLight(const glm::vec3 &point) const;
+    glm::vec3 directLight(const glm::vec3 &point, const glm::vec3 &normal, const glm::vec3 &origin, long long &rays) const;
+    static uint32_t hash(uint32_t x);
+
+public:
+    LightmapBaker();
+    LightmapBaker(const Settings &settings);
+
+    int AddObject(const std::vector<glm::vec3> &worldPositions, const std::vector<glm::vec3> &worldNormals,
+                  const SceneFile::MaterialEntry *material, bool bake);
+    void SetSun(const SceneFile::SunRecord &light);
+    void AddPointLight(const SceneFile::PointLightRecord &light);
+    void Bake(JobSystem *jobs = nullptr);
+    const Image &GetLightmap(int object) const;
+    const Stats &GetStats() const;
+    void PrintStats(std::ostream &out = std::cout) const;
+};
+
+/**
+    @brief Creates an empty baker with the default settings
+*/
+LightmapBaker::LightmapBaker() : settings()
+{
+}
+
+/**
+    @brief Creates an empty baker
+*/
+LightmapBaker::LightmapBaker(const Settings &settings) : settings(settings)
+{
+}
+
+/**
+    @brief Adds an object to the scene the light is baked for
+    @param worldPositions Triangle list in world space, three corners per triangle
+    @param worldNormals Normal of every corner in world space, face normals are used where they are zero
+    @param material Colors of the surface, nullptr for black
+    @param bake Whether the object gets a lightmap, otherwise it only casts shadows and reflects light
+    @returns int, index of the object
+*/
+int LightmapBaker::AddObject(const std::vector<glm::vec3> &worldPositions, const std::vector<glm::vec3> &worldNormals,
+                             const SceneFile::MaterialEntry *material, bool bake)
+{
+    Object object;
+    object.firstTriangle = (uint32_t)(positions.size() / 3);
+    object.triangles = (int)(worldPositions.size() / 3);
+    object.ambient = material != nullptr ? material->ambient : glm::vec3(0.0f);
+    object.diffuse = material != nullptr ? material->diffuse : glm::vec3(0.0f);
+    object.bake = bake && object.triangles > 0;
+    for (int i = 0; i < object.triangles; i++)
+    {
+        const glm::vec3 *p = &worldPositions[(size_t)i * 3];
+        glm::vec3 face = glm::cross(p[1] - p[0], p[2] - p[0]);
+        face = glm::length(face) > 0 ? glm::normalize(face) : glm::vec3(0, 1, 0);
+        for (int k = 0; k < 3; k++)
+        {
+            glm::vec3 n = (size_t)i * 3 + k < worldNormals.size() ? worldNormals[(size_t)i * 3 + k] : glm::vec3(0.0f);
+            positions.push_back(p[k]);
+            normals.push_back(glm::length(n) > 1e-6f ? glm::normalize(n) : face);
+        }
+        triangleObjects.push_back((int)objects.size());
+    }
+    objects.push_back(object);
+    stats.objects = (int)objects.size();
+    return (int)objects.size() - 1;
+}
+
+/**
+    @brief Sets the directional light, baked when its record is enabled
+*/
+void LightmapBaker::SetSun(const SceneFile::SunRecord &light)
+{
+    sun = light;
+}
+
+void LightmapBaker::AddPointLight(const SceneFile::PointLightRecord &light)
+{
+    pointLights.push_back(light);
+}
+
+/**
+    @brief Builds the hierarchy and computes every lightmap
+    @param jobs Job system the texel rows are spread over, nullptr to bake on this thread alone
+*/
+void LightmapBaker::Bake(JobSystem *jobs)
+{
+    bvh.Build(positions);
+    stats.triangles = bvh.GetStats().triangles;
+    stats.buildMs = bvh.GetStats().buildMs;
+    glm::vec3 lo, hi;
+    bvh.GetBounds(lo, hi);
+    bias = bvh.Empty() ? 1e-4f : std::max(1e-5f, 1e-4f * glm::length(hi - lo));
+
+    // Every row of every lightmap is one item of work
+    struct Row
+    {
+        int object, row;
+    };
+    std::vector<Row> rows;
+    stats.baked = 0;
+    stats.tooDense = 0;
+    stats.texels = 0;
+    for (int i = 0; i < (int)objects.size(); i++)
+    {
+        Object &object = objects[i];
+        object.lightmap = Image();
+        if (!object.bake)
+        {
+            continue;
+        }
+        int size = resolution(object);
+        if (size == 0)
+        {
+            std::cout << "Object " << i << " has too many triangles (" << object.triangles << ") for a lightmap of at most "
+                      << settings.maxResolution << "x" << settings.maxResolution << " texels, it is not baked" << std::endl;
+            stats.tooDense++;
+            continue;
+        }
+        object.lightmap.width = object.lightmap.height = size;
+        object.lightmap.pixels.assign((size_t)size * size * 3, 0.0f);
+        for (int y = 0; y < size; y++)
+        {
+            rows.push_back(Row{i, y});
+        }
+        stats.baked++;
+        stats.texels += (long long)size * size;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::atomic<long long> rays(0);
+    auto bakeRows = [&](int begin, int end)
+    {
+        long long cast = 0;
+        for (int i = begin; i < end; i++)
+        {
+            bakeRow(objects[rows[i].object], rows[i].row, cast);
+        }
+        rays += cast;
+    };
+    if (jobs != nullptr)
+    {
+        jobs->ParallelFor((int)rows.size(), 1, bakeRows);
+    }
+    else
+    {
+        bakeRows(0, (int)rows.size());
+    }
+    stats.rays = rays;
+    stats.bakeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    stats.threads = jobs != nullptr ? jobs->Threads() : 1;
+}
+
+/**
+    @brief Width and height of an object's lightmap
+    @details Cells are sized for the object's longest edge at the requested density, and shrunk when the grid
+    would be wider than the largest lightmap allowed.
+    @returns int, 0 when even the smallest cells would make the lightmap wider than that
+*/
+int LightmapBaker::resolution(const Object &object) const
+{
+    float longest = 0;
+    for (int i = 0; i < object.triangles; i++)
+    {
+        const glm::vec3 *p = &positions[((size_t)object.firstTriangle + i) * 3];
+        longest = std::max(longest, std::max(glm::length(p[1] - p[0]),
+                                             std::max(glm::length(p[2] - p[1]), glm::length(p[0] - p[2]))));
+    }
+    int row = Lightmaps::CellsPerRow(object.triangles);
+    if (row > settings.maxResolution / LIGHTMAP_MIN_CELL)
+    {
+        return 0;
+    }
+    int cellSize = std::max(LIGHTMAP_MIN_CELL, (int)std::ceil(longest * settings.texelsPerUnit) + 3 * LIGHTMAP_GUTTER);
+    if (row * cellSize > settings.maxResolution)
+    {
+        cellSize = settings.maxResolution / row;
+    }
+    return row * cellSize;
+}
+
+/**
+    @brief Computes one row of texels of an object's lightmap
+    @param rays Incremented by the rays cast
+*/
+void LightmapBaker::bakeRow(Object &object, int row, long long &rays) const
+{
+    const float pi = 3.14159265f;
+    Image &image = object.lightmap;
+    int cellsPerRow = Lightmaps::CellsPerRow(object.triangles);
+    int cellSize = image.width / cellsPerRow;
+    int objectIndex = (int)(&object - objects.data());
+    int cellY = row / cellSize;
+    if (cellY >= cellsPerRow)
+    {
+        return;
+    }
+    for (int x = 0; x < image.width; x++)
+    {
+        int cellX = x / cellSize;
+        if (cellX >= cellsPerRow)
+        {
+            break;
+        }
+        int localX = x - cellX * cellSize, localY = row - cellY * cellSize;
+        bool upper = Lightmaps::UpperTexel(cellSize, localX, localY);
+        int triangle = (cellY * cellsPerRow + cellX) * 2 + (upper ? 1 : 0);
+        if (triangle >= object.triangles)
+        {
+            continue;
+        }
+
+        // Barycentric coordinates of the texel center in the chart, clamped onto the triangle for the texels
+        // around its edges that bilinear filtering reads
+        glm::vec2 chart[3];
+        Lightmaps::ChartCorners(cellSize, upper, chart);
+        glm::vec2 center(localX + 0.5f, localY + 0.5f);
+        glm::vec2 e1 = chart[1] - chart[0], e2 = chart[2] - chart[0], d = center - chart[0];
+        float denominator = e1.x * e2.y - e2.x * e1.y;
+        float u = (d.x * e2.y - e2.x * d.y) / denominator;
+        float v = (e1.x * d.y - d.x * e1.y) / denominator;
+        u = std::max(u, 0.0f);
+        v = std::max(v, 0.0f);
+        if (u + v > 1.0f)
+        {
+            float sum = u + v;
+            u /= sum;
+            v /= sum;
+        }
+
+        size_t first = ((size_t)object.firstTriangle + triangle) * 3;
+        const glm::vec3 *p = &positions[first];
+        const glm::vec3 *n = &normals[first];
+        glm::vec3 point = p[0] * (1 - u - v) + p[1] * u + p[2] * v;
+        glm::vec3 normal = glm::normalize(n[0] * (1 - u - v) + n[1] * u + n[2] * v);
+        glm::vec3 face = glm::normalize(glm::cross(p[1] - p[0], p[2] - p[0]));
+        if (glm::dot(face, normal) < 0)
+        {
+            face = -face;
+        }
+        glm::vec3 origin = point + face * bias;
+
+        glm::vec3 light = object.diffuse * directLight(point, normal, origin, rays);
+        if (settings.bounceSamples > 0)
+        {
+            // Cosine distributed directions around the normal, so the average of what they see is the bounce
+            glm::vec3 tangent = glm::normalize(glm::cross(std::abs(normal.x) > 0.5f ? glm::vec3(0, 1, 0) : glm::vec3(1, 0, 0), normal));
+            glm::vec3 bitangent = glm::cross(normal, tangent);
+            uint32_t seed = hash((uint32_t)objectIndex * 0x9E3779B9u ^ hash((uint32_t)(row * image.width + x)));
+            glm::vec3 gathered(0.0f);
+            for (int s = 0; s < settings.bounceSamples; s++)
+            {
+                seed = hash(seed);
+                float r1 = (seed & 0xFFFFFF) / 16777216.0f;
+                seed = hash(seed);
+                float r2 = (seed & 0xFFFFFF) / 16777216.0f;
+                float radius = std::sqrt(r1), angle = 2.0f * pi * r2;
+                glm::vec3 direction = tangent * (radius * std::cos(angle)) + bitangent * (radius * std::sin(angle)) +
+                                      normal * std::sqrt(std::max(0.0f, 1.0f - r1));
+                BvhHit hit;
+                rays++;
+                if (!bvh.Intersect(origin, direction, FLT_MAX, hit))
+                {
+                    continue;
+                }
+                const Object &other = objects[triangleObjects[hit.triangle]];
+                const glm::vec3 *q = &positions[(size_t)hit.triangle * 3];
+                const glm::vec3 *m = &normals[(size_t)hit.triangle * 3];
+                glm::vec3 hitPoint = origin + direction * hit.t;
+                glm::vec3 hitNormal = glm::normalize(m[0] * (1 - hit.u - hit.v) + m[1] * hit.u + m[2] * hit.v);
+                glm::vec3 hitFace = glm::normalize(glm::cross(q[1] - q[0], q[2] - q[0]));
+                if (glm::dot(hitFace, direction) > 0)
+                {
+                    hitFace = -hitFace;
+                }
+                if (glm::dot(hitNormal, hitFace) < 0)
+                {
+                    hitNormal = -hitNormal;
+                }
+                gathered += other.diffuse * directLight(hitPoint, hitNormal, hitPoint + hitFace * bias, rays);
+            }
+            light += object.diffuse * gathered / (float)settings.bounceSamples;
+        }
+        light += object.ambient * ambientLight(point);
+
+        float *pixel = &image.pixels[((size_t)row * image.width + x) * 3];
+        pixel[0] = light.x;
+        pixel[1] = light.y;
+        pixel[2] = light.z;
+    }
+}
+
+/**
+    @brief Sum of the ambient terms of the lights at a point, attenuated like their other terms
+*/
+glm::vec3 LightmapBaker::ambientLight(const glm::vec3 &point) const
+{
+    glm::vec3 light = sun.enabled ? sun.ambient : glm::vec3(0.0f);
+    for (const SceneFile::PointLightRecord &pl : pointLights)
+    {
+        float distance = glm::length(pl.position - point);
+        light += pl.ambient / (pl.constant + pl.linear * distance + pl.quadratic * distance * distance);
+    }
+    return light;
+}
+
+/**
+    @brief Sum of the diffuse terms of the lights reaching a point, a shadow ray per light facing it
+    @param origin Point moved off the surface, where the shadow rays start
+    @param rays Incremented by the rays cast
+*/
+glm::vec3 LightmapBaker::directLight(const glm::vec3 &point, const glm::vec3 &normal, const glm::vec3 &origin,
+                                     long long &rays) const
+{
+    glm::vec3 light(0.0f);
+    if (sun.enabled)
+    {
+        glm::vec3 toLight = -glm::normalize(sun.direction);
+        float diffuse = glm::dot(normal, toLight);
+        if (diffuse > 0)
+        {
+            rays++;
+            if (!bvh.Occluded(origin, toLight, FLT_MAX))
+            {
+                light += sun.diffuse * diffuse;
+            }
+        }
+    }
+    for (const SceneFile::PointLightRecord &pl : pointLights)
+    {
+        glm::vec3 toLight = pl.position - point;
+        float distance = glm::length(toLight);
+        float diffuse = glm::dot(normal, toLight / distance);
+        if (diffuse <= 0)
+        {
+            continue;
+        }
+        rays++;
+        // In units of the vector to the light, the light itself is at 1
+        if (!bvh.Occluded(origin, pl.position - origin, 1.0f - 1e-4f))
+        {
+            float attenuation = 1.0f / (pl.constant + pl.linear * distance + pl.quadratic * distance * distance);
+            light += pl.diffuse * (diffuse * attenuation);
+        }
+    }
+    return light;
+}
+
+/**
+    @brief Integer hash (lowbias32) the texels draw their random numbers from
+*/
+uint32_t LightmapBaker::hash(uint32_t x)
+{
+    x ^= x >> 16;
+    x *= 0x7feb352dU;
+    x ^= x >> 15;
+    x *= 0x846ca68bU;
+    x ^= x >> 16;
+    return x;
+}
+
+/**
+    @brief Lightmap of an object, empty (0 by 0) for objects that were not baked
+*/
+const LightmapBaker::Image &LightmapBaker::GetLightmap(int object) const
+{
+    return objects[object].lightmap;
+}
+
+/**
+    @brief Size of the bake and how fast the rays were cast
+*/
+const LightmapBaker::Stats &LightmapBaker::GetStats() const
+{
+    return stats;
+}
+
+/**
+    @brief Prints the hierarchy, texel and ray counts and rays per second
+    @param out Stream to print to
+*/
+void LightmapBaker::PrintStats(std::ostream &out) const
+{
+    const Bvh::Stats &tree = bvh.GetStats();
+    out << "Lightmaps: " << stats.baked << " of " << stats.objects << " objects (" << stats.tooDense
+        << " too dense), " << stats.texels << " texels, " << settings.bounceSamples << " bounce samples per texel"
+        << std::endl
+        << "BVH: " << tree.triangles << " triangles, " << tree.nodes << " nodes, " << tree.leaves << " leaves, depth "
+        << tree.depth << ", built in " << tree.buildMs << " ms" << std::endl
+        << "bake " << stats.bakeMs << " ms on " << stats.threads << " threads, " << stats.rays << " rays, "
+        << stats.RaysPerSecond() / 1e6 << " Mrays/s" << std::endl;
+}
+
+#endif
@@ -13,6 +13,7 @@ struct Material
     vec3 diffuse;
     vec3 specular;
     float shininess;
+    int index = -1; // Slot in the MaterialBuffer, -1 until a shape uses it
 
     Material(vec3 _ambient, vec3 _diffuse, vec3 _specular, float _shininess) : ambient(_ambient), diffuse(_diffuse),
                                                                                specular(_specular),
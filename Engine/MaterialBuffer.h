@@ -0,0 +1,210 @@
+/**
+    @class MaterialBuffer MaterialBuffer.h "Engine/MaterialBuffer.h"
+    @brief Registry of every material in use, kept in one uniform buffer that draws index into
+    @details Materials are registered once (Shape::SetMaterial does it) and get a slot in a std140 array of
+    MaterialData, which is the layout of the shaders' Material struct in the MaterialBlock uniform block. Each
+    object's ObjectBlock carries the slot of its material, so draws no longer set material uniforms: the fragment
+    shader reads materials[MaterialIndex] and switching materials between draws costs nothing. Upload() writes only
+    the slots registered or updated since the last call, with one glBufferSubData, and returns at once on frames
+    where nothing changed. Slot 0 is reserved for shapes without a material and stays black, as an unset material
+    uniform did. The registry keeps copies, so a material may be deleted after it was registered, but its slot is
+    not reused. Registration needs no context, uploads run on the context thread.
+*/
+
+#pragma once
+#ifndef MATERIALBUFFER_H
+#define MATERIALBUFFER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <iostream>
+#include <vector>
+#include "Material.h"
+#include "RenderStats.h"
+
+#define MATERIALBLOCK_BINDING 1     // Uniform buffer binding point of the MaterialBlock block
+#define MATERIALBUFFER_CAPACITY 256 // Slots in the block, MAX_MATERIALS in Simple.fs
+
+struct MaterialData
+{
+    glm::vec4 ambient;
+    glm::vec4 diffuse;
+    glm::vec4 specular; // w is the shininess, where std140 puts the float following a vec3
+
+    void Set(const Material &material);
+};
+
+/**
+    @brief Copies a material into the std140 layout
+*/
+void MaterialData::Set(const Material &material)
+{
+    ambient = glm::vec4(material.ambient, 0.0f);
+    diffuse = glm::vec4(material.diffuse, 0.0f);
+    specular = glm::vec4(material.specular, material.shininess);
+}
+
+class MaterialBuffer
+{
+private:
+    static MaterialBuffer *instancePtr;
+    unsigned int ID = 0;               // Uniform buffer, created by the first Upload()
+    std::vector<MaterialData> entries; // One per slot
+    int dirtyFirst = 0, dirtyEnd = 0;  // Slots changed since the last upload, none when equal
+
+    MaterialBuffer();
+    void markDirty(int slot);
+
+public:
+    MaterialBuffer(const MaterialBuffer &) = delete;
+    void operator=(const MaterialBuffer &) = delete;
+
+    static MaterialBuffer *getInstance();
+    static void destroyBuffer();
+    int Register(Material *material);
+    void Update(const Material *material);
+    void Upload();
+    const MaterialData &Get(int slot) const;
+    int Count() const;
+};
+
+MaterialBuffer *MaterialBuffer::instancePtr = nullptr;
+
+/**
+    @brief Creates the registry with the empty slot 0
+*/
+MaterialBuffer::MaterialBuffer()
+{
+    entries.reserve(MATERIALBUFFER_CAPACITY);
+    MaterialData none;
+    none.Set(Material(vec3(0), vec3(0), vec3(0), 1));
+    entries.push_back(none);
+    markDirty(0);
+}
+
+/**
+    @brief Returns the registry, created on first use
+*/
+MaterialBuffer *MaterialBuffer::getInstance()
+{
+    if (instancePtr == nullptr)
+    {
+        instancePtr = new MaterialBuffer();
+    }
+    return instancePtr;
+}
+
+/**
+    @brief Deletes the uniform buffer, call while the context is still current
+    @details The registered materials keep their slots and are uploaded again if a later context draws with them.
+*/
+void MaterialBuffer::destroyBuffer()
+{
+    if (instancePtr == nullptr || instancePtr->ID == 0)
+    {
+        return;
+    }
+    glDeleteBuffers(1, &instancePtr->ID);
+    instancePtr->ID = 0;
+    instancePtr->markDirty(0);
+    instancePtr->markDirty((int)instancePtr->entries.size() - 1);
+}
+
+/**
+    @brief Gives a material a slot, or returns the one it already has
+    @details Prints an error and returns slot 0 when every slot is taken.
+    @param material Material to register, nullptr for slot 0
+    @returns int, slot of the material
+*/
+int MaterialBuffer::Register(Material *material)
+{
+    if (material == nullptr)
+    {
+        return 0;
+    }
+    if (material->index >= 0)
+    {
+        return material->index;
+    }
+    if ((int)entries.size() >= MATERIALBUFFER_CAPACITY)
+    {
+        std::cout << "Material buffer is full (" << MATERIALBUFFER_CAPACITY << " materials)" << std::endl;
+        return 0;
+    }
+    material->index = (int)entries.size();
+    entries.push_back(MaterialData());
+    entries.back().Set(*material);
+    markDirty(material->index);
+    return material->index;
+}
+
+/**
+    @brief Copies the current values of a registered material, they reach the shaders with the next Upload()
+*/
+void MaterialBuffer::Update(const Material *material)
+{
+    if (material == nullptr || material->index <= 0)
+    {
+        return;
+    }
+    entries[material->index].Set(*material);
+    markDirty(material->index);
+}
+
+/**
+    @brief Uploads the slots that changed since the last call, creating and binding the buffer the first time
+*/
+void MaterialBuffer::Upload()
+{
+    if (dirtyFirst == dirtyEnd)
+    {
+        return;
+    }
+    if (ID == 0)
+    {
+        glGenBuffers(1, &ID);
+        glBindBuffer(GL_UNIFORM_BUFFER, ID);
+        glBufferData(GL_UNIFORM_BUFFER, MATERIALBUFFER_CAPACITY * sizeof(MaterialData), nullptr, GL_DYNAMIC_DRAW);
+        glBindBufferBase(GL_UNIFORM_BUFFER, MATERIALBLOCK_BINDING, ID);
+    }
+    GLsizeiptr size = (dirtyEnd - dirtyFirst) * sizeof(MaterialData);
+    glBindBuffer(GL_UNIFORM_BUFFER, ID);
+    glBufferSubData(GL_UNIFORM_BUFFER, dirtyFirst * sizeof(MaterialData), size, &entries[dirtyFirst]);
+    RenderStats::frame.bufferBinds++;
+    RenderStats::frame.bufferBytes += size;
+    dirtyFirst = dirtyEnd = 0;
+}
+
+/**
+    @brief Values of a slot as the shaders read them, for renderers without the uniform buffer (SoftwareBackend)
+*/
+const MaterialData &MaterialBuffer::Get(int slot) const
+{
+    return entries[slot];
+}
+
+/**
+    @brief Number of slots in use, including slot 0
+*/
+int MaterialBuffer::Count() const
+{
+    return (int)entries.size();
+}
+
+/**
+    @brief Grows the range of slots to upload to cover one more
+*/
+void MaterialBuffer::markDirty(int slot)
+{
+    if (dirtyFirst == dirtyEnd)
+    {
+        dirtyFirst = slot;
+        dirtyEnd = slot + 1;
+        return;
+    }
+    dirtyFirst = std::min(dirtyFirst, slot);
+    dirtyEnd = std::max(dirtyEnd, slot + 1);
+}
+
+#endif
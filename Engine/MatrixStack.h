@@ -1,22 +1,34 @@
+/**
+    @class MatrixStack MatrixStack.h "Engine/MatrixStack.h"
+    @brief Fixed-capacity stack of transformation matrices
+    @details The matrices live in an aligned array inside the object, so push and pop never allocate and the top
+    stays in the same cache lines. getInstance() is the stack of the main thread that the camera uses; threads that
+    compose their own transforms use getThreadInstance() or a stack of their own. Pushing past
+    MATRIXSTACK_CAPACITY or popping the last matrix reports the error and leaves the stack unchanged.
+*/
+
 #pragma once
 #ifndef MATRIXSTACK_H
 #define MATRIXSTACK_H
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
-#include <stack>
+#include <iostream>
+#include "SimdMath.h"
+
+#define MATRIXSTACK_CAPACITY 32
 
 class MatrixStack
 {
   static MatrixStack *instancePtr;
-  std::stack<glm::mat4> stack;
+  alignas(64) glm::mat4 stack[MATRIXSTACK_CAPACITY];
+  int depth;
 
-  MatrixStack()
+public:
+  MatrixStack() : depth(0)
   {
-    stack.push(glm::mat4(1.0f)); // Initialize with identity matrix
+    stack[0] = glm::mat4(1.0f); // Initialize with identity matrix
   }
-
-public:
   MatrixStack(MatrixStack &) = delete;
   void operator=(const MatrixStack &) = delete;
 
@@ -29,22 +41,50 @@ public:
     return instancePtr;
   }
 
+  static MatrixStack *getThreadInstance()
+  {
+    static thread_local MatrixStack threadStack;
+    return &threadStack;
+  }
+
   void push()
   {
-    stack.push(stack.top()); // Duplicate the top matrix
+    if (depth + 1 >= MATRIXSTACK_CAPACITY)
+    {
+      std::cout << "MatrixStack overflow, capacity is " << MATRIXSTACK_CAPACITY << std::endl;
+      return;
+    }
+    stack[depth + 1] = stack[depth]; // Duplicate the top matrix
+    depth++;
   }
 
   void pop()
   {
-    stack.pop();
+    if (depth == 0)
+    {
+      std::cout << "MatrixStack underflow" << std::endl;
+      return;
+    }
+    depth--;
   }
 
   glm::mat4 &top()
   {
-    return stack.top();
+    return stack[depth];
+  }
+
+  // top = top * m
+  void multiply(const glm::mat4 &m)
+  {
+    SimdMath::multiply(stack[depth], &m, &stack[depth], 1);
+  }
+
+  int size() const
+  {
+    return depth + 1;
   }
 };
 
 MatrixStack *MatrixStack::instancePtr = nullptr;
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,520 @@
+/**
+    @class MeshStreamer MeshStreamer.h "Engine/MeshStreamer.h"
+    @brief Streams the chunks of a chunked mesh file in and out of memory under a budget
+    @details Only the file's chunk table and the coarse proxies of every chunk stay resident. Every frame Update()
+    finds the chunks in the view frustum, queues the missing ones nearest first for the background I/O threads and,
+    when the loads would go over the memory budget, evicts the least recently used chunks that are out of view.
+    Submit() hands the frame's chunks to a RenderQueue: a chunk that is resident draws its full mesh, one that is
+    still in flight draws its proxy. Only the context thread may create or delete the chunks' Shapes, so Upload()
+    runs there (on the render thread, or inline when there is none): it turns loaded chunks into Shapes (a few per
+    call to avoid hitches) and deletes evicted ones once every packet that could still draw them has been drawn.
+    Update() and Submit() run on the simulation thread. The budget counts the vertex bytes of every chunk that is
+    queued, loading, loaded or resident; proxies are not counted.
+*/
+
+#pragma once
+#ifndef MESHSTREAMER_H
+#define MESHSTREAMER_H
+
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "ChunkedMesh.h"
+#include "Frustum.h"
+#include "RenderQueue.h"
+#include "Shape.h"
+#include "SimdMath.h"
+#include "Transform.h"
+#include "Profiler.h"
+
+#define MESHSTREAMER_DEFAULT_BUDGET (256 * 1024 * 1024) // Bytes of chunk vertices kept in memory
+#define MESHSTREAMER_UPLOADS_PER_CALL 4                 // Chunks Upload() turns into Shapes at most
+
+class MeshStreamer
+{
+public:
+    struct Stats
+    {
+        int chunks = 0;          // Chunks in the file
+        int visible = 0;         // Chunks in view this frame
+        int resident = 0;        // Chunks drawn with their full mesh this frame
+        int proxies = 0;         // Chunks drawn with their proxy this frame
+        int inFlight = 0;        // Chunks queued or loading
+        long long loads = 0;     // Chunks read since the file was opened
+        long long evictions = 0; // Chunks evicted since the file was opened
+        size_t bytes = 0;        // Vertex bytes counted against the budget
+        size_t budget = 0;
+    };
+
+private:
+    enum State
+    {
+        Unloaded,
+        Queued,   // In the request list
+        Loading,  // Being read by an I/O thread
+        Loaded,   // Read, waiting for Upload()
+        Resident, // Shape created
+        Evicting, // Waiting for Upload() to delete the Shape
+        Failed    // Could not be read, never requested again
+    };
+
+    struct Chunk
+    {
+        ChunkedMesh::ChunkEntry entry;
+        std::atomic<int> state{Unloaded};
+        std::vector<Vertex> data; // Read by an I/O thread, freed once uploaded
+        Shape *shape = nullptr;   // Full mesh, owned by the context thread
+        Shape *proxy = nullptr;   // Coarse mesh, created by the first Upload()
+        glm::vec3 center;         // World space bounding sphere
+        float radius = 0;
+        float distance = 0;       // From the camera this frame, nearer chunks load first
+        long long lastUsed = -1;  // Frame the chunk was last in view
+        long long evictFrame = 0; // Frame the eviction was decided in
+    };
+
+    std::string path;
+    bool open = false;
+    std::vector<std::unique_ptr<Chunk>> chunks;
+    std::vector<std::vector<Vertex>> proxyData; // Until the proxies are uploaded
+    std::atomic<bool> proxiesReady{false};
+    Transform transform;
+    Shader *shader = nullptr;
+    ShaderVariants *variants = nullptr;
+    Material *material = nullptr;
+
+    // Simulation thread state
+    size_t budget, bytes = 0;
+    std::vector<int> frameChunks; // In view this frame
+    std::vector<int> candidates;  // In view and not loaded
+    Stats stats;
+
+    // Shared with the I/O threads and the context thread
+    std::mutex lock;
+    std::condition_variable wake;
+    std::vector<int> requests; // Queued chunks, nearest first
+    std::vector<int> loaded;   // Read and waiting for Upload()
+    std::vector<int> evicted;  // Waiting for Upload() to delete their Shapes
+    std::vector<std::thread> ioThreads;
+    bool running = false;
+    std::atomic<long long> loads{0};
+
+    void ioLoop();
+    Shape *makeShape(const std::vector<Vertex> &vertices, const ChunkedMesh::ChunkEntry &entry);
+    bool evictOne(long long frame);
+
+public:
+    MeshStreamer(const std::string &_path, size_t _budget = MESHSTREAMER_DEFAULT_BUDGET, int threads = 2);
+    ~MeshStreamer();
+    MeshStreamer(const MeshStreamer &) = delete;
+    void operator=(const MeshStreamer &) = delete;
+
+    bool IsOpen() const;
+    void SetTransform(const Transform &_transform);
+    void SetShader(Shader *_shader);
+    void SetShader(ShaderVariants *_variants);
+    void SetMaterial(Material *_material);
+    void SetBudget(size_t _budget);
+    void Update(const glm::mat4 &viewProjection, const glm::vec3 &eye, long long frame);
+    void Submit(RenderQueue &queue);
+    void Upload(long long frame);
+    void Release();
+    const Stats &GetStats() const;
+};
+
+/**
+    @brief Opens a chunked mesh file, reads its table and proxies and starts the I/O threads
+    @param _path Chunked mesh file (see ChunkedMesh.h)
+    @param _budget Bytes of chunk vertices that may be in memory at once
+    @param threads Number of background I/O threads
+*/
+MeshStreamer::MeshStreamer(const std::string &_path, size_t _budget, int threads) : path(_path), budget(_budget)
+{
+    FILE *file = fopen(path.c_str(), "rb");
+    if (file == NULL)
+    {
+        std::cout << "Cannot open file " << path << std::endl;
+        return;
+    }
+    ChunkedMesh::FileHeader header;
+    std::vector<ChunkedMesh::ChunkEntry> entries;
+    open = ChunkedMesh::ReadTable(file, header, entries);
+    proxyData.resize(entries.size());
+    for (size_t i = 0; i < entries.size() && open; i++)
+    {
+        chunks.push_back(std::unique_ptr<Chunk>(new Chunk()));
+        chunks[i]->entry = entries[i];
+        open = ChunkedMesh::ReadVertices(file, entries[i].proxyOffset, entries[i].proxyVertexCount, proxyData[i]);
+    }
+    fclose(file);
+    if (!open)
+    {
+        std::cout << "Not a chunked mesh file " << path << std::endl;
+        chunks.clear();
+        return;
+    }
+
+    frameChunks.reserve(chunks.size());
+    candidates.reserve(chunks.size());
+    requests.reserve(chunks.size());
+    loaded.reserve(chunks.size());
+    evicted.reserve(chunks.size());
+    stats.chunks = (int)chunks.size();
+    running = true;
+    for (int i = 0; i < std::max(1, threads); i++)
+    {
+        ioThreads.push_back(std::thread(&MeshStreamer::ioLoop, this));
+    }
+}
+
+/**
+    @brief Stops the I/O threads and deletes the Shapes, the context must be current (or Release() called before)
+*/
+MeshStreamer::~MeshStreamer()
+{
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        running = false;
+    }
+    wake.notify_all();
+    for (std::thread &thread : ioThreads)
+    {
+        thread.join();
+    }
+    Release();
+}
+
+/**
+    @brief Background I/O thread: reads the nearest queued chunk, repeats
+*/
+void MeshStreamer::ioLoop()
+{
+    FILE *file = fopen(path.c_str(), "rb");
+    std::unique_lock<std::mutex> guard(lock);
+    while (true)
+    {
+        wake.wait(guard, [this]()
+                  { return !requests.empty() || !running; });
+        if (!running)
+        {
+            break;
+        }
+        int index = requests.front();
+        requests.erase(requests.begin());
+        Chunk &chunk = *chunks[index];
+        chunk.state = Loading;
+        guard.unlock();
+
+        bool ok = file != NULL && ChunkedMesh::ReadVertices(file, chunk.entry.offset, chunk.entry.vertexCount, chunk.data);
+        loads++;
+
+        guard.lock();
+        if (ok)
+        {
+            chunk.state = Loaded;
+            loaded.push_back(index);
+        }
+        else
+        {
+            std::cout << "Failed reading chunk " << index << " of " << path << std::endl;
+            chunk.data = std::vector<Vertex>();
+            chunk.state = Failed;
+            bytes -= chunk.entry.vertexCount * sizeof(Vertex);
+        }
+    }
+    guard.unlock();
+    if (file != NULL)
+    {
+        fclose(file);
+    }
+}
+
+bool MeshStreamer::IsOpen() const
+{
+    return open;
+}
+
+/**
+    @brief Sets the transform every chunk is drawn with, call before the first Update()
+*/
+void MeshStreamer::SetTransform(const Transform &_transform)
+{
+    transform = _transform;
+}
+
+/**
+    @brief Sets the shader the chunks are drawn with, call before the first Upload()
+*/
+void MeshStreamer::SetShader(Shader *_shader)
+{
+    shader = _shader;
+    variants = nullptr;
+}
+
+/**
+    @brief Sets the variant cache the chunks are drawn with, call before the first Upload()
+*/
+void MeshStreamer::SetShader(ShaderVariants *_variants)
+{
+    variants = _variants;
+    shader = nullptr;
+}
+
+/**
+    @brief Sets the material the chunks are drawn with, call before the first Upload()
+*/
+void MeshStreamer::SetMaterial(Material *_material)
+{
+    material = _material;
+}
+
+/**
+    @brief Changes the memory budget, chunks over it are evicted by the next Update() once out of view
+*/
+void MeshStreamer::SetBudget(size_t _budget)
+{
+    budget = _budget;
+}
+
+/**
+    @brief Picks the chunks of the frame, queues the missing ones and evicts over the budget
+    @details Call on the simulation thread once per frame, before Submit().
+    @param viewProjection Matrix taking world space to clip space
+    @param eye Camera position, chunks are loaded nearest first
+    @param frame Frame number, increasing (FramePacket::frame when there is a render thread)
+*/
+void MeshStreamer::Update(const glm::mat4 &viewProjection, const glm::vec3 &eye, long long frame)
+{
+    PROFILE_CPU_SCOPE("MeshStreamer::Update");
+    Frustum frustum(viewProjection);
+    glm::mat4 world = transform.World();
+    frameChunks.clear();
+    candidates.clear();
+    stats.visible = stats.resident = stats.proxies = 0;
+    for (int i = 0; i < (int)chunks.size(); i++)
+    {
+        Chunk &chunk = *chunks[i];
+        AABB box = {chunk.entry.boundsMin, chunk.entry.boundsMax};
+        SimdMath::transformAABB(world, &box, &box, 1);
+        chunk.center = (box.min + box.max) * 0.5f;
+        chunk.radius = glm::length(box.max - box.min) * 0.5f;
+        if (!frustum.Intersects(chunk.center, chunk.radius))
+        {
+            continue;
+        }
+        chunk.lastUsed = frame;
+        chunk.distance = glm::max(0.0f, glm::length(chunk.center - eye) - chunk.radius);
+        frameChunks.push_back(i);
+        if (chunk.state.load(std::memory_order_acquire) == Unloaded)
+        {
+            candidates.push_back(i);
+        }
+    }
+    stats.visible = (int)frameChunks.size();
+
+    std::lock_guard<std::mutex> guard(lock);
+
+    // Requests for chunks that left the view before an I/O thread got to them are dropped
+    for (int i = 0; i < (int)requests.size();)
+    {
+        Chunk &chunk = *chunks[requests[i]];
+        if (chunk.lastUsed != frame)
+        {
+            chunk.state = Unloaded;
+            bytes -= chunk.entry.vertexCount * sizeof(Vertex);
+            requests.erase(requests.begin() + i);
+        }
+        else
+        {
+            i++;
+        }
+    }
+
+    // Nearest first, as long as the budget allows, evicting the least recently used chunks out of view
+    std::sort(candidates.begin(), candidates.end(), [this](int a, int b)
+              { return chunks[a]->distance < chunks[b]->distance; });
+    for (int index : candidates)
+    {
+        Chunk &chunk = *chunks[index];
+        size_t size = chunk.entry.vertexCount * sizeof(Vertex);
+        while (bytes + size > budget && evictOne(frame))
+        {
+        }
+        if (bytes + size > budget)
+        {
+            break;
+        }
+        bytes += size;
+        chunk.state = Queued;
+        requests.push_back(index);
+    }
+    while (bytes > budget && evictOne(frame))
+    {
+    }
+    std::stable_sort(requests.begin(), requests.end(), [this](int a, int b)
+                     { return chunks[a]->distance < chunks[b]->distance; });
+    if (!requests.empty())
+    {
+        wake.notify_all();
+    }
+
+    stats.inFlight = 0;
+    for (const std::unique_ptr<Chunk> &chunk : chunks)
+    {
+        int state = chunk->state.load(std::memory_order_relaxed);
+        stats.inFlight += state == Queued || state == Loading;
+    }
+    stats.loads = loads;
+    stats.bytes = bytes;
+    stats.budget = budget;
+}
+
+/**
+    @brief Evicts the resident chunk that was out of view the longest, call with the lock held
+    @returns bool, false if every resident chunk is in view this frame
+*/
+bool MeshStreamer::evictOne(long long frame)
+{
+    int oldest = -1;
+    for (int i = 0; i < (int)chunks.size(); i++)
+    {
+        const Chunk &chunk = *chunks[i];
+        if (chunk.lastUsed < frame && chunk.state.load(std::memory_order_acquire) == Resident &&
+            (oldest < 0 || chunk.lastUsed < chunks[oldest]->lastUsed))
+        {
+            oldest = i;
+        }
+    }
+    if (oldest < 0)
+    {
+        return false;
+    }
+    Chunk &chunk = *chunks[oldest];
+    chunk.state = Evicting;
+    chunk.evictFrame = frame;
+    evicted.push_back(oldest);
+    bytes -= chunk.entry.vertexCount * sizeof(Vertex);
+    stats.evictions++;
+    return true;
+}
+
+/**
+    @brief Submits the chunks in view, the full mesh of resident ones and the proxy of the others
+*/
+void MeshStreamer::Submit(RenderQueue &queue)
+{
+    bool proxies = proxiesReady.load(std::memory_order_acquire);
+    for (int index : frameChunks)
+    {
+        Chunk &chunk = *chunks[index];
+        if (chunk.state.load(std::memory_order_acquire) == Resident)
+        {
+            queue.Submit(chunk.shape);
+            stats.resident++;
+        }
+        else if (proxies && chunk.proxy != nullptr)
+        {
+            queue.Submit(chunk.proxy);
+            stats.proxies++;
+        }
+    }
+}
+
+/**
+    @brief Builds a Shape out of chunk vertices, on the context thread
+*/
+Shape *MeshStreamer::makeShape(const std::vector<Vertex> &vertices, const ChunkedMesh::ChunkEntry &entry)
+{
+    Shape *shape = new Shape(GL_STATIC_DRAW, vertices);
+    shape->SetBounds((entry.boundsMin + entry.boundsMax) * 0.5f, glm::length(entry.boundsMax - entry.boundsMin) * 0.5f);
+    shape->SetTransform(transform);
+    if (variants != nullptr)
+    {
+        shape->SetShader(variants);
+    }
+    else
+    {
+        shape->SetShader(shader);
+    }
+    shape->SetMaterial(material);
+    shape->Unbind();
+    return shape;
+}
+
+/**
+    @brief Creates the Shapes of loaded chunks and deletes the ones of evicted chunks, on the context thread
+    @param frame Frame about to be drawn (FramePacket::frame), evictions decided in it or before are carried out
+*/
+void MeshStreamer::Upload(long long frame)
+{
+    PROFILE_CPU_SCOPE("MeshStreamer::Upload");
+    if (!proxiesReady.load(std::memory_order_relaxed) && open)
+    {
+        for (size_t i = 0; i < chunks.size(); i++)
+        {
+            if (!proxyData[i].empty())
+            {
+                chunks[i]->proxy = makeShape(proxyData[i], chunks[i]->entry);
+            }
+        }
+        proxyData = std::vector<std::vector<Vertex>>();
+        proxiesReady.store(true, std::memory_order_release);
+    }
+
+    std::unique_lock<std::mutex> guard(lock);
+    for (int i = 0; i < (int)evicted.size();)
+    {
+        Chunk &chunk = *chunks[evicted[i]];
+        if (chunk.evictFrame <= frame)
+        {
+            delete chunk.shape;
+            chunk.shape = nullptr;
+            chunk.state = Unloaded;
+            evicted.erase(evicted.begin() + i);
+        }
+        else
+        {
+            i++;
+        }
+    }
+
+    for (int uploads = 0; uploads < MESHSTREAMER_UPLOADS_PER_CALL && !loaded.empty(); uploads++)
+    {
+        Chunk &chunk = *chunks[loaded.front()];
+        loaded.erase(loaded.begin());
+        guard.unlock();
+        chunk.shape = makeShape(chunk.data, chunk.entry);
+        chunk.data = std::vector<Vertex>();
+        guard.lock();
+        chunk.state.store(Resident, std::memory_order_release);
+    }
+}
+
+/**
+    @brief Deletes every Shape, on the context thread after the last frame was drawn
+*/
+void MeshStreamer::Release()
+{
+    for (const std::unique_ptr<Chunk> &chunk : chunks)
+    {
+        delete chunk->shape;
+        delete chunk->proxy;
+        chunk->shape = chunk->proxy = nullptr;
+    }
+}
+
+/**
+    @brief Returns the counters of the last Update() and Submit()
+*/
+const MeshStreamer::Stats &MeshStreamer::GetStats() const
+{
+    return stats;
+}
+
+#endif
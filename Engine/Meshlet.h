@@ -0,0 +1,333 @@
+/**
+    @file Meshlet.h
+    @brief Splits indexed meshes into small clusters that can be culled one by one, independent of OpenGL
+    @details A meshlet is a cluster of at most MESHLET_MAX_TRIANGLES triangles referencing at most
+    MESHLET_MAX_VERTICES distinct vertices, grown greedily over shared vertices so its triangles are close together
+    and face roughly the same way. Each one keeps a bounding sphere for frustum culling and a normal cone (the
+    average triangle normal and the spread around it) for back-face culling: a cluster whose every triangle faces
+    away from the eye is dropped without looking at its triangles. The cone test follows meshoptimizer's
+    apex-free form, dot(center - eye, axis) >= cutoff * |center - eye| + radius, so it stays conservative for any
+    eye inside or outside the sphere. Back-face culling assumes closed meshes with counter-clockwise front faces.
+    The meshlets' triangles are stored in one index buffer in meshlet order, so a culled mesh is drawn with one
+    glMultiDrawElements over the ranges of the surviving meshlets (adjacent ones merged).
+*/
+
+#pragma once
+#ifndef MESHLET_H
+#define MESHLET_H
+
+#include <glm/glm.hpp>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+#include "Frustum.h"
+#include "ObjLoader.h"
+
+#define MESHLET_MAX_VERTICES 64
+#define MESHLET_MAX_TRIANGLES 124
+
+namespace Meshlets
+{
+    struct Meshlet
+    {
+        glm::vec3 center;    // Object space bounding sphere
+        float radius;
+        glm::vec3 coneAxis;  // Average facing of the triangles
+        float coneCutoff;    // Sine of the cone's half angle, 1 when the triangles face too many ways to be culled
+        uint32_t firstIndex; // First index of the meshlet's triangles in the index buffer
+        uint32_t triangleCount;
+    };
+
+    struct Range
+    {
+        uint32_t firstIndex;
+        uint32_t indexCount;
+    };
+
+    struct VertexHash
+    {
+        size_t operator()(const Vertex &v) const
+        {
+            const unsigned char *bytes = (const unsigned char *)&v;
+            size_t hash = 14695981039346656037ull;
+            for (size_t i = 0; i < sizeof(Vertex); i++)
+            {
+                hash = (hash ^ bytes[i]) * 1099511628211ull;
+            }
+            return hash;
+        }
+    };
+
+    struct VertexEqual
+    {
+        bool operator()(const Vertex &a, const Vertex &b) const
+        {
+            return memcmp(&a, &b, sizeof(Vertex)) == 0;
+        }
+    };
+
+    /**
+        @brief Turns an expanded triangle list into an indexed one by merging identical vertices
+        @param expanded Triangle list, as ObjLoader produces it
+        @param vertices Receives the distinct vertices
+        @param indices Receives three indices per triangle
+    */
+    void Weld(const std::vector<Vertex> &expanded, std::vector<Vertex> &vertices, std::vector<uint32_t> &indices)
+    {
+        std::unordered_map<Vertex, uint32_t, VertexHash, VertexEqual> unique;
+        unique.reserve(expanded.size());
+        vertices.clear();
+        indices.resize(expanded.size());
+        for (size_t i = 0; i < expanded.size(); i++)
+        {
+            auto inserted = unique.insert({expanded[i], (uint32_t)vertices.size()});
+            if (inserted.second)
+            {
+                vertices.push_back(expanded[i]);
+            }
+            indices[i] = inserted.first->second;
+        }
+    }
+
+    /**
+        @brief Computes the bounding sphere and normal cone of a cluster of triangles
+        @param vertices Mesh vertices
+        @param indices Three indices per triangle of the cluster
+        @param triangles Number of triangles
+        @param meshlet Receives the bounds, its index range is left alone
+    */
+    void ComputeBounds(const std::vector<Vertex> &vertices, const uint32_t *indices, int triangles, Meshlet &meshlet)
+    {
+        glm::vec3 lo = vertices[indices[0]].position, hi = lo;
+        for (int i = 0; i < triangles * 3; i++)
+        {
+            lo = glm::min(lo, vertices[indices[i]].position);
+            hi = glm::max(hi, vertices[indices[i]].position);
+        }
+        meshlet.center = (lo + hi) * 0.5f;
+        meshlet.radius = 0;
+        for (int i = 0; i < triangles * 3; i++)
+        {
+            meshlet.radius = glm::max(meshlet.radius, glm::length(vertices[indices[i]].position - meshlet.center));
+        }
+
+        // Unit normals, so small triangles count as much as large ones when bounding the spread
+        std::vector<glm::vec3> normals;
+        glm::vec3 sum(0.0f);
+        for (int t = 0; t < triangles; t++)
+        {
+            glm::vec3 a = vertices[indices[t * 3]].position;
+            glm::vec3 n = glm::cross(vertices[indices[t * 3 + 1]].position - a, vertices[indices[t * 3 + 2]].position - a);
+            float length = glm::length(n);
+            if (length > 0)
+            {
+                normals.push_back(n / length);
+                sum += n / length;
+            }
+        }
+        float length = glm::length(sum);
+        meshlet.coneAxis = length > 0 ? sum / length : glm::vec3(0, 0, 1);
+        meshlet.coneCutoff = 1.0f;
+        if (length == 0)
+        {
+            return;
+        }
+        float minDot = 1.0f;
+        for (const glm::vec3 &n : normals)
+        {
+            minDot = glm::min(minDot, glm::dot(n, meshlet.coneAxis));
+        }
+        // Cones wider than a hemisphere never face entirely away, and close to it they rarely do
+        if (minDot > 0.1f)
+        {
+            meshlet.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+        }
+    }
+
+    /**
+        @brief Splits an indexed triangle list into meshlets
+        @details Each meshlet is seeded with the first triangle not taken yet and grown with the neighbouring
+        triangle that adds the fewest new vertices, the one nearest to its center on ties, until the vertex or
+        triangle limit is reached.
+        @param vertices Mesh vertices
+        @param indices Three indices per triangle
+        @param meshlets Receives the meshlets
+        @param meshletIndices Receives the triangles reordered meshlet by meshlet
+        @param maxVertices Distinct vertices a meshlet may reference
+        @param maxTriangles Triangles a meshlet may hold
+    */
+    void Build(const std::vector<Vertex> &vertices, const std::vector<uint32_t> &indices, std::vector<Meshlet> &meshlets,
+               std::vector<uint32_t> &meshletIndices, int maxVertices = MESHLET_MAX_VERTICES,
+               int maxTriangles = MESHLET_MAX_TRIANGLES)
+    {
+        int triangleCount = (int)indices.size() / 3;
+        int vertexCount = (int)vertices.size();
+        meshlets.clear();
+        meshletIndices.clear();
+        meshletIndices.reserve(triangleCount * 3);
+
+        // Triangles using each vertex
+        std::vector<int> adjacencyStart(vertexCount + 1, 0), adjacency(triangleCount * 3);
+        for (int i = 0; i < triangleCount * 3; i++)
+        {
+            adjacencyStart[indices[i] + 1]++;
+        }
+        for (int v = 0; v < vertexCount; v++)
+        {
+            adjacencyStart[v + 1] += adjacencyStart[v];
+        }
+        std::vector<int> fill(adjacencyStart.begin(), adjacencyStart.end() - 1);
+        for (int i = 0; i < triangleCount * 3; i++)
+        {
+            adjacency[fill[indices[i]]++] = i / 3;
+        }
+
+        std::vector<bool> taken(triangleCount, false);
+        std::vector<bool> inMeshlet(vertexCount, false);
+        std::vector<uint32_t> meshletVertices;
+        glm::vec3 positionSum(0.0f); // Of the meshlet's vertices, to keep it round
+        int seed = 0, triangles = 0;
+
+        auto newVertices = [&](int t)
+        {
+            return (int)!inMeshlet[indices[t * 3]] + (int)!inMeshlet[indices[t * 3 + 1]] + (int)!inMeshlet[indices[t * 3 + 2]];
+        };
+        auto flush = [&]()
+        {
+            if (triangles == 0)
+            {
+                return;
+            }
+            Meshlet meshlet;
+            meshlet.firstIndex = (uint32_t)(meshletIndices.size() - triangles * 3);
+            meshlet.triangleCount = (uint32_t)triangles;
+            ComputeBounds(vertices, &meshletIndices[meshlet.firstIndex], triangles, meshlet);
+            meshlets.push_back(meshlet);
+            for (uint32_t v : meshletVertices)
+            {
+                inMeshlet[v] = false;
+            }
+            meshletVertices.clear();
+            positionSum = glm::vec3(0.0f);
+            triangles = 0;
+        };
+
+        while (true)
+        {
+            // Neighbour adding the fewest vertices and closest to the meshlet's center, or the next free triangle
+            // when the meshlet has none
+            int best = -1, bestCost = 4;
+            float bestDistance = 0;
+            glm::vec3 center = meshletVertices.empty() ? glm::vec3(0.0f) : positionSum / (float)meshletVertices.size();
+            for (uint32_t v : meshletVertices)
+            {
+                for (int a = adjacencyStart[v]; a < adjacencyStart[v + 1]; a++)
+                {
+                    int t = adjacency[a];
+                    int cost = taken[t] ? 4 : newVertices(t);
+                    if (cost > bestCost)
+                    {
+                        continue;
+                    }
+                    glm::vec3 offset = (vertices[indices[t * 3]].position + vertices[indices[t * 3 + 1]].position +
+                                        vertices[indices[t * 3 + 2]].position) / 3.0f - center;
+                    float distance = glm::dot(offset, offset);
+                    if (cost < bestCost || distance < bestDistance)
+                    {
+                        best = t;
+                        bestCost = cost;
+                        bestDistance = distance;
+                    }
+                }
+            }
+            if (best < 0)
+            {
+                while (seed < triangleCount && taken[seed])
+                {
+                    seed++;
+                }
+                if (seed == triangleCount)
+                {
+                    break;
+                }
+                best = seed;
+                bestCost = newVertices(best);
+            }
+            if ((int)meshletVertices.size() + bestCost > maxVertices || triangles + 1 > maxTriangles)
+            {
+                flush();
+                bestCost = 3;
+            }
+
+            taken[best] = true;
+            for (int c = 0; c < 3; c++)
+            {
+                uint32_t v = indices[best * 3 + c];
+                if (!inMeshlet[v])
+                {
+                    inMeshlet[v] = true;
+                    meshletVertices.push_back(v);
+                    positionSum += vertices[v].position;
+                }
+                meshletIndices.push_back(v);
+            }
+            triangles++;
+        }
+        flush();
+    }
+
+    /**
+        @brief Whether a meshlet has triangles facing the eye
+        @param meshlet Meshlet to test
+        @param eye Eye position in the meshlet's object space
+    */
+    inline bool FacesEye(const Meshlet &meshlet, const glm::vec3 &eye)
+    {
+        glm::vec3 toCenter = meshlet.center - eye;
+        return glm::dot(toCenter, meshlet.coneAxis) < meshlet.coneCutoff * glm::length(toCenter) + meshlet.radius;
+    }
+
+    /**
+        @brief Culls the meshlets of an object against the view frustum and the eye
+        @param meshlets Meshlets of the object
+        @param count Number of meshlets
+        @param world Object to world matrix
+        @param scale Largest axis scale of world, bounding radii grow by it
+        @param frustum World space view frustum
+        @param eye Eye position in object space, back-facing meshlets are dropped
+        @param ranges Receives the index ranges to draw, adjacent meshlets merged, room for count ranges
+        @param culledMeshlets Receives the number of meshlets dropped
+        @param culledTriangles Receives the number of triangles dropped
+        @returns int, number of ranges written
+    */
+    int Cull(const Meshlet *meshlets, int count, const glm::mat4 &world, float scale, const Frustum &frustum,
+             const glm::vec3 &eye, Range *ranges, int &culledMeshlets, int &culledTriangles)
+    {
+        int written = 0;
+        culledMeshlets = culledTriangles = 0;
+        for (int i = 0; i < count; i++)
+        {
+            const Meshlet &meshlet = meshlets[i];
+            glm::vec3 center = glm::vec3(world * glm::vec4(meshlet.center, 1.0f));
+            if (!FacesEye(meshlet, eye) || !frustum.Intersects(center, meshlet.radius * scale))
+            {
+                culledMeshlets++;
+                culledTriangles += meshlet.triangleCount;
+                continue;
+            }
+            if (written > 0 && ranges[written - 1].firstIndex + ranges[written - 1].indexCount == meshlet.firstIndex)
+            {
+                ranges[written - 1].indexCount += meshlet.triangleCount * 3;
+            }
+            else
+            {
+                ranges[written++] = Range{meshlet.firstIndex, meshlet.triangleCount * 3};
+            }
+        }
+        return written;
+    }
+}
+
+#endif
@@ -0,0 +1,207 @@
+/**
+    @file ObjLoader.h
+    @brief Wavefront OBJ parsing, independent of OpenGL
+    @details Parses OBJ text into the expanded (non-indexed) Vertex list that Shape uploads. Keeping this free of GL
+    calls lets the parser be benchmarked and run on worker threads. Faces may be written as v, v/vt, v//vn or v/vt/vn
+    with positive or negative (relative) indices; polygons with more than three vertices are fan triangulated.
+*/
+
+#pragma once
+#ifndef OBJLOADER_H
+#define OBJLOADER_H
+
+#include <glm/glm.hpp>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using glm::vec3, glm::vec2;
+
+struct Vertex
+{
+    vec3 position;
+    vec2 texture;
+    vec3 normal;
+};
+
+namespace ObjLoader
+{
+    /**
+        @brief Reads a whole file into memory
+        @param path Path to the file
+        @param data Receives the file contents
+        @returns bool, whether the file could be read
+    */
+    bool ReadFile(const std::string &path, std::string &data)
+    {
+        FILE *file = fopen(path.c_str(), "rb");
+        if (file == NULL)
+        {
+            std::cout << "Cannot open file " << path << std::endl;
+            return false;
+        }
+        fseek(file, 0, SEEK_END);
+        long size = ftell(file);
+        fseek(file, 0, SEEK_SET);
+        data.resize(size > 0 ? size : 0);
+        size_t read = size > 0 ? fread(&data[0], 1, size, file) : 0;
+        fclose(file);
+        data.resize(read);
+        return true;
+    }
+
+    /**
+        @brief Parses one face corner ("v", "v/vt", "v//vn" or "v/vt/vn")
+        @details Indices are returned zero based, -1 when the element is missing. Negative OBJ indices are relative to
+        the number of elements read so far.
+        @returns const char*, position after the corner, or nullptr if there is no corner at p
+    */
+    const char *parseCorner(const char *p, const char *end, int counts[3], int indices[3])
+    {
+        for (int k = 0; k < 3; k++)
+        {
+            indices[k] = -1;
+        }
+        for (int k = 0; k < 3 && p < end; k++)
+        {
+            if (k > 0)
+            {
+                if (*p != '/')
+                    break;
+                p++;
+            }
+            if (p < end && (*p == '-' || (*p >= '0' && *p <= '9')))
+            {
+                char *next;
+                long index = strtol(p, &next, 10);
+                indices[k] = index < 0 ? counts[k] + (int)index : (int)index - 1;
+                p = next;
+            }
+            else if (k == 0)
+            {
+                return nullptr;
+            }
+        }
+        return p;
+    }
+
+    /**
+        @brief Parses OBJ text into an expanded vertex list
+        @param data OBJ file contents, must be followed by a null terminator (std::string data is)
+        @param size Size of the contents in bytes
+        @param vertices Receives three vertices per triangle
+        @returns bool, whether the data was valid
+    */
+    bool Parse(const char *data, size_t size, std::vector<Vertex> &vertices)
+    {
+        std::vector<vec3> positions, normals;
+        std::vector<vec2> uvs;
+        const char *p = data, *end = data + size;
+        vertices.clear();
+
+        while (p < end)
+        {
+            // Skip leading whitespace and empty lines
+            while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n'))
+                p++;
+            if (p >= end)
+                break;
+
+            const char *lineEnd = p;
+            while (lineEnd < end && *lineEnd != '\n')
+                lineEnd++;
+
+            char *next;
+            if (p[0] == 'v' && p + 1 < end && (p[1] == ' ' || p[1] == '\t'))
+            {
+                vec3 v;
+                v.x = strtof(p + 1, &next);
+                v.y = strtof(next, &next);
+                v.z = strtof(next, &next);
+                positions.push_back(v);
+            }
+            else if (p[0] == 'v' && p + 2 < end && p[1] == 't' && (p[2] == ' ' || p[2] == '\t'))
+            {
+                vec2 uv;
+                uv.x = strtof(p + 2, &next);
+                uv.y = strtof(next, &next);
+                uvs.push_back(uv);
+            }
+            else if (p[0] == 'v' && p + 2 < end && p[1] == 'n' && (p[2] == ' ' || p[2] == '\t'))
+            {
+                vec3 n;
+                n.x = strtof(p + 2, &next);
+                n.y = strtof(next, &next);
+                n.z = strtof(next, &next);
+                normals.push_back(n);
+            }
+            else if (p[0] == 'f' && p + 1 < end && (p[1] == ' ' || p[1] == '\t'))
+            {
+                int counts[3] = {(int)positions.size(), (int)uvs.size(), (int)normals.size()};
+                Vertex corners[3];
+                int corner = 0;
+                const char *q = p + 1;
+                while (q < lineEnd)
+                {
+                    while (q < lineEnd && (*q == ' ' || *q == '\t' || *q == '\r'))
+                        q++;
+                    if (q >= lineEnd)
+                        break;
+                    int indices[3];
+                    q = parseCorner(q, lineEnd, counts, indices);
+                    if (q == nullptr || indices[0] < 0 || indices[0] >= counts[0] || indices[1] >= counts[1] || indices[2] >= counts[2])
+                    {
+                        printf("Unable to read OBJ file! Make sure all face vertices are present.\n");
+                        return false;
+                    }
+                    Vertex v;
+                    v.position = positions[indices[0]];
+                    v.texture = indices[1] >= 0 ? uvs[indices[1]] : vec2(0, 0);
+                    v.normal = indices[2] >= 0 ? normals[indices[2]] : vec3(0, 0, 0);
+
+                    // Fan triangulation: (0, i - 1, i) for every corner after the second
+                    if (corner < 3)
+                    {
+                        corners[corner] = v;
+                        if (corner == 2)
+                        {
+                            vertices.push_back(corners[0]);
+                            vertices.push_back(corners[1]);
+                            vertices.push_back(corners[2]);
+                        }
+                    }
+                    else
+                    {
+                        vertices.push_back(corners[0]);
+                        vertices.push_back(corners[2]);
+                        vertices.push_back(v);
+                        corners[2] = v;
+                    }
+                    corner++;
+                }
+            }
+            p = lineEnd;
+        }
+        return true;
+    }
+
+    /**
+        @brief Loads an OBJ file into an expanded vertex list
+        @param path Path to the obj file
+        @param vertices Receives three vertices per triangle
+        @returns bool, whether the file could be read and parsed
+    */
+    bool Load(const std::string &path, std::vector<Vertex> &vertices)
+    {
+        std::string data;
+        if (!ReadFile(path, data))
+        {
+            return false;
+        }
+        return Parse(data.data(), data.size(), vertices);
+    }
+}
+
+#endif
@@ -0,0 +1,195 @@
+/**
+    @class ObjectBuffer ObjectBlock.h "Engine/ObjectBlock.h"
+    @brief Per-object matrices computed on the CPU and streamed to the ObjectBlock uniform block
+    @details ObjectBlock is the std140 layout of the shaders' ObjectBlock: the full model-view-projection matrix,
+    the object to world matrix (lighting is done in world space) and the normal matrix, the inverse transpose of
+    the world matrix's upper 3x3, which keeps normals perpendicular under non-uniform scale, followed by the slot of
+    the object's material in the MaterialBuffer. Blocks are computed
+    once per object per frame (RenderQueue::Build does it on the JobSystem), so the vertex shader does a single
+    matrix multiply per vertex. ObjectBuffer is a ring of blocks in one uniform buffer: a batch of blocks is staged
+    and uploaded with one glBufferSubData, each draw then binds its block with glBindBufferRange. The buffer is
+    orphaned when the ring wraps so the GPU never waits on a block that is still being read.
+*/
+
+#pragma once
+#ifndef OBJECTBLOCK_H
+#define OBJECTBLOCK_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <cstring>
+#include <vector>
+#include "RenderStats.h"
+#include "SimdMath.h"
+
+#define OBJECTBLOCK_BINDING 0      // Uniform buffer binding point of the ObjectBlock block
+#define OBJECTBUFFER_CAPACITY 1024 // Blocks in the ring before it first grows
+
+struct ObjectBlock
+{
+    glm::mat4 mvp;       // projection * camera * world
+    glm::mat4 model;     // object to world
+    glm::vec4 normal[3]; // columns of the normal matrix, std140 pads mat3 columns to vec4
+    glm::ivec4 material; // x is the slot of the material in the MaterialBlock, the rest pads the block
+
+    void Set(const glm::mat4 &viewProjection, const glm::mat4 &world, int materialIndex = 0);
+};
+
+/**
+    @brief Computes the block of an object
+    @param viewProjection Projection times camera matrix
+    @param world Object to world matrix
+    @param materialIndex Slot of the object's material in the MaterialBuffer, 0 for none
+*/
+void ObjectBlock::Set(const glm::mat4 &viewProjection, const glm::mat4 &world, int materialIndex)
+{
+    glm::mat3 normalMatrix;
+    SimdMath::multiply(viewProjection, &world, &mvp, 1);
+    SimdMath::normalMatrix(&world, &normalMatrix, 1);
+    model = world;
+    for (int i = 0; i < 3; i++)
+    {
+        normal[i] = glm::vec4(normalMatrix[i], 0.0f);
+    }
+    material = glm::ivec4(materialIndex, 0, 0, 0);
+}
+
+class ObjectBuffer
+{
+private:
+    static ObjectBuffer *instancePtr;
+    unsigned int ID = 0;       // Uniform buffer
+    GLsizeiptr stride;         // sizeof(ObjectBlock) rounded up to GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT
+    int capacity;              // Blocks in the buffer
+    int next = 0;              // First free block of the ring
+    int first = 0, count = 0;  // Blocks of the current batch
+    std::vector<char> staging; // Blocks of the current batch at the buffer's stride
+
+    ObjectBuffer();
+
+public:
+    ObjectBuffer(const ObjectBuffer &) = delete;
+    void operator=(const ObjectBuffer &) = delete;
+    ~ObjectBuffer();
+
+    static ObjectBuffer *getInstance();
+    static void destroyInstance();
+    void Begin(int blocks);
+    void Set(int index, const ObjectBlock &block);
+    void End();
+    void Bind(int index);
+    void Upload(const ObjectBlock &block);
+};
+
+ObjectBuffer *ObjectBuffer::instancePtr = nullptr;
+
+/**
+    @brief Creates the uniform buffer, needs a current GL context
+*/
+ObjectBuffer::ObjectBuffer() : capacity(OBJECTBUFFER_CAPACITY)
+{
+    GLint alignment = 256;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    stride = ((GLsizeiptr)sizeof(ObjectBlock) + alignment - 1) / alignment * alignment;
+    glGenBuffers(1, &ID);
+    glBindBuffer(GL_UNIFORM_BUFFER, ID);
+    glBufferData(GL_UNIFORM_BUFFER, capacity * stride, nullptr, GL_STREAM_DRAW);
+}
+
+ObjectBuffer::~ObjectBuffer()
+{
+    glDeleteBuffers(1, &ID);
+}
+
+/**
+    @brief Returns the buffer of the context thread, created on first use
+*/
+ObjectBuffer *ObjectBuffer::getInstance()
+{
+    if (instancePtr == nullptr)
+    {
+        instancePtr = new ObjectBuffer();
+    }
+    return instancePtr;
+}
+
+/**
+    @brief Deletes the buffer, call while the context is still current
+*/
+void ObjectBuffer::destroyInstance()
+{
+    delete instancePtr;
+    instancePtr = nullptr;
+}
+
+/**
+    @brief Starts a batch of blocks
+    @details Wraps (orphaning the buffer) when the batch doesn't fit behind the last one, and grows the buffer when
+    it doesn't fit at all.
+    @param blocks Number of blocks in the batch
+*/
+void ObjectBuffer::Begin(int blocks)
+{
+    if (next + blocks > capacity)
+    {
+        capacity = blocks > capacity ? blocks * 2 : capacity;
+        glBindBuffer(GL_UNIFORM_BUFFER, ID);
+        glBufferData(GL_UNIFORM_BUFFER, capacity * stride, nullptr, GL_STREAM_DRAW);
+        RenderStats::frame.bufferBinds++;
+        next = 0;
+    }
+    if ((GLsizeiptr)staging.size() < blocks * stride)
+    {
+        staging.resize(blocks * stride);
+    }
+    first = next;
+    count = blocks;
+    next += blocks;
+}
+
+/**
+    @brief Stages one block of the batch
+    @param index Position in the batch, 0 to blocks - 1
+*/
+void ObjectBuffer::Set(int index, const ObjectBlock &block)
+{
+    memcpy(&staging[index * stride], &block, sizeof(ObjectBlock));
+}
+
+/**
+    @brief Uploads the staged batch
+*/
+void ObjectBuffer::End()
+{
+    if (count == 0)
+    {
+        return;
+    }
+    GLsizeiptr size = (count - 1) * stride + sizeof(ObjectBlock);
+    glBindBuffer(GL_UNIFORM_BUFFER, ID);
+    glBufferSubData(GL_UNIFORM_BUFFER, first * stride, size, staging.data());
+    RenderStats::frame.bufferBinds++;
+    RenderStats::frame.bufferBytes += size;
+}
+
+/**
+    @brief Binds a block of the uploaded batch to OBJECTBLOCK_BINDING
+    @param index Position in the batch
+*/
+void ObjectBuffer::Bind(int index)
+{
+    glBindBufferRange(GL_UNIFORM_BUFFER, OBJECTBLOCK_BINDING, ID, (first + index) * stride, sizeof(ObjectBlock));
+    RenderStats::frame.bufferBinds++;
+}
+
+/**
+    @brief Uploads a batch of one block, bind it with Bind(0)
+*/
+void ObjectBuffer::Upload(const ObjectBlock &block)
+{
+    Begin(1);
+    Set(0, block);
+    End();
+}
+
+#endif
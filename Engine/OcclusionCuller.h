@@ -0,0 +1,455 @@
+/**
+    @class OcclusionCuller OcclusionCuller.h "Engine/OcclusionCuller.h"
+    @brief Hierarchical-Z occlusion culling against a software rendered depth buffer of the large occluders
+    @details Every frame the occluders (low poly triangle lists in object space, see Shape::SetOccluder) are
+    clipped against the near plane and rasterized into a small depth buffer on the CPU, in bands of rows spread over
+    the JobSystem. The buffer is reduced into a pyramid where every texel holds the farthest depth of the four
+    below it, so a bounding sphere is tested by projecting its box and comparing the nearest depth of the box with
+    at most 3x3 texels of the level whose texels are about as big as the box. Everything runs on the simulation
+    thread before the draw list is built, so visibility is decided with this frame's camera and never lags a frame
+    behind. Spheres that cross the near plane or leave the screen are always visible; frustum culling decides
+    those. The buffers are kept between frames, so a steady-state frame does not allocate.
+*/
+
+#pragma once
+#ifndef OCCLUSIONCULLER_H
+#define OCCLUSIONCULLER_H
+
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <vector>
+#include "JobSystem.h"
+#include "Profiler.h"
+
+#define OCCLUSION_WIDTH 256   // Depth buffer resolution, independent of the window
+#define OCCLUSION_HEIGHT 128
+#define OCCLUSION_BAND_ROWS 8 // Rows rasterized by one job
+#define OCCLUSION_GRAIN 256   // Spheres tested by one job
+
+class OcclusionCuller
+{
+public:
+    struct Stats
+    {
+        int occluders = 0;   // Occluders added this frame
+        int triangles = 0;   // Occluder triangles rasterized after clipping
+        int tested = 0;      // Spheres tested against the pyramid
+        int occluded = 0;    // Spheres found hidden
+        double rasterMs = 0; // Clipping, rasterization and pyramid reduction
+        double testMs = 0;   // Sphere tests
+    };
+
+private:
+    struct Occluder
+    {
+        const std::vector<glm::vec3> *triangles;
+        glm::mat4 world;
+        int first; // First screen triangle slot, every occluder triangle gets two (near plane clipping can split it)
+    };
+
+    // Screen space triangle with counter-clockwise edge functions and a depth plane, both E = A x + B y + C
+    struct ScreenTriangle
+    {
+        bool valid;
+        int minX, maxX, minY, maxY; // Covered pixels, clamped to the buffer
+        float edgeA[3], edgeB[3], edgeC[3];
+        float depthA, depthB, depthC;
+    };
+
+    JobSystem *jobs;
+    glm::mat4 viewProjection;
+    std::vector<Occluder> occluders;
+    std::vector<ScreenTriangle> screenTriangles;
+    std::vector<float> pyramid; // Every level, level 0 (the depth buffer) first, depth in [0, 1]
+    int levelCount;
+    int levelWidth[16], levelHeight[16], levelOffset[16];
+    bool ready = false; // Rasterize() ran since Begin()
+    Stats stats;
+
+    static double msSince(std::chrono::steady_clock::time_point start);
+    void setupTriangles(const Occluder &occluder);
+    void addTriangle(int slot, const glm::vec4 *clip);
+    void rasterizeBand(int firstRow, int lastRow);
+    void buildPyramid();
+
+public:
+    OcclusionCuller(JobSystem *_jobs);
+    void Begin(const glm::mat4 &_viewProjection);
+    void AddOccluder(const std::vector<glm::vec3> &triangles, const glm::mat4 &world);
+    void Rasterize();
+    bool IsVisible(const glm::vec3 &center, float radius) const;
+    int Cull(int count, const glm::vec4 *spheres, unsigned char *visible);
+    const Stats &GetStats() const;
+    float Depth(int x, int y, int level = 0) const;
+};
+
+/**
+    @brief Creates the depth buffer and its pyramid
+    @param _jobs Job system rasterization and tests are spread over
+*/
+OcclusionCuller::OcclusionCuller(JobSystem *_jobs) : jobs(_jobs)
+{
+    int width = OCCLUSION_WIDTH, height = OCCLUSION_HEIGHT, size = 0;
+    for (levelCount = 0; levelCount < 16; levelCount++)
+    {
+        levelWidth[levelCount] = width;
+        levelHeight[levelCount] = height;
+        levelOffset[levelCount] = size;
+        size += width * height;
+        if (width == 1 && height == 1)
+        {
+            levelCount++;
+            break;
+        }
+        width = (width + 1) / 2;
+        height = (height + 1) / 2;
+    }
+    pyramid.assign(size, 1.0f);
+}
+
+double OcclusionCuller::msSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+/**
+    @brief Starts a frame, clears the occluders of the last one
+    @param _viewProjection Matrix taking world space to clip space, the same the frame is drawn with
+*/
+void OcclusionCuller::Begin(const glm::mat4 &_viewProjection)
+{
+    viewProjection = _viewProjection;
+    occluders.clear();
+    ready = false;
+    stats = Stats();
+}
+
+/**
+    @brief Adds an occluder to the frame
+    @details The triangles are only referenced and must stay alive until Rasterize() returns.
+    @param triangles Object space triangle list, three positions per triangle
+    @param world Object to world matrix
+*/
+void OcclusionCuller::AddOccluder(const std::vector<glm::vec3> &triangles, const glm::mat4 &world)
+{
+    int first = occluders.empty() ? 0 : occluders.back().first + (int)occluders.back().triangles->size() / 3 * 2;
+    occluders.push_back(Occluder{&triangles, world, first});
+    stats.occluders++;
+}
+
+/**
+    @brief Renders the occluders into the depth buffer and builds the pyramid
+*/
+void OcclusionCuller::Rasterize()
+{
+    PROFILE_CPU_SCOPE("Occlusion::Rasterize");
+    auto start = std::chrono::steady_clock::now();
+    std::fill(pyramid.begin(), pyramid.begin() + levelWidth[0] * levelHeight[0], 1.0f);
+
+    int slots = occluders.empty() ? 0 : occluders.back().first + (int)occluders.back().triangles->size() / 3 * 2;
+    screenTriangles.resize(slots);
+    jobs->ParallelFor((int)occluders.size(), 1, [&](int begin, int end)
+                      {
+                          for (int i = begin; i < end; i++)
+                          {
+                              setupTriangles(occluders[i]);
+                          } });
+    for (const ScreenTriangle &triangle : screenTriangles)
+    {
+        stats.triangles += triangle.valid;
+    }
+
+    int bands = (levelHeight[0] + OCCLUSION_BAND_ROWS - 1) / OCCLUSION_BAND_ROWS;
+    jobs->ParallelFor(bands, 1, [&](int begin, int end)
+                      {
+                          for (int band = begin; band < end; band++)
+                          {
+                              rasterizeBand(band * OCCLUSION_BAND_ROWS,
+                                            std::min(levelHeight[0], (band + 1) * OCCLUSION_BAND_ROWS));
+                          } });
+    buildPyramid();
+    ready = true;
+    stats.rasterMs = msSince(start);
+}
+
+/**
+    @brief Transforms one occluder to clip space and clips its triangles against the near plane
+*/
+void OcclusionCuller::setupTriangles(const Occluder &occluder)
+{
+    glm::mat4 toClip = viewProjection * occluder.world;
+    const std::vector<glm::vec3> &triangles = *occluder.triangles;
+    for (int t = 0; t + 2 < (int)triangles.size(); t += 3)
+    {
+        int slot = occluder.first + t / 3 * 2;
+        screenTriangles[slot].valid = false;
+        screenTriangles[slot + 1].valid = false;
+
+        glm::vec4 clip[3];
+        float distance[3]; // To the near plane (z = -w), positive inside
+        int inside = 0;
+        for (int i = 0; i < 3; i++)
+        {
+            clip[i] = toClip * glm::vec4(triangles[t + i], 1.0f);
+            distance[i] = clip[i].z + clip[i].w;
+            inside += distance[i] >= 0;
+        }
+        if (inside == 3)
+        {
+            addTriangle(slot, clip);
+            continue;
+        }
+        if (inside == 0)
+        {
+            continue;
+        }
+
+        // Sutherland-Hodgman against the near plane, one triangle becomes a triangle or a quad
+        glm::vec4 polygon[4];
+        int corners = 0;
+        for (int i = 0; i < 3; i++)
+        {
+            int j = (i + 1) % 3;
+            if (distance[i] >= 0)
+            {
+                polygon[corners++] = clip[i];
+            }
+            if ((distance[i] >= 0) != (distance[j] >= 0))
+            {
+                float s = distance[i] / (distance[i] - distance[j]);
+                polygon[corners++] = clip[i] + (clip[j] - clip[i]) * s;
+            }
+        }
+        addTriangle(slot, polygon);
+        if (corners == 4)
+        {
+            glm::vec4 second[3] = {polygon[0], polygon[2], polygon[3]};
+            addTriangle(slot + 1, second);
+        }
+    }
+}
+
+/**
+    @brief Projects a clipped triangle and sets up its edge functions and depth plane
+    @param slot Screen triangle to fill
+    @param clip Clip space corners, in front of the near plane
+*/
+void OcclusionCuller::addTriangle(int slot, const glm::vec4 *clip)
+{
+    ScreenTriangle &triangle = screenTriangles[slot];
+    float x[3], y[3], z[3];
+    for (int i = 0; i < 3; i++)
+    {
+        if (clip[i].w <= 0)
+        {
+            return;
+        }
+        x[i] = (clip[i].x / clip[i].w * 0.5f + 0.5f) * levelWidth[0];
+        y[i] = (clip[i].y / clip[i].w * 0.5f + 0.5f) * levelHeight[0];
+        z[i] = clip[i].z / clip[i].w * 0.5f + 0.5f;
+    }
+
+    float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+    if (area > -1e-6f && area < 1e-6f)
+    {
+        return;
+    }
+    float sign = area > 0 ? 1.0f : -1.0f; // Both facings occlude, clockwise triangles get their edges flipped
+    for (int i = 0; i < 3; i++)
+    {
+        int a = (i + 1) % 3, b = (i + 2) % 3; // Edge i is opposite corner i, so it weights corner i
+        triangle.edgeA[i] = sign * (y[a] - y[b]);
+        triangle.edgeB[i] = sign * (x[b] - x[a]);
+        triangle.edgeC[i] = sign * (x[a] * y[b] - x[b] * y[a]);
+    }
+    float inverseArea = 1.0f / (area * sign);
+    triangle.depthA = (triangle.edgeA[0] * z[0] + triangle.edgeA[1] * z[1] + triangle.edgeA[2] * z[2]) * inverseArea;
+    triangle.depthB = (triangle.edgeB[0] * z[0] + triangle.edgeB[1] * z[1] + triangle.edgeB[2] * z[2]) * inverseArea;
+    triangle.depthC = (triangle.edgeC[0] * z[0] + triangle.edgeC[1] * z[1] + triangle.edgeC[2] * z[2]) * inverseArea;
+
+    float minX = std::min(x[0], std::min(x[1], x[2])), maxX = std::max(x[0], std::max(x[1], x[2]));
+    float minY = std::min(y[0], std::min(y[1], y[2])), maxY = std::max(y[0], std::max(y[1], y[2]));
+    triangle.minX = std::max(0, (int)std::floor(minX));
+    triangle.maxX = std::min(levelWidth[0] - 1, (int)std::ceil(maxX));
+    triangle.minY = std::max(0, (int)std::floor(minY));
+    triangle.maxY = std::min(levelHeight[0] - 1, (int)std::ceil(maxY));
+    triangle.valid = triangle.minX <= triangle.maxX && triangle.minY <= triangle.maxY;
+}
+
+/**
+    @brief Rasterizes every triangle into rows [firstRow, lastRow) of the depth buffer, keeping the nearest depth
+*/
+void OcclusionCuller::rasterizeBand(int firstRow, int lastRow)
+{
+    float *depth = &pyramid[0];
+    int width = levelWidth[0];
+    for (const ScreenTriangle &triangle : screenTriangles)
+    {
+        if (!triangle.valid || triangle.maxY < firstRow || triangle.minY >= lastRow)
+        {
+            continue;
+        }
+        int rowBegin = std::max(firstRow, triangle.minY), rowEnd = std::min(lastRow - 1, triangle.maxY);
+        for (int row = rowBegin; row <= rowEnd; row++)
+        {
+            // Pixel centers, the edge functions and depth step by A along the row
+            float px = triangle.minX + 0.5f, py = row + 0.5f;
+            float e0 = triangle.edgeA[0] * px + triangle.edgeB[0] * py + triangle.edgeC[0];
+            float e1 = triangle.edgeA[1] * px + triangle.edgeB[1] * py + triangle.edgeC[1];
+            float e2 = triangle.edgeA[2] * px + triangle.edgeB[2] * py + triangle.edgeC[2];
+            float z = triangle.depthA * px + triangle.depthB * py + triangle.depthC;
+            float *out = depth + row * width;
+            for (int column = triangle.minX; column <= triangle.maxX; column++)
+            {
+                if (e0 >= 0 && e1 >= 0 && e2 >= 0 && z < out[column])
+                {
+                    out[column] = std::max(z, 0.0f);
+                }
+                e0 += triangle.edgeA[0];
+                e1 += triangle.edgeA[1];
+                e2 += triangle.edgeA[2];
+                z += triangle.depthA;
+            }
+        }
+    }
+}
+
+/**
+    @brief Reduces every level into the next, keeping the farthest depth of each 2x2 block
+*/
+void OcclusionCuller::buildPyramid()
+{
+    for (int level = 1; level < levelCount; level++)
+    {
+        const float *below = &pyramid[levelOffset[level - 1]];
+        float *out = &pyramid[levelOffset[level]];
+        int belowWidth = levelWidth[level - 1], belowHeight = levelHeight[level - 1];
+        for (int y = 0; y < levelHeight[level]; y++)
+        {
+            int y0 = y * 2, y1 = std::min(y * 2 + 1, belowHeight - 1);
+            for (int x = 0; x < levelWidth[level]; x++)
+            {
+                int x0 = x * 2, x1 = std::min(x * 2 + 1, belowWidth - 1);
+                out[y * levelWidth[level] + x] = std::max(std::max(below[y0 * belowWidth + x0], below[y0 * belowWidth + x1]),
+                                                          std::max(below[y1 * belowWidth + x0], below[y1 * belowWidth + x1]));
+            }
+        }
+    }
+}
+
+/**
+    @brief Tests a bounding sphere against the occluders rasterized this frame
+    @details Thread safe once Rasterize() has returned.
+    @param center World space center
+    @param radius World space radius
+    @returns bool, false only if the sphere is completely hidden
+*/
+bool OcclusionCuller::IsVisible(const glm::vec3 &center, float radius) const
+{
+    if (!ready)
+    {
+        return true;
+    }
+    float minX = 1e30f, minY = 1e30f, maxX = -1e30f, maxY = -1e30f, nearest = 1e30f;
+    for (int corner = 0; corner < 8; corner++)
+    {
+        glm::vec3 offset((corner & 1) ? radius : -radius, (corner & 2) ? radius : -radius, (corner & 4) ? radius : -radius);
+        glm::vec4 clip = viewProjection * glm::vec4(center + offset, 1.0f);
+        if (clip.z < -clip.w || clip.w <= 0)
+        {
+            return true;
+        }
+        float x = clip.x / clip.w, y = clip.y / clip.w;
+        minX = std::min(minX, x);
+        maxX = std::max(maxX, x);
+        minY = std::min(minY, y);
+        maxY = std::max(maxY, y);
+        nearest = std::min(nearest, clip.z / clip.w);
+    }
+    if (maxX < -1 || minX > 1 || maxY < -1 || minY > 1)
+    {
+        return true;
+    }
+    nearest = nearest * 0.5f + 0.5f;
+
+    int x0 = std::max(0, (int)((minX * 0.5f + 0.5f) * levelWidth[0]));
+    int x1 = std::min(levelWidth[0] - 1, (int)((maxX * 0.5f + 0.5f) * levelWidth[0]));
+    int y0 = std::max(0, (int)((minY * 0.5f + 0.5f) * levelHeight[0]));
+    int y1 = std::min(levelHeight[0] - 1, (int)((maxY * 0.5f + 0.5f) * levelHeight[0]));
+
+    // Coarsest useful level: the box covers at most 3x3 of its texels
+    int level = 0;
+    while (level + 1 < levelCount && std::max(x1 - x0, y1 - y0) >> level > 1)
+    {
+        level++;
+    }
+    const float *texels = &pyramid[levelOffset[level]];
+    for (int y = y0 >> level; y <= y1 >> level; y++)
+    {
+        for (int x = x0 >> level; x <= x1 >> level; x++)
+        {
+            if (texels[y * levelWidth[level] + x] >= nearest)
+            {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+/**
+    @brief Tests a batch of spheres in parallel and clears the visibility of the hidden ones
+    @param count Number of spheres
+    @param spheres World space (center, radius), spheres with a negative radius are not tested
+    @param visible Visibility of every sphere, only entries that are set are tested
+    @returns int, number of spheres found hidden
+*/
+int OcclusionCuller::Cull(int count, const glm::vec4 *spheres, unsigned char *visible)
+{
+    PROFILE_CPU_SCOPE("Occlusion::Cull");
+    auto start = std::chrono::steady_clock::now();
+    std::atomic<int> tested(0), occluded(0);
+    jobs->ParallelFor(count, OCCLUSION_GRAIN, [&](int begin, int end)
+                      {
+                          int batchTested = 0, batchOccluded = 0;
+                          for (int i = begin; i < end; i++)
+                          {
+                              if (!visible[i] || spheres[i].w < 0)
+                              {
+                                  continue;
+                              }
+                              batchTested++;
+                              if (!IsVisible(glm::vec3(spheres[i]), spheres[i].w))
+                              {
+                                  visible[i] = 0;
+                                  batchOccluded++;
+                              }
+                          }
+                          tested += batchTested;
+                          occluded += batchOccluded; });
+    stats.tested += tested;
+    stats.occluded += occluded;
+    stats.testMs += msSince(start);
+    return occluded;
+}
+
+/**
+    @brief Returns the counters and timings of the current frame
+*/
+const OcclusionCuller::Stats &OcclusionCuller::GetStats() const
+{
+    return stats;
+}
+
+/**
+    @brief Reads one texel of the pyramid, for debugging and tests
+*/
+float OcclusionCuller::Depth(int x, int y, int level) const
+{
+    return pyramid[levelOffset[level] + y * levelWidth[level] + x];
+}
+
+#endif
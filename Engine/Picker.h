@@ -0,0 +1,196 @@
+/**
+    @class Picker Picker.h "Engine/Picker.h"
+    @brief Finds the shape and the triangle a ray or a screen position hits, on the CPU
+    @details Reading an ID buffer back from the GPU would stall the frame until the GPU caught up, so picks are ray
+    casts instead. Each shape brings a BVH over its mesh in object space (Shape::SetPickMesh, Scene builds one per
+    mesh file and shares it between the shapes drawing it), and the picker keeps a top level BVH over the world
+    boxes of its shapes. A ray walks those boxes nearest first and is moved into the object space of each shape it
+    reaches by the inverse of the shape's world matrix, which keeps distances along the ray as they were, so the
+    closest hit so far bounds every later shape and its mesh; shapes whose box starts beyond it are never entered.
+    Update() reads the shapes' transforms again and rebuilds the top level, which takes microseconds for a few
+    hundred shapes, so it is simply called before picking after shapes moved. No GL calls.
+*/
+
+#pragma once
+#ifndef PICKER_H
+#define PICKER_H
+
+#include <glm/glm.hpp>
+#include <chrono>
+#include <vector>
+#include "Bvh.h"
+#include "Shape.h"
+#include "SimdMath.h"
+
+/**
+    @brief Closest shape a pick hit
+*/
+struct PickHit
+{
+    Shape *shape = nullptr;
+    int triangle = -1;                 // Triangle of the shape's mesh, in the order it is drawn in
+    float distance = 0;                // Along the ray, in units of its direction
+    glm::vec3 position = glm::vec3(0); // World space point hit
+};
+
+class Picker
+{
+public:
+    struct Stats
+    {
+        int shapes = 0;       // Shapes with a pick mesh
+        int shapesTested = 0; // Meshes the last pick cast its ray into
+        double updateMs = 0;  // Last Update()
+        double pickUs = 0;    // Last Pick()
+    };
+
+private:
+    struct Instance
+    {
+        Shape *shape;
+        const Bvh *mesh;
+        glm::mat4 inverse; // World to object space
+    };
+
+    std::vector<Instance> instances;
+    std::vector<glm::mat4> worlds; // Scratch for the batched inverses
+    std::vector<AABB> boxes;       // World space, indexed like instances
+    Bvh top;
+    bool dirty = false;
+    Stats stats;
+
+public:
+    bool Add(Shape *shape);
+    void Clear();
+    void Update();
+    bool Pick(const glm::vec3 &origin, const glm::vec3 &direction, PickHit &hit);
+    bool PickScreen(float x, float y, const glm::mat4 &view, const glm::mat4 &projection, PickHit &hit);
+    const Stats &GetStats() const;
+};
+
+/**
+    @brief Adds a shape to pick from, picks find it from the next Update() on
+    @returns bool, false for shapes without a pick mesh, which cannot be picked
+*/
+bool Picker::Add(Shape *shape)
+{
+    if (shape->GetPickMesh() == nullptr || shape->GetPickMesh()->Empty())
+    {
+        return false;
+    }
+    instances.push_back({shape, shape->GetPickMesh(), glm::mat4(1.0f)});
+    dirty = true;
+    return true;
+}
+
+/**
+    @brief Forgets every shape
+*/
+void Picker::Clear()
+{
+    instances.clear();
+    boxes.clear();
+    top.Build(boxes);
+    dirty = false;
+}
+
+/**
+    @brief Reads the transforms of the shapes again and rebuilds the top level over their world boxes
+*/
+void Picker::Update()
+{
+    auto start = std::chrono::steady_clock::now();
+    int count = (int)instances.size();
+    worlds.resize(count);
+    boxes.resize(count);
+    for (int i = 0; i < count; i++)
+    {
+        worlds[i] = instances[i].shape->GetTransform().World();
+        AABB local;
+        instances[i].mesh->GetBounds(local.min, local.max);
+        SimdMath::transformAABB(worlds[i], &local, &boxes[i], 1);
+    }
+    SimdMath::affineInverse(worlds.data(), worlds.data(), count);
+    for (int i = 0; i < count; i++)
+    {
+        instances[i].inverse = worlds[i];
+    }
+    top.Build(boxes);
+    dirty = false;
+    stats.shapes = count;
+    stats.updateMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+/**
+    @brief Finds the closest shape and triangle a ray hits
+    @details Shapes added since the last Update() are picked up first, shapes moved since then are found where they
+    were at the last Update().
+    @param origin World space start of the ray
+    @param direction World space direction of the ray, distances are in its length
+    @param hit Receives the closest hit
+    @returns bool, whether the ray hits a shape
+*/
+bool Picker::Pick(const glm::vec3 &origin, const glm::vec3 &direction, PickHit &hit)
+{
+    if (dirty)
+    {
+        Update();
+    }
+    auto start = std::chrono::steady_clock::now();
+    float tMax = FLT_MAX;
+    int tested = 0;
+    BvhHit closest;
+    int closestInstance = -1;
+    bool found = top.Visit(origin, direction, tMax, [&](uint32_t index, float &t)
+                           {
+                               const Instance &instance = instances[index];
+                               glm::vec3 localOrigin = glm::vec3(instance.inverse * glm::vec4(origin, 1.0f));
+                               glm::vec3 localDirection = glm::mat3(instance.inverse) * direction;
+                               tested++;
+                               if (!instance.mesh->Intersect(localOrigin, localDirection, t, closest))
+                               {
+                                   return false;
+                               }
+                               t = closest.t;
+                               closestInstance = (int)index;
+                               return true; });
+    if (found)
+    {
+        hit.shape = instances[closestInstance].shape;
+        hit.triangle = closest.triangle;
+        hit.distance = closest.t;
+        hit.position = origin + direction * closest.t;
+    }
+    stats.shapesTested = tested;
+    stats.pickUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+    return found;
+}
+
+/**
+    @brief Finds the closest shape and triangle under a point of the screen
+    @param x Horizontal position in normalized device coordinates, -1 at the left edge and 1 at the right
+    @param y Vertical position in normalized device coordinates, -1 at the bottom and 1 at the top
+    @param view View matrix the frame was drawn with
+    @param projection Projection matrix the frame was drawn with
+    @param hit Receives the closest hit, its distance in world units from the camera's near plane
+    @returns bool, whether a shape is under the point
+*/
+bool Picker::PickScreen(float x, float y, const glm::mat4 &view, const glm::mat4 &projection, PickHit &hit)
+{
+    glm::mat4 inverse = glm::inverse(projection * view);
+    glm::vec4 nearPoint = inverse * glm::vec4(x, y, -1.0f, 1.0f);
+    glm::vec4 farPoint = inverse * glm::vec4(x, y, 1.0f, 1.0f);
+    glm::vec3 origin = glm::vec3(nearPoint) / nearPoint.w;
+    glm::vec3 direction = glm::normalize(glm::vec3(farPoint) / farPoint.w - origin);
+    return Pick(origin, direction, hit);
+}
+
+/**
+    @brief Shape count and the times of the last update and pick
+*/
+const Picker::Stats &Picker::GetStats() const
+{
+    return stats;
+}
+
+#endif
@@ -0,0 +1,498 @@
+/**
+    @class Profiler Profiler.h "Engine/Profiler.h"
+    @brief Frame profiler for CPU scopes and GPU timestamps
+    @details Scopes are timed on the CPU with std::chrono and, once EnableGPU() is called, on the GPU with pairs of
+    GL_TIMESTAMP queries. GPU queries are kept in a ring of PROFILER_FRAME_LATENCY frames and read back that many
+    frames later, only if the results are already available, so profiling never stalls the pipeline. Each scope
+    keeps a rolling average over the last PROFILER_WINDOW frames, and a range of frames can be captured to a
+    Chrome trace-event JSON file (chrome://tracing, ui.perfetto.dev). Only scopes on the thread that calls
+    BeginFrame/EndFrame (the thread owning the GL context) are recorded, scopes on other threads are ignored.
+*/
+
+#pragma once
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <glad/glad.h>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef ENGINE_PROFILER
+#define ENGINE_PROFILER 1
+#endif
+
+#define PROFILER_FRAME_LATENCY 4
+#define PROFILER_WINDOW 120
+#define PROFILER_MAX_SCOPES 256 // Scopes never move in memory, so other threads may register while a frame runs
+
+class Profiler
+{
+  struct Event
+  {
+    int scope;
+    double cpuBegin, cpuEnd; // microseconds since profiler creation
+    int gpuQuery;            // index of the begin query in the frame's pool, -1 if not timed on the GPU
+  };
+
+  struct Frame
+  {
+    long long index = -1;
+    std::vector<Event> events;
+    std::vector<GLuint> queries; // begin/end timestamp pairs
+    int queriesUsed = 0;
+  };
+
+  struct Scope
+  {
+    std::string name;
+    double cpuFrame = 0, gpuFrame = 0; // totals of the frame being accumulated
+    double cpuSamples[PROFILER_WINDOW] = {}, gpuSamples[PROFILER_WINDOW] = {};
+    double cpuSum = 0, gpuSum = 0;
+    int cpuCount = 0, gpuCount = 0, cpuNext = 0, gpuNext = 0;
+    int calls = 0;
+  };
+
+  struct TraceEvent
+  {
+    int scope;
+    bool gpu;
+    long long frame;
+    double begin, duration;
+  };
+
+  static Profiler *instancePtr;
+  std::chrono::steady_clock::time_point start;
+  std::vector<Scope> scopes;
+  Frame frames[PROFILER_FRAME_LATENCY];
+  long long frameIndex = 0;
+  bool inFrame = false; // Scopes are only recorded between BeginFrame and EndFrame
+  std::atomic<std::thread::id> frameThread; // and only on the thread that called BeginFrame
+  std::mutex registerLock; // Guards adding scopes, the frame thread iterates a snapshot of the count
+  bool gpu = false;
+  double gpuOffset = 0; // GPU timestamp (us) to CPU timeline (us)
+  int droppedFrames = 0;
+  int reportInterval = 0;
+
+  long long captureStart = -1, captureEnd = -1;
+  std::string capturePath;
+  std::vector<TraceEvent> trace;
+
+  Profiler() : start(std::chrono::steady_clock::now()) { scopes.reserve(PROFILER_MAX_SCOPES); }
+  Frame &current();
+  int registered();
+  void resolveGPU(Frame &frame);
+  static void addSample(double *samples, double &sum, int &count, int &next, double value);
+  bool capturing(long long frame);
+  void writeTrace();
+
+public:
+  Profiler(Profiler &) = delete;
+  void operator=(const Profiler &) = delete;
+
+  static Profiler *getInstance();
+  int Register(const char *name);
+  double Now();
+  void EnableGPU(bool enable = true);
+  void BeginFrame();
+  void EndFrame();
+  int Begin(int scope, bool timeGPU);
+  void End(int event);
+  double AverageCPU(const char *name);
+  double AverageGPU(const char *name);
+  void SetReportInterval(int frames);
+  void Print(std::ostream &out = std::cout);
+  void Capture(int frames, const std::string &path);
+};
+
+/**
+    @brief Times a block from construction to destruction
+    @details Use through the PROFILE_SCOPE / PROFILE_CPU_SCOPE macros which register the name only once.
+*/
+class ProfileScope
+{
+  int event;
+
+public:
+  ProfileScope(int scope, bool timeGPU) { event = Profiler::getInstance()->Begin(scope, timeGPU); }
+  ~ProfileScope() { Profiler::getInstance()->End(event); }
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#if ENGINE_PROFILER
+// Time the enclosing block on the CPU and, when enabled, the GPU
+#define PROFILE_SCOPE(name)                                                                            \
+  static int PROFILE_CONCAT(profileId, __LINE__) = Profiler::getInstance()->Register(name);            \
+  ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(PROFILE_CONCAT(profileId, __LINE__), true)
+// Time the enclosing block on the CPU only
+#define PROFILE_CPU_SCOPE(name)                                                                        \
+  static int PROFILE_CONCAT(profileId, __LINE__) = Profiler::getInstance()->Register(name);            \
+  ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(PROFILE_CONCAT(profileId, __LINE__), false)
+#else
+#define PROFILE_SCOPE(name)
+#define PROFILE_CPU_SCOPE(name)
+#endif
+
+Profiler *Profiler::instancePtr = nullptr;
+
+Profiler *Profiler::getInstance()
+{
+  if (instancePtr == nullptr)
+  {
+    instancePtr = new Profiler();
+  }
+  return instancePtr;
+}
+
+/**
+    @brief Registers a scope name
+    @param name Name shown in reports and traces
+    @returns int, id of the scope, -1 if PROFILER_MAX_SCOPES are already registered
+*/
+int Profiler::Register(const char *name)
+{
+  std::lock_guard<std::mutex> guard(registerLock);
+  for (int i = 0; i < (int)scopes.size(); i++)
+  {
+    if (scopes[i].name == name)
+    {
+      return i;
+    }
+  }
+  if (scopes.size() == PROFILER_MAX_SCOPES)
+  {
+    std::cout << "Profiler: too many scopes, " << name << " is not timed" << std::endl;
+    return -1;
+  }
+  scopes.emplace_back();
+  scopes.back().name = name;
+  return scopes.size() - 1;
+}
+
+/**
+    @brief Number of registered scopes, safe to call while other threads register
+*/
+int Profiler::registered()
+{
+  std::lock_guard<std::mutex> guard(registerLock);
+  return scopes.size();
+}
+
+/**
+    @brief Returns microseconds since the profiler was created
+*/
+double Profiler::Now()
+{
+  return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+}
+
+/**
+    @brief Turns GPU timing on or off
+    @details Needs a current GL context with timer queries (GL 3.3). Aligns GPU timestamps with the CPU clock so
+    both show up on the same trace timeline.
+    @param enable Whether scopes should also be timed on the GPU
+*/
+void Profiler::EnableGPU(bool enable)
+{
+  gpu = enable;
+  if (gpu)
+  {
+    GLint64 timestamp;
+    glGetInteger64v(GL_TIMESTAMP, &timestamp);
+    gpuOffset = Now() - timestamp / 1000.0;
+  }
+}
+
+Profiler::Frame &Profiler::current()
+{
+  return frames[frameIndex % PROFILER_FRAME_LATENCY];
+}
+
+/**
+    @brief Starts a frame
+    @details Reads back the GPU queries of the frame that last used this ring slot, if the GPU is done with them.
+*/
+void Profiler::BeginFrame()
+{
+  Frame &frame = current();
+  if (frame.index >= 0)
+  {
+    resolveGPU(frame);
+  }
+  frame.index = frameIndex;
+  frame.events.clear();
+  frame.queriesUsed = 0;
+  frameThread.store(std::this_thread::get_id(), std::memory_order_relaxed);
+  inFrame = true;
+}
+
+/**
+    @brief Ends a frame
+    @details Adds the frame's CPU totals to the rolling averages, prints a report every SetReportInterval frames
+    and writes the capture file once the captured range is fully resolved.
+*/
+void Profiler::EndFrame()
+{
+  inFrame = false;
+  Frame &frame = current();
+  for (Event &e : frame.events)
+  {
+    scopes[e.scope].cpuFrame += e.cpuEnd - e.cpuBegin;
+    if (capturing(frame.index))
+    {
+      trace.push_back({e.scope, false, frame.index, e.cpuBegin, e.cpuEnd - e.cpuBegin});
+    }
+  }
+  for (int i = 0, count = registered(); i < count; i++)
+  {
+    Scope &scope = scopes[i];
+    if (scope.calls > 0)
+    {
+      addSample(scope.cpuSamples, scope.cpuSum, scope.cpuCount, scope.cpuNext, scope.cpuFrame);
+    }
+    scope.cpuFrame = 0;
+    scope.calls = 0;
+  }
+
+  frameIndex++;
+  if (reportInterval > 0 && frameIndex % reportInterval == 0)
+  {
+    Print();
+  }
+  // GPU results of the last captured frame arrive PROFILER_FRAME_LATENCY frames later
+  if (captureEnd >= 0 && frameIndex > captureEnd + PROFILER_FRAME_LATENCY)
+  {
+    writeTrace();
+  }
+}
+
+/**
+    @brief Reads back a frame's GPU timestamps without waiting
+    @details Checks only the last query issued; if it is not available the whole frame is dropped instead of stalled.
+*/
+void Profiler::resolveGPU(Frame &frame)
+{
+  if (frame.queriesUsed == 0)
+  {
+    return;
+  }
+  GLint available = 0;
+  glGetQueryObjectiv(frame.queries[frame.queriesUsed - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+  if (!available)
+  {
+    droppedFrames++;
+    return;
+  }
+
+  for (Event &e : frame.events)
+  {
+    if (e.gpuQuery < 0)
+    {
+      continue;
+    }
+    GLuint64 begin, end;
+    glGetQueryObjectui64v(frame.queries[e.gpuQuery], GL_QUERY_RESULT, &begin);
+    glGetQueryObjectui64v(frame.queries[e.gpuQuery + 1], GL_QUERY_RESULT, &end);
+    double duration = (end - begin) / 1000.0;
+    scopes[e.scope].gpuFrame += duration;
+    if (capturing(frame.index))
+    {
+      trace.push_back({e.scope, true, frame.index, begin / 1000.0 + gpuOffset, duration});
+    }
+  }
+  for (int i = 0, count = registered(); i < count; i++)
+  {
+    Scope &scope = scopes[i];
+    if (scope.gpuFrame > 0)
+    {
+      addSample(scope.gpuSamples, scope.gpuSum, scope.gpuCount, scope.gpuNext, scope.gpuFrame);
+    }
+    scope.gpuFrame = 0;
+  }
+}
+
+void Profiler::addSample(double *samples, double &sum, int &count, int &next, double value)
+{
+  if (count == PROFILER_WINDOW)
+  {
+    sum -= samples[next];
+  }
+  else
+  {
+    count++;
+  }
+  samples[next] = value;
+  sum += value;
+  next = (next + 1) % PROFILER_WINDOW;
+}
+
+/**
+    @brief Opens an event for a scope
+    @param scope Id returned by Register
+    @param timeGPU Whether to also issue GPU timestamp queries
+    @returns int, the event handle passed to End, -1 outside of a frame or on another thread
+*/
+int Profiler::Begin(int scope, bool timeGPU)
+{
+  if (scope < 0 || std::this_thread::get_id() != frameThread.load(std::memory_order_relaxed) || !inFrame)
+  {
+    return -1;
+  }
+  Frame &frame = current();
+  Event e;
+  e.scope = scope;
+  e.gpuQuery = -1;
+  if (gpu && timeGPU)
+  {
+    if (frame.queriesUsed + 2 > (int)frame.queries.size())
+    {
+      size_t old = frame.queries.size();
+      frame.queries.resize(old + 64);
+      glGenQueries(64, &frame.queries[old]);
+    }
+    e.gpuQuery = frame.queriesUsed;
+    glQueryCounter(frame.queries[frame.queriesUsed], GL_TIMESTAMP);
+    frame.queriesUsed += 2;
+  }
+  scopes[scope].calls++;
+  e.cpuBegin = Now();
+  e.cpuEnd = e.cpuBegin;
+  frame.events.push_back(e);
+  return frame.events.size() - 1;
+}
+
+/**
+    @brief Closes an event opened with Begin
+*/
+void Profiler::End(int event)
+{
+  if (event < 0 || !inFrame)
+  {
+    return;
+  }
+  Frame &frame = current();
+  Event &e = frame.events[event];
+  e.cpuEnd = Now();
+  if (e.gpuQuery >= 0)
+  {
+    glQueryCounter(frame.queries[e.gpuQuery + 1], GL_TIMESTAMP);
+  }
+}
+
+/**
+    @brief Returns the rolling average CPU time per frame of a scope in milliseconds
+*/
+double Profiler::AverageCPU(const char *name)
+{
+  int id = Register(name);
+  if (id < 0)
+  {
+    return 0;
+  }
+  Scope &scope = scopes[id];
+  return scope.cpuCount > 0 ? scope.cpuSum / scope.cpuCount / 1000.0 : 0;
+}
+
+/**
+    @brief Returns the rolling average GPU time per frame of a scope in milliseconds
+*/
+double Profiler::AverageGPU(const char *name)
+{
+  int id = Register(name);
+  if (id < 0)
+  {
+    return 0;
+  }
+  Scope &scope = scopes[id];
+  return scope.gpuCount > 0 ? scope.gpuSum / scope.gpuCount / 1000.0 : 0;
+}
+
+/**
+    @brief Prints the rolling averages every given number of frames (0 turns it off)
+*/
+void Profiler::SetReportInterval(int frames)
+{
+  reportInterval = frames;
+}
+
+/**
+    @brief Prints the rolling per-scope averages
+    @param out Stream to print to
+*/
+void Profiler::Print(std::ostream &out)
+{
+  out << "---- Profiler (avg over " << PROFILER_WINDOW << " frames, ms/frame) ----" << std::endl;
+  for (int i = 0, count = registered(); i < count; i++)
+  {
+    Scope &scope = scopes[i];
+    out << std::left << std::setw(28) << scope.name << std::right << std::fixed << std::setprecision(3)
+        << " cpu " << std::setw(8) << (scope.cpuCount > 0 ? scope.cpuSum / scope.cpuCount / 1000.0 : 0);
+    if (gpu)
+    {
+      out << "  gpu " << std::setw(8) << (scope.gpuCount > 0 ? scope.gpuSum / scope.gpuCount / 1000.0 : 0);
+    }
+    out << std::endl;
+  }
+  if (gpu && droppedFrames > 0)
+  {
+    out << "GPU results dropped for " << droppedFrames << " frames (not ready in time)" << std::endl;
+  }
+  out.unsetf(std::ios_base::floatfield);
+}
+
+/**
+    @brief Captures the next frames to a Chrome trace-event JSON file
+    @details The file is written automatically once the GPU results of the last captured frame are in.
+    @param count Number of frames to capture
+    @param path Output file path
+*/
+void Profiler::Capture(int count, const std::string &path)
+{
+  captureStart = frameIndex;
+  captureEnd = frameIndex + count - 1;
+  capturePath = path;
+  trace.clear();
+}
+
+bool Profiler::capturing(long long frame)
+{
+  return captureEnd >= 0 && frame >= captureStart && frame <= captureEnd;
+}
+
+/**
+    @brief Writes the captured events as Chrome trace-event JSON
+    @details CPU scopes go on thread 1 and GPU scopes on thread 2 of the same process.
+*/
+void Profiler::writeTrace()
+{
+  std::ofstream file(capturePath);
+  if (!file)
+  {
+    std::cout << "Cannot open trace file " << capturePath << std::endl;
+  }
+  else
+  {
+    file << std::fixed << std::setprecision(3) << "{\"traceEvents\":[\n";
+    file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"CPU\"}},\n";
+    file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,\"args\":{\"name\":\"GPU\"}}";
+    for (TraceEvent &e : trace)
+    {
+      file << ",\n{\"name\":\"" << scopes[e.scope].name << "\",\"cat\":\"" << (e.gpu ? "gpu" : "cpu")
+           << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << (e.gpu ? 2 : 1) << ",\"ts\":" << e.begin
+           << ",\"dur\":" << e.duration << ",\"args\":{\"frame\":" << e.frame << "}}";
+    }
+    file << "\n]}\n";
+    std::cout << "Wrote " << trace.size() << " trace events to " << capturePath << std::endl;
+  }
+  captureStart = captureEnd = -1;
+  trace.clear();
+}
+
+#endif
@@ -0,0 +1,184 @@
+/**
+    @class RenderBackend RenderBackend.h "Engine/RenderBackend.h"
+    @brief Renderer that draws frame packets, OpenGL (GlBackend) or the CPU (SoftwareBackend.h)
+    @details A FramePacket is everything one frame needs, built on the simulation thread: the camera, the draw list
+    RenderQueue::Build culled and sorted, a snapshot of the lights and the shadow casters. A backend turns a packet
+    into pixels and reads nothing else of the scene, so the same simulation and RenderQueue feed either renderer.
+    RenderThread draws its packets with a GlBackend unless it is given another backend, tools without a render
+    thread fill a packet themselves (see FramePacket::Reset()) and call Draw() directly.
+*/
+
+#pragma once
+#ifndef RENDERBACKEND_H
+#define RENDERBACKEND_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <vector>
+#include "CascadedShadowMap.h"
+#include "FrameArena.h"
+#include "MeshStreamer.h"
+#include "RenderQueue.h"
+#include "Light.h"
+
+/**
+    @brief Everything a backend needs to draw one frame
+*/
+struct FramePacket
+{
+    long long frame = 0;
+    glm::vec3 viewPos = glm::vec3(0, 0, 0);
+    glm::mat4 view = glm::mat4(1.0f), projection = glm::mat4(1.0f); // Camera of the frame, places the shadow cascades
+    FrameArena arena;                         // Transient allocations of the simulation thread for this frame
+    FrameVector<RenderQueue::DrawItem> draws; // Sorted and culled by RenderQueue::Build, lives in arena
+    OcclusionCuller::Stats occlusion;         // Occlusion culling work of the Build, reported in RenderStats
+    MeshStreamer::Stats streaming;            // Chunks of a streamed mesh this frame, reported in RenderStats
+    std::vector<LightState> lights;           // Copied with LightIndex::snapshot
+    long long lightVersion = -1;              // LightIndex::version the lights were copied at
+    CascadedShadowMap::Casters casters;       // Shadow casters and their world matrices, from CascadedShadowMap::Capture
+    int width = 0, height = 0;                // Viewport size, 0 keeps the current one
+    bool wireframe = false;
+    bool depthPrepass = false; // Draw depth first and shade only the visible fragments (see RenderQueue::Draw)
+
+    // Requests from the simulation thread for things only the render thread may touch
+    bool printProfile = false, printStats = false;
+    int captureFrames = 0;
+    int allocatingFrames = 0; // Frames from this one on that may allocate, the allocation check skips them
+
+    // Filled in by RenderThread
+    double simulationMs = 0, simulationWaitMs = 0;
+
+    void Reset();
+};
+
+/**
+    @brief Empties the packet for the next frame and makes its arena the calling thread's current arena
+    @details The lights and the casters are kept, they are only copied again when their version changed.
+*/
+void FramePacket::Reset()
+{
+    draws = FrameVector<RenderQueue::DrawItem>();
+    occlusion = OcclusionCuller::Stats();
+    streaming = MeshStreamer::Stats();
+    arena.Reset();
+    FrameArena::SetCurrent(&arena);
+    printProfile = printStats = false;
+    captureFrames = allocatingFrames = 0;
+}
+
+class RenderBackend
+{
+public:
+    virtual ~RenderBackend() {}
+
+    /**
+        @brief Draws a packet, on the thread the backend belongs to (the context thread for GL)
+    */
+    virtual void Draw(FramePacket &packet) = 0;
+
+    /**
+        @brief Name of the renderer, for reports
+    */
+    virtual const char *Name() const = 0;
+};
+
+/**
+    @class GlBackend RenderBackend.h "Engine/RenderBackend.h"
+    @brief Draws frame packets with OpenGL into the bound framebuffer
+*/
+class GlBackend : public RenderBackend
+{
+    Shader *depthShader = nullptr;
+    CascadedShadowMap *shadows = nullptr;
+    long long uploadedLights = -1;
+    int viewportWidth = 0, viewportHeight = 0;
+    bool wireframe = false;
+
+public:
+    void Draw(FramePacket &packet) override;
+    const char *Name() const override;
+    void SetDepthShader(Shader *shader);
+    void SetShadows(CascadedShadowMap *shadowMap);
+};
+
+/**
+    @brief Applies a packet's state and draws its draw list
+    @details Sets the viewport and polygon mode when they change, uploads the lights when their version changed
+    and the camera position to every lit program, updates the shadow cascades with the packet's casters when a
+    shadow map is set and the packet has a directional light, then draws the sorted draw list, after a depth pre-pass
+    if the packet asks for one and a depth shader is set.
+*/
+void GlBackend::Draw(FramePacket &packet)
+{
+    if (packet.width > 0 && packet.height > 0 && (packet.width != viewportWidth || packet.height != viewportHeight))
+    {
+        viewportWidth = packet.width;
+        viewportHeight = packet.height;
+        glViewport(0, 0, viewportWidth, viewportHeight);
+    }
+    if (packet.wireframe != wireframe)
+    {
+        wireframe = packet.wireframe;
+        glPolygonMode(GL_FRONT_AND_BACK, wireframe ? GL_LINE : GL_FILL);
+    }
+    if (packet.lightVersion != uploadedLights)
+    {
+        LightIndex::upload(packet.lights);
+        uploadedLights = packet.lightVersion;
+    }
+    for (Shader *s : LightIndex::shaders)
+    {
+        if (s->isReady())
+        {
+            s->use();
+            s->setVec3("viewPos", packet.viewPos);
+        }
+    }
+    if (shadows != nullptr)
+    {
+        for (const LightState &light : packet.lights)
+        {
+            if (light.type == Directional)
+            {
+                // Shadow maps are always filled, whatever the polygon mode of the frame
+                if (wireframe)
+                {
+                    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+                }
+                shadows->Update(packet.view, packet.projection, light.directional.direction, packet.casters);
+                shadows->Bind();
+                if (wireframe)
+                {
+                    glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+                }
+                break;
+            }
+        }
+    }
+    RenderQueue::Draw(packet.draws, packet.depthPrepass ? depthShader : nullptr);
+}
+
+const char *GlBackend::Name() const
+{
+    return "OpenGL";
+}
+
+/**
+    @brief Sets the program of the depth pre-pass, packets ask for the pre-pass with FramePacket::depthPrepass
+*/
+void GlBackend::SetDepthShader(Shader *shader)
+{
+    depthShader = shader;
+}
+
+/**
+    @brief Sets the shadow map updated and bound before every draw list, nullptr for none
+    @details The cascades follow the packet's view and projection and the first directional light of its lights
+    and draw the packet's casters, which the simulation thread fills with CascadedShadowMap::Capture().
+*/
+void GlBackend::SetShadows(CascadedShadowMap *shadowMap)
+{
+    shadows = shadowMap;
+}
+
+#endif
@@ -0,0 +1,328 @@
+/**
+    @class RenderQueue RenderQueue.h "Engine/RenderQueue.h"
+    @brief Builds the frame's draw list on the JobSystem and submits it on the context thread
+    @details Shapes are submitted every frame. Build() computes every shape's ObjectBlock (MVP, world and normal
+    matrices), culls its bounding sphere against the view frustum and fills a draw item with its state key, all in
+    parallel jobs. With an OcclusionCuller set, the visible occluders are then rasterized and the remaining spheres
+    are tested against the hierarchical depth buffer, so shapes hidden behind them are dropped. Shapes split into
+    meshlets get their meshlets culled as well (off screen or facing away), leaving index ranges to draw. It then
+    sorts the visible items by program, material, vertex array and depth (front to back) with
+    JobSystem::ParallelSort. Materials are slots of the MaterialBuffer read through the object block, so the sort
+    only groups draws by material, no state changes with it. Draw()
+    is the only step that touches OpenGL and must run on the thread that owns the context; it uploads the blocks of
+    the whole list in one ObjectBuffer batch before drawing. Given a depth program it first draws the list's depth
+    only (positions, no color writes) and then the color pass with a GL_EQUAL depth test and depth writes off, so the
+    lighting in the fragment shader runs once per pixel instead of once per overlapping fragment. The draw list holds
+    copies of everything it draws with, so it can be handed to a render thread with TakeDrawList(). The per-shape
+    results and the draw list are allocated from the building thread's FrameArena and are only valid until that
+    arena is reset.
+*/
+
+#pragma once
+#ifndef RENDERQUEUE_H
+#define RENDERQUEUE_H
+
+#include <glm/glm.hpp>
+#include <vector>
+#include "JobSystem.h"
+#include "FrameArena.h"
+#include "Frustum.h"
+#include "MaterialBuffer.h"
+#include "Meshlet.h"
+#include "ObjectBlock.h"
+#include "OcclusionCuller.h"
+#include "Shape.h"
+#include "Profiler.h"
+
+class RenderQueue
+{
+public:
+    struct DrawItem
+    {
+        Shape *shape;
+        ObjectBlock block;   // matrices the shape is drawn with
+        const void *program; // program the shape draws with, draws sharing it are kept together
+        int material;        // slot in the MaterialBuffer
+        unsigned int vao;
+        float depth; // view space distance of the bounding sphere center
+        const Meshlets::Range *meshletRanges; // index ranges of the meshlets left after culling, nullptr for all
+        int meshletRangeCount;
+        int meshletsCulled, trianglesCulled;
+    };
+
+private:
+    JobSystem *jobs;
+    std::vector<Shape *> shapes;
+    FrameVector<DrawItem> drawList; // visible items, sorted
+    OcclusionCuller *occlusion = nullptr;
+    FrameVector<Meshlets::Range> meshletRanges; // ranges of every meshlet shape in the draw list
+    int grain;
+
+public:
+    RenderQueue(JobSystem *_jobs, int _grain = 64);
+    void Submit(Shape *shape);
+    void SetOcclusion(OcclusionCuller *culler);
+    void Build(const glm::mat4 &camera, const glm::mat4 &projection);
+    void Draw();
+    static void Draw(const FrameVector<DrawItem> &list, Shader *depthShader = nullptr);
+    static void BeginDepthPrepass(Shader *depthShader);
+    static void BeginColorPass();
+    static void EndColorPass();
+    void TakeDrawList(FrameVector<DrawItem> &list);
+    void Clear();
+    int Submitted() const;
+    int Visible() const;
+    const FrameVector<DrawItem> &DrawList() const;
+};
+
+/**
+    @brief Creates an empty queue
+    @param _jobs Job system the per-shape work is spread over
+    @param _grain Shapes per job
+*/
+RenderQueue::RenderQueue(JobSystem *_jobs, int _grain) : jobs(_jobs), grain(_grain)
+{
+}
+
+/**
+    @brief Adds a shape to the frame
+*/
+void RenderQueue::Submit(Shape *shape)
+{
+    shapes.push_back(shape);
+}
+
+/**
+    @brief Enables occlusion culling in Build()
+    @param culler Culler the shapes with occluders are rendered into, nullptr to only frustum cull
+*/
+void RenderQueue::SetOcclusion(OcclusionCuller *culler)
+{
+    occlusion = culler;
+}
+
+/**
+    @brief Computes the object blocks, culls and sorts the submitted shapes
+    @param camera Camera matrix (the top of the MatrixStack)
+    @param projection Projection the shapes are drawn with
+*/
+void RenderQueue::Build(const glm::mat4 &camera, const glm::mat4 &projection)
+{
+    PROFILE_CPU_SCOPE("RenderQueue::Build");
+    int count = (int)shapes.size();
+    FrameAllocator<DrawItem> allocator(FrameArena::Current());
+    FrameVector<DrawItem> items(count, DrawItem(), allocator);                              // one per shape
+    FrameVector<unsigned char> visible(count, 0, FrameAllocator<unsigned char>(allocator)); // culling results
+    FrameVector<glm::vec4> spheres(count, glm::vec4(0, 0, 0, -1), FrameAllocator<glm::vec4>(allocator)); // world bounds
+    glm::mat4 viewProjection = projection * camera;
+    Frustum frustum(viewProjection);
+    glm::vec3 eye = glm::vec3(glm::inverse(camera)[3]);
+
+    // Room for one range per meshlet, each shape's slice is written by the job that culls it
+    FrameVector<int> firstRange(count, 0, FrameAllocator<int>(allocator));
+    int rangeCount = 0;
+    for (int i = 0; i < count; i++)
+    {
+        firstRange[i] = rangeCount;
+        rangeCount += (int)shapes[i]->GetMeshlets().size();
+    }
+    meshletRanges = FrameVector<Meshlets::Range>(rangeCount, Meshlets::Range(), FrameAllocator<Meshlets::Range>(allocator));
+
+    jobs->ParallelFor(count, grain, [&](int begin, int end)
+                      {
+                          for (int i = begin; i < end; i++)
+                          {
+                              Shape *shape = shapes[i];
+                              const Transform &transform = shape->GetTransform();
+                              DrawItem &item = items[i];
+                              glm::mat4 world = transform.World();
+                              item.shape = shape;
+                              item.material = shape->MaterialIndex();
+                              item.block.Set(viewProjection, world, item.material);
+                              item.program = shape->StateKey();
+                              item.vao = shape->VertexArray();
+
+                              glm::vec3 center;
+                              float radius;
+                              if (!shape->GetBounds(center, radius))
+                              {
+                                  item.depth = 0;
+                                  visible[i] = 1;
+                                  continue;
+                              }
+                              glm::vec3 worldCenter = glm::vec3(world * glm::vec4(center, 1.0f));
+                              float scale = glm::max(glm::length(glm::vec3(world[0])),
+                                                     glm::max(glm::length(glm::vec3(world[1])), glm::length(glm::vec3(world[2]))));
+                              visible[i] = frustum.Intersects(worldCenter, radius * scale);
+                              const std::vector<Meshlets::Meshlet> &meshlets = shape->GetMeshlets();
+                              if (visible[i] && !meshlets.empty())
+                              {
+                                  glm::mat4 inverse;
+                                  SimdMath::affineInverse(&world, &inverse, 1);
+                                  item.meshletRanges = &meshletRanges[firstRange[i]];
+                                  item.meshletRangeCount = Meshlets::Cull(meshlets.data(), (int)meshlets.size(), world, scale, frustum,
+                                                                          glm::vec3(inverse * glm::vec4(eye, 1.0f)),
+                                                                          &meshletRanges[firstRange[i]], item.meshletsCulled,
+                                                                          item.trianglesCulled);
+                              }
+                              if (shape->GetOccluder().empty())
+                              {
+                                  spheres[i] = glm::vec4(worldCenter, radius * scale);
+                              }
+                              item.depth = -(camera * glm::vec4(worldCenter, 1.0f)).z;
+                          } });
+
+    if (occlusion != nullptr)
+    {
+        occlusion->Begin(viewProjection);
+        for (int i = 0; i < count; i++)
+        {
+            if (visible[i] && !shapes[i]->GetOccluder().empty())
+            {
+                occlusion->AddOccluder(shapes[i]->GetOccluder(), items[i].block.model);
+            }
+        }
+        occlusion->Rasterize();
+        occlusion->Cull(count, spheres.data(), visible.data());
+    }
+
+    drawList = FrameVector<DrawItem>(allocator);
+    drawList.reserve(count);
+    for (int i = 0; i < count; i++)
+    {
+        if (visible[i])
+        {
+            drawList.push_back(items[i]);
+        }
+    }
+    jobs->ParallelSort(drawList, [](const DrawItem &a, const DrawItem &b)
+                       {
+                           if (a.program != b.program)
+                               return a.program < b.program;
+                           if (a.material != b.material)
+                               return a.material < b.material;
+                           if (a.vao != b.vao)
+                               return a.vao < b.vao;
+                           return a.depth < b.depth; });
+}
+
+/**
+    @brief Draws the sorted draw list, call on the context thread after Build()
+*/
+void RenderQueue::Draw()
+{
+    Draw(drawList);
+}
+
+/**
+    @brief Draws a draw list built by a RenderQueue, call on the context thread
+    @param list Sorted draw list
+    @param depthShader Program of the depth pre-pass (Depth.vs/Depth.fs), nullptr or not ready yet to draw without one
+*/
+void RenderQueue::Draw(const FrameVector<DrawItem> &list, Shader *depthShader)
+{
+    PROFILE_SCOPE("RenderQueue::Draw");
+    ObjectBuffer *objects = ObjectBuffer::getInstance();
+    objects->Begin((int)list.size());
+    for (int i = 0; i < (int)list.size(); i++)
+    {
+        objects->Set(i, list[i].block);
+    }
+    objects->End();
+    MaterialBuffer::getInstance()->Upload();
+
+    bool prepass = depthShader != nullptr && depthShader->isReady();
+    if (prepass)
+    {
+        PROFILE_SCOPE("RenderQueue::DepthPrepass");
+        BeginDepthPrepass(depthShader);
+        for (int i = 0; i < (int)list.size(); i++)
+        {
+            if (list[i].meshletRanges == nullptr || list[i].meshletRangeCount > 0)
+            {
+                list[i].shape->DrawDepth(i, list[i].meshletRanges, list[i].meshletRangeCount);
+            }
+        }
+        BeginColorPass();
+    }
+    for (int i = 0; i < (int)list.size(); i++)
+    {
+        const DrawItem &item = list[i];
+        RenderStats::frame.meshletsCulled += item.meshletsCulled;
+        RenderStats::frame.meshletTrianglesCulled += item.trianglesCulled;
+        if (item.meshletRanges == nullptr || item.meshletRangeCount > 0)
+        {
+            item.shape->Draw(i, item.meshletRanges, item.meshletRangeCount);
+        }
+    }
+    if (prepass)
+    {
+        EndColorPass();
+    }
+}
+
+/**
+    @brief Binds the depth program and masks color writes, shapes then draw with DrawDepth()
+*/
+void RenderQueue::BeginDepthPrepass(Shader *depthShader)
+{
+    depthShader->use();
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    glDepthMask(GL_TRUE);
+    glDepthFunc(GL_LESS);
+}
+
+/**
+    @brief Switches from the depth pre-pass to the color pass: only the nearest fragments, depth left as it is
+*/
+void RenderQueue::BeginColorPass()
+{
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+    glDepthMask(GL_FALSE);
+    glDepthFunc(GL_EQUAL);
+}
+
+/**
+    @brief Restores the default depth state after the color pass
+*/
+void RenderQueue::EndColorPass()
+{
+    glDepthMask(GL_TRUE);
+    glDepthFunc(GL_LESS);
+}
+
+/**
+    @brief Moves the sorted draw list out of the queue
+    @details The list still lives in the arena it was built in, which must not be reset before it is drawn.
+*/
+void RenderQueue::TakeDrawList(FrameVector<DrawItem> &list)
+{
+    list = std::move(drawList);
+    drawList = FrameVector<DrawItem>();
+}
+
+/**
+    @brief Removes every submitted shape, call once per frame after drawing
+*/
+void RenderQueue::Clear()
+{
+    shapes.clear();
+    drawList.clear();
+}
+
+int RenderQueue::Submitted() const
+{
+    return (int)shapes.size();
+}
+
+int RenderQueue::Visible() const
+{
+    return (int)drawList.size();
+}
+
+const FrameVector<RenderQueue::DrawItem> &RenderQueue::DrawList() const
+{
+    return drawList;
+}
+
+#endif
@@ -0,0 +1,286 @@
+/**
+    @file RenderStats.h
+    @brief Per-frame counters of the work the engine submits to OpenGL
+    @details Shape, VB, VAO, Texture and Shader bump these counters as they issue GL calls. RenderStats::frame holds
+    the frame being recorded and RenderStats::last the previous complete frame, so code can query them directly.
+    endFrame() optionally prints the last frame every N frames. When enableDebugOutput() succeeds, GL_KHR_debug
+    messages of the performance category are collected alongside the counters. With a RenderThread the counters
+    belong to the render thread, which also records how long both threads worked and waited on each other.
+    Built with ENGINE_COUNT_ALLOCATIONS, the global operator new is replaced by one that counts every heap
+    allocation of the process, and expectAllocationFree() turns an allocating frame into an assertion failure.
+*/
+
+#pragma once
+#ifndef RENDERSTATS_H
+#define RENDERSTATS_H
+
+#include <glad/glad.h>
+#include <atomic>
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+
+#ifndef GL_DEBUG_OUTPUT
+#define GL_DEBUG_OUTPUT 0x92E0
+#endif
+#ifndef GL_DEBUG_OUTPUT_SYNCHRONOUS
+#define GL_DEBUG_OUTPUT_SYNCHRONOUS 0x8242
+#endif
+#ifndef GL_DEBUG_TYPE_PERFORMANCE
+#define GL_DEBUG_TYPE_PERFORMANCE 0x8250
+#endif
+#ifndef GL_DONT_CARE
+#define GL_DONT_CARE 0x1100
+#endif
+
+#ifndef ENGINE_COUNT_ALLOCATIONS
+#define ENGINE_COUNT_ALLOCATIONS 0
+#endif
+
+#define RENDERSTATS_MAX_MESSAGES 16
+
+namespace RenderStats
+{
+  struct Counters
+  {
+    long long drawCalls = 0;
+    long long prepassDraws = 0; // Depth-only draws of the depth pre-pass, included in drawCalls
+    long long shadowDraws = 0;  // Draws into shadow cascades, included in drawCalls
+    long long shadowCascadesRendered = 0; // Cascades whose static shapes were drawn this frame
+    long long shadowCascadesReused = 0;   // Cascades kept from an earlier frame
+    long long triangles = 0;
+    long long vertices = 0;
+    long long programSwitches = 0;
+    long long vaoBinds = 0;
+    long long bufferBinds = 0;
+    long long textureBinds = 0;
+    long long uniformCalls = 0;
+    long long bufferBytes = 0;  // Uploaded through VB::UpdateData
+    long long textureBytes = 0; // Uploaded through glTexImage2D
+    long long perfMessages = 0; // GL_KHR_debug performance messages
+    long long heapAllocations = 0; // operator new calls on any thread, only counted with ENGINE_COUNT_ALLOCATIONS
+    long long occluders = 0;       // Occluders rasterized by the OcclusionCuller
+    long long occlusionTested = 0; // Bounding spheres tested against its depth pyramid
+    long long occluded = 0;        // Shapes it found hidden
+    double occlusionMs = 0;        // Time it took (rasterization and tests), on the simulation thread
+    long long meshletsCulled = 0;         // Meshlets of visible shapes dropped off screen or facing away
+    long long meshletTrianglesCulled = 0; // Triangles they hold
+    long long streamedChunks = 0;  // Chunks of a MeshStreamer drawn with their full mesh
+    long long streamedProxies = 0; // Chunks drawn with their proxy while they load
+    long long streamingLoads = 0;  // Chunks queued or loading
+    long long streamedBytes = 0;   // Chunk vertices in memory
+    double simulationMs = 0;     // Time the simulation thread spent building the frame's packet
+    double simulationWaitMs = 0; // Time it waited for a free packet (render thread behind)
+    double renderMs = 0;         // Time the render thread spent drawing the packet
+    double renderWaitMs = 0;     // Time it waited for the packet (simulation thread behind)
+  };
+
+  Counters frame;                    // Frame being recorded
+  Counters last;                     // Last complete frame
+  std::vector<std::string> messages; // Performance messages of the frame being recorded (capped)
+  std::vector<std::string> lastMessages;
+  unsigned int boundProgram = 0;
+  long long frameCount = 0;
+  int printInterval = 0;
+  std::atomic<long long> allocations(0); // Heap allocations since the last endFrame()
+  long long allocationFreeFrom = -1;     // First frame expected not to allocate, -1 for none
+
+  typedef void(APIENTRY *DebugProc)(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length,
+                                    const GLchar *message, const void *userParam);
+  typedef void(APIENTRYP DebugMessageCallbackProc)(DebugProc callback, const void *userParam);
+  typedef void(APIENTRYP DebugMessageControlProc)(GLenum source, GLenum type, GLenum severity, GLsizei count,
+                                                  const GLuint *ids, GLboolean enabled);
+
+  void print(std::ostream &out = std::cout);
+
+  /**
+      @brief Counts a draw call
+      @param vertexCount Number of vertices (or indices) drawn as GL_TRIANGLES
+      @param instances Number of instances drawn
+  */
+  void countDraw(long long vertexCount, long long instances = 1)
+  {
+    frame.drawCalls++;
+    frame.vertices += vertexCount * instances;
+    frame.triangles += vertexCount / 3 * instances;
+  }
+
+  /**
+      @brief Counts a glUseProgram call, only changes of program count as a switch
+  */
+  void countProgram(unsigned int program)
+  {
+    if (program != boundProgram)
+    {
+      frame.programSwitches++;
+      boundProgram = program;
+    }
+  }
+
+  /**
+      @brief Receives GL_KHR_debug messages and keeps the performance ones
+  */
+  void APIENTRY debugCallback(GLenum /*source*/, GLenum type, GLuint /*id*/, GLenum /*severity*/, GLsizei length,
+                              const GLchar *message, const void * /*userParam*/)
+  {
+    if (type != GL_DEBUG_TYPE_PERFORMANCE)
+    {
+      return;
+    }
+    frame.perfMessages++;
+    if (messages.size() < RENDERSTATS_MAX_MESSAGES)
+    {
+      messages.push_back(std::string(message, length > 0 ? length : strlen(message)));
+    }
+  }
+
+  /**
+      @brief Installs the debug callback that collects performance messages
+      @details Needs GL 4.3 or GL_KHR_debug; drivers usually only report messages on debug contexts. Output is
+      synchronous, so the callback runs inside the GL call on the context thread and never races endFrame().
+      @param load GL function loader used to look up the debug entry points
+      @returns bool, whether debug output could be enabled
+  */
+  bool enableDebugOutput(GLADloadproc load)
+  {
+    DebugMessageCallbackProc callback = (DebugMessageCallbackProc)load("glDebugMessageCallback");
+    DebugMessageControlProc control = (DebugMessageControlProc)load("glDebugMessageControl");
+    if (callback == nullptr || control == nullptr)
+    {
+      return false;
+    }
+    glEnable(GL_DEBUG_OUTPUT);
+    glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+    control(GL_DONT_CARE, GL_DONT_CARE, GL_DONT_CARE, 0, nullptr, GL_FALSE);
+    control(GL_DONT_CARE, GL_DEBUG_TYPE_PERFORMANCE, GL_DONT_CARE, 0, nullptr, GL_TRUE);
+    callback(debugCallback, nullptr);
+    return true;
+  }
+
+  /**
+      @brief Prints the counters every given number of frames (0 turns it off)
+  */
+  void setPrintInterval(int frames)
+  {
+    printInterval = frames;
+  }
+
+  /**
+      @brief Asserts that every frame from the given one on makes no heap allocation
+      @details Needs ENGINE_COUNT_ALLOCATIONS, without it nothing is counted. Warm-up frames fill the caches and
+      grow the frame arenas, so the first frame checked should be a few frames in.
+      @param fromFrame First frame checked, -1 stops checking
+  */
+  void expectAllocationFree(long long fromFrame)
+  {
+    allocationFreeFrom = fromFrame;
+  }
+
+  /**
+      @brief Finishes the frame being recorded
+      @details Moves the counters to RenderStats::last and resets them for the next frame.
+  */
+  void endFrame()
+  {
+    frame.heapAllocations = allocations.exchange(0, std::memory_order_relaxed);
+    last = frame;
+    frame = Counters();
+    lastMessages.swap(messages);
+    messages.clear();
+    if (ENGINE_COUNT_ALLOCATIONS && allocationFreeFrom >= 0 && frameCount >= allocationFreeFrom &&
+        last.heapAllocations > 0)
+    {
+      std::cout << "Frame " << frameCount << " made " << last.heapAllocations << " heap allocations" << std::endl;
+      assert(last.heapAllocations == 0);
+    }
+    frameCount++;
+    if (printInterval > 0 && frameCount % printInterval == 0)
+    {
+      print();
+    }
+  }
+
+  /**
+      @brief Prints the counters of the last complete frame
+      @param out Stream to print to
+  */
+  void print(std::ostream &out)
+  {
+    out << "---- Render stats (frame " << frameCount << ") ----" << std::endl
+        << "draw calls " << last.drawCalls << ", triangles " << last.triangles << ", vertices " << last.vertices << std::endl
+        << "program switches " << last.programSwitches << ", VAO binds " << last.vaoBinds
+        << ", buffer binds " << last.bufferBinds << ", texture binds " << last.textureBinds << std::endl
+        << "uniform calls " << last.uniformCalls << ", uploaded " << last.bufferBytes << " buffer bytes, "
+        << last.textureBytes << " texture bytes" << std::endl;
+    if (ENGINE_COUNT_ALLOCATIONS)
+    {
+      out << "heap allocations " << last.heapAllocations << std::endl;
+    }
+    if (last.prepassDraws > 0)
+    {
+      out << "depth pre-pass draws " << last.prepassDraws << std::endl;
+    }
+    if (last.shadowCascadesRendered + last.shadowCascadesReused > 0)
+    {
+      out << "shadow draws " << last.shadowDraws << ", cascades rendered " << last.shadowCascadesRendered
+          << ", reused " << last.shadowCascadesReused << std::endl;
+    }
+    if (last.occluders > 0)
+    {
+      out << "occluders " << last.occluders << ", occluded " << last.occluded << " of " << last.occlusionTested
+          << " tested in " << last.occlusionMs << " ms" << std::endl;
+    }
+    if (last.meshletsCulled > 0)
+    {
+      out << "meshlets culled " << last.meshletsCulled << ", " << last.meshletTrianglesCulled << " triangles" << std::endl;
+    }
+    if (last.streamedChunks + last.streamedProxies + last.streamingLoads > 0)
+    {
+      out << "streamed chunks " << last.streamedChunks << ", proxies " << last.streamedProxies << ", loading "
+          << last.streamingLoads << ", " << last.streamedBytes << " bytes resident" << std::endl;
+    }
+    if (last.renderMs > 0)
+    {
+      out << "simulation thread " << last.simulationMs << " ms (waited " << last.simulationWaitMs << " ms), render thread "
+          << last.renderMs << " ms (waited " << last.renderWaitMs << " ms)" << std::endl;
+    }
+    if (last.perfMessages > 0)
+    {
+      out << last.perfMessages << " GL performance messages:" << std::endl;
+      for (const std::string &message : lastMessages)
+      {
+        out << "  " << message << std::endl;
+      }
+    }
+  }
+}
+
+#if ENGINE_COUNT_ALLOCATIONS
+// Counting replacements of the global allocation functions, the array and nothrow forms forward to these
+void *operator new(size_t size)
+{
+  RenderStats::allocations.fetch_add(1, std::memory_order_relaxed);
+  void *p = malloc(size > 0 ? size : 1);
+  if (p == nullptr)
+  {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+void operator delete(void *p) noexcept
+{
+  free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+  free(p);
+}
+#endif
+
+#endif
@@ -0,0 +1,203 @@
+/**
+    @class RenderTarget RenderTarget.h "Engine/RenderTarget.h"
+    @brief Offscreen framebuffer with a color texture and a depth buffer, optionally multisampled
+    @details Without samples the target is one framebuffer object holding an RGBA8 color texture and a 24 bit
+    depth, 8 bit stencil renderbuffer. With samples the scene is drawn into multisampled renderbuffers and Resolve()
+    blits them into the color texture, which is what ColorTexture() and ReadFramebuffer() return in both cases, so
+    readers never see the multisampled attachments. Headless contexts have no default framebuffer, everything is
+    drawn into one of these. Only uses GL 3.0 entry points and runs on the context thread.
+*/
+
+#pragma once
+#ifndef RENDERTARGET_H
+#define RENDERTARGET_H
+
+#include <glad/glad.h>
+#include <algorithm>
+#include <iostream>
+
+class RenderTarget
+{
+    int width, height;
+    int samples; // 0 when not multisampled
+    unsigned int fbo = 0, colorTexture = 0, depthBuffer = 0; // Single sampled, the resolve target with samples
+    unsigned int msaaFbo = 0, msaaColor = 0, msaaDepth = 0;  // Multisampled attachments, 0 without samples
+    bool valid = false;
+
+    bool checkComplete(const char *which);
+
+public:
+    RenderTarget(int width, int height, int samples = 0, bool depth = true);
+    ~RenderTarget();
+    RenderTarget(const RenderTarget &) = delete;
+    void operator=(const RenderTarget &) = delete;
+
+    bool Valid() const;
+    int Width() const;
+    int Height() const;
+    int Samples() const;
+    void Bind();
+    void Resolve();
+    unsigned int ReadFramebuffer() const;
+    unsigned int ColorTexture() const;
+};
+
+/**
+    @brief Creates the framebuffers and their attachments
+    @details Prints an error and leaves the target invalid when the driver rejects the combination.
+    @param width Width in pixels
+    @param height Height in pixels
+    @param samples MSAA samples, 0 or 1 for none, clamped to GL_MAX_SAMPLES
+    @param depth Whether the scene is drawn with a depth (and stencil) buffer
+*/
+RenderTarget::RenderTarget(int width, int height, int samples, bool depth) : width(width), height(height)
+{
+    GLint maxSamples = 0;
+    glGetIntegerv(GL_MAX_SAMPLES, &maxSamples);
+    this->samples = samples > 1 ? std::min(samples, (int)maxSamples) : 0;
+
+    glGenTextures(1, &colorTexture);
+    glBindTexture(GL_TEXTURE_2D, colorTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glGenFramebuffers(1, &fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colorTexture, 0);
+    if (depth && this->samples == 0)
+    {
+        glGenRenderbuffers(1, &depthBuffer);
+        glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+    }
+    valid = checkComplete("Offscreen");
+
+    if (this->samples > 0)
+    {
+        glGenFramebuffers(1, &msaaFbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, msaaFbo);
+        glGenRenderbuffers(1, &msaaColor);
+        glBindRenderbuffer(GL_RENDERBUFFER, msaaColor);
+        glRenderbufferStorageMultisample(GL_RENDERBUFFER, this->samples, GL_RGBA8, width, height);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, msaaColor);
+        if (depth)
+        {
+            glGenRenderbuffers(1, &msaaDepth);
+            glBindRenderbuffer(GL_RENDERBUFFER, msaaDepth);
+            glRenderbufferStorageMultisample(GL_RENDERBUFFER, this->samples, GL_DEPTH24_STENCIL8, width, height);
+            glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, msaaDepth);
+        }
+        valid = valid && checkComplete("Multisampled");
+    }
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+/**
+    @brief Deletes the framebuffers and their attachments
+*/
+RenderTarget::~RenderTarget()
+{
+    glDeleteFramebuffers(1, &fbo);
+    glDeleteTextures(1, &colorTexture);
+    glDeleteRenderbuffers(1, &depthBuffer);
+    if (msaaFbo != 0)
+    {
+        glDeleteFramebuffers(1, &msaaFbo);
+        glDeleteRenderbuffers(1, &msaaColor);
+        glDeleteRenderbuffers(1, &msaaDepth);
+    }
+}
+
+/**
+    @brief Prints which framebuffer is incomplete, expects it bound to GL_FRAMEBUFFER
+    @returns bool, whether it is complete
+*/
+bool RenderTarget::checkComplete(const char *which)
+{
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    if (status != GL_FRAMEBUFFER_COMPLETE)
+    {
+        std::cout << which << " framebuffer is incomplete (0x" << std::hex << status << std::dec << ")" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+/**
+    @brief Whether every framebuffer of the target is complete
+*/
+bool RenderTarget::Valid() const
+{
+    return valid;
+}
+
+/**
+    @brief Width in pixels
+*/
+int RenderTarget::Width() const
+{
+    return width;
+}
+
+/**
+    @brief Height in pixels
+*/
+int RenderTarget::Height() const
+{
+    return height;
+}
+
+/**
+    @brief Samples per pixel of the drawn framebuffer, 0 when not multisampled
+*/
+int RenderTarget::Samples() const
+{
+    return samples;
+}
+
+/**
+    @brief Binds the framebuffer to draw into and sets the viewport to cover it
+*/
+void RenderTarget::Bind()
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, samples > 0 ? msaaFbo : fbo);
+    glViewport(0, 0, width, height);
+}
+
+/**
+    @brief Resolves the multisampled color into the color texture, does nothing without samples
+    @details Leaves the target bound for drawing.
+*/
+void RenderTarget::Resolve()
+{
+    if (samples == 0)
+    {
+        return;
+    }
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, msaaFbo);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo);
+    glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_FRAMEBUFFER, msaaFbo);
+}
+
+/**
+    @brief Framebuffer holding the (resolved) color, to bind as GL_READ_FRAMEBUFFER for glReadPixels
+*/
+unsigned int RenderTarget::ReadFramebuffer() const
+{
+    return fbo;
+}
+
+/**
+    @brief Texture holding the (resolved) color
+*/
+unsigned int RenderTarget::ColorTexture() const
+{
+    return colorTexture;
+}
+
+#endif
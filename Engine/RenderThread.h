@@ -0,0 +1,251 @@
+/**
+    @class RenderThread RenderThread.h "Engine/RenderThread.h"
+    @brief Render thread that owns the GL context and draws frame packets built by the simulation thread
+    @details The simulation thread fills a FramePacket (camera, sorted draw list, light snapshot, viewport) and
+    submits it; the render thread draws it while the simulation builds the next one. Packets come from a ring of
+    latency + 1 entries, so Acquire() blocks once the simulation is latency frames ahead: a latency of 1 double
+    buffers the packets and overlaps the two threads at the cost of one frame of input latency, a latency of 0
+    runs them in lockstep. Packets only hold copies, nothing the render thread reads is touched by the simulation
+    while it draws. Every packet owns a FrameArena that Acquire() resets and makes the simulation thread's current
+    arena, so the draw list and anything else built for the frame live until the packet is reused; the render
+    thread has an arena of its own that is reset after every packet. Packets are drawn with a GlBackend unless
+    SetBackend() picks another RenderBackend, e.g. a SoftwareBackend. The render thread records the time both
+    threads worked and waited in RenderStats and calls RenderStats::endFrame() after every packet.
+*/
+
+#pragma once
+#ifndef RENDERTHREAD_H
+#define RENDERTHREAD_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "CascadedShadowMap.h"
+#include "FrameArena.h"
+#include "RenderBackend.h"
+#include "RenderStats.h"
+
+#define RENDERTHREAD_MAX_LATENCY 3
+
+class RenderThread
+{
+  FramePacket packets[RENDERTHREAD_MAX_LATENCY + 1];
+  int packetCount; // latency + 1 packets used as a ring
+  int writeIndex = 0, readIndex = 0;
+  int queued = 0;   // Packets submitted and not drawn yet
+  int inFlight = 0; // Packets acquired or submitted and not yet released by the render thread
+  std::mutex lock;
+  std::condition_variable changed;
+  std::thread thread;
+  bool running = false;
+  long long frames = 0;
+  std::chrono::steady_clock::time_point acquired;
+
+  // Render thread state
+  FrameArena arena;
+  GlBackend gl;
+  RenderBackend *backend = &gl;
+
+  static double msSince(std::chrono::steady_clock::time_point start);
+  void loop(std::function<void()> init, std::function<void(FramePacket &)> render, std::function<void()> shutdown);
+
+public:
+  RenderThread(int latency = 1);
+  ~RenderThread();
+  RenderThread(const RenderThread &) = delete;
+  void operator=(const RenderThread &) = delete;
+
+  void Start(std::function<void()> init, std::function<void(FramePacket &)> render, std::function<void()> shutdown);
+  void Stop();
+  FramePacket *Acquire();
+  void Submit(FramePacket *packet);
+  void Draw(FramePacket &packet);
+  void SetDepthShader(Shader *shader);
+  void SetShadows(CascadedShadowMap *shadowMap);
+  void SetBackend(RenderBackend *renderer);
+  int Latency() const;
+};
+
+/**
+    @brief Creates the packet ring
+    @param latency Frames the simulation may run ahead of the render thread (0 to RENDERTHREAD_MAX_LATENCY)
+*/
+RenderThread::RenderThread(int latency)
+{
+  latency = glm::clamp(latency, 0, RENDERTHREAD_MAX_LATENCY);
+  packetCount = latency + 1;
+}
+
+RenderThread::~RenderThread()
+{
+  Stop();
+}
+
+/**
+    @brief Starts the render thread
+    @param init Runs first on the render thread, typically makes the GL context current there
+    @param render Draws one packet (clear, RenderThread::Draw, swap), runs on the render thread
+    @param shutdown Runs last on the render thread, typically releases the context
+*/
+void RenderThread::Start(std::function<void()> init, std::function<void(FramePacket &)> render, std::function<void()> shutdown)
+{
+  running = true;
+  thread = std::thread(&RenderThread::loop, this, init, render, shutdown);
+}
+
+/**
+    @brief Draws the packets already submitted, then stops and joins the render thread
+*/
+void RenderThread::Stop()
+{
+  if (!thread.joinable())
+  {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    running = false;
+  }
+  changed.notify_all();
+  thread.join();
+}
+
+/**
+    @brief Returns a free packet to fill, blocking while the render thread is latency frames behind
+    @details Call on the simulation thread once per frame, then fill the packet and Submit() it. The packet's
+    arena becomes the calling thread's current arena until the next Acquire().
+*/
+FramePacket *RenderThread::Acquire()
+{
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  std::unique_lock<std::mutex> guard(lock);
+  changed.wait(guard, [this]()
+               { return inFlight < packetCount; });
+  inFlight++;
+  FramePacket *packet = &packets[writeIndex];
+  writeIndex = (writeIndex + 1) % packetCount;
+  guard.unlock();
+
+  packet->Reset();
+  packet->simulationWaitMs = msSince(start);
+  acquired = std::chrono::steady_clock::now();
+  packet->frame = frames++;
+  return packet;
+}
+
+/**
+    @brief Hands a filled packet to the render thread
+*/
+void RenderThread::Submit(FramePacket *packet)
+{
+  packet->simulationMs = msSince(acquired);
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    queued++;
+  }
+  changed.notify_all();
+}
+
+/**
+    @brief Draws a packet with the backend, call from the render callback
+*/
+void RenderThread::Draw(FramePacket &packet)
+{
+  backend->Draw(packet);
+}
+
+/**
+    @brief Sets the program of the GL backend's depth pre-pass, packets ask for it with FramePacket::depthPrepass
+    @details Call before Start(), the shader is only used on the render thread.
+*/
+void RenderThread::SetDepthShader(Shader *shader)
+{
+  gl.SetDepthShader(shader);
+}
+
+/**
+    @brief Sets the shadow map the GL backend updates and binds before every draw list, nullptr for none
+    @details Call before Start(), the shadow map is only drawn on the render thread (see GlBackend::SetShadows).
+*/
+void RenderThread::SetShadows(CascadedShadowMap *shadowMap)
+{
+  gl.SetShadows(shadowMap);
+}
+
+/**
+    @brief Draws the packets with another backend, nullptr for the GL backend
+    @details Call before Start() or from its init callback, the backend is only used on the render thread.
+*/
+void RenderThread::SetBackend(RenderBackend *renderer)
+{
+  backend = renderer != nullptr ? renderer : &gl;
+}
+
+/**
+    @brief Frames the simulation may run ahead of the render thread
+*/
+int RenderThread::Latency() const
+{
+  return packetCount - 1;
+}
+
+double RenderThread::msSince(std::chrono::steady_clock::time_point start)
+{
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+/**
+    @brief Render thread body: waits for packets and draws them in order
+*/
+void RenderThread::loop(std::function<void()> init, std::function<void(FramePacket &)> render, std::function<void()> shutdown)
+{
+  init();
+  FrameArena::SetCurrent(&arena);
+  while (true)
+  {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::unique_lock<std::mutex> guard(lock);
+    changed.wait(guard, [this]()
+                 { return queued > 0 || !running; });
+    if (queued == 0) // Stopped and every packet is drawn
+    {
+      break;
+    }
+    FramePacket &packet = packets[readIndex];
+    guard.unlock();
+
+    double waited = msSince(start);
+    start = std::chrono::steady_clock::now();
+    render(packet);
+    RenderStats::frame.renderMs = msSince(start);
+    RenderStats::frame.renderWaitMs = waited;
+    RenderStats::frame.simulationMs = packet.simulationMs;
+    RenderStats::frame.simulationWaitMs = packet.simulationWaitMs;
+    RenderStats::frame.occluders = packet.occlusion.occluders;
+    RenderStats::frame.occlusionTested = packet.occlusion.tested;
+    RenderStats::frame.occluded = packet.occlusion.occluded;
+    RenderStats::frame.occlusionMs = packet.occlusion.rasterMs + packet.occlusion.testMs;
+    RenderStats::frame.streamedChunks = packet.streaming.resident;
+    RenderStats::frame.streamedProxies = packet.streaming.proxies;
+    RenderStats::frame.streamingLoads = packet.streaming.inFlight;
+    RenderStats::frame.streamedBytes = packet.streaming.bytes;
+    RenderStats::endFrame();
+    arena.Reset();
+
+    guard.lock();
+    readIndex = (readIndex + 1) % packetCount;
+    queued--;
+    inFlight--;
+    guard.unlock();
+    changed.notify_all();
+  }
+  FrameArena::SetCurrent(nullptr);
+  shutdown();
+}
+
+#endif
@@ -0,0 +1,520 @@
+/**
+    @class Scene Scene.h "Engine/Scene.h"
+    @brief Builds the shapes, materials and lights of a scene file, loading its assets in parallel
+    @details Load() runs in three timed phases. Parse reads the scene file (see SceneFile.h, text or binary) and
+    collects every file it references, each once. Load reads and decodes all of them at the same time on the
+    JobSystem: OBJ meshes are parsed (and welded and split into meshlets where asked) and get the BVH their shapes
+    are picked with (Picker.h), images are decoded with stb_image, lightmaps as HDR images. Upload then runs on the
+    context thread alone and turns the decoded data into textures, Shapes and Lights in one batch, so no GL call
+    waits on a file; the cube marking each point light is one of the assets too. Objects with a lightmap get its
+    coordinates generated again from their triangle count (Lightmap.h). After KeepMeshes() the triangles of every
+    shape and marker stay on the CPU as well, for renderers that cannot read them back from GL (SoftwareBackend).
+    The Scene owns everything it creates.
+*/
+
+#pragma once
+#ifndef SCENE_H
+#define SCENE_H
+
+#include <glad/glad.h>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+#include "Bvh.h"
+#include "JobSystem.h"
+#include "Light.h"
+#include "Lightmap.h"
+#include "Material.h"
+#include "Meshlet.h"
+#include "ObjLoader.h"
+#include "SceneFile.h"
+#include "Shader.h"
+#include "ShaderVariants.h"
+#include "Shape.h"
+#include "Texture.h"
+
+class Scene
+{
+public:
+    struct Timings
+    {
+        double parseMs = 0;  // Reading the scene file and collecting its assets
+        double loadMs = 0;   // Reading and decoding the assets in parallel
+        double uploadMs = 0; // Creating textures, shapes and lights on the context thread
+        double totalMs = 0;
+        int files = 0;       // Distinct asset files loaded
+        long long bytes = 0; // Decoded vertex and pixel data
+        int threads = 1;     // Threads the load phase ran on
+    };
+
+private:
+    enum AssetKind
+    {
+        MeshAsset,     // Expanded triangle list
+        MeshletAsset,  // Welded and split into meshlets
+        OccluderAsset, // Positions only
+        ImageAsset,
+        LightmapAsset, // HDR image, kept as floats
+        MarkerAsset    // Expanded triangle list drawn at point lights, not pickable
+    };
+
+    struct Asset
+    {
+        AssetKind kind;
+        std::string path;
+        bool loaded = false;
+        std::vector<Vertex> vertices;
+        std::vector<uint32_t> meshletIndices;
+        std::vector<Meshlets::Meshlet> meshlets;
+        std::vector<vec3> positions;
+        unsigned char *pixels = nullptr;
+        float *hdrPixels = nullptr;
+        int width = 0, height = 0, channels = 0;
+        Bvh *pickMesh = nullptr; // Meshes only, shared by the shapes drawing them
+    };
+
+    std::vector<Shape *> shapes;
+    std::vector<Texture *> textures;
+    std::vector<Material *> materials;
+    DirectionalLight *sun = nullptr;
+    std::vector<PointLight *> pointLights;
+    std::vector<Light *> lights;
+    std::vector<Bvh *> pickMeshes;
+    bool keepMeshes = false;
+    std::vector<std::vector<Vertex>> meshes;                // Triangle lists of the mesh assets, when kept
+    std::vector<std::pair<const Shape *, int>> shapeMeshes; // Shape or marker and its entry in meshes
+    Timings timings;
+
+    static int findAsset(std::vector<Asset> &assets, AssetKind kind, const std::string &path);
+    static void loadAsset(Asset &asset);
+
+public:
+    Scene() {}
+    ~Scene();
+    Scene(const Scene &) = delete;
+    void operator=(const Scene &) = delete;
+
+    void KeepMeshes();
+    bool Load(const std::string &path, Shader *lightShader, JobSystem *jobs = nullptr);
+    const std::vector<Shape *> &GetShapes() const;
+    const std::vector<Vertex> *GetMesh(const Shape *shape) const;
+    const std::vector<Light *> &GetLights() const;
+    void SetShader(ShaderVariants *variants);
+    const Timings &GetTimings() const;
+    void PrintTimings(std::ostream &out = std::cout) const;
+};
+
+/**
+    @brief Deletes every light, shape, texture and material of the scene
+*/
+Scene::~Scene()
+{
+    for (Light *light : lights)
+    {
+        delete light;
+    }
+    for (PointLight *pl : pointLights)
+    {
+        delete pl;
+    }
+    delete sun;
+    for (Shape *shape : shapes)
+    {
+        delete shape;
+    }
+    for (Texture *texture : textures)
+    {
+        delete texture;
+    }
+    for (Material *material : materials)
+    {
+        delete material;
+    }
+    for (Bvh *bvh : pickMeshes)
+    {
+        delete bvh;
+    }
+}
+
+/**
+    @brief Returns the asset of a kind and path, adding it when it is new
+    @returns int, index of the asset
+*/
+int Scene::findAsset(std::vector<Asset> &assets, AssetKind kind, const std::string &path)
+{
+    for (size_t i = 0; i < assets.size(); i++)
+    {
+        if (assets[i].kind == kind && assets[i].path == path)
+        {
+            return (int)i;
+        }
+    }
+    Asset asset;
+    asset.kind = kind;
+    asset.path = path;
+    assets.push_back(asset);
+    return (int)assets.size() - 1;
+}
+
+/**
+    @brief Reads and decodes one asset, runs on any thread and makes no GL call
+*/
+void Scene::loadAsset(Asset &asset)
+{
+    if (asset.kind == ImageAsset || asset.kind == LightmapAsset)
+    {
+        if (asset.kind == LightmapAsset)
+        {
+            asset.hdrPixels = stbi_loadf(asset.path.c_str(), &asset.width, &asset.height, &asset.channels, 0);
+        }
+        else
+        {
+            asset.pixels = stbi_load(asset.path.c_str(), &asset.width, &asset.height, &asset.channels, 0);
+        }
+        asset.loaded = asset.pixels != nullptr || asset.hdrPixels != nullptr;
+        if (!asset.loaded)
+        {
+            std::cout << "Failed to load texture: " << asset.path << std::endl;
+        }
+        return;
+    }
+    std::vector<Vertex> expanded;
+    if (!ObjLoader::Load(asset.path, expanded) || expanded.empty())
+    {
+        return;
+    }
+    std::vector<vec3> positions;
+    if (asset.kind == MeshletAsset)
+    {
+        std::vector<uint32_t> indices;
+        Meshlets::Weld(expanded, asset.vertices, indices);
+        Meshlets::Build(asset.vertices, indices, asset.meshlets, asset.meshletIndices);
+        positions.reserve(asset.vertices.size());
+        for (const Vertex &v : asset.vertices)
+        {
+            positions.push_back(v.position);
+        }
+        asset.pickMesh = new Bvh();
+        asset.pickMesh->Build(positions, asset.meshletIndices);
+    }
+    else if (asset.kind == OccluderAsset)
+    {
+        asset.positions.reserve(expanded.size());
+        for (const Vertex &v : expanded)
+        {
+            asset.positions.push_back(v.position);
+        }
+    }
+    else if (asset.kind == MarkerAsset)
+    {
+        asset.vertices.swap(expanded);
+    }
+    else
+    {
+        asset.vertices.swap(expanded);
+        positions.reserve(asset.vertices.size());
+        for (const Vertex &v : asset.vertices)
+        {
+            positions.push_back(v.position);
+        }
+        asset.pickMesh = new Bvh();
+        asset.pickMesh->Build(positions);
+    }
+    asset.loaded = true;
+}
+
+/**
+    @brief Keeps the triangles of every shape and light marker of the next Load() on the CPU, see GetMesh()
+*/
+void Scene::KeepMeshes()
+{
+    keepMeshes = true;
+}
+
+/**
+    @brief Loads a scene file and builds its shapes and lights
+    @details Must be called on the context thread, once per Scene. Prints the failing file when an asset cannot be
+    loaded.
+    @param path Scene file, text or binary
+    @param lightShader Program the lights are registered with and their markers are drawn with, as with Light
+    @param jobs Job system the assets load on, null to load them one after the other
+    @returns bool, whether the scene and every asset it references could be loaded
+*/
+bool Scene::Load(const std::string &path, Shader *lightShader, JobSystem *jobs)
+{
+    auto start = std::chrono::steady_clock::now();
+    auto elapsed = [](std::chrono::steady_clock::time_point since)
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - since).count();
+    };
+
+    // Parse: the description, and every file it references once
+    SceneFile::Description description;
+    if (!SceneFile::Read(path, description))
+    {
+        return false;
+    }
+    std::vector<Asset> assets;
+    std::vector<int> meshAssets, occluderAssets, textureAssets;
+    for (const SceneFile::MeshEntry &mesh : description.meshes)
+    {
+        meshAssets.push_back(findAsset(assets, mesh.meshlets ? MeshletAsset : MeshAsset, mesh.path));
+        occluderAssets.push_back(mesh.occluderPath.empty() ? -1 : findAsset(assets, OccluderAsset, mesh.occluderPath));
+    }
+    // The baker bakes every light of the scene file, so once an object has a lightmap they all are in it
+    std::vector<bool> lightmaps(description.textures.size(), false);
+    bool baked = false;
+    for (const SceneFile::ObjectRecord &object : description.objects)
+    {
+        if (object.lightmap >= 0)
+        {
+            lightmaps[object.lightmap] = true;
+            baked = true;
+        }
+    }
+    for (size_t i = 0; i < description.textures.size(); i++)
+    {
+        textureAssets.push_back(findAsset(assets, lightmaps[i] ? LightmapAsset : ImageAsset, description.textures[i].path));
+    }
+    int markerAsset = description.pointLights.empty() ? -1 : findAsset(assets, MarkerAsset, "../Resources/Models/cube.obj");
+    timings.parseMs = elapsed(start);
+
+    // Load: every file at once, stb_image's flip setting is global so it is set before the jobs start
+    auto phase = std::chrono::steady_clock::now();
+    stbi_set_flip_vertically_on_load(true);
+    if (jobs != nullptr)
+    {
+        jobs->ParallelFor((int)assets.size(), 1, [&assets](int begin, int end)
+                          {
+                              for (int i = begin; i < end; i++)
+                              {
+                                  loadAsset(assets[i]);
+                              } });
+    }
+    else
+    {
+        for (Asset &asset : assets)
+        {
+            loadAsset(asset);
+        }
+    }
+    timings.loadMs = elapsed(phase);
+    timings.threads = jobs != nullptr ? jobs->Threads() : 1;
+    timings.files = (int)assets.size();
+    bool loaded = true;
+    for (const Asset &asset : assets)
+    {
+        loaded = loaded && asset.loaded;
+        long long pixelSize = asset.kind == LightmapAsset ? sizeof(float) : 1;
+        timings.bytes += (asset.vertices.size() * sizeof(Vertex) + asset.meshletIndices.size() * sizeof(uint32_t) +
+                          asset.positions.size() * sizeof(vec3) + (long long)asset.width * asset.height * asset.channels * pixelSize);
+    }
+
+    // The triangle list of a mesh asset, copied once however many shapes draw it
+    std::vector<int> keptAssets(assets.size(), -1);
+    meshes.reserve(assets.size());
+    auto keep = [&](const Shape *shape, int asset)
+    {
+        if (keptAssets[asset] < 0)
+        {
+            const Asset &mesh = assets[asset];
+            meshes.push_back(std::vector<Vertex>());
+            if (mesh.kind == MeshletAsset)
+            {
+                for (uint32_t index : mesh.meshletIndices)
+                {
+                    meshes.back().push_back(mesh.vertices[index]);
+                }
+            }
+            else
+            {
+                meshes.back() = mesh.vertices;
+            }
+            keptAssets[asset] = (int)meshes.size() - 1;
+        }
+        shapeMeshes.push_back(std::make_pair(shape, keptAssets[asset]));
+    };
+
+    // Upload: GL objects in one batch on this thread
+    phase = std::chrono::steady_clock::now();
+    if (loaded)
+    {
+        for (int asset : textureAssets)
+        {
+            Texture *texture = new Texture(GL_TEXTURE_2D);
+            if (assets[asset].kind == LightmapAsset)
+            {
+                texture->LoadTexture(assets[asset].hdrPixels, assets[asset].width, assets[asset].height, assets[asset].channels);
+            }
+            else
+            {
+                texture->LoadTexture(assets[asset].pixels, assets[asset].width, assets[asset].height, assets[asset].channels);
+            }
+            textures.push_back(texture);
+        }
+        for (const SceneFile::MaterialEntry &entry : description.materials)
+        {
+            materials.push_back(new Material(entry.ambient, entry.diffuse, entry.specular, entry.shininess));
+        }
+        for (const SceneFile::ObjectRecord &object : description.objects)
+        {
+            const Asset &mesh = assets[meshAssets[object.mesh]];
+            Shape *shape;
+            if (mesh.kind == MeshletAsset)
+            {
+                shape = new Shape(GL_STATIC_DRAW, std::vector<Vertex>());
+                shape->SetMeshlets(mesh.vertices, mesh.meshletIndices, mesh.meshlets);
+            }
+            else
+            {
+                shape = new Shape(GL_STATIC_DRAW, mesh.vertices);
+            }
+            shape->SetPickMesh(mesh.pickMesh);
+            if (occluderAssets[object.mesh] >= 0)
+            {
+                shape->SetOccluder(assets[occluderAssets[object.mesh]].positions);
+            }
+            if (object.material >= 0)
+            {
+                shape->SetMaterial(materials[object.material]);
+            }
+            if (object.texture >= 0)
+            {
+                shape->SetTexture(*textures[object.texture]);
+            }
+            if (object.lightmap >= 0 && mesh.kind == MeshletAsset)
+            {
+                std::cout << "Lightmaps need a mesh without meshlets: " << mesh.path << std::endl;
+            }
+            else if (object.lightmap >= 0)
+            {
+                std::vector<vec2> coords;
+                Lightmaps::PackTriangles((int)mesh.vertices.size() / 3, assets[textureAssets[object.lightmap]].width, coords);
+                shape->SetLightmap(textures[object.lightmap], coords);
+            }
+            Transform transform;
+            transform.Translate(object.position);
+            if (object.rotation != 0)
+            {
+                transform.Rotate(glm::radians(object.rotation), object.rotationAxis);
+            }
+            transform.Scale(object.scale);
+            shape->SetTransform(transform);
+            shape->SetShader(lightShader);
+            shapes.push_back(shape);
+            if (keepMeshes)
+            {
+                keep(shape, meshAssets[object.mesh]);
+            }
+        }
+        if (description.sun.enabled)
+        {
+            sun = new DirectionalLight();
+            sun->direction = description.sun.direction;
+            sun->ambient = description.sun.ambient;
+            sun->diffuse = description.sun.diffuse;
+            sun->specular = description.sun.specular;
+            sun->baked = baked;
+            lights.push_back(new Light(sun, lightShader, std::vector<Vertex>()));
+        }
+        for (const SceneFile::PointLightRecord &record : description.pointLights)
+        {
+            PointLight *pl = new PointLight();
+            pl->position = record.position;
+            pl->ambient = record.ambient;
+            pl->diffuse = record.diffuse;
+            pl->specular = record.specular;
+            pl->constant = record.constant;
+            pl->linear = record.linear;
+            pl->quadratic = record.quadratic;
+            pl->baked = baked;
+            pointLights.push_back(pl);
+            lights.push_back(new Light(pl, lightShader, assets[markerAsset].vertices));
+            if (keepMeshes && lights.back()->GetMesh() != nullptr)
+            {
+                keep(lights.back()->GetMesh(), markerAsset);
+            }
+        }
+    }
+    for (Asset &asset : assets)
+    {
+        stbi_image_free(asset.pixels);
+        stbi_image_free(asset.hdrPixels);
+        if (asset.pickMesh != nullptr)
+        {
+            pickMeshes.push_back(asset.pickMesh);
+        }
+    }
+    timings.uploadMs = elapsed(phase);
+    timings.totalMs = elapsed(start);
+    return loaded;
+}
+
+/**
+    @brief Shapes of the scene's objects, in file order
+*/
+const std::vector<Shape *> &Scene::GetShapes() const
+{
+    return shapes;
+}
+
+/**
+    @brief Expanded triangle list a shape or light marker of the scene draws, in object space
+    @details Shapes drawing the same mesh file get the same list.
+    @returns const std::vector<Vertex>*, nullptr unless KeepMeshes() was called before Load() and the shape is the
+    scene's
+*/
+const std::vector<Vertex> *Scene::GetMesh(const Shape *shape) const
+{
+    for (const std::pair<const Shape *, int> &entry : shapeMeshes)
+    {
+        if (entry.first == shape)
+        {
+            return &meshes[entry.second];
+        }
+    }
+    return nullptr;
+}
+
+/**
+    @brief Lights of the scene, the sun first if it has one
+*/
+const std::vector<Light *> &Scene::GetLights() const
+{
+    return lights;
+}
+
+/**
+    @brief Draws every object with the cheapest fitting variant of a shader
+*/
+void Scene::SetShader(ShaderVariants *variants)
+{
+    for (Shape *shape : shapes)
+    {
+        shape->SetShader(variants);
+    }
+}
+
+/**
+    @brief Wall time of each phase of the last Load()
+*/
+const Scene::Timings &Scene::GetTimings() const
+{
+    return timings;
+}
+
+/**
+    @brief Prints the wall time of each load phase
+    @param out Stream to print to
+*/
+void Scene::PrintTimings(std::ostream &out) const
+{
+    out << "Scene: " << shapes.size() << " objects, " << lights.size() << " lights, " << timings.files << " files ("
+        << timings.bytes / 1024 << " KB decoded)" << std::endl
+        << "parse " << timings.parseMs << " ms, load " << timings.loadMs << " ms (" << timings.threads
+        << " threads), upload " << timings.uploadMs << " ms, total " << timings.totalMs << " ms" << std::endl;
+}
+
+#endif
@@ -0,0 +1,630 @@
+/**
+    @file SceneFile.h
+    @brief Scene description files, text for editing and a compiled binary form, independent of OpenGL
+    @details A scene lists the meshes, textures and materials it uses by name, the objects placed with them and
+    the lights. The text form has one entry per line, # starts a comment:
+
+        mesh <name> <obj path> [meshlets] [occluder <obj path>]
+        texture <name> <image path>
+        material <name> ambient r g b diffuse r g b specular r g b shininess s
+        object <mesh> <material> [texture <name>] [lightmap <name>] [position x y z] [rotate degrees x y z] [scale s]
+        sun direction x y z ambient r g b diffuse r g b specular r g b
+        pointlight position x y z ambient r g b diffuse r g b specular r g b attenuation constant linear quadratic
+
+    Names must be declared before objects use them, "-" stands for no material. A lightmap is a texture holding
+    the baked light of the static lights (Tools/LightmapBaker writes them and the scene using them). Paths are used
+    as written, relative to the working directory like every other resource path of the engine. The binary form
+    (Tools/SceneCompiler) holds the same description with names resolved to indices and needs no parsing:
+
+        FileHeader | meshes | textures | materials | ObjectRecord[objectCount] | sun | PointLightRecord[pointLightCount]
+
+    where strings are a uint32_t length followed by the characters. Files are written in the machine's byte order.
+    Read() tells the two apart by the magic, WriteText() writes the text form back.
+*/
+
+#pragma once
+#ifndef SCENEFILE_H
+#define SCENEFILE_H
+
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace SceneFile
+{
+    const uint32_t VERSION = 2; // 2 added ObjectRecord::lightmap
+
+    struct MeshEntry
+    {
+        std::string name, path;
+        bool meshlets = false;    // Split into meshlets and culled by them (Shape::SetMeshlets)
+        std::string occluderPath; // Mesh hiding what is behind the objects using it, empty for none
+    };
+
+    struct TextureEntry
+    {
+        std::string name, path;
+    };
+
+    struct MaterialEntry
+    {
+        std::string name;
+        glm::vec3 ambient, diffuse, specular;
+        float shininess;
+    };
+
+    struct ObjectRecord
+    {
+        int32_t mesh;
+        int32_t material; // -1 for none
+        int32_t texture;  // -1 for none
+        int32_t lightmap; // Texture with the baked static lights, -1 for none
+        glm::vec3 position;
+        glm::vec3 rotationAxis;
+        float rotation; // Degrees
+        float scale;
+    };
+
+    struct SunRecord
+    {
+        int32_t enabled;
+        glm::vec3 direction, ambient, diffuse, specular;
+    };
+
+    struct PointLightRecord
+    {
+        glm::vec3 position, ambient, diffuse, specular;
+        float constant, linear, quadratic;
+    };
+
+    struct FileHeader
+    {
+        char magic[4]; // "SCNB"
+        uint32_t version;
+        uint32_t meshCount, textureCount, materialCount, objectCount, pointLightCount;
+        uint32_t reserved;
+    };
+
+    static_assert(sizeof(ObjectRecord) == 48, "ObjectRecord must match the file layout");
+    static_assert(sizeof(SunRecord) == 52, "SunRecord must match the file layout");
+    static_assert(sizeof(PointLightRecord) == 60, "PointLightRecord must match the file layout");
+    static_assert(sizeof(FileHeader) == 32, "FileHeader must match the file layout");
+
+    struct Description
+    {
+        std::vector<MeshEntry> meshes;
+        std::vector<TextureEntry> textures;
+        std::vector<MaterialEntry> materials;
+        std::vector<ObjectRecord> objects;
+        SunRecord sun = SunRecord{0, glm::vec3(0, -1, 0), glm::vec3(0), glm::vec3(0), glm::vec3(0)};
+        std::vector<PointLightRecord> pointLights;
+    };
+
+    /**
+        @brief Finds a declared name
+        @returns int, index of the entry, -1 if there is none
+    */
+    template <typename Entry>
+    int Find(const std::vector<Entry> &entries, const std::string &name)
+    {
+        for (size_t i = 0; i < entries.size(); i++)
+        {
+            if (entries[i].name == name)
+            {
+                return (int)i;
+            }
+        }
+        return -1;
+    }
+
+    /**
+        @brief Reads the "key x y z" and "key s" properties of a line
+        @details Every key of the line must be one of the given ones, in any order.
+        @param fields Rest of the line
+        @param keys Property names
+        @param sizes Number of floats of each property
+        @param values Receive the floats of each property, left alone for properties the line does not have
+        @param count Number of properties
+        @param error Receives a message when the line is malformed
+        @returns bool, false on an unknown key or a missing value
+    */
+    bool ReadProperties(std::istringstream &fields, const char *const *keys, const int *sizes, float *const *values,
+                        int count, std::string &error)
+    {
+        std::string key;
+        while (fields >> key)
+        {
+            int k = 0;
+            while (k < count && key != keys[k])
+            {
+                k++;
+            }
+            if (k == count)
+            {
+                error = "unknown property " + key;
+                return false;
+            }
+            for (int i = 0; i < sizes[k]; i++)
+            {
+                if (!(fields >> values[k][i]))
+                {
+                    error = "missing value of " + key;
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    /**
+        @brief Parses a scene in the text form
+        @param text Contents of the file
+        @param scene Receives the description
+        @param name Name of the file for error messages
+        @returns bool, false with a message naming the line when the text is malformed
+    */
+    bool ParseText(const std::string &text, Description &scene, const std::string &name = "scene")
+    {
+        scene = Description();
+        std::istringstream lines(text);
+        std::string line, error;
+        for (int number = 1; std::getline(lines, line); number++)
+        {
+            size_t comment = line.find('#');
+            if (comment != std::string::npos)
+            {
+                line.resize(comment);
+            }
+            std::istringstream fields(line);
+            std::string keyword;
+            if (!(fields >> keyword))
+            {
+                continue;
+            }
+
+            if (keyword == "mesh")
+            {
+                MeshEntry mesh;
+                std::string option;
+                if (!(fields >> mesh.name >> mesh.path))
+                {
+                    error = "expected a name and a path";
+                }
+                while (error.empty() && fields >> option)
+                {
+                    if (option == "meshlets")
+                    {
+                        mesh.meshlets = true;
+                    }
+                    else if (option != "occluder" || !(fields >> mesh.occluderPath))
+                    {
+                        error = "unknown mesh option " + option;
+                    }
+                }
+                scene.meshes.push_back(mesh);
+            }
+            else if (keyword == "texture")
+            {
+                TextureEntry texture;
+                if (!(fields >> texture.name >> texture.path))
+                {
+                    error = "expected a name and a path";
+                }
+                scene.textures.push_back(texture);
+            }
+            else if (keyword == "material")
+            {
+                MaterialEntry material{"", glm::vec3(0), glm::vec3(0), glm::vec3(0), 0};
+                const char *keys[] = {"ambient", "diffuse", "specular", "shininess"};
+                const int sizes[] = {3, 3, 3, 1};
+                float *values[] = {&material.ambient.x, &material.diffuse.x, &material.specular.x, &material.shininess};
+                if (!(fields >> material.name))
+                {
+                    error = "expected a name";
+                }
+                else
+                {
+                    ReadProperties(fields, keys, sizes, values, 4, error);
+                }
+                scene.materials.push_back(material);
+            }
+            else if (keyword == "object")
+            {
+                ObjectRecord object{-1, -1, -1, -1, glm::vec3(0), glm::vec3(0, 1, 0), 0, 1};
+                std::string mesh, material, option;
+                if (!(fields >> mesh >> material))
+                {
+                    error = "expected a mesh and a material";
+                }
+                else if ((object.mesh = Find(scene.meshes, mesh)) < 0)
+                {
+                    error = "undeclared mesh " + mesh;
+                }
+                else if (material != "-" && (object.material = Find(scene.materials, material)) < 0)
+                {
+                    error = "undeclared material " + material;
+                }
+                while (error.empty() && fields >> option)
+                {
+                    glm::vec3 &v = option == "position" ? object.position : object.rotationAxis;
+                    if (option == "texture" || option == "lightmap")
+                    {
+                        std::string texture;
+                        int32_t &index = option == "texture" ? object.texture : object.lightmap;
+                        if (!(fields >> texture) || (index = Find(scene.textures, texture)) < 0)
+                        {
+                            error = "undeclared texture " + texture;
+                        }
+                    }
+                    else if ((option == "position" && !(fields >> v.x >> v.y >> v.z)) ||
+                             (option == "rotate" && !(fields >> object.rotation >> v.x >> v.y >> v.z)) ||
+                             (option == "scale" && !(fields >> object.scale)))
+                    {
+                        error = "missing value of " + option;
+                    }
+                    else if (option != "position" && option != "rotate" && option != "scale")
+                    {
+                        error = "unknown object option " + option;
+                    }
+                }
+                scene.objects.push_back(object);
+            }
+            else if (keyword == "sun")
+            {
+                const char *keys[] = {"direction", "ambient", "diffuse", "specular"};
+                const int sizes[] = {3, 3, 3, 3};
+                float *values[] = {&scene.sun.direction.x, &scene.sun.ambient.x, &scene.sun.diffuse.x,
+                                   &scene.sun.specular.x};
+                scene.sun.enabled = 1;
+                ReadProperties(fields, keys, sizes, values, 4, error);
+            }
+            else if (keyword == "pointlight")
+            {
+                PointLightRecord light{glm::vec3(0), glm::vec3(0), glm::vec3(0), glm::vec3(0), 1, 0, 0};
+                const char *keys[] = {"position", "ambient", "diffuse", "specular", "attenuation"};
+                const int sizes[] = {3, 3, 3, 3, 3};
+                float *values[] = {&light.position.x, &light.ambient.x, &light.diffuse.x, &light.specular.x,
+                                   &light.constant};
+                ReadProperties(fields, keys, sizes, values, 5, error);
+                scene.pointLights.push_back(light);
+            }
+            else
+            {
+                error = "unknown entry " + keyword;
+            }
+
+            if (!error.empty())
+            {
+                std::cout << name << ":" << number << ": " << error << std::endl;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+        @brief Writes a string as its length and characters
+    */
+    void WriteString(FILE *file, const std::string &s)
+    {
+        uint32_t length = (uint32_t)s.size();
+        fwrite(&length, sizeof(length), 1, file);
+        fwrite(s.data(), 1, length, file);
+    }
+
+    /**
+        @brief Reads a string written by WriteString
+        @param data Buffer to read from
+        @param offset Position of the string, advanced past it
+        @param s Receives the string
+        @returns bool, false when the buffer ends first
+    */
+    bool ReadString(const std::string &data, size_t &offset, std::string &s)
+    {
+        uint32_t length;
+        if (offset + sizeof(length) > data.size())
+        {
+            return false;
+        }
+        memcpy(&length, &data[offset], sizeof(length));
+        offset += sizeof(length);
+        if (offset + length > data.size())
+        {
+            return false;
+        }
+        s.assign(data, offset, length);
+        offset += length;
+        return true;
+    }
+
+    /**
+        @brief Copies a fixed size record out of the buffer
+        @returns bool, false when the buffer ends first
+    */
+    template <typename Record>
+    bool ReadRecord(const std::string &data, size_t &offset, Record &record)
+    {
+        if (offset + sizeof(Record) > data.size())
+        {
+            return false;
+        }
+        memcpy(&record, &data[offset], sizeof(Record));
+        offset += sizeof(Record);
+        return true;
+    }
+
+    /**
+        @brief Checks a count read from a file against the bytes left, before anything is sized by it
+        @param data Buffer being read
+        @param offset Position the entries start at
+        @param count Number of entries the file claims
+        @param minSize Fewest bytes one entry takes
+        @returns bool, false when the buffer cannot hold that many entries
+    */
+    bool FitsEntries(const std::string &data, size_t offset, uint32_t count, size_t minSize)
+    {
+        return offset <= data.size() && count <= (data.size() - offset) / minSize;
+    }
+
+    /**
+        @brief Writes a scene in the binary form
+        @param path File to write
+        @param scene Description to write
+        @returns bool, whether the file could be written
+    */
+    bool WriteBinary(const std::string &path, const Description &scene)
+    {
+        FILE *file = fopen(path.c_str(), "wb");
+        if (file == NULL)
+        {
+            std::cout << "Cannot write " << path << std::endl;
+            return false;
+        }
+        FileHeader header;
+        memcpy(header.magic, "SCNB", 4);
+        header.version = VERSION;
+        header.meshCount = (uint32_t)scene.meshes.size();
+        header.textureCount = (uint32_t)scene.textures.size();
+        header.materialCount = (uint32_t)scene.materials.size();
+        header.objectCount = (uint32_t)scene.objects.size();
+        header.pointLightCount = (uint32_t)scene.pointLights.size();
+        header.reserved = 0;
+        fwrite(&header, sizeof(header), 1, file);
+        for (const MeshEntry &mesh : scene.meshes)
+        {
+            WriteString(file, mesh.name);
+            WriteString(file, mesh.path);
+            WriteString(file, mesh.occluderPath);
+            uint32_t meshlets = mesh.meshlets ? 1 : 0;
+            fwrite(&meshlets, sizeof(meshlets), 1, file);
+        }
+        for (const TextureEntry &texture : scene.textures)
+        {
+            WriteString(file, texture.name);
+            WriteString(file, texture.path);
+        }
+        for (const MaterialEntry &material : scene.materials)
+        {
+            WriteString(file, material.name);
+            float values[10] = {material.ambient.x, material.ambient.y, material.ambient.z,
+                                material.diffuse.x, material.diffuse.y, material.diffuse.z,
+                                material.specular.x, material.specular.y, material.specular.z, material.shininess};
+            fwrite(values, sizeof(values), 1, file);
+        }
+        fwrite(scene.objects.data(), sizeof(ObjectRecord), scene.objects.size(), file);
+        fwrite(&scene.sun, sizeof(SunRecord), 1, file);
+        fwrite(scene.pointLights.data(), sizeof(PointLightRecord), scene.pointLights.size(), file);
+        bool written = ferror(file) == 0;
+        fclose(file);
+        if (!written)
+        {
+            std::cout << "Cannot write " << path << std::endl;
+        }
+        return written;
+    }
+
+    /**
+        @brief Writes a scene in the text form
+        @details Floats are written with enough digits to read back the same values.
+        @param path File to write
+        @param scene Description to write
+        @returns bool, whether the file could be written
+    */
+    bool WriteText(const std::string &path, const Description &scene)
+    {
+        std::ofstream file(path);
+        if (!file)
+        {
+            std::cout << "Cannot write " << path << std::endl;
+            return false;
+        }
+        auto vec = [](const glm::vec3 &v)
+        {
+            std::ostringstream text;
+            text << std::setprecision(9) << v.x << " " << v.y << " " << v.z;
+            return text.str();
+        };
+        file << std::setprecision(9);
+        for (const MeshEntry &mesh : scene.meshes)
+        {
+            file << "mesh " << mesh.name << " " << mesh.path << (mesh.meshlets ? " meshlets" : "");
+            if (!mesh.occluderPath.empty())
+            {
+                file << " occluder " << mesh.occluderPath;
+            }
+            file << std::endl;
+        }
+        for (const TextureEntry &texture : scene.textures)
+        {
+            file << "texture " << texture.name << " " << texture.path << std::endl;
+        }
+        for (const MaterialEntry &material : scene.materials)
+        {
+            file << "material " << material.name << " ambient " << vec(material.ambient) << " diffuse "
+                 << vec(material.diffuse) << " specular " << vec(material.specular) << " shininess "
+                 << material.shininess << std::endl;
+        }
+        for (const ObjectRecord &object : scene.objects)
+        {
+            file << "object " << scene.meshes[object.mesh].name << " "
+                 << (object.material >= 0 ? scene.materials[object.material].name : "-");
+            if (object.texture >= 0)
+            {
+                file << " texture " << scene.textures[object.texture].name;
+            }
+            if (object.lightmap >= 0)
+            {
+                file << " lightmap " << scene.textures[object.lightmap].name;
+            }
+            file << " position " << vec(object.position);
+            if (object.rotation != 0)
+            {
+                file << " rotate " << object.rotation << " " << vec(object.rotationAxis);
+            }
+            file << " scale " << object.scale << std::endl;
+        }
+        if (scene.sun.enabled)
+        {
+            file << "sun direction " << vec(scene.sun.direction) << " ambient " << vec(scene.sun.ambient)
+                 << " diffuse " << vec(scene.sun.diffuse) << " specular " << vec(scene.sun.specular) << std::endl;
+        }
+        for (const PointLightRecord &light : scene.pointLights)
+        {
+            file << "pointlight position " << vec(light.position) << " ambient " << vec(light.ambient) << " diffuse "
+                 << vec(light.diffuse) << " specular " << vec(light.specular) << " attenuation " << light.constant
+                 << " " << light.linear << " " << light.quadratic << std::endl;
+        }
+        if (!file)
+        {
+            std::cout << "Cannot write " << path << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    /**
+        @brief Reads a scene in the binary form
+        @param data Contents of the file
+        @param scene Receives the description
+        @returns bool, false when the data is not a scene of this version or is truncated
+    */
+    bool ReadBinary(const std::string &data, Description &scene)
+    {
+        // Each table is checked against the bytes left before it is sized, so a corrupt count fails the read rather
+        // than the allocation. Strings take at least their 4 byte length
+        scene = Description();
+        FileHeader header;
+        size_t offset = 0;
+        if (!ReadRecord(data, offset, header) || memcmp(header.magic, "SCNB", 4) != 0 || header.version != VERSION)
+        {
+            return false;
+        }
+        if (!FitsEntries(data, offset, header.meshCount, 3 * sizeof(uint32_t) + sizeof(uint32_t)))
+        {
+            return false;
+        }
+        scene.meshes.resize(header.meshCount);
+        for (MeshEntry &mesh : scene.meshes)
+        {
+            uint32_t meshlets;
+            if (!ReadString(data, offset, mesh.name) || !ReadString(data, offset, mesh.path) ||
+                !ReadString(data, offset, mesh.occluderPath) || !ReadRecord(data, offset, meshlets))
+            {
+                return false;
+            }
+            mesh.meshlets = meshlets != 0;
+        }
+        if (!FitsEntries(data, offset, header.textureCount, 2 * sizeof(uint32_t)))
+        {
+            return false;
+        }
+        scene.textures.resize(header.textureCount);
+        for (TextureEntry &texture : scene.textures)
+        {
+            if (!ReadString(data, offset, texture.name) || !ReadString(data, offset, texture.path))
+            {
+                return false;
+            }
+        }
+        if (!FitsEntries(data, offset, header.materialCount, sizeof(uint32_t) + 10 * sizeof(float)))
+        {
+            return false;
+        }
+        scene.materials.resize(header.materialCount);
+        for (MaterialEntry &material : scene.materials)
+        {
+            float values[10];
+            if (!ReadString(data, offset, material.name) || !ReadRecord(data, offset, values))
+            {
+                return false;
+            }
+            material.ambient = glm::vec3(values[0], values[1], values[2]);
+            material.diffuse = glm::vec3(values[3], values[4], values[5]);
+            material.specular = glm::vec3(values[6], values[7], values[8]);
+            material.shininess = values[9];
+        }
+        if (!FitsEntries(data, offset, header.objectCount, sizeof(ObjectRecord)))
+        {
+            return false;
+        }
+        scene.objects.resize(header.objectCount);
+        for (ObjectRecord &object : scene.objects)
+        {
+            if (!ReadRecord(data, offset, object) || object.mesh < 0 || object.mesh >= (int)header.meshCount ||
+                object.material >= (int)header.materialCount || object.texture >= (int)header.textureCount ||
+                object.lightmap >= (int)header.textureCount)
+            {
+                return false;
+            }
+        }
+        if (!ReadRecord(data, offset, scene.sun) || !FitsEntries(data, offset, header.pointLightCount, sizeof(PointLightRecord)))
+        {
+            return false;
+        }
+        scene.pointLights.resize(header.pointLightCount);
+        for (PointLightRecord &light : scene.pointLights)
+        {
+            if (!ReadRecord(data, offset, light))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+        @brief Reads a scene file in either form
+        @param path File to read
+        @param scene Receives the description
+        @returns bool, false with a message when the file cannot be read or is malformed
+    */
+    bool Read(const std::string &path, Description &scene)
+    {
+        std::ifstream file(path, std::ios::binary);
+        if (!file)
+        {
+            std::cout << "Cannot open file " << path << std::endl;
+            return false;
+        }
+        std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        if (data.size() >= 4 && memcmp(data.data(), "SCNB", 4) == 0)
+        {
+            if (!ReadBinary(data, scene))
+            {
+                std::cout << path << " is not a version " << VERSION << " binary scene or is truncated" << std::endl;
+                return false;
+            }
+            return true;
+        }
+        return ParseText(data, scene, path);
+    }
+}
+
+#endif
@@ -11,38 +11,72 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include <vector>
+#include <functional>
+#include "RenderStats.h"
+#include "MaterialBuffer.h"
+#include "ObjectBlock.h"
 
 class Shader
 {
   glm::mat4 projection;
+  std::string vertexCode, fragmentCode;
+  unsigned int vertex = 0, fragment = 0;
+  bool ready = false;
+  std::vector<std::function<void()>> readyCallbacks;
+
+  bool checkStatus();
+  static std::string injectDefines(const std::string &code, const std::vector<std::string> &defines);
 
 public:
   // the program ID
-  unsigned int ID;
+  unsigned int ID = 0;
+  // program bound in place of shaders that are still compiling (set by ShaderQueue)
+  static unsigned int fallbackID;
 
-  // constructor reads and builds the shader
+  // constructor reads and builds the shader, deferred shaders are only read and must be submitted later
   Shader() {}
-  Shader(const char *vertexPath, const char *fragmentPath);
+  Shader(const char *vertexPath, const char *fragmentPath, bool deferred = false);
+  // same as above, with "NAME" or "NAME VALUE" defines injected after the #version line of both stages
+  Shader(const char *vertexPath, const char *fragmentPath, const std::vector<std::string> &defines, bool deferred = false);
+  // issue compile and link commands without waiting on the driver
+  void submit();
+  // resolve compile/link status, blocks if the driver has not finished
+  bool finish();
+  bool isSubmitted() const;
+  bool isReady() const;
+  // run fn once the program is linked (immediately if it already is)
+  void onReady(std::function<void()> fn);
+  // program that draws are issued with: the real program once ready, the fallback before
+  unsigned int program() const;
   void usePerspective(float fov, float aspect, float zNear, float zFar);
   void useOrtho();
-  // use/activate the shader
+  glm::mat4 getProjection() const;
+  // use/activate the shader, the projection reaches the shader through the ObjectBlock (see ObjectBlock.h)
   void use();
+  // connects the program's ObjectBlock and MaterialBlock uniform blocks (those it has) to their binding points
+  static void bindObjectBlock(unsigned int program);
   // utility uniform functions
-  void setBool(const std::string &name, bool value) const;
-  void setInt(const std::string &name, int value) const;
-  void setFloat(const std::string &name, float value) const;
-  void setVec3(const std::string &name, glm::vec3 vec) const;
-  void setMatrix3(const std::string &name, glm::mat3 mat) const;
-  void setMatrix4(const std::string &name, glm::mat4 mat) const;
+  void setBool(const char *name, bool value) const;
+  void setInt(const char *name, int value) const;
+  void setFloat(const char *name, float value) const;
+  void setVec3(const char *name, glm::vec3 vec) const;
+  void setMatrix3(const char *name, glm::mat3 mat) const;
+  void setMatrix4(const char *name, glm::mat4 mat) const;
 };
 
 #endif
 
-Shader::Shader(const char *vertexPath, const char *fragmentPath)
+unsigned int Shader::fallbackID = 0;
+
+Shader::Shader(const char *vertexPath, const char *fragmentPath, bool deferred)
+    : Shader(vertexPath, fragmentPath, std::vector<std::string>(), deferred)
+{
+}
+
+Shader::Shader(const char *vertexPath, const char *fragmentPath, const std::vector<std::string> &defines, bool deferred)
 {
   // 1. retrieve the vertex/fragment source code from filePath
-  std::string vertexCode;
-  std::string fragmentCode;
   std::ifstream vShaderFile;
   std::ifstream fShaderFile;
   // ensure ifstream objects can throw exceptions:
@@ -61,25 +95,134 @@ Shader::Shader(const char *vertexPath, const char *fragmentPath)
     vShaderFile.close();
     fShaderFile.close();
     // convert stream into string
-    vertexCode = vShaderStream.str();
-    fragmentCode = fShaderStream.str();
+    vertexCode = injectDefines(vShaderStream.str(), defines);
+    fragmentCode = injectDefines(fShaderStream.str(), defines);
   }
   catch (std::ifstream::failure e)
   {
     std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
   }
+
+  projection = glm::perspective(glm::radians(45.0f), 8.0f / 6.0f, 0.1f, 100.0f); // Default perspective projection
+
+  // 2. compile shaders, deferred shaders wait for a ShaderQueue to submit them
+  if (!deferred)
+  {
+    submit();
+    finish();
+  }
+}
+
+/**
+  @brief Inserts #define lines into GLSL source
+  @details GLSL requires #version to be the first statement, so the defines go on the line after it.
+  @param code Shader source
+  @param defines Defines to add, each either "NAME" or "NAME VALUE"
+  @returns std::string, the source with the defines added
+*/
+std::string Shader::injectDefines(const std::string &code, const std::vector<std::string> &defines)
+{
+  if (defines.empty())
+  {
+    return code;
+  }
+  std::string block;
+  for (const std::string &define : defines)
+  {
+    block += "#define " + define + "\n";
+  }
+  size_t version = code.find("#version");
+  if (version == std::string::npos)
+  {
+    return block + code;
+  }
+  size_t lineEnd = code.find('\n', version);
+  if (lineEnd == std::string::npos)
+  {
+    return code + "\n" + block;
+  }
+  return code.substr(0, lineEnd + 1) + block + code.substr(lineEnd + 1);
+}
+
+/**
+  @brief Issues the compile and link commands for the program
+  @details Nothing here queries compile or link status, so the driver is free to build the program in the
+  background (GL_KHR_parallel_shader_compile) while other programs are submitted.
+*/
+void Shader::submit()
+{
+  if (ID != 0)
+  {
+    return;
+  }
   const char *vShaderCode = vertexCode.c_str();
   const char *fShaderCode = fragmentCode.c_str();
 
-  // 2. compile shaders
-  unsigned int vertex, fragment;
-  int success;
-  char infoLog[512];
-
   // vertex Shader
   vertex = glCreateShader(GL_VERTEX_SHADER);
   glShaderSource(vertex, 1, &vShaderCode, NULL);
   glCompileShader(vertex);
+
+  // similiar for Fragment Shader
+  fragment = glCreateShader(GL_FRAGMENT_SHADER);
+  glShaderSource(fragment, 1, &fShaderCode, NULL);
+  glCompileShader(fragment);
+
+  // shader Program
+  ID = glCreateProgram();
+  glAttachShader(ID, vertex);
+  glAttachShader(ID, fragment);
+  glLinkProgram(ID);
+}
+
+/**
+  @brief Resolves the compile and link status of a submitted program
+  @details Prints any compile/link errors, frees the shader objects and runs the onReady callbacks.
+  Querying status forces the driver to finish the program, so this blocks if it is still compiling.
+  @returns bool, whether the program linked successfully
+*/
+bool Shader::finish()
+{
+  if (ID == 0)
+  {
+    return false;
+  }
+  if (vertex == 0)
+  {
+    return ready;
+  }
+  ready = checkStatus();
+
+  // delete the shaders as they're linked into our program now and no longer necessary
+  glDeleteShader(vertex);
+  glDeleteShader(fragment);
+  vertex = fragment = 0;
+  vertexCode.clear();
+  fragmentCode.clear();
+
+  if (ready)
+  {
+    bindObjectBlock(ID);
+    glUseProgram(ID);
+    RenderStats::countProgram(ID);
+    for (auto &fn : readyCallbacks)
+    {
+      fn();
+    }
+  }
+  readyCallbacks.clear();
+  return ready;
+}
+
+/**
+  @brief Prints compile and link errors of the program if there are any
+  @returns bool, whether the program linked successfully
+*/
+bool Shader::checkStatus()
+{
+  int success;
+  char infoLog[512];
+
   // print compile errors if any
   glGetShaderiv(vertex, GL_COMPILE_STATUS, &success);
   if (!success)
@@ -88,11 +231,6 @@ Shader::Shader(const char *vertexPath, const char *fragmentPath)
     std::cout << "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n"
               << infoLog << std::endl;
   };
-
-  // similiar for Fragment Shader
-  fragment = glCreateShader(GL_FRAGMENT_SHADER);
-  glShaderSource(fragment, 1, &fShaderCode, NULL);
-  glCompileShader(fragment);
   glGetShaderiv(fragment, GL_COMPILE_STATUS, &success);
   if (!success)
   {
@@ -101,11 +239,6 @@ Shader::Shader(const char *vertexPath, const char *fragmentPath)
               << infoLog << std::endl;
   }
 
-  // shader Program
-  ID = glCreateProgram();
-  glAttachShader(ID, vertex);
-  glAttachShader(ID, fragment);
-  glLinkProgram(ID);
   // print linking errors if any
   glGetProgramiv(ID, GL_LINK_STATUS, &success);
   if (!success)
@@ -114,18 +247,60 @@ Shader::Shader(const char *vertexPath, const char *fragmentPath)
     std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n"
               << infoLog << std::endl;
   }
+  return success;
+}
 
-  // delete the shaders as they're linked into our program now and no longer necessary
-  glDeleteShader(vertex);
-  glDeleteShader(fragment);
+bool Shader::isSubmitted() const
+{
+  return ID != 0;
+}
 
-  projection = glm::perspective(glm::radians(45.0f), 8.0f / 6.0f, 0.1f, 100.0f); // Default perspective projection
+bool Shader::isReady() const
+{
+  return ready;
+}
+
+/**
+  @brief Runs a function once the program is ready
+  @details Uniform state set before a deferred program has linked would be lost, so one-off uploads
+  (lights, counts) are wrapped in this. The program is bound when fn runs.
+  @param fn Function to run
+*/
+void Shader::onReady(std::function<void()> fn)
+{
+  if (ready)
+  {
+    fn();
+  }
+  else
+  {
+    readyCallbacks.push_back(fn);
+  }
+}
+
+unsigned int Shader::program() const
+{
+  return ready ? ID : fallbackID;
 }
 
 void Shader::use()
 {
-  glUseProgram(ID);
-  setMatrix4("projection", projection);
+  glUseProgram(program());
+  RenderStats::countProgram(program());
+}
+
+void Shader::bindObjectBlock(unsigned int program)
+{
+  unsigned int block = glGetUniformBlockIndex(program, "ObjectBlock");
+  if (block != GL_INVALID_INDEX)
+  {
+    glUniformBlockBinding(program, block, OBJECTBLOCK_BINDING);
+  }
+  block = glGetUniformBlockIndex(program, "MaterialBlock");
+  if (block != GL_INVALID_INDEX)
+  {
+    glUniformBlockBinding(program, block, MATERIALBLOCK_BINDING);
+  }
 }
 
 void Shader::usePerspective(float fov, float aspect, float zNear, float zFar)
@@ -133,32 +308,43 @@ void Shader::usePerspective(float fov, float aspect, float zNear, float zFar)
   projection = glm::perspective(fov, aspect, zNear, zFar);
 }
 
+glm::mat4 Shader::getProjection() const
+{
+  return projection;
+}
+
 void Shader::useOrtho()
 {
   // TODO: Figure out ortho arguments. We may not even want to use this.
 }
 
-void Shader::setBool(const std::string &name, bool value) const
+void Shader::setBool(const char *name, bool value) const
 {
-  glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+  glUniform1i(glGetUniformLocation(program(), name), (int)value);
+  RenderStats::frame.uniformCalls++;
 }
-void Shader::setInt(const std::string &name, int value) const
+void Shader::setInt(const char *name, int value) const
 {
-  glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+  glUniform1i(glGetUniformLocation(program(), name), value);
+  RenderStats::frame.uniformCalls++;
 }
-void Shader::setFloat(const std::string &name, float value) const
+void Shader::setFloat(const char *name, float value) const
 {
-  glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+  glUniform1f(glGetUniformLocation(program(), name), value);
+  RenderStats::frame.uniformCalls++;
 }
-void Shader::setVec3(const std::string &name, glm::vec3 vec) const
+void Shader::setVec3(const char *name, glm::vec3 vec) const
 {
-  glUniform3f(glGetUniformLocation(ID, name.c_str()), vec.x, vec.y, vec.z);
+  glUniform3f(glGetUniformLocation(program(), name), vec.x, vec.y, vec.z);
+  RenderStats::frame.uniformCalls++;
 }
-void Shader::setMatrix3(const std::string &name, glm::mat3 mat) const
+void Shader::setMatrix3(const char *name, glm::mat3 mat) const
 {
-  glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, glm::value_ptr(mat));
+  glUniform3fv(glGetUniformLocation(program(), name), 1, glm::value_ptr(mat));
+  RenderStats::frame.uniformCalls++;
 }
-void Shader::setMatrix4(const std::string &name, glm::mat4 mat) const
+void Shader::setMatrix4(const char *name, glm::mat4 mat) const
 {
-  glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, glm::value_ptr(mat));
+  glUniformMatrix4fv(glGetUniformLocation(program(), name), 1, GL_FALSE, glm::value_ptr(mat));
+  RenderStats::frame.uniformCalls++;
 }
\ No newline at end of file
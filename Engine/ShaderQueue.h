@@ -0,0 +1,202 @@
+/**
+    @class ShaderQueue ShaderQueue.h "Engine/ShaderQueue.h"
+    @brief Batches shader program builds so they compile in parallel
+    @details Shaders added to the queue have their compile and link commands issued immediately, but their
+    status is only checked later by Poll(). With GL_KHR_parallel_shader_compile the driver builds the programs
+    on its own threads and Poll() uses the non-blocking GL_COMPLETION_STATUS_KHR query, so a scene with dozens
+    of programs doesn't pay for them one after another. Programs that aren't ready yet draw with a flat
+    fallback program instead of stalling the frame.
+*/
+
+#pragma once
+#ifndef SHADERQUEUE_H
+#define SHADERQUEUE_H
+
+#include <glad/glad.h>
+#include <cstring>
+#include <vector>
+#include "Shader.h"
+
+#ifndef GL_MAX_SHADER_COMPILER_THREADS_KHR
+#define GL_MAX_SHADER_COMPILER_THREADS_KHR 0x91B0
+#endif
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+class ShaderQueue
+{
+  typedef void(APIENTRYP MaxShaderCompilerThreadsProc)(GLuint count);
+
+  std::vector<Shader *> pending;
+  unsigned int fallback;
+  bool parallel; // GL_KHR_parallel_shader_compile (or the ARB version) is available
+
+  static bool hasExtension(const char *name);
+
+public:
+  ShaderQueue(GLADloadproc load = nullptr);
+  ~ShaderQueue();
+  void Add(Shader *shader);
+  int Poll();
+  void WaitAll();
+  int Pending();
+  bool IsParallel();
+};
+
+/**
+    @brief Creates the queue and the fallback program
+    @details Compiles the fallback program synchronously (it is tiny) and, when the parallel compile extension
+    is present, asks the driver to use as many compiler threads as it likes.
+    @param load Optional GL function loader, needed to look up glMaxShaderCompilerThreadsKHR
+*/
+ShaderQueue::ShaderQueue(GLADloadproc load)
+{
+  const char *vertexCode = "#version 330 core\n"
+                           "layout (location = 0) in vec3 aPos;\n"
+                           "invariant gl_Position;\n"
+                           "layout (std140) uniform ObjectBlock { mat4 mvp; mat4 model; mat3 normalMatrix; };\n"
+                           "void main() { gl_Position = mvp * vec4(aPos, 1.0); }\n";
+  const char *fragmentCode = "#version 330 core\n"
+                             "out vec4 FragColor;\n"
+                             "void main() { FragColor = vec4(0.5, 0.5, 0.5, 1.0); }\n";
+
+  unsigned int vertex = glCreateShader(GL_VERTEX_SHADER);
+  glShaderSource(vertex, 1, &vertexCode, NULL);
+  glCompileShader(vertex);
+  unsigned int fragment = glCreateShader(GL_FRAGMENT_SHADER);
+  glShaderSource(fragment, 1, &fragmentCode, NULL);
+  glCompileShader(fragment);
+  fallback = glCreateProgram();
+  glAttachShader(fallback, vertex);
+  glAttachShader(fallback, fragment);
+  glLinkProgram(fallback);
+  Shader::bindObjectBlock(fallback);
+  glDeleteShader(vertex);
+  glDeleteShader(fragment);
+  Shader::fallbackID = fallback;
+
+  parallel = hasExtension("GL_KHR_parallel_shader_compile") || hasExtension("GL_ARB_parallel_shader_compile");
+  if (parallel && load != nullptr)
+  {
+    MaxShaderCompilerThreadsProc maxThreads = (MaxShaderCompilerThreadsProc)load("glMaxShaderCompilerThreadsKHR");
+    if (maxThreads == nullptr)
+    {
+      maxThreads = (MaxShaderCompilerThreadsProc)load("glMaxShaderCompilerThreadsARB");
+    }
+    if (maxThreads != nullptr)
+    {
+      maxThreads(0xFFFFFFFF); // Let the implementation pick the thread count
+    }
+  }
+}
+
+/**
+    @brief Deletes the fallback program
+*/
+ShaderQueue::~ShaderQueue()
+{
+  if (Shader::fallbackID == fallback)
+  {
+    Shader::fallbackID = 0;
+  }
+  glDeleteProgram(fallback);
+}
+
+/**
+    @brief Checks the context's extension list for an extension
+    @param name Name of the extension
+    @returns bool, whether the extension is supported
+*/
+bool ShaderQueue::hasExtension(const char *name)
+{
+  int count = 0;
+  glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+  for (int i = 0; i < count; i++)
+  {
+    const char *ext = (const char *)glGetStringi(GL_EXTENSIONS, i);
+    if (ext != nullptr && strcmp(ext, name) == 0)
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+    @brief Submits a shader's compile and link commands
+    @details The shader is only checked again by Poll(), nothing here waits on the driver.
+    @param shader Shader constructed with deferred set
+*/
+void ShaderQueue::Add(Shader *shader)
+{
+  if (shader->isReady())
+  {
+    return;
+  }
+  shader->submit();
+  pending.push_back(shader);
+}
+
+/**
+    @brief Finishes every program the driver is done with
+    @details Uses GL_COMPLETION_STATUS_KHR so programs still building are skipped instead of waited on. Without
+    the extension any status query blocks, so everything is resolved at once in a single stall rather than one
+    stall per program. Call once per frame.
+    @returns int, number of programs finished by this call
+*/
+int ShaderQueue::Poll()
+{
+  int finished = 0;
+  for (size_t i = 0; i < pending.size();)
+  {
+    Shader *shader = pending[i];
+    int done = GL_TRUE;
+    if (parallel)
+    {
+      glGetProgramiv(shader->ID, GL_COMPLETION_STATUS_KHR, &done);
+    }
+    if (done)
+    {
+      shader->finish();
+      pending[i] = pending.back();
+      pending.pop_back();
+      finished++;
+    }
+    else
+    {
+      i++;
+    }
+  }
+  return finished;
+}
+
+/**
+    @brief Blocks until every queued program is finished
+*/
+void ShaderQueue::WaitAll()
+{
+  for (Shader *shader : pending)
+  {
+    shader->finish();
+  }
+  pending.clear();
+}
+
+/**
+    @brief Returns the number of programs that are still building
+*/
+int ShaderQueue::Pending()
+{
+  return pending.size();
+}
+
+/**
+    @brief Returns whether the driver compiles programs in parallel
+*/
+bool ShaderQueue::IsParallel()
+{
+  return parallel;
+}
+
+#endif
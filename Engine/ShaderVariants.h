@@ -0,0 +1,261 @@
+/**
+    @class ShaderVariants ShaderVariants.h "Engine/ShaderVariants.h"
+    @brief Compiles and caches specialized permutations of one shader
+    @details Instead of one shader that handles every case at runtime, each combination of features (point
+    light count, texturing, instancing, shadows, lightmaps) is compiled as its own program with the features
+    injected as #defines. Variants are compiled the first time they are asked for and cached by key, so a scene
+    only pays for the permutations it actually uses.
+*/
+
+#pragma once
+#ifndef SHADERVARIANTS_H
+#define SHADERVARIANTS_H
+
+#include <atomic>
+#include <map>
+#include <string>
+#include <vector>
+#include <functional>
+#include <iostream>
+#include "Lightmap.h"
+#include "Shader.h"
+#include "ShaderQueue.h"
+
+#define MAX_VARIANT_POINT_LIGHTS 8
+
+/**
+    @brief Feature set that selects a shader variant
+    @details pointLights < 0 selects the generic variant that loops over a runtime numPointLights uniform.
+*/
+struct ShaderFeatures
+{
+  int pointLights = -1;
+  bool textured = false;
+  bool instanced = false;
+  bool shadowed = false;
+  bool lightmapped = false; // Ambient and diffuse light of baked lights comes from a lightmap
+
+  std::string Key() const;
+  std::vector<std::string> Defines() const;
+};
+
+/**
+    @brief Returns the cache key of the feature set (e.g. "L2_TEX_SHADOW")
+*/
+std::string ShaderFeatures::Key() const
+{
+  std::string key = pointLights < 0 ? "Ldyn" : "L" + std::to_string(pointLights);
+  if (textured)
+    key += "_TEX";
+  if (instanced)
+    key += "_INST";
+  if (shadowed)
+    key += "_SHADOW";
+  if (lightmapped)
+    key += "_LMAP";
+  return key;
+}
+
+/**
+    @brief Returns the #defines that implement the feature set in the shader source
+*/
+std::vector<std::string> ShaderFeatures::Defines() const
+{
+  std::vector<std::string> defines;
+  if (pointLights >= 0)
+    defines.push_back("NR_POINT_LIGHTS " + std::to_string(pointLights));
+  if (textured)
+    defines.push_back("TEXTURED");
+  if (instanced)
+    defines.push_back("INSTANCED");
+  if (shadowed)
+    defines.push_back("SHADOWED");
+  if (lightmapped)
+    defines.push_back("LIGHTMAPPED");
+  return defines;
+}
+
+class ShaderVariants
+{
+  struct Variant
+  {
+    Shader *shader;
+    int selections; // Times a shape selected it, once per change of its features or the scene, not per draw
+  };
+
+  std::string vertexPath, fragmentPath;
+  ShaderQueue *queue;
+  std::map<std::string, Variant> variants;
+  std::vector<std::function<void(Shader *)>> compileCallbacks;
+
+public:
+  // Set on the simulation thread and read by Select() on the render thread
+  static std::atomic<int> activePointLights; // Point lights in the scene, kept up to date by LightIndex
+  static std::atomic<bool> activeShadows;    // Whether a CascadedShadowMap casts the directional light's shadows
+  static std::atomic<int> version;           // Bumped when either changes, shapes then select their variant again
+
+  static void SetActivePointLights(int count);
+  static void SetActiveShadows(bool shadows);
+
+  ShaderVariants(const char *vertexPath, const char *fragmentPath, ShaderQueue *queue = nullptr);
+  ~ShaderVariants();
+  Shader *Get(const ShaderFeatures &features);
+  Shader *Select(bool textured, bool instanced = false, bool shadowed = false, bool lightmapped = false);
+  void OnCompile(std::function<void(Shader *)> fn);
+  int Count();
+  void Report(std::ostream &out = std::cout);
+};
+
+std::atomic<int> ShaderVariants::activePointLights(0);
+std::atomic<bool> ShaderVariants::activeShadows(false);
+std::atomic<int> ShaderVariants::version(0);
+
+/**
+    @brief Sets the number of point lights variants are specialized to
+    @details Shapes keep the variant they selected until this or the shadows change, then select again on their
+    next draw.
+*/
+void ShaderVariants::SetActivePointLights(int count)
+{
+  if (activePointLights.exchange(count) != count)
+  {
+    version++;
+  }
+}
+
+/**
+    @brief Sets whether variants sample the directional light's shadow maps
+*/
+void ShaderVariants::SetActiveShadows(bool shadows)
+{
+  if (activeShadows.exchange(shadows) != shadows)
+  {
+    version++;
+  }
+}
+
+/**
+    @brief Creates an empty variant cache for a vertex/fragment shader pair
+    @param vertexPath Path to the vertex shader
+    @param fragmentPath Path to the fragment shader
+    @param queue Optional build queue, variants compile in the background through it when given
+*/
+ShaderVariants::ShaderVariants(const char *_vertexPath, const char *_fragmentPath, ShaderQueue *_queue)
+    : vertexPath(_vertexPath), fragmentPath(_fragmentPath), queue(_queue)
+{
+}
+
+/**
+    @brief Deletes every compiled variant
+*/
+ShaderVariants::~ShaderVariants()
+{
+  for (auto &entry : variants)
+  {
+    glDeleteProgram(entry.second.shader->ID);
+    delete entry.second.shader;
+  }
+}
+
+/**
+    @brief Returns the variant for a feature set, compiling it if this is the first request
+    @param features Feature set of the variant
+    @returns Shader*, the cached variant
+*/
+Shader *ShaderVariants::Get(const ShaderFeatures &features)
+{
+  std::string key = features.Key();
+  auto found = variants.find(key);
+  if (found != variants.end())
+  {
+    found->second.selections++;
+    return found->second.shader;
+  }
+
+  Shader *shader = new Shader(vertexPath.c_str(), fragmentPath.c_str(), features.Defines(), queue != nullptr);
+  if (queue != nullptr)
+  {
+    queue->Add(shader);
+  }
+  variants[key] = {shader, 1};
+  if (features.lightmapped)
+  {
+    shader->onReady([shader]()
+                    {
+                      shader->use();
+                      shader->setInt("lightmap", LIGHTMAP_TEXTURE_UNIT); });
+  }
+  for (auto &fn : compileCallbacks)
+  {
+    fn(shader);
+  }
+  return shader;
+}
+
+/**
+    @brief Returns the cheapest variant that can draw an object with the current lights
+    @details The point light loop is specialized to the exact number of lights in the scene, so no iteration
+    is spent on unused slots. Scenes with more lights than MAX_VARIANT_POINT_LIGHTS use the generic variant. Builds
+    a key and looks it up, so shapes call it when their features or the version change and keep the result rather
+    than calling it per draw. Call on the context thread, a new variant is compiled.
+    @param textured Whether the object samples a diffuse texture
+    @param instanced Whether the object supplies its model matrix per instance
+    @param shadowed Whether the object receives directional light shadows, every object does while a shadow map is
+    active
+    @param lightmapped Whether the object has a lightmap, which replaces the ambient and diffuse terms of baked
+    lights
+*/
+Shader *ShaderVariants::Select(bool textured, bool instanced, bool shadowed, bool lightmapped)
+{
+  ShaderFeatures features;
+  int pointLights = activePointLights.load();
+  features.pointLights = pointLights <= MAX_VARIANT_POINT_LIGHTS ? pointLights : -1;
+  features.textured = textured;
+  features.instanced = instanced;
+  features.shadowed = shadowed || activeShadows.load();
+  features.lightmapped = lightmapped;
+  return Get(features);
+}
+
+/**
+    @brief Registers a function run on every newly created variant
+    @details Used to upload scene state (lights) that every variant needs. Runs on variants created earlier too.
+    Variants are created by Select(), on the context thread, so with a RenderThread the functions run on the render
+    thread: they may only touch what it owns, e.g. LightIndex::shaders and the receivers of a CascadedShadowMap,
+    which is why lights are added before the render thread starts.
+    @param fn Function receiving the new variant
+*/
+void ShaderVariants::OnCompile(std::function<void(Shader *)> fn)
+{
+  compileCallbacks.push_back(fn);
+  for (auto &entry : variants)
+  {
+    fn(entry.second.shader);
+  }
+}
+
+/**
+    @brief Returns the number of compiled variants
+*/
+int ShaderVariants::Count()
+{
+  return variants.size();
+}
+
+/**
+    @brief Prints which variants were compiled and how many shape selections each got
+    @details Shapes select a variant when their features or the scene's lights and shadows change, so the counts
+    are selections, not draws.
+    @param out Stream to print to
+*/
+void ShaderVariants::Report(std::ostream &out)
+{
+  out << "Shader variants of " << vertexPath << " / " << fragmentPath << ": " << variants.size() << " compiled" << std::endl;
+  for (auto &entry : variants)
+  {
+    out << "  " << entry.first << (entry.second.shader->isReady() ? "" : " (building)")
+        << ", " << entry.second.selections << " selections" << std::endl;
+  }
+}
+
+#endif
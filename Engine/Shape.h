@@ -10,26 +10,30 @@
 #define SHAPE_CLASS_H
 #include <glad/glad.h>
 #include <glm/glm.hpp>
+#include <atomic>
 #include <string>
 #include <fstream>
 #include <iostream>
 #include <vector>
+#include "Bvh.h"
 #include "VAO.h"
 #include "VB.h"
+#include "VertexLayout.h"
+#include "Lightmap.h"
 #include "Texture.h"
 #include "Shader.h"
+#include "ShaderVariants.h"
 #include "MatrixStack.h"
 #include "Material.h"
+#include "MaterialBuffer.h"
+#include "Profiler.h"
+#include "ObjLoader.h"
+#include "Meshlet.h"
+#include "Transform.h"
+#include "ObjectBlock.h"
 
 using glm::vec3, glm::vec2;
 
-struct Vertex
-{
-    vec3 position;
-    vec2 texture;
-    vec3 normal;
-};
-
 class Shape
 {
 private:
@@ -39,21 +43,43 @@ private:
         Elements
     };
     void initMatrices();
+    void setMesh(const std::vector<Vertex> &vertices);
+    void setBounds(const std::vector<Vertex> &vertices);
+    void setVertices(const std::vector<Vertex> &vertices);
+    void drawObject(int object, const Meshlets::Range *ranges, int rangeCount);
+    void selectVariant();
+    Shader *currentShader();
+    void drawCall(const Meshlets::Range *ranges, int rangeCount);
     VAO vao;
+    VAO depthVao; // Position attribute only, for the depth pre-pass
     VB vbo = VB(GL_ARRAY_BUFFER, GL_STATIC_DRAW), ebo = VB(GL_ELEMENT_ARRAY_BUFFER, GL_STATIC_DRAW);
+    VB shadingVbo = VB(GL_ARRAY_BUFFER, GL_STATIC_DRAW); // Texture coordinates and normals of meshes, vbo then holds their positions
+    VB lightmapVbo = VB(GL_ARRAY_BUFFER, GL_STATIC_DRAW); // Lightmap coordinates, only with a lightmap
     Texture tex = Texture(GL_TEXTURE_2D);
-    Shader *shader;
+    bool textured = false;
+    Texture *lightmap = nullptr; // Ambient and diffuse light of the baked lights, in place of those terms
+    std::atomic<Shader *> shader{nullptr}; // Program drawn with, read by RenderQueue::Build for sorting on any thread
+    ShaderVariants *variants = nullptr;    // When set, shader is the cheapest fitting variant, selected when it changes
+    int variantVersion = -1;               // ShaderVariants::version the variant was selected at
     DrawMethod drawMethod;       // Specifies method in which to draw
     int drawFirst, drawElements; // Specifies how to draw data
-    glm::mat4 model, view;       // Transformation matrices
+    Transform transform;         // Transformation matrices
     float rotation;
     MatrixStack *ms;
-    Material *mat;
+    Material *mat = nullptr;
+    vec3 boundsCenter = vec3(0, 0, 0); // Object space bounding sphere
+    float boundsRadius = -1;           // Negative when the shape has no bounds (never culled)
+    std::vector<vec3> occluder;        // Object space triangles rendered into the occlusion buffer, empty if none
+    const Bvh *pickMesh = nullptr;     // Object space hierarchy over the drawn triangles for ray picking, not owned
+    std::vector<Meshlets::Meshlet> meshlets; // Clusters of the index buffer culled one by one, empty if none
+    std::vector<GLsizei> rangeCounts;        // glMultiDrawElements arguments of the meshlet ranges being drawn
+    std::vector<const void *> rangeOffsets;
 
 public:
     Shape(GLenum type, float *vertices, int vSize);                                   // Creates just a VAO and VBO
     Shape(GLenum type, float *vertices, int vSize, unsigned int *indices, int iSize); // Creates VAO, VBO, and EBO
     Shape(GLenum type, std::string objPath);                                          // Loads mesh from a given obj file path
+    Shape(GLenum type, const std::vector<Vertex> &vertices);                          // Uploads an already loaded mesh
     void UpdateData(Vertex *vertices, int vSize);
     void UpdateData(float *vertices, int vSize);                                   // Updates the VBO
     void UpdateData(float *vertices, int vSize, unsigned int *indices, int iSize); // Updates the VBO and EBO
@@ -62,13 +88,36 @@ public:
     void Unbind();                                                                 // Unbinds all of the objects
     void SetDrawData(int first, int elements);                                     // Sets the Draw data
     void Draw();                                                                   // Draws the data
+    void Draw(const ObjectBlock &block);                                           // Draws with precomputed object matrices
+    void Draw(int object, const Meshlets::Range *ranges = nullptr, int rangeCount = 0); // Draws with a block of the current ObjectBuffer batch
+    void DrawDepth();                                                              // Draws positions only with the bound depth program
+    void DrawDepth(int object, const Meshlets::Range *ranges = nullptr, int rangeCount = 0); // Same with a block of the current ObjectBuffer batch
+    void DrawShadow(int object);                                                   // Draws positions into a shadow map, whole and uncounted as pre-pass
     void SetTexture(Texture &txtr);                                                // Sets texture to an already existing one
+    bool SetLightmap(Texture *lightmapTexture, const std::vector<vec2> &coords);   // Draws with baked static lights
     void Rotate(float angle, vec3 axis);
     void Scale(float scalar);
     void Translate(vec3 trans);
     void SetShader(Shader *shdr);
+    void SetShader(ShaderVariants *vars);
     Shader *GetShader();
     void SetMaterial(Material *mat);
+    int MaterialIndex() const;                                                     // Slot of the material in the MaterialBuffer, 0 for none
+    const Transform &GetTransform() const;
+    void SetTransform(const Transform &_transform);
+    void SetBounds(vec3 center, float radius);
+    bool GetBounds(vec3 &center, float &radius) const;
+    void SetOccluder(const std::vector<vec3> &triangles);                          // Makes the shape hide what is behind it
+    bool SetOccluder(std::string objPath);                                         // Same with a (low poly) obj mesh
+    const std::vector<vec3> &GetOccluder() const;
+    void SetPickMesh(const Bvh *bvh);                                              // Makes the shape pickable (Picker.h)
+    const Bvh *GetPickMesh() const;
+    bool SetMeshlets(std::string objPath, int maxVertices = MESHLET_MAX_VERTICES, int maxTriangles = MESHLET_MAX_TRIANGLES);
+    void SetMeshlets(const std::vector<Vertex> &vertices, const std::vector<uint32_t> &meshletIndices,
+                     const std::vector<Meshlets::Meshlet> &meshlets);               // Same with meshlets built off the GL thread
+    const std::vector<Meshlets::Meshlet> &GetMeshlets() const;
+    const void *StateKey() const;
+    unsigned int VertexArray() const;
 };
 
 /**
@@ -103,91 +152,87 @@ Shape::Shape(GLenum type, float *vertices, int vSize, unsigned int *indices, int
  * @details Reads in an OBJ file and creates a mesh based on that
  * @param objPath Path to the obj file
  */
-Shape::Shape(GLenum type, std::string path) : vbo(GL_ARRAY_BUFFER, type), ebo(GL_ELEMENT_ARRAY_BUFFER, type)
+Shape::Shape(GLenum type, std::string path) : vbo(GL_ARRAY_BUFFER, type), ebo(GL_ELEMENT_ARRAY_BUFFER, type),
+                                              shadingVbo(GL_ARRAY_BUFFER, type)
 {
-    std::vector<unsigned int> vertexIndices, uvIndices, normalIndices;
-    std::vector<vec3> positions, normals;
-    std::vector<vec2> uvs;
     std::vector<Vertex> vertices;
-    float buffer[3];
-    int faceCount = 0;
 
-    FILE *file = fopen(path.c_str(), "r");
-    if (file == NULL)
+    initMatrices();
+    if (!ObjLoader::Load(path, vertices) || vertices.empty())
     {
-        std::cout << "Cannot open file " << path << std::endl;
+        SetDrawData(0, 0);
         return;
     }
+    setMesh(vertices);
+}
 
-    while (true)
+/**
+ * @brief Creates the VAO class object, OpenGL VBO and EBO
+ * @details Uploads a mesh that was already loaded, e.g. parsed on a worker thread
+ * @param vertices Expanded triangle list, as ObjLoader produces it
+ */
+Shape::Shape(GLenum type, const std::vector<Vertex> &vertices) : vbo(GL_ARRAY_BUFFER, type), ebo(GL_ELEMENT_ARRAY_BUFFER, type),
+                                                                shadingVbo(GL_ARRAY_BUFFER, type)
+{
+    initMatrices();
+    if (vertices.empty())
     {
-        char lineHeader[128];
-        // read the first word of the line
-        int res = fscanf(file, "%s", lineHeader);
-        if (res == EOF)
-            break; // EOF = End Of File. Quit the loop.
-
-        // else : parse lineHeader
-        if (strcmp(lineHeader, "v") == 0)
-        {
-            fscanf(file, "%f %f %f\n", &buffer[0], &buffer[1], &buffer[2]);
-            positions.push_back(vec3(buffer[0], buffer[1], buffer[2]));
-        }
-        else if (strcmp(lineHeader, "vt") == 0)
-        {
-            fscanf(file, "%f %f\n", &buffer[0], &buffer[1]);
-            uvs.push_back(vec3(buffer[0], buffer[1], buffer[2]));
-        }
-        else if (strcmp(lineHeader, "vn") == 0)
-        {
-            fscanf(file, "%f %f %f\n", &buffer[0], &buffer[1], &buffer[2]);
-            normals.push_back(vec3(buffer[0], buffer[1], buffer[2]));
-        }
-        else if (strcmp(lineHeader, "f") == 0)
-        {
-            std::string vertex1, vertex2, vertex3;
-            unsigned int vertexIndex[3], uvIndex[3], normalIndex[3];
-            int matches = fscanf(file, "%d/%d/%d %d/%d/%d %d/%d/%d\n", &vertexIndex[0], &uvIndex[0], &normalIndex[0], &vertexIndex[1], &uvIndex[1], &normalIndex[1], &vertexIndex[2], &uvIndex[2], &normalIndex[2]);
-            if (matches != 9)
-            {
-                printf("Unable to read OBJ file! Make sure all face vertices are present.\n");
-                return;
-            }
-            for (int i = 0; i < 3; i++)
-            {
-                vertexIndices.push_back(vertexIndex[i]);
-                uvIndices.push_back(uvIndex[i]);
-                normalIndices.push_back(normalIndex[i]);
-            }
-            faceCount++;
-        }
+        SetDrawData(0, 0);
+        return;
     }
+    setMesh(vertices);
+}
 
-    fclose(file);
-
-    // std::cout << faceCount << std::endl;
-
-    Vertex *vBuffer;
-    vec3 defaultVec3 = vec3(0, 0, 0);
-    vec2 defaultVec2 = vec2(0, 0);
+/**
+ * @brief Uploads an expanded triangle list and derives the bounding sphere from it
+ */
+void Shape::setMesh(const std::vector<Vertex> &vertices)
+{
+    setVertices(vertices);
+    setBounds(vertices);
+    SetDrawData(0, vertices.size());
+}
 
-    for (int i = 0; i < faceCount * 3; i++)
+/**
+ * @brief Sets the bounding sphere around the center of the box of some vertices, no bounds when there are none
+ */
+void Shape::setBounds(const std::vector<Vertex> &vertices)
+{
+    if (vertices.empty())
     {
-        vBuffer = new Vertex();
-        vBuffer->position = positions.size() > 0 ? positions[vertexIndices[i] - 1] : defaultVec3;
-        vBuffer->normal = normals.size() > 0 ? normals[normalIndices[i] - 1] : defaultVec3;
-        vBuffer->texture = uvs.size() > 0 ? uvs[uvIndices[i] - 1] : defaultVec2;
-
-        vertices.push_back(*vBuffer);
+        SetBounds(vec3(0, 0, 0), -1);
+        return;
     }
+    vec3 lo = vertices[0].position, hi = vertices[0].position;
+    for (const Vertex &v : vertices)
+    {
+        lo = glm::min(lo, v.position);
+        hi = glm::max(hi, v.position);
+    }
+    float radius = 0;
+    for (const Vertex &v : vertices)
+    {
+        radius = glm::max(radius, glm::length(v.position - (lo + hi) * 0.5f));
+    }
+    SetBounds((lo + hi) * 0.5f, radius);
+}
 
-    initMatrices();
-    UpdateData(&vertices[0], vertices.size() * sizeof(Vertex));
-
-    SetVertexPointer(0, 3, 8, 0);
-    SetVertexPointer(1, 2, 8, 3);
-    SetVertexPointer(2, 3, 8, 5);
-    SetDrawData(0, vertices.size());
+/**
+ * @brief Uploads vertices as the two streams of VertexLayouts::Split
+ * @details The vertex array reads both, the depth vertex array only the positions, so the depth pre-pass fetches
+ * 12 instead of 32 bytes per vertex.
+ */
+void Shape::setVertices(const std::vector<Vertex> &vertices)
+{
+    std::vector<vec3> positions;
+    std::vector<ShadingVertex> shading;
+    VertexLayouts::SplitStreams(vertices, positions, shading);
+    vbo.UpdateData(positions.data(), positions.size() * sizeof(vec3));
+    shadingVbo.UpdateData(shading.data(), shading.size() * sizeof(ShadingVertex));
+    VertexLayouts::Split::Link(vao, vbo, shadingVbo);
+    VertexLayout<VertexLayouts::Positions>::Link(depthVao, vbo);
+    vao.Bind();
+    drawMethod = Triangles;
 }
 
 /**
@@ -196,8 +241,8 @@ Shape::Shape(GLenum type, std::string path) : vbo(GL_ARRAY_BUFFER, type), ebo(GL
  */
 void Shape::initMatrices()
 {
-    model = glm::mat4(1.0f);
-    view = glm::mat4(1.0f);
+    transform = Transform();
+    drawMethod = Triangles;
 
     ms = MatrixStack::getInstance();
 }
@@ -254,6 +299,11 @@ void Shape::SetVertexPointer(GLuint layout, int elements, int span, int index)
 {
     Bind();
     vao.LinkVB(vbo, layout, elements, span, index);
+    if (layout == 0)
+    {
+        depthVao.LinkVB(vbo, layout, elements, span, index);
+        vao.Bind();
+    }
 }
 /**
     @brief Binds the shape object (VAO, VBO, EBO, Texture)
@@ -295,34 +345,160 @@ void Shape::SetDrawData(int first, int elements)
  */
 void Shape::Draw()
 {
-    ms->push();
-    ms->top() *= view;
-    shader->use();
-    shader->setMatrix4("view", ms->top());
-    shader->setMatrix4("model", model);
-    shader->setMatrix4("objectView", view);
-    // Set the material in the shader
-    if (mat != nullptr)
+    ObjectBlock block;
+    block.Set(currentShader()->getProjection() * ms->top(), transform.World(), MaterialIndex());
+    ObjectBuffer::getInstance()->Upload(block);
+    drawObject(0, nullptr, 0);
+}
+
+/**
+    @brief Draws the shape with precomputed object matrices
+    @param block MVP, world and normal matrices to draw with, its material slot is replaced by the shape's
+ */
+void Shape::Draw(const ObjectBlock &block)
+{
+    ObjectBlock withMaterial = block;
+    withMaterial.material.x = MaterialIndex();
+    ObjectBuffer::getInstance()->Upload(withMaterial);
+    Draw(0);
+}
+
+/**
+    @brief Draws the shape with a block that was uploaded as part of a batch
+    @details Used by RenderQueue, which computes the blocks of every shape on worker threads and uploads them at
+    once, on the render thread, which draws the blocks copied into a frame packet rather than the shape's live
+    transform.
+    @param object Index of the shape's block in the current ObjectBuffer batch
+    @param ranges Index ranges of the meshlets that survived culling, nullptr draws the whole shape
+    @param rangeCount Number of ranges
+ */
+void Shape::Draw(int object, const Meshlets::Range *ranges, int rangeCount)
+{
+    currentShader();
+    drawObject(object, ranges, rangeCount);
+}
+
+/**
+    @brief Draws the shape's depth only
+    @details For the depth pre-pass: the caller binds the depth program (RenderQueue::BeginDepthPrepass), the shape
+    only binds its position stream and its object block.
+ */
+void Shape::DrawDepth()
+{
+    ObjectBlock block;
+    block.Set(currentShader()->getProjection() * ms->top(), transform.World());
+    ObjectBuffer::getInstance()->Upload(block);
+    DrawDepth(0);
+}
+
+/**
+    @brief Draws the shape's depth only with a block that was uploaded as part of a batch
+    @param object Index of the shape's block in the current ObjectBuffer batch
+    @param ranges Index ranges of the meshlets that survived culling, nullptr draws the whole shape
+    @param rangeCount Number of ranges
+ */
+void Shape::DrawDepth(int object, const Meshlets::Range *ranges, int rangeCount)
+{
+    ObjectBuffer::getInstance()->Bind(object);
+    depthVao.Bind();
+    ebo.Bind();
+    drawCall(ranges, rangeCount);
+    RenderStats::frame.prepassDraws++;
+    depthVao.Unbind();
+}
+
+/**
+    @brief Draws the whole shape's depth into a shadow map
+    @details The caller binds the shadow map's framebuffer and the depth program (see CascadedShadowMap), the shape
+    only binds its position stream and its object block, which holds the light's matrices.
+    @param object Index of the shape's block in the current ObjectBuffer batch
+ */
+void Shape::DrawShadow(int object)
+{
+    ObjectBuffer::getInstance()->Bind(object);
+    depthVao.Bind();
+    ebo.Bind();
+    drawCall(nullptr, 0);
+    RenderStats::frame.shadowDraws++;
+    depthVao.Unbind();
+}
+
+/**
+    @brief Draws with the current shader and a block of the current ObjectBuffer batch
+ */
+void Shape::drawObject(int object, const Meshlets::Range *ranges, int rangeCount)
+{
+    PROFILE_SCOPE("Shape::Draw");
+    shader.load(std::memory_order_relaxed)->use();
+    ObjectBuffer::getInstance()->Bind(object);
+    // The material is read from the MaterialBlock by the slot in the object block, this only uploads new materials
+    MaterialBuffer::getInstance()->Upload();
+
+    if (lightmap != nullptr)
     {
-        shader->setVec3("material.ambient", mat->ambient);
-        shader->setVec3("material.diffuse", mat->diffuse);
-        shader->setVec3("material.specular", mat->specular);
-        shader->setFloat("material.shininess", mat->shininess);
+        glActiveTexture(GL_TEXTURE0 + LIGHTMAP_TEXTURE_UNIT);
+        lightmap->Bind();
+        glActiveTexture(GL_TEXTURE0);
     }
-
     Bind();
+    drawCall(ranges, rangeCount);
+    Unbind();
+}
+
+/**
+    @brief Selects the variant that fits the shape's features and the scene, call on the context thread
+    @details The key lookup (and a compile the first time) happens here, when the texture, the lightmap, the
+    variant cache or the scene's lights and shadows change, not per draw.
+ */
+void Shape::selectVariant()
+{
+    variantVersion = ShaderVariants::version.load();
+    shader.store(variants->Select(textured, false, false, lightmap != nullptr), std::memory_order_relaxed);
+}
+
+/**
+    @brief Returns the program to draw with, selecting the variant again only if the scene changed since
+ */
+Shader *Shape::currentShader()
+{
+    if (variants != nullptr && variantVersion != ShaderVariants::version.load(std::memory_order_relaxed))
+    {
+        selectVariant();
+    }
+    return shader.load(std::memory_order_relaxed);
+}
+
+/**
+    @brief Issues the draw call for the bound vertex array
+    @details Meshlet ranges go out as one glMultiDrawElements, the whole shape as one glDrawArrays/glDrawElements.
+ */
+void Shape::drawCall(const Meshlets::Range *ranges, int rangeCount)
+{
+    if (ranges != nullptr && drawMethod == Elements)
+    {
+        long long indices = 0;
+        for (int i = 0; i < rangeCount; i++)
+        {
+            rangeCounts[i] = (GLsizei)ranges[i].indexCount;
+            rangeOffsets[i] = (const void *)(ranges[i].firstIndex * sizeof(unsigned int));
+            indices += ranges[i].indexCount;
+        }
+        glMultiDrawElements(GL_TRIANGLES, rangeCounts.data(), GL_UNSIGNED_INT, rangeOffsets.data(), rangeCount);
+        RenderStats::countDraw(indices);
+        return;
+    }
     switch (drawMethod)
     {
     case Triangles:
         glDrawArrays(GL_TRIANGLES, drawFirst, drawElements);
+        RenderStats::countDraw(drawElements);
         break;
     case Elements:
         glDrawElements(GL_TRIANGLES, drawElements, GL_UNSIGNED_INT, (void *)(drawFirst * sizeof(float)));
+        RenderStats::countDraw(drawElements);
     default:
         break;
     }
-    Unbind();
-    ms->pop();
 }
 
 /**
@@ -334,6 +510,39 @@ void Shape::SetTexture(Texture &txtr)
 {
     Bind();
     tex = txtr;
+    textured = true;
+    if (variants != nullptr)
+    {
+        selectVariant();
+    }
+}
+
+/**
+    @brief Draws the shape with the ambient and diffuse light of the baked lights read from a lightmap
+    @details The lightmap is not owned by the shape. Only shapes drawn from a triangle list can have one, every
+    corner needs coordinates of its own (see Lightmap.h).
+    @param lightmapTexture Lightmap written by the baker (LightmapBaker.h)
+    @param coords Lightmap coordinates of every vertex
+    @returns bool, false (with a message) when the shape is indexed or the coordinates do not match its vertices
+ */
+bool Shape::SetLightmap(Texture *lightmapTexture, const std::vector<vec2> &coords)
+{
+    if (drawMethod != Triangles || (int)coords.size() != drawElements)
+    {
+        std::cout << "Lightmaps need a triangle list with one coordinate per vertex" << std::endl;
+        return false;
+    }
+    lightmapVbo.UpdateData(coords.data(), coords.size() * sizeof(vec2));
+    vao.Bind();
+    lightmapVbo.Bind();
+    VertexLayouts::LightmapCoords::Link();
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    lightmap = lightmapTexture;
+    if (variants != nullptr)
+    {
+        selectVariant();
+    }
+    return true;
 }
 
 /**
@@ -343,7 +552,7 @@ void Shape::SetTexture(Texture &txtr)
  */
 void Shape::Rotate(float angle, vec3 axis)
 {
-    model = glm::rotate(glm::mat4(1.0f), angle, axis) * model;
+    transform.Rotate(angle, axis);
 }
 
 /**
@@ -353,7 +562,7 @@ void Shape::Rotate(float angle, vec3 axis)
  */
 void Shape::Scale(float scalar)
 {
-    model = glm::scale(model, vec3(scalar, scalar, scalar));
+    transform.Scale(scalar);
 }
 
 /**
@@ -363,7 +572,7 @@ void Shape::Scale(float scalar)
  */
 void Shape::Translate(vec3 vec)
 {
-    view = glm::translate(view, vec);
+    transform.Translate(vec);
 }
 
 /**
@@ -373,17 +582,197 @@ void Shape::Translate(vec3 vec)
  */
 void Shape::SetShader(Shader *shdr)
 {
-    shader = shdr;
+    shader.store(shdr, std::memory_order_relaxed);
+    variants = nullptr;
+}
+
+/**
+    @brief Sets a shader variant cache
+    @details The shape draws with the cheapest variant of the cache that fits it (texture, lightmap) and the scene
+    (lights, shadows). The variant is selected now and again whenever one of those changes, draws reuse it.
+    @param vars The variant cache to select from
+ */
+void Shape::SetShader(ShaderVariants *vars)
+{
+    variants = vars;
+    selectVariant();
 }
 
 Shader *Shape::GetShader()
 {
-    return shader;
+    return shader.load(std::memory_order_relaxed);
 }
 
+/**
+    @brief Sets the material, registering it with the MaterialBuffer
+    @details Edits to the material afterwards reach the shaders through MaterialBuffer::Update().
+ */
 void Shape::SetMaterial(Material *_mat)
 {
     mat = _mat;
+    MaterialBuffer::getInstance()->Register(mat);
+}
+
+int Shape::MaterialIndex() const
+{
+    return mat != nullptr ? std::max(mat->index, 0) : 0;
+}
+
+const Transform &Shape::GetTransform() const
+{
+    return transform;
+}
+
+void Shape::SetTransform(const Transform &_transform)
+{
+    transform = _transform;
+}
+
+/**
+    @brief Sets the object space bounding sphere used for culling
+    @param center Center of the sphere
+    @param radius Radius of the sphere, negative to never cull the shape
+ */
+void Shape::SetBounds(vec3 center, float radius)
+{
+    boundsCenter = center;
+    boundsRadius = radius;
+}
+
+/**
+    @brief Gets the object space bounding sphere
+    @returns bool, false if the shape has no bounds
+ */
+bool Shape::GetBounds(vec3 &center, float &radius) const
+{
+    center = boundsCenter;
+    radius = boundsRadius;
+    return boundsRadius >= 0;
+}
+
+/**
+    @brief Sets the geometry the shape occludes with
+    @details The triangles are rendered into the OcclusionCuller's depth buffer every frame the shape is in view, so
+    they should be few and must lie inside the drawn mesh (an occluder bigger than the mesh hides visible objects).
+    @param triangles Object space triangle list, three positions per triangle, empty to stop occluding
+ */
+void Shape::SetOccluder(const std::vector<vec3> &triangles)
+{
+    occluder = triangles;
+}
+
+/**
+    @brief Loads the geometry the shape occludes with from an obj file
+    @param objPath Path to the obj file, usually a low poly version of the drawn mesh
+    @returns bool, whether the file could be read
+ */
+bool Shape::SetOccluder(std::string objPath)
+{
+    std::vector<Vertex> vertices;
+    occluder.clear();
+    if (!ObjLoader::Load(objPath, vertices))
+    {
+        return false;
+    }
+    occluder.reserve(vertices.size());
+    for (const Vertex &v : vertices)
+    {
+        occluder.push_back(v.position);
+    }
+    return true;
+}
+
+const std::vector<vec3> &Shape::GetOccluder() const
+{
+    return occluder;
+}
+
+/**
+    @brief Sets the hierarchy rays pick the shape with
+    @details The hierarchy is not owned by the shape and may be shared by every shape drawing the same mesh. Its
+    triangles must be the drawn ones in draw order, so a pick reports the triangle the index or vertex buffer holds.
+    @param bvh Object space hierarchy over the shape's triangles, null to make the shape unpickable
+ */
+void Shape::SetPickMesh(const Bvh *bvh)
+{
+    pickMesh = bvh;
+}
+
+const Bvh *Shape::GetPickMesh() const
+{
+    return pickMesh;
+}
+
+/**
+    @brief Replaces the mesh with an indexed version split into meshlets
+    @details The OBJ's identical vertices are merged and its triangles are grouped into meshlets, each with a bounding
+    sphere and a normal cone (see Meshlet.h), and uploaded in meshlet order. RenderQueue::Build then culls the
+    meshlets that are off screen or face away from the camera and the shape draws the rest with one
+    glMultiDrawElements. Meant for large closed meshes, where about half of the triangles face away at any time.
+    @param objPath Path to the obj file
+    @param maxVertices Distinct vertices a meshlet may reference
+    @param maxTriangles Triangles a meshlet may hold
+    @returns bool, whether the file could be read
+ */
+bool Shape::SetMeshlets(std::string objPath, int maxVertices, int maxTriangles)
+{
+    std::vector<Vertex> expanded, vertices;
+    std::vector<uint32_t> indices, meshletIndices;
+    std::vector<Meshlets::Meshlet> built;
+    if (!ObjLoader::Load(objPath, expanded) || expanded.empty())
+    {
+        return false;
+    }
+    Meshlets::Weld(expanded, vertices, indices);
+    Meshlets::Build(vertices, indices, built, meshletIndices, maxVertices, maxTriangles);
+    SetMeshlets(vertices, meshletIndices, built);
+    return true;
+}
+
+/**
+    @brief Replaces the mesh with meshlets that were already built
+    @details Only uploads, so the welding and clustering can run on worker threads (see Scene). An empty set leaves
+    the shape as it was.
+    @param vertices Distinct vertices, as Meshlets::Weld produces them
+    @param meshletIndices Triangles in meshlet order, as Meshlets::Build produces them
+    @param meshlets The meshlets indexing meshletIndices
+ */
+void Shape::SetMeshlets(const std::vector<Vertex> &vertices, const std::vector<uint32_t> &meshletIndices,
+                        const std::vector<Meshlets::Meshlet> &meshlets)
+{
+    if (vertices.empty() || meshletIndices.empty())
+    {
+        return;
+    }
+    this->meshlets = meshlets;
+    rangeCounts.resize(meshlets.size());
+    rangeOffsets.resize(meshlets.size());
+
+    setVertices(vertices);
+    ebo.UpdateData((unsigned int *)meshletIndices.data(), meshletIndices.size() * sizeof(unsigned int));
+    drawMethod = Elements;
+    SetDrawData(0, meshletIndices.size());
+    setBounds(vertices);
+}
+
+const std::vector<Meshlets::Meshlet> &Shape::GetMeshlets() const
+{
+    return meshlets;
+}
+
+/**
+    @brief Identifies the program the shape draws with (its selected variant or shader) for sorting draws
+    @details The variant is only selected again on the context thread when the scene's lights or shadows change, so
+    a list sorted before such a change is off by that frame at most.
+ */
+const void *Shape::StateKey() const
+{
+    return shader.load(std::memory_order_relaxed);
+}
+
+unsigned int Shape::VertexArray() const
+{
+    return vao.ID;
 }
 
 #endif
\ No newline at end of file
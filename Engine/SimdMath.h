@@ -0,0 +1,479 @@
+/**
+    @file SimdMath.h
+    @brief Batched matrix kernels with SSE and AVX2 paths picked at runtime
+    @details Every kernel works on arrays of glm matrices: mat4 multiply, affine inverse, normal matrix and AABB
+    transform. At startup the CPU is detected (cpuid) and the widest supported implementation is bound: AVX2 + FMA,
+    SSE2, or the scalar glm code, which is also what non-x86 targets use. The AVX2 paths are compiled with
+    per-function target attributes, so the engine needs no -mavx2 and still runs on any x86-64 CPU. setLevel()
+    forces a path, which the benchmarks use to compare the kernels against glm's own code. Outputs may alias the
+    matrix inputs (in-place updates), matrices need no particular alignment.
+*/
+
+#pragma once
+#ifndef SIMDMATH_H
+#define SIMDMATH_H
+
+#include <glm/glm.hpp>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define SIMDMATH_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define SIMDMATH_TARGET_AVX2
+#else
+#define SIMDMATH_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#endif
+#else
+#define SIMDMATH_X86 0
+#endif
+
+/**
+    @brief Axis aligned bounding box
+*/
+struct AABB
+{
+  glm::vec3 min, max;
+};
+
+static_assert(sizeof(glm::mat4) == 16 * sizeof(float), "SimdMath expects a tightly packed glm::mat4");
+static_assert(sizeof(glm::mat3) == 9 * sizeof(float), "SimdMath expects a tightly packed glm::mat3");
+static_assert(sizeof(AABB) == 6 * sizeof(float), "SimdMath expects a tightly packed AABB");
+
+namespace SimdMath
+{
+  enum Level
+  {
+    Scalar,
+    SSE,
+    AVX2
+  };
+
+  struct Kernels
+  {
+    void (*multiply)(const glm::mat4 &a, const glm::mat4 *b, glm::mat4 *out, int count);
+    void (*affineInverse)(const glm::mat4 *in, glm::mat4 *out, int count);
+    void (*normalMatrix)(const glm::mat4 *in, glm::mat3 *out, int count);
+    void (*transformAABB)(const glm::mat4 &m, const AABB *in, AABB *out, int count);
+  };
+
+  //====| Scalar (glm) |====//
+
+  void multiplyScalar(const glm::mat4 &a, const glm::mat4 *b, glm::mat4 *out, int count)
+  {
+    for (int i = 0; i < count; i++)
+    {
+      out[i] = a * b[i];
+    }
+  }
+
+  void affineInverseScalar(const glm::mat4 *in, glm::mat4 *out, int count)
+  {
+    for (int i = 0; i < count; i++)
+    {
+      glm::mat3 inverse = glm::inverse(glm::mat3(in[i]));
+      glm::vec3 translation = -(inverse * glm::vec3(in[i][3]));
+      out[i] = glm::mat4(inverse);
+      out[i][3] = glm::vec4(translation, 1.0f);
+    }
+  }
+
+  void normalMatrixScalar(const glm::mat4 *in, glm::mat3 *out, int count)
+  {
+    for (int i = 0; i < count; i++)
+    {
+      out[i] = glm::transpose(glm::inverse(glm::mat3(in[i])));
+    }
+  }
+
+  void transformAABBScalar(const glm::mat4 &m, const AABB *in, AABB *out, int count)
+  {
+    glm::vec3 x = glm::abs(glm::vec3(m[0])), y = glm::abs(glm::vec3(m[1])), z = glm::abs(glm::vec3(m[2]));
+    for (int i = 0; i < count; i++)
+    {
+      glm::vec3 center = (in[i].min + in[i].max) * 0.5f;
+      glm::vec3 extent = (in[i].max - in[i].min) * 0.5f;
+      glm::vec3 c = glm::vec3(m * glm::vec4(center, 1.0f));
+      glm::vec3 e = x * extent.x + y * extent.y + z * extent.z;
+      out[i].min = c - e;
+      out[i].max = c + e;
+    }
+  }
+
+#if SIMDMATH_X86
+  //====| SSE |====//
+
+#define SIMDMATH_SPLAT(v, i) _mm_shuffle_ps(v, v, _MM_SHUFFLE(i, i, i, i))
+
+  // Cross product of the xyz parts, w of the result is 0 when both w are 0
+  inline __m128 cross(__m128 a, __m128 b)
+  {
+    __m128 aYZX = _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 0, 2, 1));
+    __m128 bYZX = _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 0, 2, 1));
+    __m128 c = _mm_sub_ps(_mm_mul_ps(a, bYZX), _mm_mul_ps(aYZX, b));
+    return _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 0, 2, 1));
+  }
+
+  // Dot product of the xyz parts in every lane
+  inline __m128 dot3(__m128 a, __m128 b)
+  {
+    __m128 p = _mm_mul_ps(a, b);
+    return _mm_add_ps(_mm_add_ps(SIMDMATH_SPLAT(p, 0), SIMDMATH_SPLAT(p, 1)), SIMDMATH_SPLAT(p, 2));
+  }
+
+  // Rows of inverse(mat3(m)) with w = 0, which are the columns of the normal matrix
+  inline void inverseRows(const float *m, __m128 &r0, __m128 &r1, __m128 &r2)
+  {
+    const __m128 xyz = _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1));
+    __m128 c0 = _mm_and_ps(_mm_loadu_ps(m), xyz);
+    __m128 c1 = _mm_and_ps(_mm_loadu_ps(m + 4), xyz);
+    __m128 c2 = _mm_and_ps(_mm_loadu_ps(m + 8), xyz);
+    r0 = cross(c1, c2);
+    r1 = cross(c2, c0);
+    r2 = cross(c0, c1);
+    __m128 inverseDeterminant = _mm_div_ps(_mm_set1_ps(1.0f), dot3(c0, r0));
+    r0 = _mm_mul_ps(r0, inverseDeterminant);
+    r1 = _mm_mul_ps(r1, inverseDeterminant);
+    r2 = _mm_mul_ps(r2, inverseDeterminant);
+  }
+
+  // Stores the xyz of v
+  inline void store3(float *p, __m128 v)
+  {
+    _mm_storel_pi((__m64 *)p, v);
+    _mm_store_ss(p + 2, _mm_movehl_ps(v, v));
+  }
+
+  // Loads center and extent of a box
+  inline void loadAABB(const AABB &box, __m128 &center, __m128 &extent)
+  {
+    const float *p = &box.min.x;
+    __m128 min = _mm_loadu_ps(p);
+    __m128 max = _mm_loadu_ps(p + 2); // min.z, max.x, max.y, max.z
+    max = _mm_shuffle_ps(max, max, _MM_SHUFFLE(3, 3, 2, 1));
+    center = _mm_mul_ps(_mm_add_ps(min, max), _mm_set1_ps(0.5f));
+    extent = _mm_mul_ps(_mm_sub_ps(max, min), _mm_set1_ps(0.5f));
+  }
+
+  // Stores min and max of a box without writing past it
+  inline void storeAABB(AABB &box, __m128 min, __m128 max)
+  {
+    float *p = &box.min.x;
+    __m128 shifted = _mm_shuffle_ps(min, max, _MM_SHUFFLE(0, 0, 2, 2));
+    shifted = _mm_shuffle_ps(shifted, max, _MM_SHUFFLE(2, 1, 2, 0)); // min.z, max.x, max.y, max.z
+    _mm_storeu_ps(p, min);
+    _mm_storeu_ps(p + 2, shifted);
+  }
+
+  void multiplySSE(const glm::mat4 &a, const glm::mat4 *b, glm::mat4 *out, int count)
+  {
+    const float *pa = &a[0][0];
+    __m128 a0 = _mm_loadu_ps(pa), a1 = _mm_loadu_ps(pa + 4), a2 = _mm_loadu_ps(pa + 8), a3 = _mm_loadu_ps(pa + 12);
+    for (int i = 0; i < count; i++)
+    {
+      const float *pb = &b[i][0][0];
+      float *po = &out[i][0][0];
+      for (int j = 0; j < 4; j++)
+      {
+        __m128 column = _mm_loadu_ps(pb + 4 * j);
+        __m128 r = _mm_mul_ps(a0, SIMDMATH_SPLAT(column, 0));
+        r = _mm_add_ps(r, _mm_mul_ps(a1, SIMDMATH_SPLAT(column, 1)));
+        r = _mm_add_ps(r, _mm_mul_ps(a2, SIMDMATH_SPLAT(column, 2)));
+        r = _mm_add_ps(r, _mm_mul_ps(a3, SIMDMATH_SPLAT(column, 3)));
+        _mm_storeu_ps(po + 4 * j, r);
+      }
+    }
+  }
+
+  void affineInverseSSE(const glm::mat4 *in, glm::mat4 *out, int count)
+  {
+    for (int i = 0; i < count; i++)
+    {
+      const float *m = &in[i][0][0];
+      __m128 c0, c1, c2, c3 = _mm_setzero_ps();
+      inverseRows(m, c0, c1, c2);
+      __m128 t = _mm_loadu_ps(m + 12);
+      _MM_TRANSPOSE4_PS(c0, c1, c2, c3); // Rows to columns, c3 stays 0
+      __m128 translation = _mm_add_ps(_mm_add_ps(_mm_mul_ps(c0, SIMDMATH_SPLAT(t, 0)), _mm_mul_ps(c1, SIMDMATH_SPLAT(t, 1))),
+                                      _mm_mul_ps(c2, SIMDMATH_SPLAT(t, 2)));
+      c3 = _mm_sub_ps(_mm_set_ps(1.0f, 0, 0, 0), translation);
+      float *po = &out[i][0][0];
+      _mm_storeu_ps(po, c0);
+      _mm_storeu_ps(po + 4, c1);
+      _mm_storeu_ps(po + 8, c2);
+      _mm_storeu_ps(po + 12, c3);
+    }
+  }
+
+  void normalMatrixSSE(const glm::mat4 *in, glm::mat3 *out, int count)
+  {
+    for (int i = 0; i < count; i++)
+    {
+      __m128 n0, n1, n2;
+      inverseRows(&in[i][0][0], n0, n1, n2);
+      float *po = &out[i][0][0];
+      _mm_storeu_ps(po, n0); // The w lanes are overwritten by the next column
+      _mm_storeu_ps(po + 3, n1);
+      store3(po + 6, n2);
+    }
+  }
+
+  void transformAABBSSE(const glm::mat4 &m, const AABB *in, AABB *out, int count)
+  {
+    const float *pm = &m[0][0];
+    const __m128 sign = _mm_set1_ps(-0.0f);
+    __m128 m0 = _mm_loadu_ps(pm), m1 = _mm_loadu_ps(pm + 4), m2 = _mm_loadu_ps(pm + 8), m3 = _mm_loadu_ps(pm + 12);
+    __m128 a0 = _mm_andnot_ps(sign, m0), a1 = _mm_andnot_ps(sign, m1), a2 = _mm_andnot_ps(sign, m2);
+    for (int i = 0; i < count; i++)
+    {
+      __m128 center, extent;
+      loadAABB(in[i], center, extent);
+      __m128 c = _mm_add_ps(_mm_add_ps(m3, _mm_mul_ps(m0, SIMDMATH_SPLAT(center, 0))),
+                            _mm_add_ps(_mm_mul_ps(m1, SIMDMATH_SPLAT(center, 1)), _mm_mul_ps(m2, SIMDMATH_SPLAT(center, 2))));
+      __m128 e = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a0, SIMDMATH_SPLAT(extent, 0)), _mm_mul_ps(a1, SIMDMATH_SPLAT(extent, 1))),
+                            _mm_mul_ps(a2, SIMDMATH_SPLAT(extent, 2)));
+      storeAABB(out[i], _mm_sub_ps(c, e), _mm_add_ps(c, e));
+    }
+  }
+
+  //====| AVX2 + FMA, two columns or two matrices per register |====//
+
+#define SIMDMATH_SPLAT8(v, i) _mm256_permute_ps(v, _MM_SHUFFLE(i, i, i, i))
+
+  SIMDMATH_TARGET_AVX2 inline __m256 cross8(__m256 a, __m256 b)
+  {
+    __m256 aYZX = _mm256_permute_ps(a, _MM_SHUFFLE(3, 0, 2, 1));
+    __m256 bYZX = _mm256_permute_ps(b, _MM_SHUFFLE(3, 0, 2, 1));
+    __m256 c = _mm256_fmsub_ps(a, bYZX, _mm256_mul_ps(aYZX, b));
+    return _mm256_permute_ps(c, _MM_SHUFFLE(3, 0, 2, 1));
+  }
+
+  // Loads column j of two matrices into the low and high lanes
+  SIMDMATH_TARGET_AVX2 inline __m256 loadPair(const float *low, const float *high)
+  {
+    return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(low)), _mm_loadu_ps(high), 1);
+  }
+
+  // inverseRows for the matrices at p and q
+  SIMDMATH_TARGET_AVX2 inline void inverseRows8(const float *p, const float *q, __m256 &r0, __m256 &r1, __m256 &r2)
+  {
+    const __m256 xyz = _mm256_castsi256_ps(_mm256_set_epi32(0, -1, -1, -1, 0, -1, -1, -1));
+    __m256 c0 = _mm256_and_ps(loadPair(p, q), xyz);
+    __m256 c1 = _mm256_and_ps(loadPair(p + 4, q + 4), xyz);
+    __m256 c2 = _mm256_and_ps(loadPair(p + 8, q + 8), xyz);
+    r0 = cross8(c1, c2);
+    r1 = cross8(c2, c0);
+    r2 = cross8(c0, c1);
+    __m256 d = _mm256_mul_ps(c0, r0);
+    d = _mm256_add_ps(_mm256_add_ps(SIMDMATH_SPLAT8(d, 0), SIMDMATH_SPLAT8(d, 1)), SIMDMATH_SPLAT8(d, 2));
+    __m256 inverseDeterminant = _mm256_div_ps(_mm256_set1_ps(1.0f), d);
+    r0 = _mm256_mul_ps(r0, inverseDeterminant);
+    r1 = _mm256_mul_ps(r1, inverseDeterminant);
+    r2 = _mm256_mul_ps(r2, inverseDeterminant);
+  }
+
+  SIMDMATH_TARGET_AVX2 void multiplyAVX2(const glm::mat4 &a, const glm::mat4 *b, glm::mat4 *out, int count)
+  {
+    const float *pa = &a[0][0];
+    __m256 a0 = _mm256_broadcast_ps((const __m128 *)pa), a1 = _mm256_broadcast_ps((const __m128 *)(pa + 4));
+    __m256 a2 = _mm256_broadcast_ps((const __m128 *)(pa + 8)), a3 = _mm256_broadcast_ps((const __m128 *)(pa + 12));
+    for (int i = 0; i < count; i++)
+    {
+      const float *pb = &b[i][0][0];
+      float *po = &out[i][0][0];
+      __m256 columns01 = _mm256_loadu_ps(pb), columns23 = _mm256_loadu_ps(pb + 8);
+      __m256 r01 = _mm256_mul_ps(a0, SIMDMATH_SPLAT8(columns01, 0));
+      __m256 r23 = _mm256_mul_ps(a0, SIMDMATH_SPLAT8(columns23, 0));
+      r01 = _mm256_fmadd_ps(a1, SIMDMATH_SPLAT8(columns01, 1), r01);
+      r23 = _mm256_fmadd_ps(a1, SIMDMATH_SPLAT8(columns23, 1), r23);
+      r01 = _mm256_fmadd_ps(a2, SIMDMATH_SPLAT8(columns01, 2), r01);
+      r23 = _mm256_fmadd_ps(a2, SIMDMATH_SPLAT8(columns23, 2), r23);
+      r01 = _mm256_fmadd_ps(a3, SIMDMATH_SPLAT8(columns01, 3), r01);
+      r23 = _mm256_fmadd_ps(a3, SIMDMATH_SPLAT8(columns23, 3), r23);
+      _mm256_storeu_ps(po, r01);
+      _mm256_storeu_ps(po + 8, r23);
+    }
+  }
+
+  SIMDMATH_TARGET_AVX2 void affineInverseAVX2(const glm::mat4 *in, glm::mat4 *out, int count)
+  {
+    int i = 0;
+    for (; i + 1 < count; i += 2)
+    {
+      const float *p = &in[i][0][0], *q = &in[i + 1][0][0];
+      __m256 r0, r1, r2, r3 = _mm256_setzero_ps();
+      inverseRows8(p, q, r0, r1, r2);
+      __m256 t = loadPair(p + 12, q + 12);
+      // 4x4 transpose within each lane, rows become columns
+      __m256 t0 = _mm256_unpacklo_ps(r0, r1), t1 = _mm256_unpacklo_ps(r2, r3);
+      __m256 t2 = _mm256_unpackhi_ps(r0, r1), t3 = _mm256_unpackhi_ps(r2, r3);
+      __m256 c0 = _mm256_shuffle_ps(t0, t1, _MM_SHUFFLE(1, 0, 1, 0));
+      __m256 c1 = _mm256_shuffle_ps(t0, t1, _MM_SHUFFLE(3, 2, 3, 2));
+      __m256 c2 = _mm256_shuffle_ps(t2, t3, _MM_SHUFFLE(1, 0, 1, 0));
+      __m256 translation = _mm256_mul_ps(c0, SIMDMATH_SPLAT8(t, 0));
+      translation = _mm256_fmadd_ps(c1, SIMDMATH_SPLAT8(t, 1), translation);
+      translation = _mm256_fmadd_ps(c2, SIMDMATH_SPLAT8(t, 2), translation);
+      __m256 c3 = _mm256_sub_ps(_mm256_set_ps(1.0f, 0, 0, 0, 1.0f, 0, 0, 0), translation);
+      float *po = &out[i][0][0], *qo = &out[i + 1][0][0];
+      _mm_storeu_ps(po, _mm256_castps256_ps128(c0));
+      _mm_storeu_ps(po + 4, _mm256_castps256_ps128(c1));
+      _mm_storeu_ps(po + 8, _mm256_castps256_ps128(c2));
+      _mm_storeu_ps(po + 12, _mm256_castps256_ps128(c3));
+      _mm_storeu_ps(qo, _mm256_extractf128_ps(c0, 1));
+      _mm_storeu_ps(qo + 4, _mm256_extractf128_ps(c1, 1));
+      _mm_storeu_ps(qo + 8, _mm256_extractf128_ps(c2, 1));
+      _mm_storeu_ps(qo + 12, _mm256_extractf128_ps(c3, 1));
+    }
+    affineInverseSSE(in + i, out + i, count - i);
+  }
+
+  SIMDMATH_TARGET_AVX2 void normalMatrixAVX2(const glm::mat4 *in, glm::mat3 *out, int count)
+  {
+    int i = 0;
+    for (; i + 1 < count; i += 2)
+    {
+      __m256 n0, n1, n2;
+      inverseRows8(&in[i][0][0], &in[i + 1][0][0], n0, n1, n2);
+      float *po = &out[i][0][0], *qo = &out[i + 1][0][0];
+      _mm_storeu_ps(po, _mm256_castps256_ps128(n0));
+      _mm_storeu_ps(po + 3, _mm256_castps256_ps128(n1));
+      store3(po + 6, _mm256_castps256_ps128(n2));
+      _mm_storeu_ps(qo, _mm256_extractf128_ps(n0, 1));
+      _mm_storeu_ps(qo + 3, _mm256_extractf128_ps(n1, 1));
+      store3(qo + 6, _mm256_extractf128_ps(n2, 1));
+    }
+    normalMatrixSSE(in + i, out + i, count - i);
+  }
+
+  SIMDMATH_TARGET_AVX2 void transformAABBAVX2(const glm::mat4 &m, const AABB *in, AABB *out, int count)
+  {
+    const float *pm = &m[0][0];
+    const __m256 sign = _mm256_set1_ps(-0.0f);
+    __m256 m0 = _mm256_broadcast_ps((const __m128 *)pm), m1 = _mm256_broadcast_ps((const __m128 *)(pm + 4));
+    __m256 m2 = _mm256_broadcast_ps((const __m128 *)(pm + 8)), m3 = _mm256_broadcast_ps((const __m128 *)(pm + 12));
+    __m256 a0 = _mm256_andnot_ps(sign, m0), a1 = _mm256_andnot_ps(sign, m1), a2 = _mm256_andnot_ps(sign, m2);
+    int i = 0;
+    for (; i + 1 < count; i += 2)
+    {
+      __m128 lowCenter, lowExtent, highCenter, highExtent;
+      loadAABB(in[i], lowCenter, lowExtent);
+      loadAABB(in[i + 1], highCenter, highExtent);
+      __m256 center = _mm256_insertf128_ps(_mm256_castps128_ps256(lowCenter), highCenter, 1);
+      __m256 extent = _mm256_insertf128_ps(_mm256_castps128_ps256(lowExtent), highExtent, 1);
+      __m256 c = _mm256_fmadd_ps(m0, SIMDMATH_SPLAT8(center, 0), m3);
+      c = _mm256_fmadd_ps(m1, SIMDMATH_SPLAT8(center, 1), c);
+      c = _mm256_fmadd_ps(m2, SIMDMATH_SPLAT8(center, 2), c);
+      __m256 e = _mm256_mul_ps(a0, SIMDMATH_SPLAT8(extent, 0));
+      e = _mm256_fmadd_ps(a1, SIMDMATH_SPLAT8(extent, 1), e);
+      e = _mm256_fmadd_ps(a2, SIMDMATH_SPLAT8(extent, 2), e);
+      __m256 min = _mm256_sub_ps(c, e), max = _mm256_add_ps(c, e);
+      storeAABB(out[i], _mm256_castps256_ps128(min), _mm256_castps256_ps128(max));
+      storeAABB(out[i + 1], _mm256_extractf128_ps(min, 1), _mm256_extractf128_ps(max, 1));
+    }
+    transformAABBSSE(m, in + i, out + i, count - i);
+  }
+#endif
+
+  //====| Dispatch |====//
+
+  /**
+      @brief Widest kernel set the CPU and OS support
+  */
+  Level detect()
+  {
+#if SIMDMATH_X86
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+    {
+      return SSE;
+    }
+    __cpuid(info, 1);
+    bool fma = info[2] & (1 << 12), osxsave = info[2] & (1 << 27), avx = info[2] & (1 << 28);
+    __cpuidex(info, 7, 0);
+    bool avx2 = info[1] & (1 << 5);
+    return (avx2 && fma && avx && osxsave && (_xgetbv(0) & 6) == 6) ? AVX2 : SSE;
+#else
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+    {
+      return AVX2;
+    }
+    return __builtin_cpu_supports("sse2") ? SSE : Scalar;
+#endif
+#else
+    return Scalar;
+#endif
+  }
+
+  Kernels kernelsFor(Level level)
+  {
+#if SIMDMATH_X86
+    if (level == AVX2)
+    {
+      return Kernels{multiplyAVX2, affineInverseAVX2, normalMatrixAVX2, transformAABBAVX2};
+    }
+    if (level == SSE)
+    {
+      return Kernels{multiplySSE, affineInverseSSE, normalMatrixSSE, transformAABBSSE};
+    }
+#endif
+    return Kernels{multiplyScalar, affineInverseScalar, normalMatrixScalar, transformAABBScalar};
+  }
+
+  Level supported = detect();           // Widest level of this CPU
+  Level active = supported;             // Level the kernels below dispatch to
+  Kernels kernels = kernelsFor(active); // Bound before main runs
+
+  /**
+      @brief Selects the kernels to use, capped at what the CPU supports
+      @details Not thread-safe, call before any thread uses the kernels.
+      @returns Level, the level now active
+  */
+  Level setLevel(Level level)
+  {
+    active = level < supported ? level : supported;
+    kernels = kernelsFor(active);
+    return active;
+  }
+
+  const char *levelName(Level level)
+  {
+    return level == AVX2 ? "AVX2" : level == SSE ? "SSE" : "Scalar";
+  }
+
+  /**
+      @brief out[i] = a * b[i]
+  */
+  inline void multiply(const glm::mat4 &a, const glm::mat4 *b, glm::mat4 *out, int count)
+  {
+    kernels.multiply(a, b, out, count);
+  }
+
+  /**
+      @brief Inverts affine matrices (rotation, scale, shear and translation, last row 0 0 0 1)
+  */
+  inline void affineInverse(const glm::mat4 *in, glm::mat4 *out, int count)
+  {
+    kernels.affineInverse(in, out, count);
+  }
+
+  /**
+      @brief out[i] = transpose(inverse(mat3(in[i]))), the matrix that transforms normals
+  */
+  inline void normalMatrix(const glm::mat4 *in, glm::mat3 *out, int count)
+  {
+    kernels.normalMatrix(in, out, count);
+  }
+
+  /**
+      @brief Transforms boxes by an affine matrix, each result is the box around the transformed box
+  */
+  inline void transformAABB(const glm::mat4 &m, const AABB *in, AABB *out, int count)
+  {
+    kernels.transformAABB(m, in, out, count);
+  }
+}
+
+#endif
@@ -0,0 +1,226 @@
+/**
+    @class SoftwareBackend SoftwareBackend.h "Engine/SoftwareBackend.h"
+    @brief Draws frame packets on the CPU with the SoftwareRasterizer
+    @details The draw lists of packets reference Shapes, whose vertices live in GL buffers, so the triangles of every
+    shape are registered once with AddShape() (Scene::GetMesh() keeps them for a scene's shapes); draws of shapes
+    without triangles, such as the chunks of a MeshStreamer, are skipped and counted. Each draw is submitted with the
+    world matrix of its ObjectBlock and the material of its MaterialBuffer slot, the lights are those of the packet's
+    snapshot (the first directional light and every point light), so a packet looks as it does through GlBackend
+    without textures, lightmaps, shadows and wireframe. Meshlet culling is not applied, the whole mesh is drawn. The
+    image keeps the size it was created with: Pixels() returns it after Draw(), Present() scales it into the bound
+    framebuffer of a GL context for showing it in a window. The JobSystem should be the backend's alone when another
+    thread resets the arenas of its own system while Draw() runs.
+*/
+
+#pragma once
+#ifndef SOFTWAREBACKEND_H
+#define SOFTWAREBACKEND_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <unordered_map>
+#include <vector>
+#include "JobSystem.h"
+#include "Material.h"
+#include "MaterialBuffer.h"
+#include "Profiler.h"
+#include "RenderBackend.h"
+#include "RenderStats.h"
+#include "Shape.h"
+#include "SoftwareRasterizer.h"
+
+class SoftwareBackend : public RenderBackend
+{
+    SoftwareRasterizer rasterizer;
+    std::unordered_map<const std::vector<Vertex> *, int> meshes; // Rasterizer mesh of every registered triangle list
+    std::unordered_map<const Shape *, int> shapes;                // Rasterizer mesh every shape draws
+    std::vector<SoftwareRasterizer::PointLight> pointLights;      // Of the last light snapshot, kept for its memory
+    long long uploadedLights = -1;
+    int skipped = 0;
+    unsigned int texture = 0, framebuffer = 0; // Present() only
+
+public:
+    SoftwareBackend(JobSystem *jobs, int width, int height);
+    ~SoftwareBackend();
+    SoftwareBackend(const SoftwareBackend &) = delete;
+    void operator=(const SoftwareBackend &) = delete;
+
+    void AddShape(const Shape *shape, const std::vector<Vertex> &expanded);
+    void SetClearColor(const glm::vec3 &color);
+    void Draw(FramePacket &packet) override;
+    const char *Name() const override;
+    void Present(int width, int height);
+    const unsigned char *Pixels() const;
+    int Width() const;
+    int Height() const;
+    int Skipped() const;
+    const SoftwareRasterizer::Stats &GetStats() const;
+};
+
+/**
+    @brief Creates the rasterizer, makes no GL call
+    @param jobs Job system the rasterizer's passes are spread over
+    @param width Width of the image in pixels
+    @param height Height of the image in pixels
+*/
+SoftwareBackend::SoftwareBackend(JobSystem *jobs, int width, int height) : rasterizer(jobs, width, height)
+{
+}
+
+/**
+    @brief Deletes the texture and framebuffer of Present(), on the context thread if it was called
+*/
+SoftwareBackend::~SoftwareBackend()
+{
+    if (framebuffer != 0)
+    {
+        glDeleteFramebuffers(1, &framebuffer);
+        glDeleteTextures(1, &texture);
+    }
+}
+
+/**
+    @brief Registers the triangles a shape draws
+    @details Shapes passing the same vector share one mesh of the rasterizer, the vector is copied the first time.
+    @param shape Shape as it appears in the draw lists
+    @param expanded Object space triangle list, as ObjLoader produces it
+*/
+void SoftwareBackend::AddShape(const Shape *shape, const std::vector<Vertex> &expanded)
+{
+    std::unordered_map<const std::vector<Vertex> *, int>::iterator found = meshes.find(&expanded);
+    if (found == meshes.end())
+    {
+        found = meshes.insert(std::make_pair(&expanded, rasterizer.AddMesh(expanded))).first;
+    }
+    shapes[shape] = found->second;
+}
+
+void SoftwareBackend::SetClearColor(const glm::vec3 &color)
+{
+    rasterizer.SetClearColor(color);
+}
+
+/**
+    @brief Renders a packet's draw list into the image
+    @details Takes the lights from the packet when their version changed and adds the draws and triangles to
+    RenderStats. The packet's viewport size is ignored, the image keeps its size.
+*/
+void SoftwareBackend::Draw(FramePacket &packet)
+{
+    PROFILE_CPU_SCOPE("SoftwareBackend::Draw");
+    if (packet.lightVersion != uploadedLights)
+    {
+        SoftwareRasterizer::DirLight sun{glm::vec3(0, -1, 0), glm::vec3(0.0f), glm::vec3(0.0f), glm::vec3(0.0f)};
+        bool hasSun = false;
+        pointLights.clear();
+        for (const LightState &light : packet.lights)
+        {
+            if (light.type == Directional && !hasSun)
+            {
+                const DirectionalLight &d = light.directional;
+                sun = SoftwareRasterizer::DirLight{d.direction, d.ambient, d.diffuse, d.specular};
+                hasSun = true;
+            }
+            else if (light.type == Point)
+            {
+                const PointLight &p = light.point;
+                pointLights.push_back({p.position, p.constant, p.linear, p.quadratic, p.ambient, p.diffuse, p.specular});
+            }
+        }
+        rasterizer.SetLights(sun, pointLights.data(), (int)pointLights.size());
+        uploadedLights = packet.lightVersion;
+    }
+
+    MaterialBuffer *materials = MaterialBuffer::getInstance();
+    rasterizer.Begin(packet.projection * packet.view, packet.viewPos);
+    skipped = 0;
+    for (const RenderQueue::DrawItem &item : packet.draws)
+    {
+        std::unordered_map<const Shape *, int>::const_iterator found = shapes.find(item.shape);
+        if (found == shapes.end())
+        {
+            skipped++;
+            continue;
+        }
+        const MaterialData &data = materials->Get(item.material);
+        Material material(glm::vec3(data.ambient), glm::vec3(data.diffuse), glm::vec3(data.specular), data.specular.w);
+        rasterizer.Submit(found->second, item.block.model, material);
+    }
+    rasterizer.Render();
+
+    const SoftwareRasterizer::Stats &stats = rasterizer.GetStats();
+    RenderStats::frame.drawCalls += stats.draws;
+    RenderStats::frame.triangles += stats.triangles;
+}
+
+const char *SoftwareBackend::Name() const
+{
+    return "SoftwareRasterizer";
+}
+
+/**
+    @brief Copies the image of the last Draw() into the bound draw framebuffer, scaled to a size
+    @details Needs a current GL context, e.g. a window's, and leaves the read framebuffer as it was.
+    @param width Width of the area of the framebuffer to fill
+    @param height Height of that area
+*/
+void SoftwareBackend::Present(int width, int height)
+{
+    GLint readFramebuffer = 0;
+    glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &readFramebuffer);
+    if (framebuffer == 0)
+    {
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, Width(), Height(), 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glGenFramebuffers(1, &framebuffer);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+        glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+        RenderStats::frame.textureBytes += (long long)Width() * Height() * 4;
+    }
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, Width(), Height(), GL_RGBA, GL_UNSIGNED_BYTE, Pixels());
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+    glBlitFramebuffer(0, 0, Width(), Height(), 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, readFramebuffer);
+    RenderStats::frame.textureBinds++;
+}
+
+/**
+    @brief Image of the last Draw(), RGBA8 rows from the bottom up like glReadPixels output
+*/
+const unsigned char *SoftwareBackend::Pixels() const
+{
+    return rasterizer.Pixels();
+}
+
+int SoftwareBackend::Width() const
+{
+    return rasterizer.Width();
+}
+
+int SoftwareBackend::Height() const
+{
+    return rasterizer.Height();
+}
+
+/**
+    @brief Draws of the last packet whose shape has no registered triangles
+*/
+int SoftwareBackend::Skipped() const
+{
+    return skipped;
+}
+
+/**
+    @brief Counters and stage timings of the last Draw()
+*/
+const SoftwareRasterizer::Stats &SoftwareBackend::GetStats() const
+{
+    return rasterizer.GetStats();
+}
+
+#endif
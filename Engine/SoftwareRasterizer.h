@@ -0,0 +1,864 @@
+/**
+    @class SoftwareRasterizer SoftwareRasterizer.h "Engine/SoftwareRasterizer.h"
+    @brief CPU rendering backend that draws meshes with the lighting of Simple.fs, independent of OpenGL
+    @details Renders on machines without a GPU (or a GL driver) the same kind of scene the GL path draws: indexed
+    meshes with a world transform and a Material, lit by one directional and any number of point lights with the
+    Phong model of Simple.fs. A frame runs as a pipeline of job passes over the JobSystem, each timed on its own:
+    vertices are transformed, triangles are clipped against the near plane, back-face culled and set up (normalized
+    edge functions, depth plane, perspective-correct attribute corners), then binned into screen tiles in batches
+    that keep the submission order. Every tile is rasterized by one job, eight pixels of a row at a time with SSE or
+    AVX2 edge functions (picked with SimdMath's level), into a visibility buffer holding the depth and triangle of
+    every pixel. Each 8x8 block of the depth buffer keeps its farthest depth, so triangles behind everything drawn in
+    a block skip it without touching a pixel. Shading runs last, once per visible pixel, so overdraw costs no
+    lighting. The color buffer is laid out like glReadPixels(GL_RGBA, GL_UNSIGNED_BYTE) output, bottom row first.
+    The buffers are kept between frames, so a steady-state frame does not allocate.
+*/
+
+#pragma once
+#ifndef SOFTWARERASTERIZER_H
+#define SOFTWARERASTERIZER_H
+
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "JobSystem.h"
+#include "Material.h"
+#include "Meshlet.h"
+#include "ObjLoader.h"
+#include "Profiler.h"
+#include "SimdMath.h"
+
+#define SOFTRAST_TILE_SIZE 64        // Pixels per side of a tile, one raster and shading job each
+#define SOFTRAST_BLOCK_SIZE 8        // Pixels per side of a hierarchical depth block, one SIMD row wide
+#define SOFTRAST_VERTEX_GRAIN 4096   // Vertices transformed by one job
+#define SOFTRAST_MIN_BATCH 256       // Fewest triangles set up and binned by one job
+#define SOFTRAST_NO_TRIANGLE 0xFFFFFFFFu
+
+class SoftwareRasterizer
+{
+public:
+    // Same members as the light structs of Simple.fs
+    struct DirLight
+    {
+        glm::vec3 direction;
+        glm::vec3 ambient, diffuse, specular;
+    };
+
+    struct PointLight
+    {
+        glm::vec3 position;
+        float constant, linear, quadratic;
+        glm::vec3 ambient, diffuse, specular;
+    };
+
+    struct Stats
+    {
+        int draws = 0;
+        int triangles = 0;       // Submitted
+        int culled = 0;          // Back-facing, degenerate, behind the eye or off screen
+        int binned = 0;          // Triangle and tile pairs
+        int blocksSkipped = 0;   // 8x8 blocks a triangle skipped because it was behind their farthest depth
+        int pixelsShaded = 0;
+        double vertexMs = 0;     // Vertex transform
+        double setupMs = 0;      // Clipping, culling and triangle setup
+        double binMs = 0;        // Binning into tiles
+        double rasterMs = 0;     // Clear and rasterization into the visibility buffer
+        double shadeMs = 0;      // Lighting of the visible pixels
+        double totalMs = 0;
+    };
+
+private:
+    struct Mesh
+    {
+        std::vector<Vertex> vertices;
+        std::vector<uint32_t> indices;
+    };
+
+    struct Draw
+    {
+        int mesh;
+        glm::mat4 world;
+        glm::mat3 normalMatrix;
+        Material material;
+        int firstVertex;   // In the transformed vertices
+        int firstTriangle; // Running triangle count, a triangle t gets screen triangle slots 2t and 2t + 1
+    };
+
+    struct TransformedVertex
+    {
+        glm::vec4 clip;
+        glm::vec3 world;
+        glm::vec3 normal;
+    };
+
+    // Screen space triangle: edge functions E = A x + B y + C divided by the area, so at a pixel they are its
+    // barycentric weights, a depth plane and the corners' attributes for perspective-correct interpolation
+    struct ScreenTriangle
+    {
+        bool valid;
+        int minX, maxX, minY, maxY; // Covered pixels, clamped to the screen
+        float edgeA[3], edgeB[3], edgeC[3];
+        float depthA, depthB, depthC;
+        float minDepth;
+        float inverseW[3];
+        glm::vec3 world[3], normal[3];
+        int draw;
+    };
+
+    // Rasterizes the pixels [begin, end) of a block row starting at x, returns whether any was written. The whole
+    // row is loaded and stored, so it never reaches into a block (and tile) another job owns.
+    typedef bool (*RowFunction)(const ScreenTriangle &triangle, int x, int y, int begin, int end, float *depth,
+                                uint32_t *ids, uint32_t id);
+
+    JobSystem *jobs;
+    int width, height, paddedWidth, paddedHeight, tilesX, tilesY, blocksX;
+    std::vector<Mesh> meshes;
+    std::vector<Draw> draws;
+    std::vector<TransformedVertex> transformed;
+    std::vector<ScreenTriangle> screenTriangles;
+    std::vector<std::vector<uint32_t>> bins; // One list per batch and tile, batch major
+    std::vector<float> depth;                // paddedWidth x paddedHeight, depth in [0, 1]
+    std::vector<uint32_t> ids;               // Screen triangle of every pixel
+    std::vector<float> blockDepth;           // Farthest depth of every 8x8 block
+    std::vector<uint32_t> color;             // width x height RGBA8
+    int batches = 0, batchTriangles = 0;
+
+    glm::mat4 viewProjection;
+    glm::vec3 eye;
+    glm::vec3 clearColor = glm::vec3(0.0f);
+    DirLight sun;
+    std::vector<PointLight> pointLights;
+    bool cullBackFaces = true;
+    Stats stats;
+
+    static double msSince(std::chrono::steady_clock::time_point start);
+    static bool rasterizeRowScalar(const ScreenTriangle &triangle, int x, int y, int begin, int end, float *depth,
+                                   uint32_t *ids, uint32_t id);
+#if SIMDMATH_X86
+    static bool rasterizeRowSSE(const ScreenTriangle &triangle, int x, int y, int begin, int end, float *depth,
+                                uint32_t *ids, uint32_t id);
+    SIMDMATH_TARGET_AVX2 static bool rasterizeRowAVX2(const ScreenTriangle &triangle, int x, int y, int begin, int end,
+                                                      float *depth, uint32_t *ids, uint32_t id);
+#endif
+    void transformVertices(int first, int last);
+    void setupTriangles(int first, int last);
+    void addTriangle(int slot, int draw, const TransformedVertex *corners);
+    void binTriangles(int batch);
+    void rasterizeTile(int tile, RowFunction rasterizeRow, int &skipped);
+    int shadeTile(int tile);
+    glm::vec3 shade(const ScreenTriangle &triangle, float x, float y) const;
+
+public:
+    SoftwareRasterizer(JobSystem *_jobs, int _width, int _height);
+    int AddMesh(const std::vector<Vertex> &expanded);
+    int AddMesh(std::string objPath);
+    void SetLights(const DirLight &_sun, const PointLight *points, int count);
+    void SetClearColor(const glm::vec3 &_clearColor);
+    void SetCullBackFaces(bool cull);
+    void Begin(const glm::mat4 &_viewProjection, const glm::vec3 &_eye);
+    void Submit(int mesh, const glm::mat4 &world, const Material &material);
+    void Render();
+    const unsigned char *Pixels() const;
+    int Width() const;
+    int Height() const;
+    float Depth(int x, int y) const;
+    const Stats &GetStats() const;
+};
+
+/**
+    @brief Creates the frame buffers
+    @param _jobs Job system every pass is spread over
+    @param _width Width of the image in pixels
+    @param _height Height of the image in pixels
+*/
+SoftwareRasterizer::SoftwareRasterizer(JobSystem *_jobs, int _width, int _height)
+    : jobs(_jobs), width(_width), height(_height)
+{
+    paddedWidth = (width + SOFTRAST_BLOCK_SIZE - 1) / SOFTRAST_BLOCK_SIZE * SOFTRAST_BLOCK_SIZE;
+    paddedHeight = (height + SOFTRAST_BLOCK_SIZE - 1) / SOFTRAST_BLOCK_SIZE * SOFTRAST_BLOCK_SIZE;
+    tilesX = (width + SOFTRAST_TILE_SIZE - 1) / SOFTRAST_TILE_SIZE;
+    tilesY = (height + SOFTRAST_TILE_SIZE - 1) / SOFTRAST_TILE_SIZE;
+    blocksX = paddedWidth / SOFTRAST_BLOCK_SIZE;
+    depth.assign(paddedWidth * paddedHeight, 1.0f);
+    ids.assign(paddedWidth * paddedHeight, SOFTRAST_NO_TRIANGLE);
+    blockDepth.assign(blocksX * (paddedHeight / SOFTRAST_BLOCK_SIZE), 1.0f);
+    color.assign(width * height, 0xFF000000u);
+    sun = DirLight{glm::vec3(0, -1, 0), glm::vec3(0.0f), glm::vec3(0.0f), glm::vec3(0.0f)};
+}
+
+double SoftwareRasterizer::msSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+/**
+    @brief Adds a mesh that draws can reference
+    @param expanded Triangle list, as ObjLoader produces it, identical vertices are merged
+    @returns int, mesh index for Submit()
+*/
+int SoftwareRasterizer::AddMesh(const std::vector<Vertex> &expanded)
+{
+    Mesh mesh;
+    Meshlets::Weld(expanded, mesh.vertices, mesh.indices);
+    meshes.push_back(std::move(mesh));
+    return (int)meshes.size() - 1;
+}
+
+/**
+    @brief Adds the mesh of an OBJ file
+    @returns int, mesh index for Submit(), -1 if the file could not be read
+*/
+int SoftwareRasterizer::AddMesh(std::string objPath)
+{
+    std::vector<Vertex> expanded;
+    if (!ObjLoader::Load(objPath, expanded) || expanded.empty())
+    {
+        return -1;
+    }
+    return AddMesh(expanded);
+}
+
+/**
+    @brief Sets the lights, like the dirLight and pointLights uniforms of Simple.fs
+    @param _sun Directional light
+    @param points Point lights
+    @param count Number of point lights
+*/
+void SoftwareRasterizer::SetLights(const DirLight &_sun, const PointLight *points, int count)
+{
+    sun = _sun;
+    pointLights.assign(points, points + count);
+}
+
+void SoftwareRasterizer::SetClearColor(const glm::vec3 &_clearColor)
+{
+    clearColor = _clearColor;
+}
+
+/**
+    @brief Whether clockwise (back-facing) triangles are dropped, on by default since meshes are closed
+*/
+void SoftwareRasterizer::SetCullBackFaces(bool cull)
+{
+    cullBackFaces = cull;
+}
+
+/**
+    @brief Starts a frame, clears the draws of the last one
+    @param _viewProjection Matrix taking world space to clip space
+    @param _eye World space eye position, the viewPos of the lighting
+*/
+void SoftwareRasterizer::Begin(const glm::mat4 &_viewProjection, const glm::vec3 &_eye)
+{
+    viewProjection = _viewProjection;
+    eye = _eye;
+    draws.clear();
+    stats = Stats();
+}
+
+/**
+    @brief Adds a draw of a mesh to the frame
+    @param mesh Index returned by AddMesh(), draws of other indices (-1 for a file that could not be read) are ignored
+    @param world Object to world matrix
+    @param material Material, copied
+*/
+void SoftwareRasterizer::Submit(int mesh, const glm::mat4 &world, const Material &material)
+{
+    if (mesh < 0 || mesh >= (int)meshes.size())
+    {
+        return;
+    }
+    Draw draw{mesh, world, glm::mat3(1.0f), material, 0, 0};
+    SimdMath::normalMatrix(&world, &draw.normalMatrix, 1);
+    if (!draws.empty())
+    {
+        const Draw &last = draws.back();
+        draw.firstVertex = last.firstVertex + (int)meshes[last.mesh].vertices.size();
+        draw.firstTriangle = last.firstTriangle + (int)meshes[last.mesh].indices.size() / 3;
+    }
+    draws.push_back(draw);
+}
+
+/**
+    @brief Renders the draws of the frame into the color buffer
+*/
+void SoftwareRasterizer::Render()
+{
+    PROFILE_CPU_SCOPE("SoftwareRasterizer::Render");
+    auto frameStart = std::chrono::steady_clock::now();
+    int vertexCount = 0, triangleCount = 0;
+    if (!draws.empty())
+    {
+        const Draw &last = draws.back();
+        vertexCount = last.firstVertex + (int)meshes[last.mesh].vertices.size();
+        triangleCount = last.firstTriangle + (int)meshes[last.mesh].indices.size() / 3;
+    }
+    stats.draws = (int)draws.size();
+    stats.triangles = triangleCount;
+
+    auto start = std::chrono::steady_clock::now();
+    transformed.resize(vertexCount);
+    jobs->ParallelFor(vertexCount, SOFTRAST_VERTEX_GRAIN, [&](int begin, int end)
+                      { transformVertices(begin, end); });
+    stats.vertexMs = msSince(start);
+
+    // Batches of triangles set up and binned by one job, a few per thread to even out the load
+    start = std::chrono::steady_clock::now();
+    batchTriangles = std::max(SOFTRAST_MIN_BATCH, triangleCount / (jobs->Threads() * 4) + 1);
+    batches = (triangleCount + batchTriangles - 1) / batchTriangles;
+    screenTriangles.resize(triangleCount * 2);
+    jobs->ParallelFor(batches, 1, [&](int begin, int end)
+                      {
+                          for (int batch = begin; batch < end; batch++)
+                          {
+                              setupTriangles(batch * batchTriangles, std::min(triangleCount, (batch + 1) * batchTriangles));
+                          } });
+    stats.setupMs = msSince(start);
+
+    start = std::chrono::steady_clock::now();
+    int tiles = tilesX * tilesY;
+    if ((int)bins.size() < batches * tiles)
+    {
+        bins.resize(batches * tiles);
+    }
+    jobs->ParallelFor(batches, 1, [&](int begin, int end)
+                      {
+                          for (int batch = begin; batch < end; batch++)
+                          {
+                              binTriangles(batch);
+                          } });
+    for (int i = 0; i < batches * tiles; i++)
+    {
+        stats.binned += (int)bins[i].size();
+    }
+    for (int slot = 0; slot < triangleCount * 2; slot += 2)
+    {
+        stats.culled += !screenTriangles[slot].valid && !screenTriangles[slot + 1].valid;
+    }
+    stats.binMs = msSince(start);
+
+    start = std::chrono::steady_clock::now();
+    RowFunction rasterizeRow = rasterizeRowScalar;
+#if SIMDMATH_X86
+    if (SimdMath::active == SimdMath::AVX2)
+    {
+        rasterizeRow = rasterizeRowAVX2;
+    }
+    else if (SimdMath::active == SimdMath::SSE)
+    {
+        rasterizeRow = rasterizeRowSSE;
+    }
+#endif
+    std::atomic<int> skipped(0);
+    jobs->ParallelFor(tiles, 1, [&](int begin, int end)
+                      {
+                          int tileSkipped = 0;
+                          for (int tile = begin; tile < end; tile++)
+                          {
+                              rasterizeTile(tile, rasterizeRow, tileSkipped);
+                          }
+                          skipped += tileSkipped; });
+    stats.blocksSkipped = skipped;
+    stats.rasterMs = msSince(start);
+
+    start = std::chrono::steady_clock::now();
+    std::atomic<int> shaded(0);
+    jobs->ParallelFor(tiles, 1, [&](int begin, int end)
+                      {
+                          int tileShaded = 0;
+                          for (int tile = begin; tile < end; tile++)
+                          {
+                              tileShaded += shadeTile(tile);
+                          }
+                          shaded += tileShaded; });
+    stats.pixelsShaded = shaded;
+    stats.shadeMs = msSince(start);
+    stats.totalMs = msSince(frameStart);
+}
+
+/**
+    @brief Transforms the vertices [first, last) of the frame to clip and world space
+*/
+void SoftwareRasterizer::transformVertices(int first, int last)
+{
+    // Draw holding the first vertex, the draws are ordered by firstVertex
+    int d = (int)(std::upper_bound(draws.begin(), draws.end(), first, [](int vertex, const Draw &draw)
+                                   { return vertex < draw.firstVertex; }) -
+                  draws.begin()) - 1;
+    for (int v = first; v < last; d++)
+    {
+        const Draw &draw = draws[d];
+        const std::vector<Vertex> &vertices = meshes[draw.mesh].vertices;
+        int end = std::min(last, draw.firstVertex + (int)vertices.size());
+        for (; v < end; v++)
+        {
+            const Vertex &vertex = vertices[v - draw.firstVertex];
+            TransformedVertex &out = transformed[v];
+            glm::vec4 world = draw.world * glm::vec4(vertex.position, 1.0f);
+            out.world = glm::vec3(world);
+            out.clip = viewProjection * world;
+            out.normal = draw.normalMatrix * vertex.normal;
+        }
+    }
+}
+
+/**
+    @brief Clips the triangles [first, last) of the frame against the near plane and sets them up
+*/
+void SoftwareRasterizer::setupTriangles(int first, int last)
+{
+    int d = (int)(std::upper_bound(draws.begin(), draws.end(), first, [](int triangle, const Draw &draw)
+                                   { return triangle < draw.firstTriangle; }) -
+                  draws.begin()) - 1;
+    for (int t = first; t < last; d++)
+    {
+        const Draw &draw = draws[d];
+        const std::vector<uint32_t> &indices = meshes[draw.mesh].indices;
+        int end = std::min(last, draw.firstTriangle + (int)indices.size() / 3);
+        for (; t < end; t++)
+        {
+            int slot = t * 2;
+            screenTriangles[slot].valid = false;
+            screenTriangles[slot + 1].valid = false;
+
+            const uint32_t *corners = &indices[(t - draw.firstTriangle) * 3];
+            TransformedVertex clip[3];
+            float distance[3]; // To the near plane (z = -w), positive inside
+            int inside = 0;
+            for (int i = 0; i < 3; i++)
+            {
+                clip[i] = transformed[draw.firstVertex + corners[i]];
+                distance[i] = clip[i].clip.z + clip[i].clip.w;
+                inside += distance[i] >= 0;
+            }
+            if (inside == 3)
+            {
+                addTriangle(slot, d, clip);
+                continue;
+            }
+            if (inside == 0)
+            {
+                continue;
+            }
+
+            // Sutherland-Hodgman against the near plane, one triangle becomes a triangle or a quad
+            TransformedVertex polygon[4];
+            int count = 0;
+            for (int i = 0; i < 3; i++)
+            {
+                int j = (i + 1) % 3;
+                if (distance[i] >= 0)
+                {
+                    polygon[count++] = clip[i];
+                }
+                if ((distance[i] >= 0) != (distance[j] >= 0))
+                {
+                    float s = distance[i] / (distance[i] - distance[j]);
+                    TransformedVertex &cut = polygon[count++];
+                    cut.clip = clip[i].clip + (clip[j].clip - clip[i].clip) * s;
+                    cut.world = clip[i].world + (clip[j].world - clip[i].world) * s;
+                    cut.normal = clip[i].normal + (clip[j].normal - clip[i].normal) * s;
+                }
+            }
+            addTriangle(slot, d, polygon);
+            if (count == 4)
+            {
+                TransformedVertex second[3] = {polygon[0], polygon[2], polygon[3]};
+                addTriangle(slot + 1, d, second);
+            }
+        }
+    }
+}
+
+/**
+    @brief Projects a clipped triangle and sets up its edge functions, depth plane and attributes
+    @param slot Screen triangle to fill
+    @param draw Draw the triangle belongs to
+    @param corners Corners in front of the near plane
+*/
+void SoftwareRasterizer::addTriangle(int slot, int draw, const TransformedVertex *corners)
+{
+    ScreenTriangle &triangle = screenTriangles[slot];
+    float x[3], y[3], z[3];
+    for (int i = 0; i < 3; i++)
+    {
+        const glm::vec4 &clip = corners[i].clip;
+        if (clip.w <= 0)
+        {
+            return;
+        }
+        triangle.inverseW[i] = 1.0f / clip.w;
+        x[i] = (clip.x * triangle.inverseW[i] * 0.5f + 0.5f) * width;
+        y[i] = (clip.y * triangle.inverseW[i] * 0.5f + 0.5f) * height;
+        z[i] = clip.z * triangle.inverseW[i] * 0.5f + 0.5f;
+    }
+
+    // Counter-clockwise in window space (y up) is front facing, as with glFrontFace(GL_CCW)
+    float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+    if ((area > -1e-8f && area < 1e-8f) || (cullBackFaces && area < 0))
+    {
+        return;
+    }
+    float minX = std::min(x[0], std::min(x[1], x[2])), maxX = std::max(x[0], std::max(x[1], x[2]));
+    float minY = std::min(y[0], std::min(y[1], y[2])), maxY = std::max(y[0], std::max(y[1], y[2]));
+    triangle.minX = std::max(0, (int)std::floor(minX));
+    triangle.maxX = std::min(width - 1, (int)std::ceil(maxX));
+    triangle.minY = std::max(0, (int)std::floor(minY));
+    triangle.maxY = std::min(height - 1, (int)std::ceil(maxY));
+    if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY)
+    {
+        return;
+    }
+
+    float inverseArea = 1.0f / area; // Negative for back faces, which keeps their edge functions positive inside
+    for (int i = 0; i < 3; i++)
+    {
+        int a = (i + 1) % 3, b = (i + 2) % 3; // Edge i is opposite corner i, so it weights corner i
+        triangle.edgeA[i] = (y[a] - y[b]) * inverseArea;
+        triangle.edgeB[i] = (x[b] - x[a]) * inverseArea;
+        triangle.edgeC[i] = (x[a] * y[b] - x[b] * y[a]) * inverseArea;
+        triangle.world[i] = corners[i].world;
+        triangle.normal[i] = corners[i].normal;
+    }
+    triangle.depthA = triangle.edgeA[0] * z[0] + triangle.edgeA[1] * z[1] + triangle.edgeA[2] * z[2];
+    triangle.depthB = triangle.edgeB[0] * z[0] + triangle.edgeB[1] * z[1] + triangle.edgeB[2] * z[2];
+    triangle.depthC = triangle.edgeC[0] * z[0] + triangle.edgeC[1] * z[1] + triangle.edgeC[2] * z[2];
+    triangle.minDepth = std::min(z[0], std::min(z[1], z[2]));
+    triangle.draw = draw;
+    triangle.valid = true;
+}
+
+/**
+    @brief Appends the set up triangles of a batch to the lists of the tiles they overlap
+*/
+void SoftwareRasterizer::binTriangles(int batch)
+{
+    std::vector<uint32_t> *batchBins = &bins[batch * tilesX * tilesY];
+    for (int tile = 0; tile < tilesX * tilesY; tile++)
+    {
+        batchBins[tile].clear();
+    }
+    int first = batch * batchTriangles * 2;
+    int last = std::min((int)screenTriangles.size(), (batch + 1) * batchTriangles * 2);
+    for (int slot = first; slot < last; slot++)
+    {
+        const ScreenTriangle &triangle = screenTriangles[slot];
+        if (!triangle.valid)
+        {
+            continue;
+        }
+        for (int ty = triangle.minY / SOFTRAST_TILE_SIZE; ty <= triangle.maxY / SOFTRAST_TILE_SIZE; ty++)
+        {
+            for (int tx = triangle.minX / SOFTRAST_TILE_SIZE; tx <= triangle.maxX / SOFTRAST_TILE_SIZE; tx++)
+            {
+                batchBins[ty * tilesX + tx].push_back((uint32_t)slot);
+            }
+        }
+    }
+}
+
+/**
+    @brief Clears a tile and rasterizes its triangles, in submission order, into the visibility buffer
+    @param tile Tile index, row major from the bottom left
+    @param rasterizeRow Row function of the active SIMD level
+    @param skipped Incremented for every block skipped by its farthest depth
+*/
+void SoftwareRasterizer::rasterizeTile(int tile, RowFunction rasterizeRow, int &skipped)
+{
+    int tileX = tile % tilesX * SOFTRAST_TILE_SIZE, tileY = tile / tilesX * SOFTRAST_TILE_SIZE;
+    int tileMaxX = std::min(width, tileX + SOFTRAST_TILE_SIZE) - 1;
+    int tileMaxY = std::min(height, tileY + SOFTRAST_TILE_SIZE) - 1;
+    int rowEnd = std::min(paddedHeight, tileY + SOFTRAST_TILE_SIZE);
+    int columnEnd = std::min(paddedWidth, tileX + SOFTRAST_TILE_SIZE);
+    for (int row = tileY; row < rowEnd; row++)
+    {
+        std::fill(&depth[row * paddedWidth + tileX], &depth[row * paddedWidth + columnEnd], 1.0f);
+        std::fill(&ids[row * paddedWidth + tileX], &ids[row * paddedWidth + columnEnd], SOFTRAST_NO_TRIANGLE);
+    }
+    for (int by = tileY / SOFTRAST_BLOCK_SIZE; by < rowEnd / SOFTRAST_BLOCK_SIZE; by++)
+    {
+        for (int bx = tileX / SOFTRAST_BLOCK_SIZE; bx < columnEnd / SOFTRAST_BLOCK_SIZE; bx++)
+        {
+            blockDepth[by * blocksX + bx] = 1.0f;
+        }
+    }
+
+    for (int batch = 0; batch < batches; batch++)
+    {
+        for (uint32_t slot : bins[batch * tilesX * tilesY + tile])
+        {
+            const ScreenTriangle &triangle = screenTriangles[slot];
+            int minX = std::max(tileX, triangle.minX), maxX = std::min(tileMaxX, triangle.maxX);
+            int minY = std::max(tileY, triangle.minY), maxY = std::min(tileMaxY, triangle.maxY);
+            for (int blockY = minY / SOFTRAST_BLOCK_SIZE * SOFTRAST_BLOCK_SIZE; blockY <= maxY; blockY += SOFTRAST_BLOCK_SIZE)
+            {
+                for (int blockX = minX / SOFTRAST_BLOCK_SIZE * SOFTRAST_BLOCK_SIZE; blockX <= maxX; blockX += SOFTRAST_BLOCK_SIZE)
+                {
+                    float &farthest = blockDepth[blockY / SOFTRAST_BLOCK_SIZE * blocksX + blockX / SOFTRAST_BLOCK_SIZE];
+                    if (triangle.minDepth >= farthest)
+                    {
+                        skipped++;
+                        continue;
+                    }
+                    // Edge functions are linear, so an edge negative at the four corner pixels is negative inside
+                    float x0 = blockX + 0.5f, y0 = blockY + 0.5f;
+                    float x1 = x0 + SOFTRAST_BLOCK_SIZE - 1, y1 = y0 + SOFTRAST_BLOCK_SIZE - 1;
+                    bool outside = false;
+                    for (int e = 0; e < 3 && !outside; e++)
+                    {
+                        float a = triangle.edgeA[e], b = triangle.edgeB[e], c = triangle.edgeC[e];
+                        outside = std::max(std::max(a * x0 + b * y0, a * x1 + b * y0), std::max(a * x0 + b * y1, a * x1 + b * y1)) + c < 0;
+                    }
+                    if (outside)
+                    {
+                        continue;
+                    }
+
+                    int begin = std::max(minX, blockX) - blockX;
+                    int end = std::min(maxX, blockX + SOFTRAST_BLOCK_SIZE - 1) - blockX + 1;
+                    int yEnd = std::min(maxY, blockY + SOFTRAST_BLOCK_SIZE - 1);
+                    bool written = false;
+                    for (int y = std::max(minY, blockY); y <= yEnd; y++)
+                    {
+                        written |= rasterizeRow(triangle, blockX, y, begin, end, &depth[y * paddedWidth + blockX],
+                                                &ids[y * paddedWidth + blockX], slot);
+                    }
+                    if (written)
+                    {
+                        float blockFarthest = 0;
+                        for (int y = blockY; y < blockY + SOFTRAST_BLOCK_SIZE; y++)
+                        {
+                            const float *row = &depth[y * paddedWidth + blockX];
+                            for (int i = 0; i < SOFTRAST_BLOCK_SIZE; i++)
+                            {
+                                blockFarthest = std::max(blockFarthest, row[i]);
+                            }
+                        }
+                        farthest = blockFarthest;
+                    }
+                }
+            }
+        }
+    }
+}
+
+bool SoftwareRasterizer::rasterizeRowScalar(const ScreenTriangle &triangle, int x, int y, int begin, int end,
+                                            float *depth, uint32_t *ids, uint32_t id)
+{
+    float px = x + begin + 0.5f, py = y + 0.5f;
+    float e0 = triangle.edgeA[0] * px + triangle.edgeB[0] * py + triangle.edgeC[0];
+    float e1 = triangle.edgeA[1] * px + triangle.edgeB[1] * py + triangle.edgeC[1];
+    float e2 = triangle.edgeA[2] * px + triangle.edgeB[2] * py + triangle.edgeC[2];
+    float z = triangle.depthA * px + triangle.depthB * py + triangle.depthC;
+    bool written = false;
+    for (int i = begin; i < end; i++)
+    {
+        if (e0 >= 0 && e1 >= 0 && e2 >= 0 && z < depth[i])
+        {
+            depth[i] = z;
+            ids[i] = id;
+            written = true;
+        }
+        e0 += triangle.edgeA[0];
+        e1 += triangle.edgeA[1];
+        e2 += triangle.edgeA[2];
+        z += triangle.depthA;
+    }
+    return written;
+}
+
+#if SIMDMATH_X86
+bool SoftwareRasterizer::rasterizeRowSSE(const ScreenTriangle &triangle, int x, int y, int begin, int end,
+                                         float *depth, uint32_t *ids, uint32_t id)
+{
+    float py = y + 0.5f;
+    __m128 newId = _mm_castsi128_ps(_mm_set1_epi32((int)id));
+    __m128 first = _mm_set1_ps((float)begin), last = _mm_set1_ps((float)end);
+    bool written = false;
+    for (int i = 0; i < SOFTRAST_BLOCK_SIZE; i += 4)
+    {
+        __m128 lanes = _mm_add_ps(_mm_set1_ps((float)i), _mm_setr_ps(0, 1, 2, 3));
+        __m128 inside = _mm_and_ps(_mm_cmpge_ps(lanes, first), _mm_cmplt_ps(lanes, last));
+        if (_mm_movemask_ps(inside) == 0)
+        {
+            continue;
+        }
+        __m128 px = _mm_add_ps(_mm_set1_ps(x + 0.5f), lanes);
+        for (int e = 0; e < 3; e++)
+        {
+            __m128 edge = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(triangle.edgeA[e]), px),
+                                     _mm_set1_ps(triangle.edgeB[e] * py + triangle.edgeC[e]));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(edge, _mm_setzero_ps()));
+        }
+        __m128 z = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(triangle.depthA), px),
+                              _mm_set1_ps(triangle.depthB * py + triangle.depthC));
+        __m128 old = _mm_loadu_ps(depth + i);
+        __m128 pass = _mm_and_ps(inside, _mm_cmplt_ps(z, old));
+        if (_mm_movemask_ps(pass) == 0)
+        {
+            continue;
+        }
+        _mm_storeu_ps(depth + i, _mm_or_ps(_mm_and_ps(pass, z), _mm_andnot_ps(pass, old)));
+        __m128 oldId = _mm_loadu_ps((const float *)(ids + i));
+        _mm_storeu_ps((float *)(ids + i), _mm_or_ps(_mm_and_ps(pass, newId), _mm_andnot_ps(pass, oldId)));
+        written = true;
+    }
+    return written;
+}
+
+SIMDMATH_TARGET_AVX2 bool SoftwareRasterizer::rasterizeRowAVX2(const ScreenTriangle &triangle, int x, int y, int begin,
+                                                               int end, float *depth, uint32_t *ids, uint32_t id)
+{
+    float py = y + 0.5f;
+    __m256 lanes = _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7);
+    __m256 px = _mm256_add_ps(_mm256_set1_ps(x + 0.5f), lanes);
+    __m256 inside = _mm256_and_ps(_mm256_cmp_ps(lanes, _mm256_set1_ps((float)begin), _CMP_GE_OQ),
+                                  _mm256_cmp_ps(lanes, _mm256_set1_ps((float)end), _CMP_LT_OQ));
+    for (int e = 0; e < 3; e++)
+    {
+        __m256 edge = _mm256_fmadd_ps(_mm256_set1_ps(triangle.edgeA[e]), px,
+                                      _mm256_set1_ps(triangle.edgeB[e] * py + triangle.edgeC[e]));
+        inside = _mm256_and_ps(inside, _mm256_cmp_ps(edge, _mm256_setzero_ps(), _CMP_GE_OQ));
+    }
+    __m256 z = _mm256_fmadd_ps(_mm256_set1_ps(triangle.depthA), px, _mm256_set1_ps(triangle.depthB * py + triangle.depthC));
+    __m256 old = _mm256_loadu_ps(depth);
+    __m256 pass = _mm256_and_ps(inside, _mm256_cmp_ps(z, old, _CMP_LT_OQ));
+    if (_mm256_movemask_ps(pass) == 0)
+    {
+        return false;
+    }
+    _mm256_storeu_ps(depth, _mm256_blendv_ps(old, z, pass));
+    __m256 oldId = _mm256_loadu_ps((const float *)ids);
+    _mm256_storeu_ps((float *)ids, _mm256_blendv_ps(oldId, _mm256_castsi256_ps(_mm256_set1_epi32((int)id)), pass));
+    return true;
+}
+#endif
+
+/**
+    @brief Lights the visible pixels of a tile and writes their colors
+    @returns int, number of pixels shaded
+*/
+int SoftwareRasterizer::shadeTile(int tile)
+{
+    int tileX = tile % tilesX * SOFTRAST_TILE_SIZE, tileY = tile / tilesX * SOFTRAST_TILE_SIZE;
+    int tileMaxX = std::min(width, tileX + SOFTRAST_TILE_SIZE), tileMaxY = std::min(height, tileY + SOFTRAST_TILE_SIZE);
+    auto pack = [](const glm::vec3 &c)
+    {
+        glm::vec3 v = glm::clamp(c, 0.0f, 1.0f) * 255.0f + 0.5f;
+        return (uint32_t)v.x | (uint32_t)v.y << 8 | (uint32_t)v.z << 16 | 0xFF000000u;
+    };
+    uint32_t background = pack(clearColor);
+    int shaded = 0;
+    for (int y = tileY; y < tileMaxY; y++)
+    {
+        const uint32_t *rowIds = &ids[y * paddedWidth];
+        uint32_t *out = &color[y * width];
+        for (int x = tileX; x < tileMaxX; x++)
+        {
+            if (rowIds[x] == SOFTRAST_NO_TRIANGLE)
+            {
+                out[x] = background;
+                continue;
+            }
+            out[x] = pack(shade(screenTriangles[rowIds[x]], x + 0.5f, y + 0.5f));
+            shaded++;
+        }
+    }
+    return shaded;
+}
+
+/**
+    @brief Lights a pixel of a triangle like Simple.fs does (untextured, unshadowed)
+    @param triangle Triangle visible at the pixel
+    @param x Pixel center
+    @param y Pixel center
+    @returns glm::vec3, color before clamping
+*/
+glm::vec3 SoftwareRasterizer::shade(const ScreenTriangle &triangle, float x, float y) const
+{
+    // Screen space barycentrics weighted by 1/w give perspective-correct ones
+    float weight[3], sum = 0;
+    for (int i = 0; i < 3; i++)
+    {
+        weight[i] = std::max(0.0f, triangle.edgeA[i] * x + triangle.edgeB[i] * y + triangle.edgeC[i]) * triangle.inverseW[i];
+        sum += weight[i];
+    }
+    sum = sum > 0 ? 1.0f / sum : 0.0f;
+    glm::vec3 position(0.0f), normal(0.0f);
+    for (int i = 0; i < 3; i++)
+    {
+        position += triangle.world[i] * (weight[i] * sum);
+        normal += triangle.normal[i] * (weight[i] * sum);
+    }
+
+    const Material &material = draws[triangle.draw].material;
+    normal = glm::normalize(normal);
+    glm::vec3 viewDir = glm::normalize(eye - position);
+
+    // pow(0, shininess) is 0, so the highlight is only evaluated where there is one
+    auto highlight = [&](const glm::vec3 &lightDir)
+    {
+        float facing = glm::dot(viewDir, glm::reflect(-lightDir, normal));
+        return facing > 0 ? std::pow(facing, material.shininess) : 0.0f;
+    };
+
+    glm::vec3 lightDir = glm::normalize(-sun.direction);
+    float diff = std::max(glm::dot(normal, lightDir), 0.0f);
+    float spec = highlight(lightDir);
+    glm::vec3 result = sun.ambient * material.ambient + sun.diffuse * (material.diffuse * diff) +
+                       sun.specular * (material.specular * spec);
+
+    for (const PointLight &light : pointLights)
+    {
+        glm::vec3 toLight = light.position - position;
+        float distance = glm::length(toLight);
+        lightDir = toLight / distance;
+        diff = std::max(glm::dot(normal, lightDir), 0.0f);
+        spec = highlight(lightDir);
+        float attenuation = 1.0f / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
+        result += (light.ambient * material.ambient + light.diffuse * (diff * material.diffuse) +
+                   light.specular * (spec * material.specular)) * attenuation;
+    }
+    return result;
+}
+
+/**
+    @brief Returns the color buffer of the last Render(), RGBA8 rows from the bottom up
+*/
+const unsigned char *SoftwareRasterizer::Pixels() const
+{
+    return (const unsigned char *)color.data();
+}
+
+int SoftwareRasterizer::Width() const
+{
+    return width;
+}
+
+int SoftwareRasterizer::Height() const
+{
+    return height;
+}
+
+/**
+    @brief Reads the depth of a pixel after Render(), for debugging and tests
+*/
+float SoftwareRasterizer::Depth(int x, int y) const
+{
+    return depth[y * paddedWidth + x];
+}
+
+/**
+    @brief Returns the counters and stage timings of the last frame
+*/
+const SoftwareRasterizer::Stats &SoftwareRasterizer::GetStats() const
+{
+    return stats;
+}
+
+#endif
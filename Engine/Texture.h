@@ -15,6 +15,7 @@
 #include "Shader.h"
 #include "VAO.h"
 #include "VB.h"
+#include "RenderStats.h"
 class Texture
 {
 private:
@@ -26,6 +27,8 @@ public:
     ~Texture();                                             // Delete OpenGL texture object by ID
     void UpdateParameter(GLenum type, GLint specification); // Update parameter of texture
     bool LoadTexture(const char *path);                     // Load texture given a path to image file
+    void LoadTexture(const unsigned char *data, int width, int height, int channels); // Upload decoded pixels
+    void LoadTexture(const float *data, int width, int height, int channels);         // Upload HDR pixels (lightmaps)
     void Bind();                                            // Bind the OpenGL texture object by ID
     void Unbind();                                          // unbind the OpenGL texture object
 };
@@ -74,8 +77,7 @@ bool Texture::LoadTexture(const char *path)
     unsigned char *data = stbi_load(path, &width, &height, &nrChannels, 0);
     if (data)
     {
-        glTexImage2D(target, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(target);
+        LoadTexture(data, width, height, nrChannels);
         stbi_image_free(data);
         return true;
     }
@@ -86,12 +88,53 @@ bool Texture::LoadTexture(const char *path)
     }
 }
 
+/**
+    @brief Upload already decoded pixels to the OpenGL texture
+    @details Lets images be decoded on worker threads (stbi_load) and uploaded on the context thread afterwards.
+    @param data pixels, rows from the bottom up
+    @param width width of the image
+    @param height height of the image
+    @param channels 3 for RGB, 4 for RGBA, 1 for grey
+ */
+void Texture::LoadTexture(const unsigned char *data, int width, int height, int channels)
+{
+    Bind();
+    GLenum format = channels == 4 ? GL_RGBA : channels == 1 ? GL_RED : GL_RGB;
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(target, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
+    RenderStats::frame.textureBytes += (long long)width * height * channels;
+    glGenerateMipmap(target);
+}
+
+/**
+    @brief Upload high dynamic range pixels to the OpenGL texture
+    @details Stored as 16 bit floats, for lightmaps (LightmapBaker.h) whose light may exceed 1. They are filtered
+    without mipmaps, which would blend the charts of neighbouring triangles.
+    @param data pixels, rows from the bottom up
+    @param width width of the image
+    @param height height of the image
+    @param channels 3 for RGB, 4 for RGBA
+ */
+void Texture::LoadTexture(const float *data, int width, int height, int channels)
+{
+    Bind();
+    GLenum format = channels == 4 ? GL_RGBA : GL_RGB;
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(target, 0, channels == 4 ? GL_RGBA16F : GL_RGB16F, width, height, 0, format, GL_FLOAT, data);
+    glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(target, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    RenderStats::frame.textureBytes += (long long)width * height * channels * 2;
+}
+
 /**
     @brief Bind OpenGL texture
  */
 void Texture::Bind()
 {
     glBindTexture(target, ID);
+    RenderStats::frame.textureBinds++;
 }
 
 /**
@@ -0,0 +1,71 @@
+/**
+    @class Transform Transform.h "Engine/Transform.h"
+    @brief Object transformation state, independent of OpenGL
+    @details Holds the two matrices a Shape is drawn with: model (rotation and scale about the object's origin) and
+    view (the object's translation in the world). Kept separate from Shape so transform work can be benchmarked and
+    updated off the GL thread.
+*/
+
+#pragma once
+#ifndef TRANSFORM_H
+#define TRANSFORM_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+class Transform
+{
+public:
+    glm::mat4 model, view; // Transformation matrices
+
+    Transform();
+    void Rotate(float angle, glm::vec3 axis);
+    void Scale(float scalar);
+    void Translate(glm::vec3 trans);
+    glm::mat4 World() const;
+};
+
+/**
+    @brief Initializes both matrices to the identity
+*/
+Transform::Transform() : model(1.0f), view(1.0f)
+{
+}
+
+/**
+    @brief Rotates by a given angle (Radians) about the object's origin
+    @param angle The angle to be rotated by
+    @param axis The axis to rotate about
+ */
+void Transform::Rotate(float angle, glm::vec3 axis)
+{
+    model = glm::rotate(glm::mat4(1.0f), angle, axis) * model;
+}
+
+/**
+    @brief Scales by a given scalar
+    @param scalar the scalar to be scaled by
+ */
+void Transform::Scale(float scalar)
+{
+    model = glm::scale(model, glm::vec3(scalar, scalar, scalar));
+}
+
+/**
+    @brief Translates by a given translation vector
+    @param trans The translation vector to be applied
+ */
+void Transform::Translate(glm::vec3 trans)
+{
+    view = glm::translate(view, trans);
+}
+
+/**
+    @brief Returns the object to world matrix (view * model)
+ */
+glm::mat4 Transform::World() const
+{
+    return view * model;
+}
+
+#endif
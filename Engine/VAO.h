@@ -12,6 +12,7 @@
 
 #include <glad/glad.h>
 #include "VB.h"
+#include "RenderStats.h"
 class VAO
 {
 public:
@@ -57,6 +58,7 @@ void VAO::LinkVB(VB &vb, GLuint layout, int elements, int span, int index)
 void VAO::Bind()
 {
     glBindVertexArray(ID);
+    RenderStats::frame.vaoBinds++;
 }
 
 /**
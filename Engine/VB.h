@@ -10,6 +10,7 @@
 #ifndef VB_CLASS_H
 #define VB_CLASS_H
 #include <glad/glad.h>
+#include "RenderStats.h"
 
 class VB
 {
@@ -72,6 +73,7 @@ void VB::UpdateData(T *data, GLsizeiptr size)
 {
     Bind();
     glBufferData(target, size, data, usage);
+    RenderStats::frame.bufferBytes += size;
 }
 
 /**
@@ -80,6 +82,7 @@ void VB::UpdateData(T *data, GLsizeiptr size)
 void VB::Bind()
 {
     glBindBuffer(target, ID);
+    RenderStats::frame.bufferBinds++;
 }
 
 /**
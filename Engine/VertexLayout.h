@@ -0,0 +1,185 @@
+/**
+    @file VertexLayout.h
+    @brief Compile-time descriptions of vertex buffers that generate their attribute setup
+    @details An Attribute pairs a shader input location with the C++ type stored for it, a VertexStream lists the
+    attributes interleaved in one buffer and derives their offsets and the stride from the types, and a
+    VertexLayout lists the streams a vertex array reads, one buffer each. Linking a stream issues the
+    glVertexAttribPointer calls for the bound buffer and vertex array, so layouts are written once as types instead
+    of as counts of floats repeated at every call site. Meshes are kept in two streams (VertexLayouts::Split):
+    positions alone, which is all the depth pre-pass and shadow passes fetch, 12 bytes per vertex instead of the
+    32 of the interleaved Vertex, and the texture coordinates and normals the shading pass adds to them.
+*/
+
+#pragma once
+#ifndef VERTEXLAYOUT_H
+#define VERTEXLAYOUT_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <tuple>
+#include <vector>
+#include "ObjLoader.h"
+#include "VAO.h"
+#include "VB.h"
+
+// How a stored type is fed to a shader input: components, GL type and whether the input is an integer
+template <typename T>
+struct AttributeFormat;
+
+template <>
+struct AttributeFormat<float>
+{
+    static constexpr GLint components = 1;
+    static constexpr GLenum type = GL_FLOAT;
+    static constexpr bool integer = false;
+};
+
+template <>
+struct AttributeFormat<glm::vec2>
+{
+    static constexpr GLint components = 2;
+    static constexpr GLenum type = GL_FLOAT;
+    static constexpr bool integer = false;
+};
+
+template <>
+struct AttributeFormat<glm::vec3>
+{
+    static constexpr GLint components = 3;
+    static constexpr GLenum type = GL_FLOAT;
+    static constexpr bool integer = false;
+};
+
+template <>
+struct AttributeFormat<glm::vec4>
+{
+    static constexpr GLint components = 4;
+    static constexpr GLenum type = GL_FLOAT;
+    static constexpr bool integer = false;
+};
+
+template <>
+struct AttributeFormat<uint32_t>
+{
+    static constexpr GLint components = 1;
+    static constexpr GLenum type = GL_UNSIGNED_INT;
+    static constexpr bool integer = true;
+};
+
+/**
+    @brief A shader input and the type stored for it
+*/
+template <GLuint Location, typename T>
+struct Attribute
+{
+    typedef T Type;
+    static constexpr GLuint location = Location;
+
+    /**
+        @brief Points the input at the bound array buffer
+        @param stride Bytes between two vertices of the buffer
+        @param offset Byte offset of the attribute in a vertex
+        @param divisor 0 to advance per vertex, n to advance every n instances
+    */
+    static void Link(GLsizei stride, size_t offset, GLuint divisor)
+    {
+        typedef AttributeFormat<T> Format;
+        if (Format::integer)
+        {
+            glVertexAttribIPointer(Location, Format::components, Format::type, stride, (void *)offset);
+        }
+        else
+        {
+            glVertexAttribPointer(Location, Format::components, Format::type, GL_FALSE, stride, (void *)offset);
+        }
+        glEnableVertexAttribArray(Location);
+        glVertexAttribDivisor(Location, divisor);
+    }
+};
+
+/**
+    @brief Attributes interleaved in one buffer, in the order given
+*/
+template <typename... Attributes>
+struct VertexStream
+{
+    static constexpr GLsizei stride = (GLsizei)(0 + ... + sizeof(typename Attributes::Type));
+
+    /**
+        @brief Sets up every attribute of the stream for the bound array buffer and vertex array
+        @param divisor 0 for per-vertex data, n for data advancing every n instances
+    */
+    static void Link(GLuint divisor = 0)
+    {
+        size_t offset = 0;
+        ((Attributes::Link(stride, offset, divisor), offset += sizeof(typename Attributes::Type)), ...);
+    }
+};
+
+/**
+    @brief Streams a vertex array reads, each from its own buffer
+*/
+template <typename... Streams>
+struct VertexLayout
+{
+    template <int I>
+    using Stream = std::tuple_element_t<I, std::tuple<Streams...>>;
+
+    static constexpr int streams = sizeof...(Streams);
+    static constexpr GLsizei stride = (0 + ... + Streams::stride); // Bytes per vertex over all streams
+
+    /**
+        @brief Links every stream of the layout into a vertex array
+        @param vao Vertex array to set up, left bound
+        @param buffers One buffer per stream, in the layout's order
+    */
+    template <typename... Buffers>
+    static void Link(VAO &vao, Buffers &...buffers)
+    {
+        static_assert(sizeof...(Buffers) == sizeof...(Streams), "one buffer per stream");
+        vao.Bind();
+        ((buffers.Bind(), Streams::Link()), ...);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+};
+
+// Texture coordinates and normal of a vertex, the shading stream of a split mesh
+struct ShadingVertex
+{
+    vec2 texture;
+    vec3 normal;
+};
+
+namespace VertexLayouts
+{
+    typedef VertexStream<Attribute<0, vec3>> Positions;                                        // Depth and shadow passes
+    typedef VertexStream<Attribute<1, vec2>, Attribute<2, vec3>> Shading;                      // ShadingVertex
+    typedef VertexStream<Attribute<0, vec3>, Attribute<1, vec2>, Attribute<2, vec3>> Interleaved; // Vertex
+    typedef VertexStream<Attribute<7, vec2>> LightmapCoords;                                   // Lightmapped shapes (Lightmap.h)
+    typedef VertexLayout<Positions, Shading> Split;
+
+    static_assert(Interleaved::stride == sizeof(Vertex), "Interleaved must match Vertex");
+    static_assert(Shading::stride == sizeof(ShadingVertex), "Shading must match ShadingVertex");
+
+    /**
+        @brief Splits interleaved vertices into the streams of the Split layout
+        @param vertices Vertices as ObjLoader produces them
+        @param positions Receives the position stream
+        @param shading Receives the shading stream
+    */
+    void SplitStreams(const std::vector<Vertex> &vertices, std::vector<vec3> &positions, std::vector<ShadingVertex> &shading)
+    {
+        positions.resize(vertices.size());
+        shading.resize(vertices.size());
+        for (size_t i = 0; i < vertices.size(); i++)
+        {
+            positions[i] = vertices[i].position;
+            shading[i].texture = vertices[i].texture;
+            shading[i].normal = vertices[i].normal;
+        }
+    }
+}
+
+#endif
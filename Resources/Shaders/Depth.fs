@@ -0,0 +1,6 @@
+#version 330 core
+// Depth pre-pass: color writes are masked, only the depth of the fragment is kept
+
+void main()
+{
+}
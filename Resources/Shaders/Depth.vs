@@ -0,0 +1,18 @@
+#version 330 core
+// Depth pre-pass: positions only, gl_Position must be computed exactly like Simple.vs for the GL_EQUAL color pass
+layout (location = 0) in vec3 aPos;
+
+invariant gl_Position;
+
+layout (std140) uniform ObjectBlock
+{
+    mat4 mvp;          // projection * view * model
+    mat4 model;        // object to world
+    mat3 normalMatrix; // unused here, declared so the block layout matches Simple.vs
+    int material;      // unused here
+};
+
+void main()
+{
+    gl_Position = mvp * vec4(aPos, 1.0);
+}
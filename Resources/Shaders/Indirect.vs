@@ -0,0 +1,41 @@
+#version 430 core
+// Vertex shader of GpuCuller's indirect draws, pair it with Simple.fs. Every object of the scene is drawn by one
+// glMultiDrawElementsIndirect call, each command's base instance selects its ObjectData, whose material slot Simple.fs
+// reads from the MaterialBlock (MaterialBuffer.h) like the other draw paths.
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec2 aTexCoords;
+layout (location = 2) in vec3 aNormal;
+layout (location = 3) in uint aObject; // per-instance, baseInstance of the command
+
+invariant gl_Position;
+
+// Same layout as GpuCuller::ObjectData and Cull.comp
+struct ObjectData
+{
+    mat4 model;
+    vec4 normalMatrix[3];
+    vec4 bounds;
+    ivec4 material; // x is the MaterialBuffer slot
+    uvec4 mesh;
+};
+
+layout (std430, binding = 0) readonly buffer Objects
+{
+    ObjectData objects[];
+};
+
+uniform mat4 viewProjection;
+
+out vec3 Normal;
+out vec3 FragPos;
+flat out int MaterialIndex;
+
+void main()
+{
+    ObjectData object = objects[aObject];
+    vec4 worldPos = object.model * vec4(aPos, 1.0);
+    gl_Position = viewProjection * worldPos;
+    FragPos = vec3(worldPos);
+    Normal = mat3(object.normalMatrix[0].xyz, object.normalMatrix[1].xyz, object.normalMatrix[2].xyz) * aNormal;
+    MaterialIndex = object.material.x;
+}
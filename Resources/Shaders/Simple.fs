@@ -1,5 +1,10 @@
 #version 330 core
-#define NR_POINT_LIGHTS 4  
+// Feature defines (NR_POINT_LIGHTS, TEXTURED, INSTANCED, SHADOWED, LIGHTMAPPED) are injected above by ShaderVariants.
+// Without NR_POINT_LIGHTS the generic variant loops over up to 4 lights given by numPointLights.
+#ifndef NR_POINT_LIGHTS
+#define NR_POINT_LIGHTS 4
+#define DYNAMIC_POINT_LIGHTS
+#endif
 
 struct Material {
     vec3 ambient;
@@ -14,6 +19,8 @@ struct DirLight {
     vec3 ambient;
     vec3 diffuse;
     vec3 specular;
+
+    bool baked;
 };  
 
 struct PointLight {    
@@ -26,38 +33,85 @@ struct PointLight {
     vec3 ambient;
     vec3 diffuse;
     vec3 specular;
+
+    bool baked;
 };  
 
 in vec3 Normal;
 in vec3 FragPos;
+#ifdef TEXTURED
+in vec2 TexCoords;
+uniform sampler2D diffuseTexture;
+#endif
+#ifdef LIGHTMAPPED
+// Ambient and diffuse light of the baked lights, with the material's colors and their shadows (LightmapBaker.h)
+in vec2 LightmapCoords;
+uniform sampler2D lightmap;
+#endif
+#ifdef SHADOWED
+// Cascades of the directional light's shadow map (CascadedShadowMap.h), nearest first
+#define MAX_CASCADES 4 // SHADOW_MAX_CASCADES
+uniform sampler2DArrayShadow shadowMap;
+uniform mat4 lightSpace[MAX_CASCADES];
+uniform int numCascades;
+#endif
 out vec4 FragColor;
 
 // Camera inputs
 uniform vec3 viewPos;
 
-// Material inputs
-uniform Material material;
+// Material inputs, the slot of the object's material in the MaterialBlock (MaterialBuffer.h), passed on by Simple.vs
+// from its ObjectBlock or by Indirect.vs from GpuCuller's object buffer
+#define MAX_MATERIALS 256 // MATERIALBUFFER_CAPACITY
+layout (std140) uniform MaterialBlock
+{
+    Material materials[MAX_MATERIALS];
+};
+flat in int MaterialIndex;
+#define material materials[MaterialIndex]
 
 // Light inputs
 uniform DirLight dirLight;
+#if NR_POINT_LIGHTS > 0
 uniform PointLight pointLights[NR_POINT_LIGHTS];
+#endif
+#ifdef DYNAMIC_POINT_LIGHTS
 uniform int numPointLights;
+#endif
+
+// Surface color from the diffuse texture, white when untextured
+vec3 albedo = vec3(1.0);
 
 // Helper functions
 vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir);  
 vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir);  
+float CalcShadow();
 
 void main()
 {
     // properties
     vec3 norm = normalize(Normal);
     vec3 viewDir = normalize(viewPos - FragPos);
+#ifdef TEXTURED
+    albedo = vec3(texture(diffuseTexture, TexCoords));
+#endif
 
+#ifdef LIGHTMAPPED
+    // phase 0: Baked lights, which add only their specular term below; lights that were not baked add all of it
+    vec3 result = albedo * texture(lightmap, LightmapCoords).rgb;
+#else
+    vec3 result = vec3(0.0);
+#endif
     // phase 1: Directional lighting
-    vec3 result = CalcDirLight(dirLight, norm, viewDir);
+    result += CalcDirLight(dirLight, norm, viewDir);
     // phase 2: Point lights
+#if defined(DYNAMIC_POINT_LIGHTS)
     for(int i = 0; i < numPointLights; i++)
         result += CalcPointLight(pointLights[i], norm, FragPos, viewDir);
+#elif NR_POINT_LIGHTS > 0
+    for(int i = 0; i < NR_POINT_LIGHTS; i++)
+        result += CalcPointLight(pointLights[i], norm, FragPos, viewDir);
+#endif
     // phase 3: Spot light
     //result += CalcSpotLight(spotLight, norm, FragPos, viewDir); 
     
@@ -73,10 +127,14 @@ vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir)
     vec3 reflectDir = reflect(-lightDir, normal);
     float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
     // combine results
-    vec3 ambient  = light.ambient * material.ambient;  //* vec3(texture(material.diffuse, TexCoords));
-    vec3 diffuse  = light.diffuse * (material.diffuse * diff);  //* diff * vec3(texture(material.diffuse, TexCoords));
-    vec3 specular = light.specular * (material.specular * spec); //* spec * vec3(texture(material.specular, TexCoords));
-    return (ambient + diffuse + specular);
+    vec3 ambient  = light.ambient * material.ambient * albedo;
+    vec3 diffuse  = light.diffuse * (material.diffuse * diff) * albedo;
+    vec3 specular = light.specular * (material.specular * spec);
+#ifdef LIGHTMAPPED
+    if (light.baked)
+        return CalcShadow() * specular;
+#endif
+    return (ambient + CalcShadow() * (diffuse + specular));
 }  
 
 vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
@@ -92,11 +150,33 @@ vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
     float attenuation = 1.0 / (light.constant + light.linear * distance + 
   			     light.quadratic * (distance * distance));    
     // combine results
-    vec3 ambient  = light.ambient * material.ambient;  //* vec3(texture(material.diffuse, TexCoords));
-    vec3 diffuse  = light.diffuse * (diff * material.diffuse);  //* diff * vec3(texture(material.diffuse, TexCoords));
-    vec3 specular = light.specular * (spec * material.specular); //* spec * vec3(texture(material.specular, TexCoords));
+    vec3 ambient  = light.ambient * material.ambient * albedo;
+    vec3 diffuse  = light.diffuse * (diff * material.diffuse) * albedo;
+    vec3 specular = light.specular * (spec * material.specular);
     ambient  *= attenuation;
     diffuse  *= attenuation;
     specular *= attenuation;
+#ifdef LIGHTMAPPED
+    if (light.baked)
+        return specular;
+#endif
     return (ambient + diffuse + specular);
-} 
\ No newline at end of file
+}
+
+// Fraction of the directional light reaching the fragment, 1 when the variant has no shadows
+float CalcShadow()
+{
+#ifdef SHADOWED
+    // The nearest cascade covering the fragment has the most texels for it
+    for (int i = 0; i < numCascades; i++)
+    {
+        vec4 position = lightSpace[i] * vec4(FragPos, 1.0);
+        vec3 coords = position.xyz / position.w * 0.5 + 0.5;
+        if (all(greaterThan(coords, vec3(0.0))) && all(lessThan(coords, vec3(1.0))))
+            return texture(shadowMap, vec4(coords.xy, float(i), coords.z - 0.0005));
+    }
+    return 1.0;
+#else
+    return 1.0;
+#endif
+}
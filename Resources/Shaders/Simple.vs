@@ -1,19 +1,54 @@
 #version 330 core
+// Feature defines (NR_POINT_LIGHTS, TEXTURED, INSTANCED, SHADOWED, LIGHTMAPPED) are injected above by ShaderVariants
 layout (location = 0) in vec3 aPos;
-layout (location = 1) in vec2 TexCoords;
+layout (location = 1) in vec2 aTexCoords;
 layout (location = 2) in vec3 aNormal;
+#ifdef INSTANCED
+layout (location = 3) in mat4 aModel; // per-instance model matrix, uses locations 3-6
+#endif
+#ifdef LIGHTMAPPED
+layout (location = 7) in vec2 aLightmapCoords; // one chart per triangle (Lightmap.h)
+#endif
+
+// Same as Depth.vs, so the color pass after a depth pre-pass passes its GL_EQUAL depth test
+invariant gl_Position;
 
 out vec3 Normal;
 out vec3 FragPos;
+flat out int MaterialIndex;
+#ifdef TEXTURED
+out vec2 TexCoords;
+#endif
+#ifdef LIGHTMAPPED
+out vec2 LightmapCoords;
+#endif
 
-uniform mat4 view;
-uniform mat4 model;
-uniform mat4 projection;
-uniform mat4 objectView;
+// Computed once per object on the CPU (ObjectBlock.h)
+layout (std140) uniform ObjectBlock
+{
+    mat4 mvp;          // projection * view * model
+    mat4 model;        // object to world, lighting is done in world space
+    mat3 normalMatrix; // transpose(inverse(mat3(model)))
+    int material;      // slot in the MaterialBlock (MaterialBuffer.h)
+};
 
 void main()
 {
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
-    Normal = vec3(model * vec4(aNormal, 1.0));
-    FragPos = vec3(objectView * model * vec4(aPos, 1.0));
-}
\ No newline at end of file
+    MaterialIndex = material;
+#ifdef INSTANCED
+    // Instances carry only their model matrix, so their normal matrix is derived here
+    gl_Position = mvp * aModel * vec4(aPos, 1.0);
+    Normal = normalMatrix * (transpose(inverse(mat3(aModel))) * aNormal);
+    FragPos = vec3(model * aModel * vec4(aPos, 1.0));
+#else
+    gl_Position = mvp * vec4(aPos, 1.0);
+    Normal = normalMatrix * aNormal;
+    FragPos = vec3(model * vec4(aPos, 1.0));
+#endif
+#ifdef TEXTURED
+    TexCoords = aTexCoords;
+#endif
+#ifdef LIGHTMAPPED
+    LightmapCoords = aLightmapCoords;
+#endif
+}
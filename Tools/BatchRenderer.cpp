@@ -0,0 +1,438 @@
+/**
+    @file BatchRenderer.cpp
+    @brief Renders a scripted batch of images offscreen and writes them as PNG files
+    @details Creates a surfaceless EGL context like RenderBenchmark, builds its sphere grid scene and renders one
+    image per camera of the script: every frame is culled and sorted by a RenderQueue into a FramePacket, which a
+    RenderBackend draws. The GL backend draws into a RenderTarget, frames are read back through an AsyncReadback
+    ring and encoded to PNG on the JobSystem's threads while the next frames render; --sync reads every frame back
+    with a blocking glReadPixels and encodes it on the context thread instead, for comparison. --software draws the
+    packets with the SoftwareBackend on the JobSystem and encodes each image on the context thread; the context is
+    then only used to create the Shapes, so it runs on machines without a GPU (Mesa llvmpipe). Prints the batch
+    throughput in frames per second as JSON.
+
+    Usage: BatchRenderer [--script file.txt | --frames N] [--out-dir dir] [--width X] [--height Y] [--samples S]
+                         [--spheres N] [--lights M] [--ring R] [--threads T] [--sync] [--software] [--out file.json]
+    Each script line is "output.png eyeX eyeY eyeZ targetX targetY targetZ", blank lines and lines starting with #
+    are skipped. Without a script, --frames cameras orbit the grid and write out-dir/frame_00000.png and on.
+    Run from the build directory like the main executable so ../Resources resolves.
+*/
+
+//====| Includes |====//
+#include <glad/glad.h>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb_image_write.h>
+
+#include "../Engine/Shader.h"
+#include "../Engine/ShaderQueue.h"
+#include "../Engine/ShaderVariants.h"
+#include "../Engine/Shape.h"
+#include "../Engine/Light.h"
+#include "../Engine/MatrixStack.h"
+#include "../Engine/Camera.h"
+#include "../Engine/Material.h"
+#include "../Engine/JobSystem.h"
+#include "../Engine/ObjLoader.h"
+#include "../Engine/RenderQueue.h"
+#include "../Engine/RenderBackend.h"
+#include "../Engine/SoftwareBackend.h"
+#include "../Engine/RenderTarget.h"
+#include "../Engine/AsyncReadback.h"
+#include "../Benchmarks/BenchmarkScene.h"
+
+//====| Types |====//
+struct BatchOptions
+{
+    std::string script;
+    int frames = 120; // Orbit cameras when there is no script
+    std::string outDir = ".";
+    int width = 256;
+    int height = 256;
+    int samples = 0;
+    int spheres = 64;
+    int lights = 4;
+    int ring = 3;      // Readbacks in flight
+    int threads = 0;   // Encoding threads including the context thread, 0 for every hardware thread
+    bool sync = false; // Blocking readback and encoding on the context thread
+    bool software = false; // Draw with the SoftwareBackend instead of OpenGL
+    std::string out;
+};
+
+struct BatchFrame
+{
+    std::string path;
+    glm::vec3 eye, target;
+};
+
+//====| Function Declarations |====//
+bool parseOptions(int argc, char **argv, BatchOptions &options);               // Read command line flags
+bool loadScript(const BatchOptions &options, std::vector<BatchFrame> &frames); // Read or generate the cameras
+bool encodePNG(const std::string &path, const unsigned char *pixels, int width, int height); // RGBA rows bottom up
+
+//====| Main |====//
+int main(int argc, char **argv)
+{
+    BatchOptions options;
+    std::vector<BatchFrame> frames;
+    if (!parseOptions(argc, argv, options) || !loadScript(options, frames))
+    {
+        return 1;
+    }
+    HeadlessContext ctx;
+    if (!initHeadlessContext(ctx, 3, 3))
+    {
+        return 1;
+    }
+    stbi_flip_vertically_on_write(1); // glReadPixels rows start at the bottom
+
+    // The software backend draws into an image of its own
+    RenderTarget *target = nullptr;
+    if (!options.software)
+    {
+        target = new RenderTarget(options.width, options.height, options.samples);
+        if (!target->Valid())
+        {
+            return 1;
+        }
+        target->Bind();
+        glEnable(GL_DEPTH_TEST);
+    }
+
+    // Scene setup is not timed: the sphere grid of RenderBenchmark
+    ShaderQueue shaderQueue((GLADloadproc)eglGetProcAddress);
+    Shader lightShader("../Resources/Shaders/Simple.vs", "../Resources/Shaders/Simple.fs", true);
+    shaderQueue.Add(&lightShader);
+    ShaderVariants variants("../Resources/Shaders/Simple.vs", "../Resources/Shaders/Simple.fs", &shaderQueue);
+    MatrixStack *ms = MatrixStack::getInstance();
+    Camera camera(ms);
+    camera.SetShader(&lightShader);
+
+    // The meshes are read once, the software backend gets the same triangles as the GL buffers
+    std::vector<Vertex> sphereMesh, markerMesh;
+    if (!ObjLoader::Load("../Resources/Models/sphere.obj", sphereMesh) || !ObjLoader::Load("../Resources/Models/cube.obj", markerMesh))
+    {
+        return 1;
+    }
+    std::vector<Shape *> spheres;
+    int side = (int)std::ceil(std::sqrt((double)options.spheres));
+    for (int i = 0; i < options.spheres; i++)
+    {
+        Shape *sphere = new Shape(GL_STATIC_DRAW, sphereMesh);
+        sphere->SetMaterial(i % 2 == 0 ? Materials::emerald : Materials::brass);
+        sphere->SetTransform(sphereTransform(i, side));
+        spheres.push_back(sphere);
+    }
+    std::vector<PointLight *> pointLights;
+    std::vector<Light *> lights;
+    DirectionalLight sun = sceneSun();
+    lights.push_back(new Light(&sun, &lightShader, std::vector<Vertex>()));
+    for (int i = 0; i < options.lights; i++)
+    {
+        PointLight *pl = new PointLight(scenePointLight(i, options.lights, side));
+        pointLights.push_back(pl);
+        lights.push_back(new Light(pl, &lightShader, markerMesh));
+    }
+    float aspect = (float)options.width / options.height;
+    variants.OnCompile(LightIndex::addShader);
+    variants.OnCompile([aspect](Shader *s)
+                       { s->usePerspective(glm::radians(45.0f), aspect, 0.1f, 200.0f); });
+    lightShader.usePerspective(glm::radians(45.0f), aspect, 0.1f, 200.0f);
+    camera.SetProjection(lightShader.getProjection());
+    for (Shape *sphere : spheres)
+    {
+        sphere->SetShader(&variants);
+    }
+    shaderQueue.WaitAll();
+
+    JobSystem jobs(options.sync ? 1 : options.threads);
+    RenderQueue queue(&jobs);
+    GlBackend glBackend;
+    SoftwareBackend *softwareBackend = nullptr;
+    RenderBackend *backend = &glBackend;
+    if (options.software)
+    {
+        softwareBackend = new SoftwareBackend(&jobs, options.width, options.height);
+        softwareBackend->SetClearColor(vec3(0.25f, 0.3f, 0.3f));
+        for (Shape *sphere : spheres)
+        {
+            softwareBackend->AddShape(sphere, sphereMesh);
+        }
+        for (Light *light : lights)
+        {
+            if (light->GetMesh() != nullptr)
+            {
+                softwareBackend->AddShape(light->GetMesh(), markerMesh);
+            }
+        }
+        backend = softwareBackend;
+    }
+    AsyncReadback *readback = new AsyncReadback(&jobs, options.ring);
+    FramePacket packet;
+    packet.width = options.width;
+    packet.height = options.height;
+    std::vector<unsigned char> pixels;
+    std::atomic<int> failed(0);
+    auto start = std::chrono::steady_clock::now();
+    for (const BatchFrame &frame : frames)
+    {
+        packet.Reset();
+        camera.LookAt(frame.eye, frame.target);
+        camera.Update();
+        for (Shape *sphere : spheres)
+        {
+            queue.Submit(sphere);
+        }
+        for (Light *light : lights)
+        {
+            if (light->GetMesh() != nullptr)
+            {
+                queue.Submit(light->GetMesh());
+            }
+        }
+        queue.Build(camera.GetView(), camera.GetProjection());
+        queue.TakeDrawList(packet.draws);
+        queue.Clear();
+        packet.viewPos = camera.GetPosition();
+        packet.view = camera.GetView();
+        packet.projection = camera.GetProjection();
+        if (packet.lightVersion != LightIndex::version)
+        {
+            LightIndex::snapshot(packet.lights);
+            packet.lightVersion = LightIndex::version;
+        }
+
+        if (!options.software)
+        {
+            glClearColor(0.25f, 0.3f, 0.3f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        }
+        backend->Draw(packet);
+
+        if (options.software)
+        {
+            if (!encodePNG(frame.path, softwareBackend->Pixels(), options.width, options.height))
+            {
+                failed++;
+            }
+        }
+        else if (options.sync)
+        {
+            target->Resolve();
+            pixels.resize((size_t)options.width * options.height * 4);
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, target->ReadFramebuffer());
+            glPixelStorei(GL_PACK_ALIGNMENT, 1);
+            glReadPixels(0, 0, options.width, options.height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+            target->Bind();
+            if (!encodePNG(frame.path, pixels.data(), options.width, options.height))
+            {
+                failed++;
+            }
+        }
+        else
+        {
+            const std::string &path = frame.path;
+            readback->Request(*target, [&path, &failed](const unsigned char *data, int width, int height)
+                             {
+                                 if (data == nullptr)
+                                 {
+                                     std::cout << "Cannot read back " << path << std::endl;
+                                     failed++;
+                                 }
+                                 else if (!encodePNG(path, data, width, height))
+                                 {
+                                     failed++;
+                                 } });
+        }
+        RenderStats::endFrame();
+    }
+    readback->Flush();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    const AsyncReadback::Stats &stats = readback->GetStats();
+    std::ostringstream json;
+    json << "{\n"
+         << "  \"renderer\": \"" << (options.software ? backend->Name() : (const char *)glGetString(GL_RENDERER)) << "\",\n"
+         << "  \"readback\": \"" << (options.software ? "none" : options.sync ? "sync" : "async") << "\",\n"
+         << "  \"width\": " << options.width << ",\n"
+         << "  \"height\": " << options.height << ",\n"
+         << "  \"samples\": " << (options.software ? 0 : target->Samples()) << ",\n"
+         << "  \"threads\": " << jobs.Threads() << ",\n"
+         << "  \"ring\": " << (options.sync || options.software ? 0 : options.ring) << ",\n"
+         << "  \"frames\": " << frames.size() << ",\n"
+         << "  \"failed\": " << failed.load() << ",\n"
+         << "  \"seconds\": " << seconds << ",\n"
+         << "  \"frames_per_second\": " << frames.size() / seconds << ",\n"
+         << "  \"readback_failed\": " << stats.failed << ",\n"
+         << "  \"stalls\": " << stats.stalls << ",\n"
+         << "  \"stall_ms\": " << stats.stallMs << ",\n"
+         << "  \"copy_ms\": " << stats.copyMs << ",\n"
+         << "  \"help_ms\": " << stats.helpMs << "\n"
+         << "}\n";
+    std::cout << json.str();
+    if (!options.out.empty())
+    {
+        std::ofstream file(options.out);
+        file << json.str();
+    }
+
+    for (Light *light : lights)
+    {
+        delete light;
+    }
+    for (PointLight *pl : pointLights)
+    {
+        delete pl;
+    }
+    for (Shape *sphere : spheres)
+    {
+        delete sphere;
+    }
+    delete readback;
+    delete softwareBackend;
+    delete target;
+    ObjectBuffer::destroyInstance();
+    MaterialBuffer::destroyBuffer();
+    destroyHeadlessContext(ctx);
+    return failed.load() == 0 ? 0 : 1;
+}
+
+//====| Function Definitions |====//
+
+/*
+    Reads the command line flags into the options struct
+    Parameters: int argc, char** argv, BatchOptions& options
+    Returns: Boolean, false on unknown or malformed flags
+*/
+bool parseOptions(int argc, char **argv, BatchOptions &options)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--sync")
+            options.sync = true;
+        else if (arg == "--software")
+            options.software = true;
+        else if (arg == "--script" && hasValue)
+            options.script = argv[++i];
+        else if (arg == "--frames" && hasValue)
+            options.frames = std::atoi(argv[++i]);
+        else if (arg == "--out-dir" && hasValue)
+            options.outDir = argv[++i];
+        else if (arg == "--width" && hasValue)
+            options.width = std::atoi(argv[++i]);
+        else if (arg == "--height" && hasValue)
+            options.height = std::atoi(argv[++i]);
+        else if (arg == "--samples" && hasValue)
+            options.samples = std::atoi(argv[++i]);
+        else if (arg == "--spheres" && hasValue)
+            options.spheres = std::atoi(argv[++i]);
+        else if (arg == "--lights" && hasValue)
+            options.lights = std::atoi(argv[++i]);
+        else if (arg == "--ring" && hasValue)
+            options.ring = std::atoi(argv[++i]);
+        else if (arg == "--threads" && hasValue)
+            options.threads = std::atoi(argv[++i]);
+        else if (arg == "--out" && hasValue)
+            options.out = argv[++i];
+        else
+        {
+            std::cout << "Usage: BatchRenderer [--script file.txt | --frames N] [--out-dir dir] [--width X] [--height Y]"
+                      << " [--samples S] [--spheres N] [--lights M] [--ring R] [--threads T] [--sync] [--software]"
+                      << " [--out file.json]" << std::endl;
+            return false;
+        }
+    }
+    if (options.lights > MAX_VARIANT_POINT_LIGHTS)
+    {
+        std::cout << "At most " << MAX_VARIANT_POINT_LIGHTS << " point lights are supported" << std::endl;
+        return false;
+    }
+    if (options.width < 1 || options.height < 1 || options.spheres < 1 || options.frames < 1 || options.ring < 1)
+    {
+        std::cout << "--width, --height, --spheres, --frames and --ring must be positive" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+/*
+    Reads the cameras of the batch from the script, or places --frames cameras on an orbit around the grid
+    Parameters: const BatchOptions& options, std::vector<BatchFrame>& frames
+    Returns: Boolean, false when the script cannot be read or has a malformed line
+*/
+bool loadScript(const BatchOptions &options, std::vector<BatchFrame> &frames)
+{
+    if (options.script.empty())
+    {
+        float radius = std::ceil(std::sqrt((double)options.spheres)) * 2.0f + 4.0f;
+        for (int i = 0; i < options.frames; i++)
+        {
+            char name[32];
+            snprintf(name, sizeof(name), "/frame_%05d.png", i);
+            float angle = glm::radians(360.0f * i / options.frames);
+            vec3 eye(std::cos(angle) * radius, radius * 0.5f, std::sin(angle) * radius);
+            frames.push_back(BatchFrame{options.outDir + name, eye, vec3(0.0f)});
+        }
+        return true;
+    }
+
+    std::ifstream file(options.script);
+    if (!file)
+    {
+        std::cout << "Cannot read " << options.script << std::endl;
+        return false;
+    }
+    std::string line;
+    for (int number = 1; std::getline(file, line); number++)
+    {
+        std::istringstream fields(line);
+        BatchFrame frame;
+        if (!(fields >> frame.path) || frame.path[0] == '#')
+        {
+            continue;
+        }
+        if (!(fields >> frame.eye.x >> frame.eye.y >> frame.eye.z >> frame.target.x >> frame.target.y >> frame.target.z))
+        {
+            std::cout << options.script << ":" << number << ": expected output.png and six coordinates" << std::endl;
+            return false;
+        }
+        if (frame.path[0] != '/')
+        {
+            frame.path = options.outDir + "/" + frame.path;
+        }
+        frames.push_back(frame);
+    }
+    if (frames.empty())
+    {
+        std::cout << options.script << " has no frames" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+/*
+    Encodes an image as PNG, safe to call from several threads at once
+    Parameters: const std::string& path, const unsigned char* pixels (RGBA, rows from the bottom up), int width,
+                int height
+    Returns: Boolean
+*/
+bool encodePNG(const std::string &path, const unsigned char *pixels, int width, int height)
+{
+    if (!stbi_write_png(path.c_str(), width, height, 4, pixels, width * 4))
+    {
+        std::cout << "Cannot write " << path << std::endl;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,232 @@
+/**
+    @file LightmapBaker.cpp
+    @brief Bakes the static lights of a scene file into lightmaps, headless and on every core
+    @details Reads the scene, loads its meshes in parallel and places them in world space like Scene does, then
+    bakes the sun and the point lights into a lightmap per object (see Engine/LightmapBaker.h). Objects whose mesh
+    is split into meshlets share vertices between triangles and cannot take the per-triangle lightmap coordinates,
+    and objects with more triangles than a lightmap of --max-size texels holds are reported and left out too; they
+    keep their dynamic lighting but still cast shadows into the lightmaps. Each lightmap is written as a
+    Radiance HDR image next to the output scene, out_lightmap<N>.hdr for object N, and the output scene is the
+    input with the lightmaps declared as textures and given to their objects; lightmaps of an earlier bake are
+    replaced. The output is written in the binary form when its name ends in .bscene. Needs no window or GL
+    context. Prints the BVH, the texel and ray counts and the rays per second.
+
+    Usage: LightmapBaker in.scene out.scene [--density texels-per-unit] [--max-size N] [--bounce samples]
+                         [--threads T]
+    Run from the build directory like the main executable so the scene's ../Resources paths resolve.
+*/
+
+//====| Includes |====//
+#include <glm/glm.hpp>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb_image_write.h>
+
+#include "../Engine/JobSystem.h"
+#include "../Engine/LightmapBaker.h"
+#include "../Engine/ObjLoader.h"
+#include "../Engine/SceneFile.h"
+#include "../Engine/Transform.h"
+
+//====| Types |====//
+struct BakeOptions
+{
+    std::string in, out;
+    LightmapBaker::Settings settings;
+    int threads = 0; // 0 for every hardware thread
+};
+
+//====| Function Declarations |====//
+bool parseOptions(int argc, char **argv, BakeOptions &options);                // Read the paths and command line flags
+void removeLightmaps(SceneFile::Description &scene);                           // Drop the lightmaps of an earlier bake
+bool writeScene(const std::string &path, const SceneFile::Description &scene); // Text or binary by extension
+
+//====| Main |====//
+int main(int argc, char **argv)
+{
+    BakeOptions options;
+    SceneFile::Description scene;
+    if (!parseOptions(argc, argv, options) || !SceneFile::Read(options.in, scene))
+    {
+        return 1;
+    }
+    removeLightmaps(scene);
+    JobSystem jobs(options.threads);
+
+    // Every mesh once, in parallel
+    std::vector<std::vector<Vertex>> meshes(scene.meshes.size());
+    std::vector<char> loaded(scene.meshes.size(), 0);
+    jobs.ParallelFor((int)scene.meshes.size(), 1, [&](int begin, int end)
+                     {
+                         for (int i = begin; i < end; i++)
+                         {
+                             loaded[i] = ObjLoader::Load(scene.meshes[i].path, meshes[i]) ? 1 : 0;
+                         } });
+    for (size_t i = 0; i < meshes.size(); i++)
+    {
+        if (!loaded[i])
+        {
+            return 1;
+        }
+    }
+
+    // Objects in world space, placed like Scene::Load places them
+    LightmapBaker baker(options.settings);
+    std::vector<glm::vec3> positions, normals;
+    for (const SceneFile::ObjectRecord &object : scene.objects)
+    {
+        Transform transform;
+        transform.Translate(object.position);
+        if (object.rotation != 0)
+        {
+            transform.Rotate(glm::radians(object.rotation), object.rotationAxis);
+        }
+        transform.Scale(object.scale);
+        glm::mat4 world = transform.World();
+        glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(world)));
+        const std::vector<Vertex> &mesh = meshes[object.mesh];
+        positions.resize(mesh.size());
+        normals.resize(mesh.size());
+        for (size_t i = 0; i < mesh.size(); i++)
+        {
+            positions[i] = glm::vec3(world * glm::vec4(mesh[i].position, 1.0f));
+            normals[i] = normalMatrix * mesh[i].normal;
+        }
+        const SceneFile::MaterialEntry *material = object.material >= 0 ? &scene.materials[object.material] : nullptr;
+        baker.AddObject(positions, normals, material, !scene.meshes[object.mesh].meshlets);
+    }
+    baker.SetSun(scene.sun);
+    for (const SceneFile::PointLightRecord &light : scene.pointLights)
+    {
+        baker.AddPointLight(light);
+    }
+    baker.Bake(&jobs);
+
+    // The lightmaps next to the output scene, which refers to them
+    std::string stem = options.out.substr(0, options.out.rfind('.'));
+    stbi_flip_vertically_on_write(1); // Rows start at the bottom, as Scene loads them
+    for (size_t i = 0; i < scene.objects.size(); i++)
+    {
+        const LightmapBaker::Image &image = baker.GetLightmap((int)i);
+        if (image.width == 0)
+        {
+            continue;
+        }
+        SceneFile::TextureEntry texture;
+        texture.name = "lightmap" + std::to_string(i);
+        texture.path = stem + "_lightmap" + std::to_string(i) + ".hdr";
+        if (!stbi_write_hdr(texture.path.c_str(), image.width, image.height, 3, image.pixels.data()))
+        {
+            std::cout << "Cannot write " << texture.path << std::endl;
+            return 1;
+        }
+        scene.objects[i].lightmap = (int32_t)scene.textures.size();
+        scene.textures.push_back(texture);
+    }
+    if (!writeScene(options.out, scene))
+    {
+        return 1;
+    }
+    baker.PrintStats();
+    std::cout << "Wrote " << options.out << std::endl;
+    return 0;
+}
+
+//====| Function Definitions |====//
+
+/*
+    Reads the paths and command line flags
+    Parameters: int argc, char** argv, BakeOptions& options
+    Returns: bool, false after printing the usage when they are malformed
+*/
+bool parseOptions(int argc, char **argv, BakeOptions &options)
+{
+    bool valid = argc >= 3;
+    for (int i = 3; valid && i < argc; i++)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--density" && hasValue)
+            options.settings.texelsPerUnit = (float)std::atof(argv[++i]);
+        else if (arg == "--max-size" && hasValue)
+            options.settings.maxResolution = std::atoi(argv[++i]);
+        else if (arg == "--bounce" && hasValue)
+            options.settings.bounceSamples = std::atoi(argv[++i]);
+        else if (arg == "--threads" && hasValue)
+            options.threads = std::atoi(argv[++i]);
+        else
+            valid = false;
+    }
+    if (!valid)
+    {
+        std::cout << "Usage: LightmapBaker in.scene out.scene [--density texels-per-unit] [--max-size N]"
+                  << " [--bounce samples] [--threads T]" << std::endl;
+        return false;
+    }
+    options.in = argv[1];
+    options.out = argv[2];
+    if (options.settings.texelsPerUnit <= 0 || options.settings.maxResolution < LIGHTMAP_MIN_CELL ||
+        options.settings.bounceSamples < 0)
+    {
+        std::cout << "--density must be positive, --max-size at least " << LIGHTMAP_MIN_CELL
+                  << " and --bounce at least 0" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+/*
+    Drops the lightmaps of an earlier bake and the textures declared for them
+    Parameters: SceneFile::Description& scene
+    Returns: None
+*/
+void removeLightmaps(SceneFile::Description &scene)
+{
+    // Textures only ever used as lightmaps go, every other one is kept in its order
+    std::vector<bool> lightmap(scene.textures.size(), false), texture(scene.textures.size(), false);
+    for (const SceneFile::ObjectRecord &object : scene.objects)
+    {
+        if (object.lightmap >= 0)
+        {
+            lightmap[object.lightmap] = true;
+        }
+        if (object.texture >= 0)
+        {
+            texture[object.texture] = true;
+        }
+    }
+    std::vector<int> remap(scene.textures.size(), -1);
+    std::vector<SceneFile::TextureEntry> textures;
+    for (size_t i = 0; i < scene.textures.size(); i++)
+    {
+        if (!lightmap[i] || texture[i])
+        {
+            remap[i] = (int)textures.size();
+            textures.push_back(scene.textures[i]);
+        }
+    }
+    for (SceneFile::ObjectRecord &object : scene.objects)
+    {
+        object.lightmap = -1;
+        if (object.texture >= 0)
+        {
+            object.texture = remap[object.texture];
+        }
+    }
+    scene.textures.swap(textures);
+}
+
+/*
+    Writes the scene in the binary form for .bscene paths, in the text form otherwise
+    Parameters: const std::string& path, const SceneFile::Description& scene
+    Returns: bool, whether the file could be written
+*/
+bool writeScene(const std::string &path, const SceneFile::Description &scene)
+{
+    bool binary = path.size() > 7 && path.compare(path.size() - 7, 7, ".bscene") == 0;
+    return binary ? SceneFile::WriteBinary(path, scene) : SceneFile::WriteText(path, scene);
+}
@@ -0,0 +1,85 @@
+/**
+    @file MeshChunker.cpp
+    @brief Converts OBJ models into chunked mesh files for MeshStreamer
+    @details Parses the whole OBJ, splits its triangles into spatial chunks with a coarse proxy each and writes the
+    chunked mesh file (see Engine/ChunkedMesh.h). Run it offline on models too large to load at once.
+
+    Usage: MeshChunker in.obj out.cmesh [--triangles N]
+*/
+
+//====| Includes |====//
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#include "../Engine/ChunkedMesh.h"
+
+//====| Function Declarations |====//
+void printUsage(); // Prints the command line usage
+
+//====| Main |====//
+int main(int argc, char **argv)
+{
+    if (argc < 3)
+    {
+        printUsage();
+        return 1;
+    }
+    std::string objPath = argv[1], path = argv[2];
+    int triangles = ChunkedMesh::DEFAULT_TRIANGLES_PER_CHUNK;
+    for (int i = 3; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--triangles") == 0 && i + 1 < argc)
+        {
+            triangles = std::max(1, atoi(argv[++i]));
+        }
+        else
+        {
+            printUsage();
+            return 1;
+        }
+    }
+
+    if (!ChunkedMesh::Convert(objPath, path, triangles))
+    {
+        return 1;
+    }
+
+    FILE *file = fopen(path.c_str(), "rb");
+    ChunkedMesh::FileHeader header;
+    std::vector<ChunkedMesh::ChunkEntry> entries;
+    if (file == NULL || !ChunkedMesh::ReadTable(file, header, entries))
+    {
+        std::cout << "Cannot read back " << path << std::endl;
+        if (file != NULL)
+        {
+            fclose(file);
+        }
+        return 1;
+    }
+    fclose(file);
+    unsigned long long vertices = 0, proxyVertices = 0;
+    for (const ChunkedMesh::ChunkEntry &entry : entries)
+    {
+        vertices += entry.vertexCount;
+        proxyVertices += entry.proxyVertexCount;
+    }
+    std::cout << "Wrote " << path << ": " << header.chunkCount << " chunks, " << vertices / 3 << " triangles, "
+              << proxyVertices / 3 << " proxy triangles" << std::endl;
+    return 0;
+}
+
+//====| Function Definitions |====//
+
+/*
+    Prints the command line usage
+    Parameters: None
+    Returns: None
+*/
+void printUsage()
+{
+    std::cout << "Usage: MeshChunker in.obj out.cmesh [--triangles N]" << std::endl
+              << "  --triangles N  average triangles per chunk (default "
+              << ChunkedMesh::DEFAULT_TRIANGLES_PER_CHUNK << ")" << std::endl;
+}
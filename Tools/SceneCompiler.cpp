@@ -0,0 +1,55 @@
+/**
+    @file SceneCompiler.cpp
+    @brief Compiles text scene files into the binary form
+    @details Parses the text scene, resolving every name to an index, and writes the binary scene file (see
+    Engine/SceneFile.h) that Scene loads without parsing. The referenced assets are not touched, the binary scene
+    points at the same files.
+
+    Usage: SceneCompiler in.scene out.bscene
+*/
+
+//====| Includes |====//
+#include <iostream>
+#include <string>
+
+#include "../Engine/SceneFile.h"
+
+//====| Function Declarations |====//
+void printUsage(); // Prints the command line usage
+
+//====| Main |====//
+int main(int argc, char **argv)
+{
+    if (argc != 3)
+    {
+        printUsage();
+        return 1;
+    }
+    std::string inPath = argv[1], path = argv[2];
+    SceneFile::Description scene, check;
+    if (!SceneFile::Read(inPath, scene) || !SceneFile::WriteBinary(path, scene))
+    {
+        return 1;
+    }
+    if (!SceneFile::Read(path, check) || check.objects.size() != scene.objects.size())
+    {
+        std::cout << "Cannot read back " << path << std::endl;
+        return 1;
+    }
+    std::cout << "Wrote " << path << ": " << scene.meshes.size() << " meshes, " << scene.textures.size()
+              << " textures, " << scene.materials.size() << " materials, " << scene.objects.size() << " objects, "
+              << scene.pointLights.size() + (scene.sun.enabled ? 1 : 0) << " lights" << std::endl;
+    return 0;
+}
+
+//====| Function Definitions |====//
+
+/*
+    Prints the command line usage
+    Parameters: None
+    Returns: None
+*/
+void printUsage()
+{
+    std::cout << "Usage: SceneCompiler in.scene out.bscene" << std::endl;
+}
@@ -11,12 +11,25 @@
 #include <stdio.h>
 
 #include "Engine/Shader.h"
+#include "Engine/ShaderQueue.h"
+#include "Engine/ShaderVariants.h"
 #include "Engine/Shape.h"
+#include "Engine/ChunkedMesh.h"
+#include "Engine/MeshStreamer.h"
+#include "Engine/JobSystem.h"
+#include "Engine/RenderQueue.h"
+#include "Engine/RenderThread.h"
+#include "Engine/SoftwareBackend.h"
 #include "Engine/Texture.h"
 #include "Engine/Light.h"
 #include "Engine/MatrixStack.h"
 #include "Engine/Camera.h"
 #include "Engine/Material.h"
+#include "Engine/Scene.h"
+#include "Engine/Picker.h"
+#include "Engine/CascadedShadowMap.h"
+#include "Engine/Profiler.h"
+#include "Engine/RenderStats.h"
 //====| Namespaces |====//
 using namespace std;
 
@@ -26,18 +39,25 @@ using glm::vec3;
 int _width = 800, _height = 600;
 float lastX = 400, lastY = 300; // Mouse variables
 bool isFirstMouse = true;
-Shape *currentShape;
+bool pickRequested = false; // Set by a click, handled once per frame
+Shape *currentShape = nullptr; // Moved by the arrow keys, picked with the mouse
 MatrixStack *ms;
 Camera *camera;
+Profiler *profiler;
+bool wireframe = false;
+bool depthPrepass = false;
 //====| Function Declarations |====//
 GLFWwindow *initWindow();                                                  // Create and initialize window to default variables
 bool initGlad();                                                           // Initialize glad to expose OpenGL function pointers
 void framebuffer_size_callback(GLFWwindow *window, int width, int height); // function that sets GLFWwindow size when user changes it
 void mouse_callback(GLFWwindow *window, double xpos, double ypos);         // Mouse input callback
-void processInput(GLFWwindow *window);                                     // Process user input
+void mouse_button_callback(GLFWwindow *window, int button, int action, int mods); // Mouse click callback
+void processInput(GLFWwindow *window, FramePacket *packet);                 // Process user input
+bool keyPressed(GLFWwindow *window, int key);                              // True only on the frame a key goes down
+SoftwareBackend *createSoftwareBackend(GLFWwindow *window, const Scene &scene, JobSystem *jobs); // CPU renderer of the scene
 
 //====| Main |====//
-int main(int, char **)
+int main(int argc, char **argv)
 {
     GLFWwindow *window = initWindow();
     if (window == NULL) // If failed, exit
@@ -45,12 +65,23 @@ int main(int, char **)
         return 1;
     }
 
-    Shader shader1("../Resources/Shaders/Simple.vs", "../Resources/Shaders/Simple.fs");
-    Shader shader2("../Resources/Shaders/4.1.texture.vs", "../Resources/Shaders/4.1.texture.fs");
+    // Submit every program up front, they finish compiling in the background and are picked up by Poll()
+    ShaderQueue shaderQueue((GLADloadproc)glfwGetProcAddress);
+    Shader shader1("../Resources/Shaders/Simple.vs", "../Resources/Shaders/Simple.fs", true);
+    Shader shader2("../Resources/Shaders/4.1.texture.vs", "../Resources/Shaders/4.1.texture.fs", true);
+    shaderQueue.Add(&shader1);
+    shaderQueue.Add(&shader2);
+    Shader depthShader("../Resources/Shaders/Depth.vs", "../Resources/Shaders/Depth.fs", true);
+    shaderQueue.Add(&depthShader);
+
+    RenderStats::enableDebugOutput((GLADloadproc)glfwGetProcAddress);
+
+    profiler = Profiler::getInstance();
+    profiler->EnableGPU();
 
     ms = MatrixStack::getInstance();
-    camera = new Camera(ms);
-    camera->SetShader(&shader1);
+    camera = new Camera(ms); // viewPos reaches the shaders through the frame packets
+    camera->SetProjection(shader1.getProjection());
 
     // VAO textureVAO = bindImageToVAO();
     // Vertices coordinates
@@ -115,15 +146,6 @@ int main(int, char **)
     // texShape.SetTexture(tex);
     // texShape.Unbind();
 
-    Shape shape1 = Shape(GL_STATIC_DRAW, "../Resources/Models/sphere.obj");
-    shape1.SetShader(&shader1);
-
-    // Move the shape into the view volume for viewing
-    // shape1.Translate(glm::vec3(0, 0, 5.0f));
-
-    // Set shape material
-    shape1.SetMaterial(Materials::emerald);
-
     // Shape shape2 = Shape(GL_STATIC_DRAW, "../Resources/Models/cube2.obj");
     // shape2.SetVertexPointer(0, 3, 3, 0);
     // shape2.SetDrawData(0, 12 * 3);
@@ -132,50 +154,245 @@ int main(int, char **)
     // // Move the shape into the view volume for viewing
     // shape2.Translate(glm::vec3(0, 5.0f, 5.0f));
 
-    DirectionalLight *dl = new DirectionalLight();
-    dl->direction = vec3(0, -1, 0);
-    dl->ambient = vec3(0.6f, 0.6f, 0.6f);
-    dl->diffuse = vec3(0.5f, 0.5f, 0.5f);
-    dl->specular = vec3(1.0f, 1.0f, 1.0f);
+    // Transform composition, culling, sorting and asset loading run on every core
+    JobSystem jobs;
+
+    // The objects, materials and lights come from a scene file (a .scene or compiled .bscene given on the command
+    // line, the default scene otherwise); its meshes and images are read and decoded in parallel, then uploaded.
+    // --software draws the frames with the CPU rasterizer instead of OpenGL, for machines without a usable GPU.
+    std::string scenePath = "../Resources/Scenes/Default.scene";
+    std::string modelPath;
+    bool software = false;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "--software")
+            software = true;
+        else
+            modelPath = arg;
+    }
+    if (modelPath.find(".scene") != std::string::npos || modelPath.find(".bscene") != std::string::npos)
+    {
+        scenePath = modelPath;
+        modelPath.clear();
+    }
+    Scene scene;
+    if (software)
+    {
+        scene.KeepMeshes(); // The software backend cannot read the triangles back from the GL buffers
+    }
+    if (!scene.Load(scenePath, &shader1, &jobs))
+    {
+        glfwTerminate();
+        return 1;
+    }
+    scene.PrintTimings();
+
+    // Draw the objects with the cheapest Simple.vs/Simple.fs permutation for the scene, every variant gets the lights
+    ShaderVariants simpleVariants("../Resources/Shaders/Simple.vs", "../Resources/Shaders/Simple.fs", &shaderQueue);
+    simpleVariants.OnCompile(LightIndex::addShader);
+    scene.SetShader(&simpleVariants);
 
-    PointLight *pl = new PointLight();
-    pl->position = vec3(0, 3, 0);
-    pl->ambient = vec3(0.2f, 0.2f, 0.2f);
-    pl->diffuse = vec3(0.7f, 0.7f, 0.7f);
-    pl->specular = vec3(1.0f, 1.0f, 1.0f);
-    pl->quadratic = 0.00007;
-    pl->linear = 0.0014;
-    pl->constant = 1;
+    // The sun's shadows come from cascades that are cached while the scene and the light stay put, every variant
+    // receives them. The shape picked to be moved is drawn into them every frame instead (see the picking below).
+    CascadedShadowMap *shadows = new CascadedShadowMap(&depthShader);
+    for (Shape *shape : scene.GetShapes())
+    {
+        shadows->AddStatic(shape);
+    }
+    simpleVariants.OnCompile([shadows](Shader *s)
+                             { shadows->AddReceiver(s); });
 
-    Light l = Light(pl, &shader1);
+    // Clicking selects the shape under the crosshair, found by a ray cast through the BVHs of the scene's meshes
+    Picker picker;
+    for (Shape *shape : scene.GetShapes())
+    {
+        picker.Add(shape);
+    }
 
-    currentShape = &shape1;
+    // A model given on the command line is streamed in chunks, an OBJ is converted to a chunked mesh next to it first
+    MeshStreamer *streamer = nullptr;
+    if (!modelPath.empty())
+    {
+        std::string path = modelPath;
+        if (path.size() > 4 && path.compare(path.size() - 4, 4, ".obj") == 0)
+        {
+            std::string chunked = path.substr(0, path.size() - 4) + ".cmesh";
+            FILE *file = fopen(chunked.c_str(), "rb");
+            if (file != NULL)
+            {
+                fclose(file);
+            }
+            else
+            {
+                ChunkedMesh::Convert(path, chunked);
+            }
+            path = chunked;
+        }
+        streamer = new MeshStreamer(path);
+        streamer->SetShader(&simpleVariants);
+        streamer->SetMaterial(Materials::emerald);
+    }
 
     glEnable(GL_DEPTH_TEST);
 
+    // The simulation stays on this thread (GLFW input has to be polled here) while the render thread owns the
+    // context and draws the previous frame's packet. A latency of 1 overlaps the two threads, 0 runs them in lockstep.
+    RenderQueue renderQueue(&jobs);
+    OcclusionCuller occlusion(&jobs);
+    renderQueue.SetOcclusion(&occlusion);
+    RenderThread renderThread(1);
+    renderThread.SetDepthShader(&depthShader);
+    renderThread.SetShadows(shadows);
+
+    // The software backend rasterizes the same packets on a job system of its own, created on the render thread so
+    // that thread takes part in the work; the simulation resets the other one's arenas while the render thread draws
+    JobSystem *rasterJobs = nullptr;
+    SoftwareBackend *softwareBackend = nullptr;
+
+    LightIndex::deferUploads = true;
+    glfwMakeContextCurrent(NULL);
+
+    // Built with ENGINE_COUNT_ALLOCATIONS, frames after the warm-up must not touch the heap (streaming chunks does)
+    if (streamer == nullptr)
+        RenderStats::expectAllocationFree(120);
+
+    renderThread.Start([&]()
+                       {
+                           glfwMakeContextCurrent(window);
+                           if (software)
+                           {
+                               rasterJobs = new JobSystem();
+                               softwareBackend = createSoftwareBackend(window, scene, rasterJobs);
+                               renderThread.SetBackend(softwareBackend);
+                           } },
+                       [&](FramePacket &packet)
+                       {
+                           profiler->BeginFrame();
+
+                           // Pick up any programs that finished compiling, unfinished ones draw with the fallback
+                           shaderQueue.Poll();
+
+                           // Chunks the I/O threads finished reading become Shapes, evicted ones are deleted
+                           if (streamer != nullptr)
+                               streamer->Upload(packet.frame);
+
+                           // rendering commands
+                           glClearColor(0.25f, 0.3f, 0.3f, 1.0f);
+                           glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+                           renderThread.Draw(packet);
+                           if (softwareBackend != nullptr)
+                               softwareBackend->Present(packet.width, packet.height);
+
+                           // Profiler controls, the reports allocate so the allocation check skips their frames
+                           if (packet.printProfile || packet.printStats || packet.captureFrames > 0)
+                               packet.allocatingFrames = std::max(packet.allocatingFrames, packet.captureFrames + 2);
+                           if (packet.allocatingFrames > 0 && RenderStats::allocationFreeFrom >= 0)
+                               RenderStats::expectAllocationFree(std::max(RenderStats::allocationFreeFrom,
+                                                                          RenderStats::frameCount + packet.allocatingFrames));
+                           if (packet.printProfile)
+                               profiler->Print();
+                           if (packet.captureFrames > 0)
+                               profiler->Capture(packet.captureFrames, "profile_trace.json");
+                           if (packet.printStats)
+                               RenderStats::print();
+
+                           {
+                               PROFILE_SCOPE("SwapBuffers");
+                               glfwSwapBuffers(window);
+                           }
+                           profiler->EndFrame();
+                       },
+                       [&]()
+                       {
+                           delete softwareBackend;
+                           delete rasterJobs;
+                           glfwMakeContextCurrent(NULL);
+                       });
+
     while (!glfwWindowShouldClose(window)) // Where the window stuff happens.
     {
-        // input
-        processInput(window);
+        FramePacket *packet = renderThread.Acquire();
 
-        // rendering commands
-        glClearColor(0.25f, 0.3f, 0.3f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        // input
+        glfwPollEvents();
+        processInput(window, packet);
+        camera->Update(); // One view rebuild for all of this frame's mouse and key input
 
-        // texShape.Draw();
-        shape1.Draw();
-        l.Draw();
-        // shape2.Draw();
+        // The cursor is held in the middle of the window, so a click picks what is in the middle of the view
+        if (pickRequested)
+        {
+            pickRequested = false;
+            packet->allocatingFrames = 3; // Rebuilding the top level allocates, as the reports do
+            picker.Update(); // The selected shape may have moved
+            PickHit hit;
+            if (picker.PickScreen(0, 0, camera->GetView(), camera->GetProjection(), hit))
+            {
+                // The selection may move, so its shadow leaves the cache and the shape it replaces goes back in
+                if (hit.shape != currentShape)
+                {
+                    if (currentShape != nullptr)
+                        shadows->SetDynamic(currentShape, false);
+                    shadows->SetDynamic(hit.shape, true);
+                }
+                currentShape = hit.shape;
+                std::cout << "Picked triangle " << hit.triangle << " at distance " << hit.distance << " in "
+                          << picker.GetStats().pickUs << " us (" << picker.GetStats().shapesTested << " of "
+                          << picker.GetStats().shapes << " shapes tested)" << std::endl;
+            }
+        }
 
-        // shader1.setVec3("dirLight.direction", dl->direction);
-        // shader1.setVec3("dirLight.ambient", dl->ambient);
-        // shader1.setVec3("dirLight.diffuse", dl->diffuse);
-        // shader1.setVec3("dirLight.specular", dl->specular);
+        // texShape, shape2, ...
+        for (Shape *shape : scene.GetShapes())
+        {
+            renderQueue.Submit(shape);
+        }
+        for (Light *light : scene.GetLights())
+        {
+            if (light->GetMesh() != nullptr)
+            {
+                renderQueue.Submit(light->GetMesh());
+            }
+        }
+        if (streamer != nullptr)
+        {
+            streamer->Update(camera->GetViewProjection(), camera->GetPosition(), packet->frame);
+            streamer->Submit(renderQueue);
+            packet->streaming = streamer->GetStats();
+        }
+        renderQueue.Build(camera->GetView(), camera->GetProjection());
+        renderQueue.TakeDrawList(packet->draws);
+        packet->occlusion = occlusion.GetStats();
+        renderQueue.Clear();
+
+        packet->viewPos = camera->GetPosition();
+        packet->view = camera->GetView();
+        packet->projection = camera->GetProjection();
+        if (packet->lightVersion != LightIndex::version)
+        {
+            LightIndex::snapshot(packet->lights);
+            packet->lightVersion = LightIndex::version;
+        }
+        shadows->Capture(packet->casters);
+        packet->wireframe = wireframe;
+        packet->depthPrepass = depthPrepass;
+        glfwGetFramebufferSize(window, &packet->width, &packet->height);
 
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+        renderThread.Submit(packet);
+        jobs.ResetArenas(); // The workers' transient data, the packet keeps its own arena until it is reused
     }
 
+    renderThread.Stop();
+    glfwMakeContextCurrent(window);
+
+    delete streamer;
+
+    simpleVariants.Report();
+    shadows->PrintStats();
+    delete shadows;
+
+    ObjectBuffer::destroyInstance();
+    MaterialBuffer::destroyBuffer();
     glfwTerminate(); // Properly exit the application
     return 0;
 }
@@ -195,6 +412,9 @@ GLFWwindow *initWindow()
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE); // Specify which type of OpenGL to use
     glfwWindowHint(GLFW_MAXIMIZED, GL_TRUE);                       // Start in maximized mode
     glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);           // Needed for Mac
+#ifndef NDEBUG
+    glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, GL_TRUE); // Lets the driver report performance warnings to RenderStats
+#endif
 
     // Create the window and display it
     GLFWwindow *window = glfwCreateWindow(800, 600, "LearnOpenGL", NULL, NULL);
@@ -210,6 +430,7 @@ GLFWwindow *initWindow()
     glfwSetFramebufferSizeCallback(window, framebuffer_size_callback); // Call back so user can resize the window
     glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);       // Fix the cursor to the middle of the window
     glfwSetCursorPosCallback(window, mouse_callback);
+    glfwSetMouseButtonCallback(window, mouse_button_callback);
 
     if (!initGlad()) // If failed, exit
     {
@@ -254,8 +475,7 @@ bool initGlad()
 void framebuffer_size_callback(GLFWwindow *window, int width, int height)
 {
     _width = width;
-    _height = height;
-    glViewport(0, 0, _width, _height);
+    _height = height; // The render thread picks the new size up from the next frame packet
 }
 
 void mouse_callback(GLFWwindow *window, double xpos, double ypos)
@@ -283,11 +503,24 @@ void mouse_callback(GLFWwindow *window, double xpos, double ypos)
 }
 
 /*
-    Gets user input and responds accordingly
-    Parameters: GLFWwindow* window
+    Requests a pick on a left click, the main loop casts the ray once the frame's camera is known
+    Parameters: GLFWwindow* window, int button, int action, int mods
+    Returns: None
+*/
+void mouse_button_callback(GLFWwindow *window, int button, int action, int mods)
+{
+    if (button == GLFW_MOUSE_BUTTON_LEFT && action == GLFW_PRESS)
+    {
+        pickRequested = true;
+    }
+}
+
+/*
+    Gets user input and responds accordingly, GL work is requested through the frame packet
+    Parameters: GLFWwindow* window, FramePacket* packet
     Returns: None
 */
-void processInput(GLFWwindow *window)
+void processInput(GLFWwindow *window, FramePacket *packet)
 {
     if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
     {
@@ -295,13 +528,25 @@ void processInput(GLFWwindow *window)
     }
     if (glfwGetKey(window, GLFW_KEY_R) == GLFW_PRESS)
     {
-        glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+        wireframe = true;
     }
     if (glfwGetKey(window, GLFW_KEY_F) == GLFW_PRESS)
     {
-        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+        wireframe = false;
     }
 
+    // Profiler controls
+    if (keyPressed(window, GLFW_KEY_F1))
+        packet->printProfile = true;
+    if (keyPressed(window, GLFW_KEY_F2))
+        packet->captureFrames = 120;
+    if (keyPressed(window, GLFW_KEY_F3))
+        packet->printStats = true;
+
+    // Depth pre-pass toggle, compare frame times with F1/F3 on and off
+    if (keyPressed(window, GLFW_KEY_F4))
+        depthPrepass = !depthPrepass;
+
     // Shape controls
     if (currentShape != nullptr)
     {
@@ -353,4 +598,46 @@ void processInput(GLFWwindow *window)
         if (glfwGetKey(window, GLFW_KEY_E) == GLFW_PRESS)
             camera->Roll(-.025);
     }
-}
\ No newline at end of file
+}
+
+/*
+    Edge-triggered key check so held keys only fire once
+    Parameters: GLFWwindow* window, int key
+    Returns: Boolean
+*/
+bool keyPressed(GLFWwindow *window, int key)
+{
+    static bool down[GLFW_KEY_LAST + 1] = {};
+    bool pressed = glfwGetKey(window, key) == GLFW_PRESS;
+    bool fired = pressed && !down[key];
+    down[key] = pressed;
+    return fired;
+}
+
+/*
+    Creates the CPU renderer of the scene at the window's size with the scene's triangles, which must have been kept
+    (Scene::KeepMeshes). Textures, shadows and streamed chunks are not drawn by it.
+    Parameters: GLFWwindow* window, const Scene& scene, JobSystem* jobs (spreads the rasterizer's passes)
+    Returns: SoftwareBackend*
+*/
+SoftwareBackend *createSoftwareBackend(GLFWwindow *window, const Scene &scene, JobSystem *jobs)
+{
+    int width, height;
+    glfwGetFramebufferSize(window, &width, &height);
+    SoftwareBackend *backend = new SoftwareBackend(jobs, width, height);
+    backend->SetClearColor(glm::vec3(0.25f, 0.3f, 0.3f));
+    for (Shape *shape : scene.GetShapes())
+    {
+        backend->AddShape(shape, *scene.GetMesh(shape));
+    }
+    for (Light *light : scene.GetLights())
+    {
+        if (light->GetMesh() != nullptr)
+        {
+            backend->AddShape(light->GetMesh(), *scene.GetMesh(light->GetMesh()));
+        }
+    }
+    std::cout << "Rendering " << width << "x" << height << " with the " << backend->Name() << " ("
+              << SimdMath::levelName(SimdMath::active) << ", " << jobs->Threads() << " threads)" << std::endl;
+    return backend;
+}